@@ -0,0 +1,63 @@
+#ifndef LIBMODBUS_CPP_BENCHMARK_H_GUARD
+#define LIBMODBUS_CPP_BENCHMARK_H_GUARD
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace libmodbus_cpp {
+namespace bench {
+
+
+/// benchmark body runs given count of iterations of measured operation
+using BenchmarkFunction = std::function<void(int64_t iterations)>;
+
+struct Benchmark {
+    std::string name;
+    BenchmarkFunction func;
+};
+
+inline std::vector<Benchmark> &registry() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+struct Registrar {
+    Registrar(const std::string &name, BenchmarkFunction func) {
+        registry().push_back(Benchmark { name, func });
+    }
+};
+
+
+/// keeps value and its computation from being optimized out
+template<typename T>
+inline void doNotOptimize(const T &value) {
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+inline void clobberMemory() {
+#if defined(__GNUC__)
+    asm volatile("" : : : "memory");
+#endif
+}
+
+
+} // ns bench
+} // ns libmodbus_cpp
+
+
+#define LMB_BENCHMARK_CAT_(A, B) A ## B
+#define LMB_BENCHMARK_CAT(A, B) LMB_BENCHMARK_CAT_(A, B)
+
+/// registers callable with signature void(int64_t iterations) under name, name must not contain spaces
+#define LMB_BENCHMARK(Name, ...) \
+    static const libmodbus_cpp::bench::Registrar LMB_BENCHMARK_CAT(lmb_benchmark_, __COUNTER__)(Name, __VA_ARGS__)
+
+
+#endif // LIBMODBUS_CPP_BENCHMARK_H_GUARD
@@ -0,0 +1,21 @@
+QT -= gui
+
+TEMPLATE = app
+
+CONFIG += c++11 console
+
+include(../libmodbus_cpp.prf)
+
+DESTDIR = $${LIBMODBUS_CPP_DESTDIR}
+TARGET  = $${LIBMODBUS_CPP_TARGET}_benchmarks
+CONFIG += $${LIBMODBUS_CPP_CONFIG}
+
+SOURCES += \
+    main.cpp \
+    pdu_benchmark.cpp \
+    codec_benchmark.cpp \
+    map_benchmark.cpp \
+    connection_benchmark.cpp
+
+HEADERS += \
+    benchmark.h
@@ -0,0 +1,114 @@
+/**
+ * Value <-> register conversion: registerMemoryCopy, byte reversal helpers, RegisterLayout codecs.
+ */
+
+#include <libmodbus_cpp/abstract_slave.h>
+#include <libmodbus_cpp/register_layout.h>
+#include "benchmark.h"
+
+using namespace libmodbus_cpp;
+using namespace libmodbus_cpp::bench;
+
+namespace libmodbus_cpp {
+// internal helpers of abstract_slave.cpp
+void reverseBytes(char* data, unsigned int size);
+void reverseBytesPairs(char* data, unsigned int size);
+}
+
+namespace {
+
+template<typename ValueType>
+void valueToRegisters(int64_t iterations, ByteOrder order) {
+    ValueType value = ValueType(1);
+    uint16_t regs[8];
+    for (int64_t i = 0; i < iterations; ++i) {
+        registerMemoryCopy(&value, sizeof(ValueType), regs, order);
+        doNotOptimize(regs);
+        value += ValueType(1);
+    }
+}
+
+template<typename ValueType>
+void registersToValue(int64_t iterations, ByteOrder order) {
+    uint16_t regs[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    ValueType value;
+    for (int64_t i = 0; i < iterations; ++i) {
+        registerMemoryCopy(regs, sizeof(ValueType), &value, order);
+        doNotOptimize(value);
+        regs[0] += 1;
+    }
+}
+
+#define LMB_CODEC_BENCHMARK(TypeName, Type) \
+    LMB_BENCHMARK("codec/registerMemoryCopy/to_regs/" TypeName "/le",   [](int64_t n) { valueToRegisters<Type>(n, ByteOrder::LittleEndian); }); \
+    LMB_BENCHMARK("codec/registerMemoryCopy/to_regs/" TypeName "/be",   [](int64_t n) { valueToRegisters<Type>(n, ByteOrder::BigEndian); }); \
+    LMB_BENCHMARK("codec/registerMemoryCopy/from_regs/" TypeName "/le", [](int64_t n) { registersToValue<Type>(n, ByteOrder::LittleEndian); }); \
+    LMB_BENCHMARK("codec/registerMemoryCopy/from_regs/" TypeName "/be", [](int64_t n) { registersToValue<Type>(n, ByteOrder::BigEndian); })
+
+LMB_CODEC_BENCHMARK("uint16", uint16_t);
+LMB_CODEC_BENCHMARK("int32",  int32_t);
+LMB_CODEC_BENCHMARK("float",  float);
+LMB_CODEC_BENCHMARK("int64",  int64_t);
+LMB_CODEC_BENCHMARK("double", double);
+
+#undef LMB_CODEC_BENCHMARK
+
+
+template<unsigned int Size>
+void reverse(int64_t iterations, bool pairs) {
+    char data[Size] = { 0 };
+    for (int64_t i = 0; i < iterations; ++i) {
+        if (pairs) {
+            reverseBytesPairs(data, Size);
+        } else {
+            reverseBytes(data, Size);
+        }
+        doNotOptimize(data);
+    }
+}
+
+LMB_BENCHMARK("codec/reverseBytes/2",        [](int64_t n) { reverse<2>(n, false); });
+LMB_BENCHMARK("codec/reverseBytes/8",        [](int64_t n) { reverse<8>(n, false); });
+LMB_BENCHMARK("codec/reverseBytes/250",      [](int64_t n) { reverse<250>(n, false); });
+LMB_BENCHMARK("codec/reverseBytesPairs/2",   [](int64_t n) { reverse<2>(n, true); });
+LMB_BENCHMARK("codec/reverseBytesPairs/8",   [](int64_t n) { reverse<8>(n, true); });
+LMB_BENCHMARK("codec/reverseBytesPairs/250", [](int64_t n) { reverse<250>(n, true); });
+
+
+struct Block {
+    float speed;
+    uint16_t state;
+    int32_t position;
+    double total;
+};
+
+using BlockLayout = RegisterLayout<Block,
+    LMB_REGISTER_FIELD(Block, speed, 0),
+    LMB_REGISTER_FIELD(Block, state, 2),
+    LMB_REGISTER_FIELD(Block, position, 3),
+    LMB_REGISTER_FIELD(Block, total, 5)>;
+
+LMB_BENCHMARK("codec/layout/encode/fused", [](int64_t n) {
+    Block b { 1.5f, 2, 3, 4.5 };
+    uint16_t regs[BlockLayout::RegCount];
+    for (int64_t i = 0; i < n; ++i) {
+        BlockLayout::encode(b, regs, ByteOrder::BigEndian);
+        doNotOptimize(regs);
+        b.state += 1;
+    }
+});
+
+LMB_BENCHMARK("codec/layout/encode/per_field", [](int64_t n) {
+    Block b { 1.5f, 2, 3, 4.5 };
+    uint16_t regs[BlockLayout::RegCount];
+    for (int64_t i = 0; i < n; ++i) {
+        registerMemoryCopy(&b.speed, sizeof(b.speed), regs + 0, ByteOrder::BigEndian);
+        registerMemoryCopy(&b.state, sizeof(b.state), regs + 2, ByteOrder::BigEndian);
+        registerMemoryCopy(&b.position, sizeof(b.position), regs + 3, ByteOrder::BigEndian);
+        registerMemoryCopy(&b.total, sizeof(b.total), regs + 5, ByteOrder::BigEndian);
+        doNotOptimize(regs);
+        b.state += 1;
+    }
+});
+
+}
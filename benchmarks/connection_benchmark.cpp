@@ -0,0 +1,196 @@
+/**
+ * TCP slave with many idle masters: request round trip on one connection while
+ * others are idle, socket against compact and io_uring connection modes.
+ * Memory (resident set growth) and CPU per idle connection are printed to stderr
+ * when fixture is set up.
+ */
+
+#ifdef __linux__
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <libmodbus_cpp/slave_tcp.h>
+#include <libmodbus_cpp/slave_tcp_backend.h>
+#include "benchmark.h"
+
+using namespace libmodbus_cpp;
+using namespace libmodbus_cpp::bench;
+
+namespace {
+
+const int IDLE_CONNECTIONS = 10000;
+
+void ensureApplication() {
+    static int argc = 1;
+    static char name[] = "modbus_benchmarks";
+    static char *argv[] = { name, Q_NULLPTR };
+    if (!QCoreApplication::instance()) {
+        new QCoreApplication(argc, argv); // lives until exit
+    }
+}
+
+/// connections affordable by descriptor limit, both ends of each one are in this process
+int affordableConnections(int wanted) {
+    rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+    // room for other fixtures
+    return std::min<int>(wanted, static_cast<int>((limit.rlim_cur - 100) / 6));
+}
+
+long residentBytes() {
+    long pages = 0;
+    long resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+double cpuSeconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void processEventsFor(int ms) {
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < ms) {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, ms - timer.elapsed());
+    }
+}
+
+
+struct ConnectionFixture {
+    SlaveTcpBackend *backend;
+    SlaveTcp *slave;
+    std::vector<int> clients;
+    size_t next = 0;
+
+    ConnectionFixture(TcpConnectionMode mode, const char *name, int port) {
+        ensureApplication();
+        const int count = affordableConnections(IDLE_CONNECTIONS);
+
+        backend = new SlaveTcpBackend();
+        backend->init("127.0.0.1", port, 1024);
+        backend->setConnectionMode(mode);
+        slave = new SlaveTcp(backend); // owns backend, lives until exit
+        slave->initMap(100, 100, 100, 100);
+        if (!slave->startListen()) {
+            fprintf(stderr, "%s: can't listen on port %d, round trips are skipped\n", name, port);
+            return;
+        }
+
+        const long rssBefore = residentBytes();
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        for (int i = 0; i < count; ++i) {
+            const int fd = socket(AF_INET, SOCK_STREAM, 0);
+            if ((fd == -1) || (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1)) {
+                fprintf(stderr, "%s: connect failed after %d connections\n", name, i);
+                if (fd != -1) {
+                    ::close(fd);
+                }
+                break;
+            }
+            clients.push_back(fd);
+            if ((i & 255) == 255) {
+                QCoreApplication::processEvents(); // drain backlog
+            }
+        }
+        QElapsedTimer timer;
+        timer.start();
+        while ((backend->getConnectionCount() < static_cast<int>(clients.size())) && (timer.elapsed() < 10000)) {
+            QCoreApplication::processEvents();
+        }
+        const long rssAfter = residentBytes();
+
+        const double cpuBefore = cpuSeconds();
+        processEventsFor(1000);
+        const double idleCpu = cpuSeconds() - cpuBefore;
+
+        fprintf(stderr, "%s: %d connections, %.0f bytes/connection resident, idle CPU %.3f%% of core\n",
+                name, backend->getConnectionCount(),
+                clients.empty() ? 0.0 : double(rssAfter - rssBefore) / clients.size(),
+                idleCpu * 100);
+    }
+
+    /// FC3 of one register on next connection
+    void roundTrip() {
+        if (clients.empty()) {
+            return; // listen or first connect failed, reported by constructor
+        }
+        const uint8_t req[] = { 0, 1, 0, 0, 0, 6, 1, MODBUS_FC_READ_HOLDING_REGISTERS, 0, 0, 0, 1 };
+        const int fd = clients[next];
+        next = (next + 1) % clients.size();
+        if (::write(fd, req, sizeof(req)) != sizeof(req)) {
+            return;
+        }
+        pollfd p = { fd, POLLIN, 0 };
+        do {
+            QCoreApplication::processEvents();
+        } while (poll(&p, 1, 0) == 0);
+        uint8_t rsp[MODBUS_TCP_MAX_ADU_LENGTH];
+        doNotOptimize(::read(fd, rsp, sizeof(rsp)));
+    }
+};
+
+ConnectionFixture &socketFixture() {
+    static ConnectionFixture f(TcpConnectionMode::Socket, "tcp/socket", 15502);
+    return f;
+}
+
+ConnectionFixture &compactFixture() {
+    static ConnectionFixture f(TcpConnectionMode::Compact, "tcp/compact", 15503);
+    return f;
+}
+
+ConnectionFixture &uringFixture() {
+    static ConnectionFixture f(TcpConnectionMode::Uring, "tcp/uring", 15504);
+    return f;
+}
+
+LMB_BENCHMARK("tcp/roundtrip/socket/idle_10k", [](int64_t n) {
+    ConnectionFixture &f = socketFixture();
+    for (int64_t i = 0; i < n; ++i) {
+        f.roundTrip();
+    }
+});
+
+LMB_BENCHMARK("tcp/roundtrip/compact/idle_10k", [](int64_t n) {
+    ConnectionFixture &f = compactFixture();
+    for (int64_t i = 0; i < n; ++i) {
+        f.roundTrip();
+    }
+});
+
+LMB_BENCHMARK("tcp/roundtrip/uring/idle_10k", [](int64_t n) {
+    ConnectionFixture &f = uringFixture();
+    for (int64_t i = 0; i < n; ++i) {
+        f.roundTrip();
+    }
+});
+
+}
+
+#endif // __linux__
@@ -0,0 +1,158 @@
+/**
+ * Micro-benchmark runner.
+ *
+ *   modbus_benchmarks [--filter TEXT] [--repetitions N] [--min-time MS]
+ *                     [--save FILE] [--compare FILE] [--threshold PERCENT]
+ *
+ * Each benchmark is calibrated to run at least min-time, then measured
+ * repetitions times; median ns/op is reported with spread of repetitions.
+ * --save writes "name ns/op" lines, --compare prints change against such file
+ * and exits with 1 if any benchmark is slower than threshold.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include "benchmark.h"
+
+using namespace libmodbus_cpp::bench;
+
+namespace {
+
+struct Options {
+    std::string filter;
+    int repetitions = 5;
+    double minTime_ms = 200;
+    std::string save;
+    std::string compare;
+    double threshold = 5;
+};
+
+struct Result {
+    double median;
+    double min;
+    double spread; // (max - min) / median
+};
+
+double runOnce(const Benchmark &b, int64_t iterations) {
+    const auto start = std::chrono::steady_clock::now();
+    b.func(iterations);
+    const auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count();
+}
+
+Result run(const Benchmark &b, const Options &options) {
+    // calibration, also warms up caches and branch predictors
+    const double targetNs = options.minTime_ms * 1e6;
+    int64_t iterations = 1;
+    double ns = runOnce(b, iterations);
+    while (ns < targetNs / 10) {
+        iterations *= (ns < targetNs / 1000) ? 100 : 10;
+        ns = runOnce(b, iterations);
+    }
+    iterations = std::max<int64_t>(1, static_cast<int64_t>(iterations * targetNs / ns));
+
+    std::vector<double> perOp;
+    for (int i = 0; i < options.repetitions; ++i) {
+        perOp.push_back(runOnce(b, iterations) / iterations);
+    }
+    std::sort(perOp.begin(), perOp.end());
+    const double median = perOp[perOp.size() / 2];
+    return Result { median, perOp.front(), (perOp.back() - perOp.front()) / median };
+}
+
+std::map<std::string, double> loadBaseline(const std::string &path) {
+    std::map<std::string, double> res;
+    std::ifstream in(path.c_str());
+    std::string name;
+    double ns;
+    while (in >> name >> ns) {
+        res[name] = ns;
+    }
+    return res;
+}
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = (i + 1 < argc);
+        if ((arg == "--filter") && hasValue) {
+            options.filter = argv[++i];
+        } else if ((arg == "--repetitions") && hasValue) {
+            options.repetitions = std::max(1, atoi(argv[++i]));
+        } else if ((arg == "--min-time") && hasValue) {
+            options.minTime_ms = atof(argv[++i]);
+        } else if ((arg == "--save") && hasValue) {
+            options.save = argv[++i];
+        } else if ((arg == "--compare") && hasValue) {
+            options.compare = argv[++i];
+        } else if ((arg == "--threshold") && hasValue) {
+            options.threshold = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--filter TEXT] [--repetitions N] [--min-time MS] "
+                            "[--save FILE] [--compare FILE] [--threshold PERCENT]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    const std::map<std::string, double> baseline = options.compare.empty()
+            ? std::map<std::string, double>()
+            : loadBaseline(options.compare);
+    std::ofstream save;
+    if (!options.save.empty()) {
+        save.open(options.save.c_str());
+    }
+
+    std::vector<Benchmark> benchmarks = registry();
+    std::sort(benchmarks.begin(), benchmarks.end(), [](const Benchmark &l, const Benchmark &r) { return l.name < r.name; });
+
+    printf("%-52s %12s %12s %8s", "benchmark", "ns/op", "min", "spread");
+    if (!baseline.empty()) {
+        printf(" %12s %8s", "baseline", "change");
+    }
+    printf("\n");
+
+    int regressions = 0;
+    for (const Benchmark &b : benchmarks) {
+        if (!options.filter.empty() && (b.name.find(options.filter) == std::string::npos)) {
+            continue;
+        }
+        const Result r = run(b, options);
+        printf("%-52s %12.2f %12.2f %7.1f%%", b.name.c_str(), r.median, r.min, r.spread * 100);
+        const auto it = baseline.find(b.name);
+        if (it != baseline.end()) {
+            const double change = (r.median / it->second - 1) * 100;
+            const bool regression = change > options.threshold;
+            regressions += regression ? 1 : 0;
+            printf(" %12.2f %+7.1f%%%s", it->second, change, regression ? "  REGRESSION" : "");
+        }
+        printf("\n");
+        fflush(stdout);
+        if (save.is_open()) {
+            save << b.name << " " << r.median << "\n";
+        }
+    }
+
+    if (regressions) {
+        printf("%d benchmark(s) slower than baseline by more than %.1f%%\n", regressions, options.threshold);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * Slave map access: typed accessors with getMapper checks, bit helpers, hook dispatch.
+ */
+
+#include <libmodbus_cpp/slave_tcp.h>
+#include <libmodbus_cpp/slave_tcp_backend.h>
+#include "benchmark.h"
+
+using namespace libmodbus_cpp;
+using namespace libmodbus_cpp::bench;
+
+namespace {
+
+const int MAP_SIZE = 1000;
+
+/// exposes request processing steps
+class BenchSlaveBackend : public SlaveTcpBackend {
+public:
+    using AbstractSlaveBackend::processHooks;
+};
+
+struct MapFixture {
+    BenchSlaveBackend *backend;
+    SlaveTcp *slave;
+
+    explicit MapFixture(MapConcurrency concurrency) {
+        backend = new BenchSlaveBackend();
+        backend->init("127.0.0.1");
+        backend->initMap(MAP_SIZE, MAP_SIZE, MAP_SIZE, MAP_SIZE);
+        backend->setMapConcurrency(concurrency);
+        slave = new SlaveTcp(backend); // owns backend, lives until exit
+    }
+};
+
+SlaveTcp *plainSlave() {
+    static MapFixture f(MapConcurrency::None);
+    return f.slave;
+}
+
+SlaveTcp *seqLockSlave() {
+    static MapFixture f(MapConcurrency::SeqLock);
+    return f.slave;
+}
+
+
+template<typename ValueType>
+void getValue(int64_t iterations, SlaveTcp *slave) {
+    for (int64_t i = 0; i < iterations; ++i) {
+        doNotOptimize(slave->getValueFromHoldingRegister<ValueType>(static_cast<Address>(i & 255)));
+    }
+}
+
+template<typename ValueType>
+void setValue(int64_t iterations, SlaveTcp *slave) {
+    for (int64_t i = 0; i < iterations; ++i) {
+        slave->setValueToHoldingRegister(static_cast<Address>(i & 255), static_cast<ValueType>(i));
+    }
+    clobberMemory();
+}
+
+#define LMB_MAP_BENCHMARK(TypeName, Type) \
+    LMB_BENCHMARK("map/getValueFromHoldingRegister/" TypeName,         [](int64_t n) { getValue<Type>(n, plainSlave()); }); \
+    LMB_BENCHMARK("map/getValueFromHoldingRegister/" TypeName "/seqlock", [](int64_t n) { getValue<Type>(n, seqLockSlave()); }); \
+    LMB_BENCHMARK("map/setValueToHoldingRegister/" TypeName,           [](int64_t n) { setValue<Type>(n, plainSlave()); }); \
+    LMB_BENCHMARK("map/setValueToHoldingRegister/" TypeName "/seqlock",   [](int64_t n) { setValue<Type>(n, seqLockSlave()); })
+
+LMB_MAP_BENCHMARK("uint16", uint16_t);
+LMB_MAP_BENCHMARK("float",  float);
+LMB_MAP_BENCHMARK("double", double);
+
+#undef LMB_MAP_BENCHMARK
+
+LMB_BENCHMARK("map/getMapper/out_of_range", [](int64_t n) {
+    SlaveTcp *slave = plainSlave();
+    for (int64_t i = 0; i < n; ++i) {
+        try {
+            doNotOptimize(slave->getValueFromHoldingRegister<uint16_t>(MAP_SIZE));
+        } catch (LocalReadError &) {
+        }
+    }
+});
+
+LMB_BENCHMARK("map/setValueToCoil", [](int64_t n) {
+    SlaveTcp *slave = plainSlave();
+    for (int64_t i = 0; i < n; ++i) {
+        slave->setValueToCoil(static_cast<Address>(i & 255), (i & 1) != 0);
+    }
+    clobberMemory();
+});
+
+LMB_BENCHMARK("map/setModbusBit", [](int64_t n) {
+    uint8_t table[256];
+    for (int64_t i = 0; i < n; ++i) {
+        setModbusBit(table, static_cast<Address>(i & 255), (i & 1) != 0);
+    }
+    doNotOptimize(table);
+});
+
+
+/// slave with hookCount uni hooks of hookSize registers spread over map
+BenchSlaveBackend *hookedBackend(int hookCount, int hookSize) {
+    BenchSlaveBackend *backend = new BenchSlaveBackend(); // lives until exit
+    backend->init("127.0.0.1");
+    backend->initMap(MAP_SIZE, MAP_SIZE, MAP_SIZE, MAP_SIZE);
+    const int step = hookCount ? MAP_SIZE / hookCount : 0;
+    for (int i = 0; i < hookCount; ++i) {
+        backend->addUniHook(DataType::HoldingRegister, AccessMode::Read, i * step, hookSize,
+                            HookTime::Preprocessing, [](const UniHookInfo *info) { doNotOptimize(info->rangeSize); });
+    }
+    return backend;
+}
+
+void dispatch(int64_t iterations, BenchSlaveBackend *backend, uint16_t count) {
+    const uint8_t req[] = { 0, 1, 0, 0, 0, 6, 1, MODBUS_FC_READ_HOLDING_REGISTERS, 0, 0, uint8_t(count >> 8), uint8_t(count) };
+    RequestView view;
+    view.parse(req, sizeof(req), 7);
+    for (int64_t i = 0; i < iterations; ++i) {
+        backend->processHooks(view, HookTime::Preprocessing);
+    }
+}
+
+#define LMB_HOOK_BENCHMARK(HookCount, RangeSize) \
+    LMB_BENCHMARK("hooks/dispatch/hooks_" #HookCount "/range_" #RangeSize, [](int64_t n) { \
+        static BenchSlaveBackend *backend = hookedBackend(HookCount, 4); \
+        dispatch(n, backend, RangeSize); \
+    })
+
+LMB_HOOK_BENCHMARK(1, 1);
+LMB_HOOK_BENCHMARK(1, 100);
+LMB_HOOK_BENCHMARK(10, 1);
+LMB_HOOK_BENCHMARK(10, 100);
+LMB_HOOK_BENCHMARK(100, 1);
+LMB_HOOK_BENCHMARK(100, 100);
+
+#undef LMB_HOOK_BENCHMARK
+
+LMB_BENCHMARK("hooks/dispatch/no_hooks", [](int64_t n) {
+    static BenchSlaveBackend *backend = hookedBackend(0, 0);
+    dispatch(n, backend, 1);
+});
+
+}
@@ -0,0 +1,102 @@
+/**
+ * Slave request path: libmodbus modbus_reply() against native RequestView + ResponseBuilder,
+ * native one also with register tables in wire order (RegisterStorage::WireOrder).
+ * All variants parse the frame for hooks and produce reply into memory, socket I/O is excluded.
+ */
+
+#include <cstring>
+#include <array>
+#include <vector>
+#include <modbus/modbus-private.h>
+#include <libmodbus_cpp/pdu.h>
+#include "benchmark.h"
+
+using namespace libmodbus_cpp;
+using namespace libmodbus_cpp::bench;
+
+namespace {
+
+ssize_t discardSend(modbus_t *ctx, const uint8_t *req, int req_length) {
+    (void)ctx;
+    doNotOptimize(req[req_length - 1]);
+    return req_length;
+}
+
+/// TCP context sending nowhere and map shared by all pdu benchmarks
+struct PduFixture {
+    modbus_t *ctx;
+    modbus_backend_t backend;
+    modbus_mapping_t *map;
+
+    PduFixture() {
+        ctx = modbus_new_tcp("127.0.0.1", MODBUS_TCP_DEFAULT_PORT);
+        memcpy(&backend, ctx->backend, sizeof(backend));
+        backend.send = discardSend;
+        ctx->backend = &backend;
+        map = modbus_mapping_new(2000, 2000, 1000, 1000);
+    }
+};
+
+PduFixture &fixture() {
+    static PduFixture f;
+    return f;
+}
+
+/// hook lookup as done by checkHookMap before native parser
+int parseForHooks(const uint8_t *req, int offset) {
+#define GET_HDR_U16(ID)  ((req[offset + 1 + ((ID) << 1)] << 8) + req[offset + 2 + ((ID) << 1)])
+    return req[offset] + GET_HDR_U16(0) + GET_HDR_U16(1);
+#undef GET_HDR_U16
+}
+
+void libmodbusReply(int64_t iterations, const std::vector<uint8_t> &req) {
+    PduFixture &f = fixture();
+    const int offset = modbus_get_header_length(f.ctx);
+    for (int64_t i = 0; i < iterations; ++i) {
+        // pre and post hooks parsed header separately
+        doNotOptimize(parseForHooks(req.data(), offset));
+        doNotOptimize(parseForHooks(req.data(), offset));
+        modbus_reply(f.ctx, req.data(), req.size(), f.map);
+    }
+}
+
+void nativeReply(int64_t iterations, const std::vector<uint8_t> &req, bool wireOrder = false) {
+    PduFixture &f = fixture();
+    const int offset = modbus_get_header_length(f.ctx);
+    std::array<uint8_t, MODBUS_MAX_ADU_LENGTH> rsp;
+    for (int64_t i = 0; i < iterations; ++i) {
+        RequestView view;
+        view.parse(req.data(), req.size(), offset);
+        const int length = ResponseBuilder(rsp.data(), wireOrder).build(view, f.map);
+        discardSend(f.ctx, rsp.data(), f.backend.send_msg_pre(rsp.data(), length));
+    }
+}
+
+std::vector<uint8_t> request(uint8_t function, uint16_t address, uint16_t count) {
+    std::vector<uint8_t> req = { 0, 1, 0, 0, 0, 6, 1, function,
+                                 uint8_t(address >> 8), uint8_t(address), uint8_t(count >> 8), uint8_t(count) };
+    return req;
+}
+
+std::vector<uint8_t> writeRegistersRequest(uint16_t address, uint16_t count) {
+    std::vector<uint8_t> req = request(MODBUS_FC_WRITE_MULTIPLE_REGISTERS, address, count);
+    req[5] = uint8_t(7 + 2 * count);
+    req.push_back(uint8_t(2 * count));
+    req.resize(req.size() + 2 * count, 0x5A);
+    return req;
+}
+
+#define LMB_PDU_BENCHMARK(Name, Request) \
+    LMB_BENCHMARK("pdu/" Name "/modbus_reply", [](int64_t n) { libmodbusReply(n, Request); }); \
+    LMB_BENCHMARK("pdu/" Name "/native",       [](int64_t n) { nativeReply(n, Request); }); \
+    LMB_BENCHMARK("pdu/" Name "/native_wire",  [](int64_t n) { nativeReply(n, Request, true); })
+
+LMB_PDU_BENCHMARK("fc3_read_1",      request(MODBUS_FC_READ_HOLDING_REGISTERS, 10, 1));
+LMB_PDU_BENCHMARK("fc3_read_100",    request(MODBUS_FC_READ_HOLDING_REGISTERS, 10, 100));
+LMB_PDU_BENCHMARK("fc1_read_1000",   request(MODBUS_FC_READ_COILS, 0, 1000));
+LMB_PDU_BENCHMARK("fc6_write_1",     request(MODBUS_FC_WRITE_SINGLE_REGISTER, 10, 0x1234));
+LMB_PDU_BENCHMARK("fc16_write_100",  writeRegistersRequest(10, 100));
+
+#undef LMB_PDU_BENCHMARK
+
+}
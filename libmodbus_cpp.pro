@@ -14,6 +14,17 @@ contains(LIBMODBUS_CPP_CONFIG, libmodbus_cpp_tests) {
     tests.depends = libmodbus_cpp
 }
 
+contains(LIBMODBUS_CPP_CONFIG, libmodbus_cpp_benchmarks) {
+    SUBDIRS += benchmarks
+    benchmarks.depends = libmodbus_cpp
+}
+
+contains(LIBMODBUS_CPP_CONFIG, libmodbus_cpp_tools) {
+    SUBDIRS += load_generator
+    load_generator.subdir = tools/load_generator
+    load_generator.depends = libmodbus_cpp
+}
+
 OTHER_FILES += \
     *.txt \
     *.prf \
@@ -15,18 +15,18 @@ libmodbus_cpp::AbstractMaster::~AbstractMaster()
 bool libmodbus_cpp::AbstractMaster::readCoil(uint16_t address)
 {
     uint8_t result;
-    int errorCode = modbus_read_bits(getBackend()->getCtx(), address, 1, &result);
+    int errorCode = transact([&]() { return modbus_read_bits(getBackend()->getCtx(), address, 1, &result); });
     if (errorCode == -1)
-        throw RemoteReadError(modbus_strerror(errno));
+        throw RemoteReadError(modbus_strerror(errno), errno);
     return result;
 }
 
 QVector<bool> libmodbus_cpp::AbstractMaster::readCoils(uint16_t address, int count)
 {
     uint8_t *rawData = new uint8_t[count];
-    int errorCode = modbus_read_bits(getBackend()->getCtx(), address, count, rawData);
+    int errorCode = transact([&]() { return modbus_read_bits(getBackend()->getCtx(), address, count, rawData); });
     if (errorCode == -1)
-        throw RemoteReadError(modbus_strerror(errno));
+        throw RemoteReadError(modbus_strerror(errno), errno);
     QVector<bool> result(count);
     std::copy(rawData, rawData + count, result.begin());
     return result;
@@ -34,38 +34,80 @@ QVector<bool> libmodbus_cpp::AbstractMaster::readCoils(uint16_t address, int cou
 
 void libmodbus_cpp::AbstractMaster::writeCoil(uint16_t address, bool value)
 {
-    int errorCode = modbus_write_bit(getBackend()->getCtx(), address, value);
+    int errorCode = transact([&]() { return modbus_write_bit(getBackend()->getCtx(), address, value); });
     if (errorCode == -1)
-        throw RemoteWriteError(modbus_strerror(errno));
+        throw RemoteWriteError(modbus_strerror(errno), errno);
 }
 
 void libmodbus_cpp::AbstractMaster::writeCoils(uint16_t address, QVector<bool> values)
 {
-    int errorCode = modbus_write_bits(getBackend()->getCtx(), address, values.size(), reinterpret_cast<uint8_t*>(values.data()));
+    int errorCode = transact([&]() { return modbus_write_bits(getBackend()->getCtx(), address, values.size(), reinterpret_cast<uint8_t*>(values.data())); });
     if (errorCode == -1)
-        throw RemoteWriteError(modbus_strerror(errno));
+        throw RemoteWriteError(modbus_strerror(errno), errno);
 }
 
 bool libmodbus_cpp::AbstractMaster::readDiscreteInput(uint16_t address)
 {
     uint8_t result;
-    int errorCode = modbus_read_input_bits(getBackend()->getCtx(), address, 1, &result);
+    int errorCode = transact([&]() { return modbus_read_input_bits(getBackend()->getCtx(), address, 1, &result); });
     if (errorCode == -1)
-        throw RemoteReadError(modbus_strerror(errno));
+        throw RemoteReadError(modbus_strerror(errno), errno);
     return result;
 }
 
 QVector<bool> libmodbus_cpp::AbstractMaster::readDiscreteInputs(uint16_t address, int count)
 {
     uint8_t *rawData = new uint8_t[count];
-    int errorCode = modbus_read_input_bits(getBackend()->getCtx(), address, count, rawData);
+    int errorCode = transact([&]() { return modbus_read_input_bits(getBackend()->getCtx(), address, count, rawData); });
     if (errorCode == -1)
-        throw RemoteReadError(modbus_strerror(errno));
+        throw RemoteReadError(modbus_strerror(errno), errno);
     QVector<bool> result(count);
     std::copy(rawData, rawData + count, result.begin());
     return result;
 }
 
+QVector<uint16_t> libmodbus_cpp::AbstractMaster::readHoldingRegisters(uint16_t address, int count)
+{
+    QVector<uint16_t> result(count);
+    int errorCode = transact([&]() { return modbus_read_registers(getBackend()->getCtx(), address, count, result.data()); });
+    if (errorCode == -1)
+        throw RemoteReadError(modbus_strerror(errno), errno);
+    return result;
+}
+
+void libmodbus_cpp::AbstractMaster::writeHoldingRegisters(uint16_t address, const QVector<uint16_t> &values)
+{
+    int errorCode = transact([&]() { return modbus_write_registers(getBackend()->getCtx(), address, values.size(), values.constData()); });
+    if (errorCode == -1)
+        throw RemoteWriteError(modbus_strerror(errno), errno);
+}
+
+QVector<uint16_t> libmodbus_cpp::AbstractMaster::writeAndReadHoldingRegisters(uint16_t writeAddress, const QVector<uint16_t> &values, uint16_t readAddress, int readCount)
+{
+    QVector<uint16_t> result(readCount);
+    int errorCode = transact([&]() {
+        return modbus_write_and_read_registers(getBackend()->getCtx(), writeAddress, values.size(), values.constData(),
+                                               readAddress, readCount, result.data());
+    });
+    if (errorCode == -1)
+        throw RemoteWriteError(modbus_strerror(errno), errno);
+    return result;
+}
+
+QVector<uint16_t> libmodbus_cpp::AbstractMaster::readInputRegisters(uint16_t address, int count)
+{
+    QVector<uint16_t> result(count);
+    int errorCode = transact([&]() { return modbus_read_input_registers(getBackend()->getCtx(), address, count, result.data()); });
+    if (errorCode == -1)
+        throw RemoteReadError(modbus_strerror(errno), errno);
+    return result;
+}
+
+void libmodbus_cpp::AbstractMaster::setTargetByteOrder(ByteOrder byteOrder)
+{
+    getBackend()->setTargetByteOrder(byteOrder);
+}
+
 bool libmodbus_cpp::AbstractMaster::connect()
 {
     return getBackend()->openConnection();
@@ -84,9 +126,9 @@ void libmodbus_cpp::AbstractMaster::setSlaveAddress(uint8_t address)
 QString libmodbus_cpp::AbstractMaster::readSlaveId()
 {
     std::array<uint8_t, 80> buf{ 0 };
-    int errorCode = modbus_report_slave_id(getBackend()->getCtx(), buf.size(), buf.data());
+    int errorCode = transact([&]() { return modbus_report_slave_id(getBackend()->getCtx(), buf.size(), buf.data()); });
     if (errorCode == -1) {
-        throw RemoteReadError(modbus_strerror(errno));
+        throw RemoteReadError(modbus_strerror(errno), errno);
     }
     return QString(reinterpret_cast<const char*>(buf.data()));
 }
@@ -97,17 +139,99 @@ libmodbus_cpp::RawResult libmodbus_cpp::AbstractMaster::sendRawRequest(uint8_t s
     req[0] = slaveId;
     req[1] = functionCode;
     std::copy(data.begin(), data.end(), req.begin() + 2);
+    getBackend()->beforeTransaction();
     int errorCode = modbus_send_raw_request(getBackend()->getCtx(), req.data(), req.size());
     if (errorCode == -1) {
-        throw RemoteWriteError(modbus_strerror(errno));
+        const int error = errno;
+        getBackend()->transactionFailed(error);
+        throw RemoteWriteError(modbus_strerror(error), error);
     }
     std::array<uint8_t, MODBUS_MAX_ADU_LENGTH> buf{ 0 };
     errorCode = modbus_receive_confirmation(getBackend()->getCtx(), buf.data());
     if (errorCode == -1) {
-        throw RemoteReadError(modbus_strerror(errno));
+        const int error = errno;
+        getBackend()->transactionFailed(error);
+        throw RemoteReadError(modbus_strerror(error), error);
     }
+    getBackend()->transactionSucceeded();
     int headerLength = modbus_get_header_length(getBackend()->getCtx());
     uint8_t returnedAddress = buf[headerLength - 1];
     uint8_t returnedFunctionCode = buf[headerLength];
     return RawResult { returnedAddress, returnedFunctionCode, QByteArray(reinterpret_cast<const char*>(buf.data()) + headerLength + 2) };
 }
+
+void libmodbus_cpp::AbstractMaster::enableAdaptiveTimeout(int min_ms, int max_ms)
+{
+    m_rtt.reset(min_ms, max_ms);
+    m_adaptiveTimeout = true;
+}
+
+void libmodbus_cpp::AbstractMaster::disableAdaptiveTimeout(int timeout_ms)
+{
+    m_adaptiveTimeout = false;
+    modbus_set_response_timeout(getBackend()->getCtx(), timeout_ms / 1000, (timeout_ms % 1000) * 1000);
+}
+
+void libmodbus_cpp::AbstractMaster::setRetryPolicy(const RetryPolicy &policy)
+{
+    m_retryPolicy = policy;
+    m_retryBudget.reset(policy);
+}
+
+libmodbus_cpp::RttStats libmodbus_cpp::AbstractMaster::getRttStats() const
+{
+    return m_rtt.stats();
+}
+
+void libmodbus_cpp::AbstractMaster::beforeRequest()
+{
+    getBackend()->beforeTransaction();
+    if (m_adaptiveTimeout) {
+        const int timeout_ms = m_rtt.timeout_ms();
+        modbus_set_response_timeout(getBackend()->getCtx(), timeout_ms / 1000, (timeout_ms % 1000) * 1000);
+    }
+}
+
+bool libmodbus_cpp::AbstractMaster::afterRequest(int result, int error, int attempt, qint64 elapsed_ns)
+{
+    // exception reply is answer of device too
+    const bool answered = (result != -1) || isExceptionReplyError(error);
+    if (answered) {
+        if (attempt == 0) {
+            m_rtt.sample(elapsed_ns / 1000000.0);
+        }
+        getBackend()->transactionSucceeded();
+        m_retryBudget.request(m_retryPolicy);
+        return false;
+    }
+    if (getBackend()->transactionFailed(error)) {
+        return false;
+    }
+    // retry got late reply of earlier attempt, TCP one is refused by transaction id
+    const bool stale = (attempt > 0) && (error == EMBBADDATA);
+    if ((error != ETIMEDOUT) && !stale) {
+        return false;
+    }
+
+    m_rtt.timedOut();
+    if (attempt >= m_retryPolicy.maxRetries) {
+        return false;
+    }
+    const bool granted = m_retryBudget.takeRetry();
+    m_rtt.retried(granted);
+    // TCP: retry is sent at once, reply of retry follows refused late one and is dropped with it
+    if (granted && (!getBackend()->hasTransactionIds() || stale)) {
+        flushLateReply();
+    }
+    return granted;
+}
+
+void libmodbus_cpp::AbstractMaster::flushLateReply()
+{
+    // without transaction ids late reply of timed out attempt would be taken as reply of retry (RTU),
+    // it is awaited for one more response timeout, slave answers requests in order
+    modbus_t *ctx = getBackend()->getCtx();
+    std::array<uint8_t, MODBUS_MAX_ADU_LENGTH> late;
+    modbus_receive_confirmation(ctx, late.data());
+    modbus_flush(ctx);
+}
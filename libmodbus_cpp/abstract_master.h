@@ -3,14 +3,22 @@
 
 #include <QScopedPointer>
 #include <QVector>
+#include <QElapsedTimer>
+#include <errno.h>
 #include "defs.h"
 #include "backend.h"
+#include "register_layout.h"
+#include "rtt_estimator.h"
 
 namespace libmodbus_cpp {
 
 class AbstractMaster
 {
     QScopedPointer<AbstractBackend> m_backend;
+    RttEstimator m_rtt;
+    RetryPolicy m_retryPolicy;
+    RetryBudget m_retryBudget;
+    bool m_adaptiveTimeout = false;
 
 protected:
     AbstractMaster(AbstractBackend *backend);
@@ -37,39 +45,118 @@ public:
     template<typename ValueType>
     ValueType readInputRegister(uint16_t address);
 
+    QVector<uint16_t> readHoldingRegisters(uint16_t address, int count);
+    /// registers in host order, count is limited by MODBUS_MAX_WRITE_REGISTERS
+    void writeHoldingRegisters(uint16_t address, const QVector<uint16_t> &values);
+
+    /// FC23: write is done before read in one transaction
+    template<typename ReadType, typename WriteType>
+    ReadType writeAndReadHoldingRegisters(uint16_t writeAddress, WriteType value, uint16_t readAddress);
+    QVector<uint16_t> writeAndReadHoldingRegisters(uint16_t writeAddress, const QVector<uint16_t> &values, uint16_t readAddress, int readCount);
+
+    QVector<uint16_t> readInputRegisters(uint16_t address, int count);
+
+    /// whole struct described by RegisterLayout in one request, see register_layout.h
+    template<typename Layout>
+    typename Layout::StructType readHoldingStruct(uint16_t address) {
+        return Layout::decode(readHoldingRegisters(address, Layout::RegCount).constData(), getBackend()->getTargetByteOrder());
+    }
+    template<typename Layout>
+    typename Layout::StructType readInputStruct(uint16_t address) {
+        return Layout::decode(readInputRegisters(address, Layout::RegCount).constData(), getBackend()->getTargetByteOrder());
+    }
+    /// registers not covered by fields are written as zeroes
+    template<typename Layout>
+    void writeHoldingStruct(uint16_t address, const typename Layout::StructType &value) {
+        QVector<uint16_t> regs(Layout::RegCount, 0);
+        Layout::encode(value, regs.data(), getBackend()->getTargetByteOrder());
+        writeHoldingRegisters(address, regs);
+    }
+
+    /// byte order of struct codecs
+    void setTargetByteOrder(ByteOrder byteOrder);
+
     bool connect();
     void disconnect();
 
     void setSlaveAddress(uint8_t address);
     QString readSlaveId();
+    /// not retried, its reply is received separately
     RawResult sendRawRequest(uint8_t slaveId, uint8_t functionCode, const QVector<uint8_t> &data = QVector<uint8_t>(0));
+
+    /// response timeout of each request follows measured round trip times of device, see RttEstimator
+    void enableAdaptiveTimeout(int min_ms = 5, int max_ms = 500);
+    /// fixed timeout of libmodbus is restored
+    void disableAdaptiveTimeout(int timeout_ms = 500);
+    /// RTU: late reply of timed out request is awaited for one more timeout and dropped before retry.
+    /// TCP: late reply is refused by transaction id, retry is sent at once
+    void setRetryPolicy(const RetryPolicy &policy);
+    RttStats getRttStats() const;
+
+private:
+    /// request with adaptive timeout and retries, result of libmodbus call with its errno
+    template<typename Call>
+    int transact(Call call);
+    void beforeRequest();
+    /// true if timed out request is retried
+    bool afterRequest(int result, int error, int attempt, qint64 elapsed_ns);
+    void flushLateReply();
 };
 
+template<typename Call>
+int AbstractMaster::transact(Call call) {
+    for (int attempt = 0; ; ++attempt) {
+        beforeRequest();
+        QElapsedTimer timer;
+        timer.start();
+        const int result = call();
+        const int error = errno;
+        if (!afterRequest(result, error, attempt, timer.nsecsElapsed())) {
+            errno = error;
+            return result;
+        }
+    }
+}
+
 template<typename ValueType>
 ValueType AbstractMaster::readHoldingRegister(uint16_t address) {
     int regCount = std::max(sizeof(ValueType) / sizeof(uint16_t), static_cast<size_t>(1u));
     ValueType result;
-    int errorCode = modbus_read_registers(getBackend()->getCtx(), address, regCount, reinterpret_cast<uint16_t*>(&result));
+    int errorCode = transact([&]() { return modbus_read_registers(getBackend()->getCtx(), address, regCount, reinterpret_cast<uint16_t*>(&result)); });
     if (errorCode == -1)
-        throw RemoteReadError(modbus_strerror(errno));
+        throw RemoteReadError(modbus_strerror(errno), errno);
     return result;
 }
 
 template<typename ValueType>
 void AbstractMaster::writeHoldingRegister(uint16_t address, ValueType value) {
     int regCount = std::max(sizeof(ValueType) / sizeof(uint16_t), static_cast<size_t>(1u));
-    int errorCode = modbus_write_registers(getBackend()->getCtx(), address, regCount, reinterpret_cast<uint16_t*>(&value));
+    int errorCode = transact([&]() { return modbus_write_registers(getBackend()->getCtx(), address, regCount, reinterpret_cast<uint16_t*>(&value)); });
     if (errorCode == -1)
-        throw RemoteWriteError(modbus_strerror(errno));
+        throw RemoteWriteError(modbus_strerror(errno), errno);
+}
+
+template<typename ReadType, typename WriteType>
+ReadType AbstractMaster::writeAndReadHoldingRegisters(uint16_t writeAddress, WriteType value, uint16_t readAddress) {
+    int writeCount = std::max(sizeof(WriteType) / sizeof(uint16_t), static_cast<size_t>(1u));
+    int readCount = std::max(sizeof(ReadType) / sizeof(uint16_t), static_cast<size_t>(1u));
+    ReadType result;
+    int errorCode = transact([&]() {
+        return modbus_write_and_read_registers(getBackend()->getCtx(), writeAddress, writeCount, reinterpret_cast<uint16_t*>(&value),
+                                               readAddress, readCount, reinterpret_cast<uint16_t*>(&result));
+    });
+    if (errorCode == -1)
+        throw RemoteWriteError(modbus_strerror(errno), errno);
+    return result;
 }
 
 template<typename ValueType>
 ValueType AbstractMaster::readInputRegister(uint16_t address) {
     int regCount = std::max(sizeof(ValueType) / sizeof(uint16_t), static_cast<size_t>(1u));
     ValueType result;
-    int errorCode = modbus_read_input_registers(getBackend()->getCtx(), address, regCount, reinterpret_cast<uint16_t*>(&result));
+    int errorCode = transact([&]() { return modbus_read_input_registers(getBackend()->getCtx(), address, regCount, reinterpret_cast<uint16_t*>(&result)); });
     if (errorCode == -1)
-        throw RemoteReadError(modbus_strerror(errno));
+        throw RemoteReadError(modbus_strerror(errno), errno);
     return result;
 }
 
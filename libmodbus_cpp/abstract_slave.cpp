@@ -119,6 +119,20 @@ bool libmodbus_cpp::AbstractSlave::initMap(int holdingBitsCount, int inputBitsCo
 }
 
 
+bool libmodbus_cpp::AbstractSlave::initPersistentMap(const char *path, int holdingBitsCount, int inputBitsCount, int holdingRegistersCount, int inputRegistersCount)
+{
+    return getBackend()->initPersistentMap(path, holdingBitsCount, inputBitsCount, holdingRegistersCount, inputRegistersCount);
+}
+
+
+#ifndef _WIN32
+bool libmodbus_cpp::AbstractSlave::initSharedMap(const char *name, int holdingBitsCount, int inputBitsCount, int holdingRegistersCount, int inputRegistersCount)
+{
+    return getBackend()->initSharedMap(name, holdingBitsCount, inputBitsCount, holdingRegistersCount, inputRegistersCount);
+}
+#endif
+
+
 bool libmodbus_cpp::AbstractSlave::setAddress(uint8_t address)
 {
     return (modbus_set_slave(getBackend()->getCtx(), address) != -1);
@@ -131,6 +145,12 @@ bool libmodbus_cpp::AbstractSlave::setDefaultAddress()
 }
 
 
+void libmodbus_cpp::AbstractSlave::setMapConcurrency(MapConcurrency mode)
+{
+    getBackend()->setMapConcurrency(mode);
+}
+
+
 /// libmodbus_cpp::AbstractSlave hooks
 
 
@@ -171,6 +191,18 @@ void libmodbus_cpp::AbstractSlave::registerReadHookOnRange(DataType type, Addres
 }
 
 
+void libmodbus_cpp::AbstractSlave::registerHook(DataType type, AccessMode accessMode, Address rangeBaseAddress, Address rangeSize, HookTime hookTime, const HookLimits &limits, UniHookFunction func)
+{
+    getBackend()->addUniHook(type, accessMode, rangeBaseAddress, rangeSize, hookTime, limits, func);
+}
+
+
+void libmodbus_cpp::AbstractSlave::registerReadHookOnRange(DataType type, Address rangeBaseAddress, Address rangeSize, const HookLimits &limits, UniHookFunction func, HookTime hookTime)
+{
+    registerHook(type, libmodbus_cpp::AccessMode::Read, rangeBaseAddress, rangeSize, hookTime, limits, func);
+}
+
+
 void libmodbus_cpp::AbstractSlave::registerWriteHookOnRange(libmodbus_cpp::DataType type, libmodbus_cpp::Address rangeBaseAddress, Address rangeSize, UniHookFunction func, libmodbus_cpp::HookTime hookTime)
 {
     registerHook(type, libmodbus_cpp::AccessMode::Write, rangeBaseAddress, rangeSize, hookTime, func);
@@ -189,6 +221,75 @@ void libmodbus_cpp::AbstractSlave::registerWriteHook(DataType type, Address rang
 }
 
 
+void libmodbus_cpp::AbstractSlave::setAsyncHookWorkers(int workerCount, int queueCapacity)
+{
+    getBackend()->setAsyncHookWorkers(workerCount, queueCapacity);
+}
+
+
+libmodbus_cpp::HookPool::Stats libmodbus_cpp::AbstractSlave::getAsyncHookStats()
+{
+    return getBackend()->getAsyncHookStats();
+}
+
+
+bool libmodbus_cpp::AbstractSlave::waitForAsyncHooks(int timeout_ms)
+{
+    return getBackend()->waitForAsyncHooks(timeout_ms);
+}
+
+
+libmodbus_cpp::DeferredReplyPtr libmodbus_cpp::AbstractSlave::deferReply(int timeout_ms, uint8_t timeoutException)
+{
+    return getBackend()->deferReply(timeout_ms, timeoutException);
+}
+
+
+/// libmodbus_cpp::AbstractSlave changes made by master
+
+
+void libmodbus_cpp::AbstractSlave::enableChangeTracking(bool onlyValueChanges)
+{
+    getBackend()->enableChangeTracking(onlyValueChanges);
+}
+
+
+void libmodbus_cpp::AbstractSlave::disableChangeTracking()
+{
+    getBackend()->disableChangeTracking();
+}
+
+
+void libmodbus_cpp::AbstractSlave::setChangeDebounce(DataType type, Address rangeBaseAddress, Address rangeSize, int debounce_ms)
+{
+    getBackend()->setChangeDebounce(type, rangeBaseAddress, rangeSize, debounce_ms);
+}
+
+
+QVector<libmodbus_cpp::MapChange> libmodbus_cpp::AbstractSlave::takeMapChanges()
+{
+    return getBackend()->takeMapChanges();
+}
+
+
+void libmodbus_cpp::AbstractSlave::enableResponseCache(int maxEntries)
+{
+    getBackend()->enableResponseCache(maxEntries);
+}
+
+
+void libmodbus_cpp::AbstractSlave::disableResponseCache()
+{
+    getBackend()->disableResponseCache();
+}
+
+
+libmodbus_cpp::ResponseCache::Stats libmodbus_cpp::AbstractSlave::getResponseCacheStats()
+{
+    return getBackend()->getResponseCacheStats();
+}
+
+
 /// libmodbus_cpp::AbstractSlave activators
 
 
@@ -210,6 +311,12 @@ void libmodbus_cpp::AbstractSlave::setTargetByteOrder(ByteOrder byteOrder)
 }
 
 
+void libmodbus_cpp::AbstractSlave::setRegisterStorage(RegisterStorage storage)
+{
+    getBackend()->setRegisterStorage(storage);
+}
+
+
 /// libmodbus_cpp::AbstractSlave data access
 
 
@@ -233,3 +340,9 @@ bool libmodbus_cpp::AbstractSlave::getValueFromDiscreteInput(Address address)
 {
     return getBit<DataType::DiscreteInput>(address);
 }
+
+
+libmodbus_cpp::MapTransaction libmodbus_cpp::AbstractSlave::beginTransaction()
+{
+    return MapTransaction(getBackend());
+}
@@ -2,11 +2,14 @@
 #define LIBMODBUS_CPP_ABSTRACTSLAVE_H
 
 #include <QScopedPointer>
+#include <algorithm>
 #include <stdexcept>
 #include <iterator>
 #include "backend.h"
 #include "defs.h"
 #include "mapping_wrapper.h"
+#include "map_transaction.h"
+#include "register_layout.h"
 
 namespace libmodbus_cpp {
 
@@ -32,8 +35,16 @@ public:
     /// setup
 
     bool initMap(int holdingBitsCount, int inputBitsCount, int holdingRegistersCount, int inputRegistersCount);
+    /// tables are kept in memory mapped file at path and restored from it on next start if layout is the same
+    bool initPersistentMap(const char *path, int holdingBitsCount, int inputBitsCount, int holdingRegistersCount, int inputRegistersCount);
+#ifndef _WIN32
+    /// tables are exported to other processes in named POSIX shared memory segment, see shared_map_client.h
+    bool initSharedMap(const char *name, int holdingBitsCount, int inputBitsCount, int holdingRegistersCount, int inputRegistersCount);
+#endif
     bool setAddress(uint8_t address);
     bool setDefaultAddress();
+    /// must be called before startListen
+    void setMapConcurrency(MapConcurrency mode);
 
     /// hooks
 
@@ -48,12 +59,40 @@ public:
     void registerWriteHook(DataType type, Address rangeBaseAddress, UniHookFunction func, HookTime hookTime = HookTime::Postprocessing);
     void registerReadHookOnRange (DataType type, Address rangeBaseAddress, Address rangeSize, UniHookFunction func, HookTime hookTime = HookTime::Preprocessing);
     void registerWriteHookOnRange(DataType type, Address rangeBaseAddress, Address rangeSize, UniHookFunction func, HookTime hookTime = HookTime::Postprocessing);
+    /// calls are skipped by limits, e.g. refresh hook of range polled by many masters, see HookLimits
+    void registerHook(DataType type, AccessMode accessMode, Address rangeBaseAddress, Address rangeSize, HookTime hookTime, const HookLimits &limits, UniHookFunction func);
+    void registerReadHookOnRange(DataType type, Address rangeBaseAddress, Address rangeSize, const HookLimits &limits, UniHookFunction func, HookTime hookTime = HookTime::Preprocessing);
+
+    /// HookTime::AsyncPostprocessing hooks get UniHookInfo::snapshot and are run by worker pool in order per hook.
+    /// Hooks posted to full queue are dropped and counted by stats
+    void setAsyncHookWorkers(int workerCount, int queueCapacity = HookPool::DefaultQueueCapacity);
+    HookPool::Stats getAsyncHookStats();
+    bool waitForAsyncHooks(int timeout_ms);
+    /// from pre-processing hook: reply is sent when token completes, see AbstractSlaveBackend::deferReply()
+    DeferredReplyPtr deferReply(int timeout_ms, uint8_t timeoutException = MODBUS_EXCEPTION_GATEWAY_TARGET);
+
+    /// changes made by master
+
+    /// master writes are collected in dirty bitmap and drained by takeMapChanges() as coalesced ranges
+    void enableChangeTracking(bool onlyValueChanges = false);
+    void disableChangeTracking();
+    /// change of range is reported not earlier than debounce_ms after first write
+    void setChangeDebounce(DataType type, Address rangeBaseAddress, Address rangeSize, int debounce_ms);
+    QVector<MapChange> takeMapChanges();
+
+    /// replies of repeated FC1-FC4 reads served from cache until app or master writes covered items.
+    /// Writes through getMap() pointer must be reported by getBackend()->markMapWritten()
+    void enableResponseCache(int maxEntries = 256);
+    void disableResponseCache();
+    ResponseCache::Stats getResponseCacheStats();
 
     /// activation
 
     bool startListen();
     void stopListen();
     void setTargetByteOrder(ByteOrder byteOrder);
+    /// WireOrder makes read replies plain copies of tables, see RegisterStorage
+    void setRegisterStorage(RegisterStorage storage);
 
     /// data access
 
@@ -62,25 +101,35 @@ public:
     template<DataType dataType>
     void setBit(Address address, bool value) {
         const auto m = getBackend()->getMapper<dataType>(address);
+        SeqLockWriteGuard guard(getBackend()->getMapLock());
         setModbusBit(m.bitTable(), address, value);
+        getBackend()->markMapWritten(dataType, address, 1);
     }
 
     template<DataType dataType>
     bool getBit(Address address) {
         const auto m = getBackend()->getMapper<dataType>(address);
-        return getModbusBit(m.bitTable(), address);
+        bool res = false;
+        seqLockRead(getBackend()->getMapLock(), [&]() { res = getModbusBit(m.bitTable(), address); });
+        return res;
     }
 
     // registers
 
     template<typename ValueType, DataType dataType>
     void      setValue(Address address, ValueType value) {
-        setValueToRegs(getBackend()->getMapper<dataType>(address).regTable(), address, value);
+        uint16_t *table = getBackend()->getMapper<dataType>(address).regTable();
+        SeqLockWriteGuard guard(getBackend()->getMapLock());
+        setValueToRegs(table, address, value);
+        getBackend()->markMapWritten(dataType, address, (sizeof(ValueType) + 1) / sizeof(uint16_t));
     }
 
     template<typename ValueType, DataType dataType>
     ValueType getValue(Address address) {
-        return getValueFromRegs<ValueType>(getBackend()->getMapper<dataType>(address).regTable(), address);
+        uint16_t *table = getBackend()->getMapper<dataType>(address).regTable();
+        ValueType res;
+        seqLockRead(getBackend()->getMapLock(), [&]() { res = getValueFromRegs<ValueType>(table, address); });
+        return res;
     }
 
     // NOTE: old intf but also it's needed to ceate all template funcs!
@@ -108,24 +157,78 @@ public:
         return getValue<ValueType, DataType::InputRegister>(address);
     }
 
+    /// whole struct described by RegisterLayout in one pass, see register_layout.h
+    template<typename Layout, DataType dataType>
+    void setStruct(Address address, const typename Layout::StructType &value) {
+        uint16_t *table = getStructTable<Layout, dataType>(address);
+        SeqLockWriteGuard guard(getBackend()->getMapLock());
+        Layout::encode(value, table + address, getBackend()->getTargetByteOrder(), getBackend()->getRegisterStorage());
+        getBackend()->markMapWritten(dataType, address, Layout::RegCount);
+    }
+
+    template<typename Layout, DataType dataType>
+    typename Layout::StructType getStruct(Address address) {
+        uint16_t *table = getStructTable<Layout, dataType>(address);
+        typename Layout::StructType res;
+        const ByteOrder target = getBackend()->getTargetByteOrder();
+        const RegisterStorage storage = getBackend()->getRegisterStorage();
+        seqLockRead(getBackend()->getMapLock(), [&]() { Layout::decode(table + address, res, target, storage); });
+        return res;
+    }
+
+    template<typename Layout>
+    void setStructToHoldingRegisters(Address address, const typename Layout::StructType &value) {
+        setStruct<Layout, DataType::HoldingRegister>(address, value);
+    }
+    template<typename Layout>
+    typename Layout::StructType getStructFromHoldingRegisters(Address address) {
+        return getStruct<Layout, DataType::HoldingRegister>(address);
+    }
+    template<typename Layout>
+    void setStructToInputRegisters(Address address, const typename Layout::StructType &value) {
+        setStruct<Layout, DataType::InputRegister>(address, value);
+    }
+    template<typename Layout>
+    typename Layout::StructType getStructFromInputRegisters(Address address) {
+        return getStruct<Layout, DataType::InputRegister>(address);
+    }
+
+    /// stage many writes and publish them at once by MapTransaction::commit()
+    MapTransaction beginTransaction();
+
     template<DataType DT>
     void fillWith(Address address, uint8_t value, int byteSize) {
         const auto m = getBackend()->getMapper<DT>(address);
         uint8_t* d = (uint8_t*)(m.table());
+        SeqLockWriteGuard guard(getBackend()->getMapLock());
         memset(d, value, byteSize);
+        getBackend()->markMapWritten(DT, 0, m.count());
     }
 
 private:
 
+    template<typename Layout, DataType dataType>
+    uint16_t *getStructTable(Address address) {
+        const auto m = getBackend()->getMapper<dataType>(address);
+        if (m.count() < address + Layout::RegCount) {
+            throw LocalReadError("wrong address");
+        }
+        return m.regTable();
+    }
+
+    layout_detail::Codec codec() {
+        return layout_detail::makeCodec(getBackend()->getTargetByteOrder(), getBackend()->getRegisterStorage());
+    }
+
     template<typename ValueType>
     void setValueToRegs(uint16_t *table, uint16_t address, const ValueType &value) {
-        registerMemoryCopy(&value, sizeof(ValueType), table + address, getBackend()->getTargetByteOrder());
+        codec().encode<FieldOrder::Target, sizeof(ValueType)>(&value, table + address);
     }
 
     template<typename ValueType>
     ValueType getValueFromRegs(uint16_t *table, uint16_t address) {
         ValueType res;
-        registerMemoryCopy(table + address, sizeof(ValueType), &res, getBackend()->getTargetByteOrder());
+        codec().decode<FieldOrder::Target, sizeof(ValueType)>(table + address, &res);
         return res;
     }
 
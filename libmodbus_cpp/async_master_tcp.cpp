@@ -0,0 +1,510 @@
+#include <errno.h>
+#include <QPointer>
+#include <libmodbus_cpp/async_master_tcp.h>
+#include "logger.h"
+
+#define LDOM_AMTCP "[modbus.master.async.tcp]"
+
+
+namespace {
+
+const int MBAP_HEADER_LENGTH = 7;
+
+void putU16(QByteArray &buf, uint16_t value) {
+    buf.append(static_cast<char>(value >> 8));
+    buf.append(static_cast<char>(value & 0xFF));
+}
+
+uint16_t getU16(const uint8_t *p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+QByteArray requestBasis(uint8_t functionCode, uint16_t address, uint16_t count) {
+    QByteArray pdu;
+    pdu.append(static_cast<char>(functionCode));
+    putU16(pdu, address);
+    putU16(pdu, count);
+    return pdu;
+}
+
+bool isWriteFunction(uint8_t functionCode) {
+    switch (functionCode) {
+        case MODBUS_FC_WRITE_SINGLE_COIL:
+        case MODBUS_FC_WRITE_SINGLE_REGISTER:
+        case MODBUS_FC_WRITE_MULTIPLE_COILS:
+        case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+        case MODBUS_FC_MASK_WRITE_REGISTER:
+        case MODBUS_FC_WRITE_AND_READ_REGISTERS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::exception_ptr makeError(uint8_t functionCode, int errorCode) {
+    const std::string msg = modbus_strerror(errorCode);
+    if (isWriteFunction(functionCode)) {
+        return std::make_exception_ptr(libmodbus_cpp::RemoteWriteError(msg, errorCode));
+    }
+    return std::make_exception_ptr(libmodbus_cpp::RemoteReadError(msg, errorCode));
+}
+
+/// false if reply is exception or malformed, error is reported
+bool checkReply(const uint8_t *pdu, int pduLength, uint8_t functionCode, int minLength, const libmodbus_cpp::AsyncMasterTcp::ErrorHandler &onError) {
+    if ((pduLength >= 2) && (pdu[0] == (functionCode | 0x80))) {
+        onError(makeError(functionCode, MODBUS_ENOBASE + pdu[1]));
+        return false;
+    }
+    if ((pduLength < minLength) || (pdu[0] != functionCode)) {
+        onError(makeError(functionCode, EMBBADDATA));
+        return false;
+    }
+    return true;
+}
+
+template<typename T>
+libmodbus_cpp::AsyncMasterTcp::ErrorHandler failer(libmodbus_cpp::AsyncReply<T> reply) {
+    return [reply](std::exception_ptr e) mutable { reply.fail(e); };
+}
+
+}
+
+
+libmodbus_cpp::AsyncMasterTcp::AsyncMasterTcp(const QString &host, quint16 port, QObject *parent)
+    : QObject(parent)
+    , m_host(host)
+    , m_port(port)
+{
+    m_timer.setSingleShot(true);
+    m_clock.start();
+#ifdef USE_QT5
+    connect(&m_socket, &QTcpSocket::connected,    this, &AsyncMasterTcp::slot_connected);
+    connect(&m_socket, &QTcpSocket::disconnected, this, &AsyncMasterTcp::slot_disconnected);
+    connect(&m_socket, &QTcpSocket::readyRead,    this, &AsyncMasterTcp::slot_readyRead);
+#if QT_VERSION >= QT_VERSION_CHECK(5,15,0)
+    connect(&m_socket, &QTcpSocket::errorOccurred, this, &AsyncMasterTcp::slot_error);
+#else
+    connect(&m_socket, static_cast<void (QAbstractSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error), this, &AsyncMasterTcp::slot_error);
+#endif
+    connect(&m_timer,  &QTimer::timeout,          this, &AsyncMasterTcp::slot_checkTimeouts);
+#else
+    connect(&m_socket, SIGNAL(connected()),    this, SLOT(slot_connected()));
+    connect(&m_socket, SIGNAL(disconnected()), this, SLOT(slot_disconnected()));
+    connect(&m_socket, SIGNAL(readyRead()),    this, SLOT(slot_readyRead()));
+    connect(&m_socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(slot_error()));
+    connect(&m_timer,  SIGNAL(timeout()),      this, SLOT(slot_checkTimeouts()));
+#endif
+}
+
+
+libmodbus_cpp::AsyncMasterTcp::~AsyncMasterTcp()
+{
+    m_socket.disconnect(this);
+    failAll(modbus_strerror(ECONNRESET));
+}
+
+
+void libmodbus_cpp::AsyncMasterTcp::connectToSlave()
+{
+    LMB_DGLOG(LDOM_AMTCP, "connect to" << m_host << m_port);
+    m_socket.connectToHost(m_host, m_port);
+}
+
+
+void libmodbus_cpp::AsyncMasterTcp::disconnectFromSlave()
+{
+    m_socket.disconnectFromHost();
+}
+
+
+bool libmodbus_cpp::AsyncMasterTcp::isConnected() const
+{
+    return m_socket.state() == QAbstractSocket::ConnectedState;
+}
+
+
+void libmodbus_cpp::AsyncMasterTcp::setSlaveAddress(uint8_t address)
+{
+    m_unit = address;
+}
+
+
+void libmodbus_cpp::AsyncMasterTcp::setResponseTimeout(int timeout_ms)
+{
+    m_timeout_ms = timeout_ms;
+}
+
+
+void libmodbus_cpp::AsyncMasterTcp::setMaxInFlight(int count)
+{
+    m_maxInFlight = std::max(count, 1);
+    pump();
+}
+
+
+/// bits
+
+
+libmodbus_cpp::AsyncReply<bool> libmodbus_cpp::AsyncMasterTcp::readCoil(Address address)
+{
+    AsyncReply<bool> reply;
+    readBits(MODBUS_FC_READ_COILS, address, 1, [reply](const QVector<bool> &bits) mutable { reply.finish(bits.at(0)); }, failer(reply));
+    return reply;
+}
+
+
+libmodbus_cpp::AsyncReply<QVector<bool>> libmodbus_cpp::AsyncMasterTcp::readCoils(Address address, int count)
+{
+    AsyncReply<QVector<bool>> reply;
+    readBits(MODBUS_FC_READ_COILS, address, count, [reply](const QVector<bool> &bits) mutable { reply.finish(bits); }, failer(reply));
+    return reply;
+}
+
+
+libmodbus_cpp::AsyncReply<void> libmodbus_cpp::AsyncMasterTcp::writeCoil(Address address, bool value)
+{
+    AsyncReply<void> reply;
+    const QByteArray pdu = requestBasis(MODBUS_FC_WRITE_SINGLE_COIL, address, value ? 0xFF00 : 0x0000);
+    const ErrorHandler onError = failer(reply);
+    request(m_unit, pdu, [reply, onError](const uint8_t *rsp, int rspLength) mutable {
+        if (checkReply(rsp, rspLength, MODBUS_FC_WRITE_SINGLE_COIL, 5, onError)) {
+            reply.finish();
+        }
+    }, onError);
+    return reply;
+}
+
+
+libmodbus_cpp::AsyncReply<void> libmodbus_cpp::AsyncMasterTcp::writeCoils(Address address, const QVector<bool> &values)
+{
+    AsyncReply<void> reply;
+    const int count = values.size();
+    QByteArray pdu = requestBasis(MODBUS_FC_WRITE_MULTIPLE_COILS, address, count);
+    const int byteCount = (count + 7) / 8;
+    pdu.append(static_cast<char>(byteCount));
+    for (int i = 0; i < byteCount; ++i) {
+        uint8_t byte = 0;
+        for (int b = 0; (b < 8) && (i * 8 + b < count); ++b) {
+            if (values.at(i * 8 + b)) {
+                byte |= (1 << b);
+            }
+        }
+        pdu.append(static_cast<char>(byte));
+    }
+    const ErrorHandler onError = failer(reply);
+    request(m_unit, pdu, [reply, onError](const uint8_t *rsp, int rspLength) mutable {
+        if (checkReply(rsp, rspLength, MODBUS_FC_WRITE_MULTIPLE_COILS, 5, onError)) {
+            reply.finish();
+        }
+    }, onError);
+    return reply;
+}
+
+
+libmodbus_cpp::AsyncReply<bool> libmodbus_cpp::AsyncMasterTcp::readDiscreteInput(Address address)
+{
+    AsyncReply<bool> reply;
+    readBits(MODBUS_FC_READ_DISCRETE_INPUTS, address, 1, [reply](const QVector<bool> &bits) mutable { reply.finish(bits.at(0)); }, failer(reply));
+    return reply;
+}
+
+
+libmodbus_cpp::AsyncReply<QVector<bool>> libmodbus_cpp::AsyncMasterTcp::readDiscreteInputs(Address address, int count)
+{
+    AsyncReply<QVector<bool>> reply;
+    readBits(MODBUS_FC_READ_DISCRETE_INPUTS, address, count, [reply](const QVector<bool> &bits) mutable { reply.finish(bits); }, failer(reply));
+    return reply;
+}
+
+
+/// registers
+
+
+libmodbus_cpp::AsyncReply<QVector<uint16_t>> libmodbus_cpp::AsyncMasterTcp::readHoldingRegisters(Address address, int count)
+{
+    AsyncReply<QVector<uint16_t>> reply;
+    readRegisters(MODBUS_FC_READ_HOLDING_REGISTERS, address, count, [reply](const QVector<uint16_t> &regs) mutable { reply.finish(regs); }, failer(reply));
+    return reply;
+}
+
+
+libmodbus_cpp::AsyncReply<QVector<uint16_t>> libmodbus_cpp::AsyncMasterTcp::readInputRegisters(Address address, int count)
+{
+    AsyncReply<QVector<uint16_t>> reply;
+    readRegisters(MODBUS_FC_READ_INPUT_REGISTERS, address, count, [reply](const QVector<uint16_t> &regs) mutable { reply.finish(regs); }, failer(reply));
+    return reply;
+}
+
+
+libmodbus_cpp::AsyncReply<void> libmodbus_cpp::AsyncMasterTcp::writeHoldingRegisters(Address address, const QVector<uint16_t> &values)
+{
+    AsyncReply<void> reply;
+    QByteArray pdu = requestBasis(MODBUS_FC_WRITE_MULTIPLE_REGISTERS, address, values.size());
+    pdu.append(static_cast<char>(values.size() * 2));
+    for (const uint16_t v : values) {
+        putU16(pdu, v);
+    }
+    const ErrorHandler onError = failer(reply);
+    request(m_unit, pdu, [reply, onError](const uint8_t *rsp, int rspLength) mutable {
+        if (checkReply(rsp, rspLength, MODBUS_FC_WRITE_MULTIPLE_REGISTERS, 5, onError)) {
+            reply.finish();
+        }
+    }, onError);
+    return reply;
+}
+
+
+libmodbus_cpp::AsyncReply<QVector<uint16_t>> libmodbus_cpp::AsyncMasterTcp::writeAndReadHoldingRegisters(Address writeAddress, const QVector<uint16_t> &values, Address readAddress, int readCount)
+{
+    AsyncReply<QVector<uint16_t>> reply;
+    QByteArray pdu = requestBasis(MODBUS_FC_WRITE_AND_READ_REGISTERS, readAddress, readCount);
+    putU16(pdu, writeAddress);
+    putU16(pdu, values.size());
+    pdu.append(static_cast<char>(values.size() * 2));
+    for (const uint16_t v : values) {
+        putU16(pdu, v);
+    }
+    const ErrorHandler onError = failer(reply);
+    request(m_unit, pdu, [reply, onError, readCount](const uint8_t *rsp, int rspLength) mutable {
+        if (!checkReply(rsp, rspLength, MODBUS_FC_WRITE_AND_READ_REGISTERS, 2 + readCount * 2, onError)) {
+            return;
+        }
+        if (rsp[1] != readCount * 2) {
+            onError(makeError(MODBUS_FC_WRITE_AND_READ_REGISTERS, EMBBADDATA));
+            return;
+        }
+        QVector<uint16_t> regs(readCount);
+        for (int i = 0; i < readCount; ++i) {
+            regs[i] = getU16(rsp + 2 + i * 2);
+        }
+        reply.finish(regs);
+    }, onError);
+    return reply;
+}
+
+
+libmodbus_cpp::AsyncReply<libmodbus_cpp::RawResult> libmodbus_cpp::AsyncMasterTcp::sendRawRequest(uint8_t slaveId, uint8_t functionCode, const QVector<uint8_t> &data)
+{
+    AsyncReply<RawResult> reply;
+    QByteArray pdu;
+    pdu.append(static_cast<char>(functionCode));
+    pdu.append(reinterpret_cast<const char *>(data.constData()), data.size());
+    request(slaveId, pdu, [reply, slaveId](const uint8_t *rsp, int rspLength) mutable {
+        reply.finish(RawResult { slaveId, rsp[0], QByteArray(reinterpret_cast<const char *>(rsp) + 1, rspLength - 1) });
+    }, failer(reply));
+    return reply;
+}
+
+
+/// transport
+
+
+void libmodbus_cpp::AsyncMasterTcp::request(uint8_t unit, const QByteArray &pdu, PduHandler onReply, ErrorHandler onError)
+{
+    Pending p;
+    p.adu.reserve(MBAP_HEADER_LENGTH + pdu.size());
+    putU16(p.adu, 0); // transaction id is set on send
+    putU16(p.adu, 0); // protocol id
+    putU16(p.adu, pdu.size() + 1);
+    p.adu.append(static_cast<char>(unit));
+    p.adu.append(pdu);
+    // timeout covers wait in queue, e.g. for connect which never completes
+    p.deadline_ms = m_clock.elapsed() + m_timeout_ms;
+    p.onReply = onReply;
+    p.onError = onError;
+    m_queue.append(p);
+    pump();
+}
+
+
+void libmodbus_cpp::AsyncMasterTcp::slot_connected()
+{
+    LMB_DGLOG(LDOM_AMTCP, "connected");
+    pump();
+}
+
+
+void libmodbus_cpp::AsyncMasterTcp::slot_disconnected()
+{
+    LMB_DGLOG(LDOM_AMTCP, "disconnected");
+    m_rx.clear();
+    failAll(modbus_strerror(ECONNRESET));
+}
+
+
+void libmodbus_cpp::AsyncMasterTcp::slot_error()
+{
+    // e.g. refused connect, disconnected() is not emitted for it
+    LMB_DGLOG(LDOM_AMTCP, "socket error:" << m_socket.errorString());
+    m_rx.clear();
+    failAll(m_socket.errorString().toStdString());
+}
+
+
+void libmodbus_cpp::AsyncMasterTcp::slot_readyRead()
+{
+    m_rx.append(m_socket.readAll());
+
+    // continuations of user may send, disconnect or delete master, they are called after parsing
+    const QPointer<AsyncMasterTcp> self(this);
+    QList<std::function<void()>> completed;
+    while (m_rx.size() >= MBAP_HEADER_LENGTH) {
+        const uint8_t *adu = reinterpret_cast<const uint8_t *>(m_rx.constData());
+        const int length = getU16(adu + 4);
+        if (length < 2) {
+            LMB_WGLOG(LDOM_AMTCP, "bad MBAP length, drop stream");
+            m_socket.abort();
+            break;
+        }
+        const int total = 6 + length;
+        if (m_rx.size() < total) {
+            break;
+        }
+
+        const uint16_t tid = getU16(adu);
+        auto it = m_inFlight.find(tid);
+        if (it == m_inFlight.end()) {
+            LMB_DGLOG(LDOM_AMTCP, "late or unknown reply, tid =" << tid);
+        } else if (static_cast<uint8_t>(it->adu.at(6)) != adu[6]) {
+            LMB_WGLOG(LDOM_AMTCP, "reply of other unit, tid =" << tid << "unit =" << adu[6]);
+            const ErrorHandler onError = it->onError;
+            m_inFlight.erase(it);
+            completed.append([onError]() { onError(std::make_exception_ptr(RemoteReadError(modbus_strerror(EMBBADDATA), EMBBADDATA))); });
+        } else {
+            const PduHandler onReply = it->onReply;
+            const QByteArray pdu = m_rx.mid(MBAP_HEADER_LENGTH, length - 1);
+            m_inFlight.erase(it);
+            completed.append([onReply, pdu]() { onReply(reinterpret_cast<const uint8_t *>(pdu.constData()), pdu.size()); });
+        }
+        m_rx.remove(0, total);
+    }
+
+    for (const std::function<void()> &c : completed) {
+        c();
+    }
+    if (self) {
+        pump();
+    }
+}
+
+
+void libmodbus_cpp::AsyncMasterTcp::slot_checkTimeouts()
+{
+    const qint64 now = m_clock.elapsed();
+    QList<ErrorHandler> expired;
+    auto it = m_inFlight.begin();
+    while (it != m_inFlight.end()) {
+        if (it->deadline_ms <= now) {
+            expired.append(it->onError);
+            it = m_inFlight.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    auto queued = m_queue.begin();
+    while (queued != m_queue.end()) {
+        if (queued->deadline_ms <= now) {
+            expired.append(queued->onError);
+            queued = m_queue.erase(queued);
+        } else {
+            ++queued;
+        }
+    }
+    const QPointer<AsyncMasterTcp> self(this);
+    for (const ErrorHandler &onError : expired) {
+        onError(std::make_exception_ptr(RemoteReadError(modbus_strerror(ETIMEDOUT), ETIMEDOUT)));
+    }
+    if (self) {
+        pump();
+    }
+}
+
+
+void libmodbus_cpp::AsyncMasterTcp::pump()
+{
+    if (isConnected()) {
+        while (!m_queue.isEmpty() && (m_inFlight.size() < m_maxInFlight)) {
+            Pending p = m_queue.takeFirst();
+            const uint16_t tid = m_nextTid++;
+            p.adu[0] = static_cast<char>(tid >> 8);
+            p.adu[1] = static_cast<char>(tid & 0xFF);
+            m_socket.write(p.adu);
+            m_inFlight.insert(tid, p);
+        }
+    }
+    rearmTimer();
+}
+
+
+void libmodbus_cpp::AsyncMasterTcp::failAll(const std::string &reason)
+{
+    QList<ErrorHandler> handlers;
+    for (const Pending &p : m_inFlight) {
+        handlers.append(p.onError);
+    }
+    for (const Pending &p : m_queue) {
+        handlers.append(p.onError);
+    }
+    m_inFlight.clear();
+    m_queue.clear();
+    m_timer.stop();
+    for (const ErrorHandler &onError : handlers) {
+        onError(std::make_exception_ptr(ConnectionError(reason)));
+    }
+}
+
+
+void libmodbus_cpp::AsyncMasterTcp::rearmTimer()
+{
+    if (m_inFlight.isEmpty() && m_queue.isEmpty()) {
+        m_timer.stop();
+        return;
+    }
+    qint64 nearest = m_queue.isEmpty() ? m_inFlight.begin()->deadline_ms : m_queue.first().deadline_ms;
+    for (const Pending &p : m_inFlight) {
+        nearest = std::min(nearest, p.deadline_ms);
+    }
+    for (const Pending &p : m_queue) {
+        nearest = std::min(nearest, p.deadline_ms);
+    }
+    m_timer.start(static_cast<int>(std::max<qint64>(nearest - m_clock.elapsed(), 0)));
+}
+
+
+void libmodbus_cpp::AsyncMasterTcp::readRegisters(FunctionCode functionCode, Address address, int count, std::function<void(const QVector<uint16_t> &)> onRegs, ErrorHandler onError)
+{
+    request(m_unit, requestBasis(functionCode, address, count), [=](const uint8_t *rsp, int rspLength) {
+        if (!checkReply(rsp, rspLength, functionCode, 2 + count * 2, onError)) {
+            return;
+        }
+        if (rsp[1] != count * 2) {
+            onError(makeError(functionCode, EMBBADDATA));
+            return;
+        }
+        QVector<uint16_t> regs(count);
+        for (int i = 0; i < count; ++i) {
+            regs[i] = getU16(rsp + 2 + i * 2);
+        }
+        onRegs(regs);
+    }, onError);
+}
+
+
+void libmodbus_cpp::AsyncMasterTcp::readBits(FunctionCode functionCode, Address address, int count, std::function<void(const QVector<bool> &)> onBits, ErrorHandler onError)
+{
+    const int byteCount = (count + 7) / 8;
+    request(m_unit, requestBasis(functionCode, address, count), [=](const uint8_t *rsp, int rspLength) {
+        if (!checkReply(rsp, rspLength, functionCode, 2 + byteCount, onError)) {
+            return;
+        }
+        if (rsp[1] != byteCount) {
+            onError(makeError(functionCode, EMBBADDATA));
+            return;
+        }
+        QVector<bool> bits(count);
+        for (int i = 0; i < count; ++i) {
+            bits[i] = (rsp[2 + i / 8] >> (i % 8)) & 1;
+        }
+        onBits(bits);
+    }, onError);
+}
@@ -0,0 +1,139 @@
+#ifndef LIBMODBUS_CPP_ASYNC_MASTER_TCP_H_GUARD
+#define LIBMODBUS_CPP_ASYNC_MASTER_TCP_H_GUARD
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QMap>
+#include <QList>
+#include <cstring>
+#include <algorithm>
+#include "defs.h"
+#include "async_reply.h"
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief Modbus TCP master on non-blocking socket of Qt event loop
+ * Requests never block calling thread: each one returns AsyncReply which is finished
+ * from event loop of thread owning the master. Many masters can live in one thread.
+ * Registers are exchanged in host order as in AbstractMaster.
+ */
+class AsyncMasterTcp : public QObject
+{
+    Q_OBJECT
+
+public:
+    using PduHandler = std::function<void(const uint8_t *pdu, int pduLength)>;
+    using ErrorHandler = std::function<void(std::exception_ptr)>;
+
+    AsyncMasterTcp(const QString &host, quint16 port = MODBUS_TCP_DEFAULT_PORT, QObject *parent = Q_NULLPTR);
+    ~AsyncMasterTcp() override;
+
+    /// requests issued before connection is established are sent right after it
+    void connectToSlave();
+    void disconnectFromSlave();
+    bool isConnected() const;
+
+    void setSlaveAddress(uint8_t address);
+    void setResponseTimeout(int timeout_ms);
+    /// count of requests sent without waiting for replies, 1 for devices which can't pipeline
+    void setMaxInFlight(int count);
+
+    AsyncReply<bool> readCoil(Address address);
+    AsyncReply<QVector<bool>> readCoils(Address address, int count);
+    AsyncReply<void> writeCoil(Address address, bool value);
+    AsyncReply<void> writeCoils(Address address, const QVector<bool> &values);
+
+    AsyncReply<bool> readDiscreteInput(Address address);
+    AsyncReply<QVector<bool>> readDiscreteInputs(Address address, int count);
+
+    template<typename ValueType>
+    AsyncReply<ValueType> readHoldingRegister(Address address) {
+        return readValue<ValueType>(MODBUS_FC_READ_HOLDING_REGISTERS, address);
+    }
+
+    template<typename ValueType>
+    AsyncReply<ValueType> readInputRegister(Address address) {
+        return readValue<ValueType>(MODBUS_FC_READ_INPUT_REGISTERS, address);
+    }
+
+    template<typename ValueType>
+    AsyncReply<void> writeHoldingRegister(Address address, ValueType value) {
+        QVector<uint16_t> regs(regCountOf<ValueType>());
+        memcpy(regs.data(), &value, sizeof(ValueType));
+        return writeHoldingRegisters(address, regs);
+    }
+
+    AsyncReply<QVector<uint16_t>> readHoldingRegisters(Address address, int count);
+    AsyncReply<QVector<uint16_t>> readInputRegisters(Address address, int count);
+    AsyncReply<void> writeHoldingRegisters(Address address, const QVector<uint16_t> &values);
+    /// FC23: write is done before read in one transaction
+    AsyncReply<QVector<uint16_t>> writeAndReadHoldingRegisters(Address writeAddress, const QVector<uint16_t> &values, Address readAddress, int readCount);
+
+    AsyncReply<RawResult> sendRawRequest(uint8_t slaveId, uint8_t functionCode, const QVector<uint8_t> &data = QVector<uint8_t>(0));
+
+    /// low level: pdu starts with function code, handler gets any reply pdu including exception one
+    void request(uint8_t unit, const QByteArray &pdu, PduHandler onReply, ErrorHandler onError);
+
+private slots:
+    void slot_connected();
+    void slot_disconnected();
+    void slot_readyRead();
+    void slot_error();
+    void slot_checkTimeouts();
+
+private:
+    struct Pending {
+        QByteArray adu;
+        qint64 deadline_ms; // from queueing
+        PduHandler onReply;
+        ErrorHandler onError;
+    };
+
+    template<typename ValueType>
+    static int regCountOf() {
+        return std::max(sizeof(ValueType) / sizeof(uint16_t), static_cast<size_t>(1u));
+    }
+
+    template<typename ValueType>
+    AsyncReply<ValueType> readValue(FunctionCode functionCode, Address address) {
+        AsyncReply<ValueType> reply;
+        readRegisters(functionCode, address, regCountOf<ValueType>(),
+                      [reply](const QVector<uint16_t> &regs) mutable {
+                          ValueType value;
+                          memcpy(&value, regs.constData(), std::min(sizeof(ValueType), regs.size() * sizeof(uint16_t)));
+                          reply.finish(value);
+                      },
+                      [reply](std::exception_ptr e) mutable { reply.fail(e); });
+        return reply;
+    }
+
+    void readRegisters(FunctionCode functionCode, Address address, int count, std::function<void(const QVector<uint16_t> &)> onRegs, ErrorHandler onError);
+    void readBits(FunctionCode functionCode, Address address, int count, std::function<void(const QVector<bool> &)> onBits, ErrorHandler onError);
+    void pump();
+    void failAll(const std::string &reason);
+    void rearmTimer();
+
+    QTcpSocket m_socket;
+    QString m_host;
+    quint16 m_port;
+    uint8_t m_unit = MODBUS_TCP_SLAVE;
+    uint16_t m_nextTid = 0;
+    int m_timeout_ms = 500;
+    int m_maxInFlight = 1;
+
+    QList<Pending> m_queue;
+    QMap<uint16_t, Pending> m_inFlight;
+    QByteArray m_rx;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_ASYNC_MASTER_TCP_H_GUARD
@@ -0,0 +1,128 @@
+#ifndef LIBMODBUS_CPP_ASYNC_REPLY_H_GUARD
+#define LIBMODBUS_CPP_ASYNC_REPLY_H_GUARD
+
+#include <memory>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <type_traits>
+
+#if defined(__cpp_impl_coroutine) && (__cpp_impl_coroutine >= 201902L)
+#include <coroutine>
+#define LIBMODBUS_CPP_HAS_COROUTINES 1
+#endif
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief result of asynchronous request, filled later in event loop of its master
+ * Copies share the same state. With C++20 coroutines reply can be co_await-ed:
+ * co_await resumes coroutine in thread of master and throws stored error if any.
+ */
+template<typename T>
+class AsyncReply
+{
+    using Storage = typename std::conditional<std::is_void<T>::value, char, T>::type;
+
+    struct State {
+        bool finished = false;
+        Storage value = Storage();
+        std::exception_ptr error;
+        std::vector<std::function<void()>> continuations;
+    };
+
+    std::shared_ptr<State> m_state;
+
+public:
+    AsyncReply() : m_state(std::make_shared<State>()) {}
+
+    bool isFinished() const {
+        return m_state->finished;
+    }
+
+    bool hasError() const {
+        return m_state->finished && m_state->error;
+    }
+
+    /// throws error of request
+    T result() const {
+        if (m_state->error) {
+            std::rethrow_exception(m_state->error);
+        }
+        return static_cast<T>(m_state->value);
+    }
+
+    /// called immediately if reply is already finished
+    void onFinished(std::function<void(const AsyncReply &)> func) const {
+        if (m_state->finished) {
+            func(*this);
+            return;
+        }
+        const AsyncReply self = *this;
+        m_state->continuations.push_back([func, self]() { func(self); });
+    }
+
+    // producer side
+
+    void finish(Storage value = Storage()) {
+        m_state->value = std::move(value);
+        complete();
+    }
+
+    void fail(std::exception_ptr error) {
+        m_state->error = error;
+        complete();
+    }
+
+#ifdef LIBMODBUS_CPP_HAS_COROUTINES
+    bool await_ready() const noexcept {
+        return isFinished();
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) const {
+        m_state->continuations.push_back([handle]() { handle.resume(); });
+    }
+
+    T await_resume() const {
+        return result();
+    }
+#endif
+
+private:
+    void complete() {
+        m_state->finished = true;
+        std::vector<std::function<void()>> continuations;
+        continuations.swap(m_state->continuations);
+        for (const auto &c : continuations) {
+            c();
+        }
+    }
+};
+
+
+#ifdef LIBMODBUS_CPP_HAS_COROUTINES
+/**
+ * @brief coroutine type for straight-line device conversations, may be dropped (fire-and-forget)
+ * Escaped exception is stored, co_await of task or result() rethrows it.
+ */
+struct AsyncTask : public AsyncReply<void> {
+    struct promise_type {
+        AsyncReply<void> reply;
+
+        AsyncTask get_return_object() noexcept { return AsyncTask(reply); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() { reply.finish(); }
+        void unhandled_exception() { reply.fail(std::current_exception()); }
+    };
+
+private:
+    explicit AsyncTask(const AsyncReply<void> &reply) : AsyncReply<void>(reply) {}
+};
+#endif
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_ASYNC_REPLY_H_GUARD
@@ -1,9 +1,22 @@
 #include <cassert>
+#include <algorithm>
+#include <array>
+#include <memory>
 #include <modbus/modbus-private.h>
 #include <libmodbus_cpp/backend.h>
+#include <libmodbus_cpp/change_tracker.h>
+#include <libmodbus_cpp/response_cache.h>
+#include <libmodbus_cpp/hook_pool.h>
+#include <libmodbus_cpp/deferred_reply.h>
+#include <libmodbus_cpp/map_file.h>
+#include <libmodbus_cpp/shared_map.h>
+#include <libmodbus_cpp/pdu.h>
 #include <QVector>
+#include <QSet>
+#include <QMutex>
 #include <QDebug>
 #include <QTime>
+#include <QElapsedTimer>
 #include <QEventLoop>
 #include "logger.h"
 
@@ -96,6 +109,7 @@ public:
     struct UniHookSetup {
         AddressRange range;
         UniHookFunction handler;
+        std::shared_ptr<HookGate> gate; // nil without limits
 
         bool isHit(const AddressRange& hitRng) const {
             return range.intersectsWith(hitRng);
@@ -105,10 +119,13 @@ public:
     struct UniHooks {
         QVector<UniHookSetup> hooks;
 
-        void add(Address rangeBaseAddress, Address rangeLength, UniHookFunction func) {
+        void add(Address rangeBaseAddress, Address rangeLength, UniHookFunction func, const HookLimits &limits) {
             UniHookSetup stp;
             stp.handler = func;
             stp.range = AddressRange::fromSizedRange(rangeBaseAddress, rangeLength);
+            if (limits.isSet()) {
+                stp.gate = std::make_shared<HookGate>(limits);
+            }
             hooks.append(stp);
         }
 
@@ -126,7 +143,7 @@ public:
             });
         }
 
-        void process(UniHookInfo& info) {
+        void process(UniHookInfo& info, const QElapsedTimer &clock) const {
             info.range = AddressRange::fromSizedRange(info.rangeBaseAddress, info.rangeSize);
 
             //TODO 2: improove speed
@@ -135,7 +152,32 @@ public:
             for(int i = 0; i < N; ++i) {
                 const UniHookSetup& hookRange = hooks.at(i);
                 if (hookRange.isHit(info.range)) {
-                    hookRange.handler(&info);
+                    if (hookRange.gate) {
+                        hookRange.gate->pass(clock, [&hookRange, &info]() { hookRange.handler(&info); });
+                    } else {
+                        hookRange.handler(&info);
+                    }
+                }
+            }
+        }
+
+        /// each hook has lane of its own, so it gets requests in order they were served
+        template<typename Snapshot>
+        void post(UniHookInfo& info, UniHookKey key, HookPool *pool, Snapshot takeSnapshot) const {
+            info.range = AddressRange::fromSizedRange(info.rangeBaseAddress, info.rangeSize);
+
+            bool taken = false;
+            const int N = hooks.size();
+            for(int i = 0; i < N; ++i) {
+                const UniHookSetup& hookRange = hooks.at(i);
+                if (hookRange.isHit(info.range)) {
+                    if (!taken) {
+                        info.snapshot = takeSnapshot(info);
+                        taken = true;
+                    }
+                    const UniHookFunction handler = hookRange.handler;
+                    const UniHookInfo job = info;
+                    pool->post((static_cast<quint64>(key) << 32) | static_cast<quint64>(i), [handler, job]() { handler(&job); });
                 }
             }
         }
@@ -147,10 +189,97 @@ public:
 
     modbus_mapping_t *m_map = Q_NULLPTR;
     AbstractSlaveBackend* q;
+    QElapsedTimer m_clock; // of hook limits
+
+    MapConcurrency m_mapConcurrency = MapConcurrency::None;
+    SeqLock m_mapLock;
+    RegisterStorage m_registerStorage = RegisterStorage::HostOrder;
+
+    std::shared_ptr<ChangeTracker> m_changeTracker; // swapped by API thread while shards reply, access by atomic load/store
+    std::shared_ptr<ResponseCache> m_responseCache;
+
+    QScopedPointer<MapFile> m_mapFile; // owns m_map if set
+#ifndef _WIN32
+    QScopedPointer<SharedMap> m_sharedMap; // owns m_map if set
+#endif
+
+    QScopedPointer<HookPool> m_hookPool; // runs AsyncPostprocessing hooks
+
+    /// request of pre-processing hooks being called in this thread while it is in scope, see deferReply()
+    struct CurrentRequest {
+        AbstractSlaveBackend *backend;
+        modbus_t *ctx;
+        const RequestView *req;
+        DeferredReplyPtr deferred;
+        CurrentRequest *outer;
+
+        CurrentRequest(AbstractSlaveBackend *backend, modbus_t *ctx, const RequestView *req)
+            : backend(backend), ctx(ctx), req(req), outer(m_currentRequest) {
+            m_currentRequest = this;
+        }
+
+        ~CurrentRequest() {
+            m_currentRequest = outer;
+        }
+    };
+    static thread_local CurrentRequest *m_currentRequest;
+
+    QMutex m_deferredLock;
+    QSet<DeferredReply*> m_deferred; // not sent yet, requests of shard threads too
+
+
+    void freeMap() {
+        if (m_mapFile) {
+            m_mapFile.reset();
+#ifndef _WIN32
+        } else if (m_sharedMap) {
+            m_mapLock.attach(Q_NULLPTR);
+            m_sharedMap.reset();
+#endif
+        } else {
+            modbus_mapping_free(m_map);
+        }
+        m_map = Q_NULLPTR;
+    }
+
+    void setMap(modbus_mapping_t *map) {
+        m_map = map;
+        if (const std::shared_ptr<ChangeTracker> tracker = changeTracker()) {
+            setChangeTracker(m_map ? std::make_shared<ChangeTracker>(m_map, tracker->isOnlyValueChanges()) : std::shared_ptr<ChangeTracker>());
+        }
+        if (const std::shared_ptr<ResponseCache> cache = responseCache()) {
+#ifndef _WIN32
+            if (m_sharedMap) {
+                // other processes write shared map without invalidating cached replies
+                LMB_WGLOG(LDOM_BK, "response cache is disabled by shared map");
+                setResponseCache(std::shared_ptr<ResponseCache>());
+                return;
+            }
+#endif
+            setResponseCache(m_map ? std::make_shared<ResponseCache>(m_map, cache->maxEntries()) : std::shared_ptr<ResponseCache>());
+        }
+    }
+
+
+    std::shared_ptr<ChangeTracker> changeTracker() const {
+        return std::atomic_load(&m_changeTracker);
+    }
+
+    void setChangeTracker(const std::shared_ptr<ChangeTracker> &tracker) {
+        std::atomic_store(&m_changeTracker, tracker);
+    }
+
+    std::shared_ptr<ResponseCache> responseCache() const {
+        return std::atomic_load(&m_responseCache);
+    }
+
+    void setResponseCache(const std::shared_ptr<ResponseCache> &cache) {
+        std::atomic_store(&m_responseCache, cache);
+    }
 
 
     AbstractSlaveBackendPrivate(AbstractSlaveBackend* q) : q(q) {
-        //stub
+        m_clock.start();
     }
 
 
@@ -158,58 +287,93 @@ public:
 
         const UniHookKey key = uniHookKey(info.type, info.accessMode, info.hookTime);
 
-        if (!m_uniHook.contains(key)) {
+        // const lookup, hooks are called from listener shard threads concurrently
+        const auto it = m_uniHook.constFind(key);
+        if (it == m_uniHook.constEnd()) {
             return;
         }
 
         LMB_DGLOG(LDOM_HOOK, "call hook");
-        m_uniHook[key].process(info);
-
-
+        it.value().process(info, m_clock);
     }
 
-    void checkHookMap(const uint8_t *req, int req_length, const HooksByFunctionCode &oldHooks, HookTime hookTime) {
-
-        Q_UNUSED(req_length);
+    void tryPostUniHook(const UniHookInfo& info) {
 
-#define GET_HDR_U16(ID)  ((req[offset + 1 + ((ID) << 1)] << 8) + req[offset + 2 + ((ID) << 1)])
-
-        UniHookInfo info;
+        const UniHookKey key = uniHookKey(info.type, info.accessMode, HookTime::AsyncPostprocessing);
 
-        const int offset = modbus_get_header_length(q->getCtx());
+        const auto it = m_uniHook.constFind(key);
+        if (it == m_uniHook.constEnd()) {
+            return;
+        }
 
-        info.function = req[offset];
-        info.rangeBaseAddress = GET_HDR_U16(0);
+        UniHookInfo asyncInfo = info;
+        asyncInfo.hookTime = HookTime::AsyncPostprocessing;
+        it.value().post(asyncInfo, key, m_hookPool.data(), [this](const UniHookInfo &i) { return snapshot(i); });
+    }
 
-        // check old style hooks
-        {
-            const auto &addrHooks = oldHooks[info.function];
-            if (addrHooks.contains(info.rangeBaseAddress)) {
-                addrHooks[info.rangeBaseAddress]();
-            }
+    /// items of info range, registers in host order
+    QByteArray snapshot(const UniHookInfo &info) {
+        if (!m_map) {
+            return QByteArray();
         }
 
-        info.hookTime = hookTime;
+        const bool bits = (info.type == DataType::Coil) || (info.type == DataType::DiscreteInput);
+        const void *table = Q_NULLPTR;
+        int nb = 0;
+        int offset = 0;
+        switch (info.type) {
+            case DataType::Coil:
+                table = m_map->tab_bits;
+                nb = m_map->nb_bits;
+                offset = m_map->offset_bits;
+                break;
+            case DataType::DiscreteInput:
+                table = m_map->tab_input_bits;
+                nb = m_map->nb_input_bits;
+                offset = m_map->offset_input_bits;
+                break;
+            case DataType::HoldingRegister:
+                table = m_map->tab_registers;
+                nb = m_map->nb_registers;
+                offset = m_map->offset_registers;
+                break;
+            case DataType::InputRegister:
+                table = m_map->tab_input_registers;
+                nb = m_map->nb_input_registers;
+                offset = m_map->offset_input_registers;
+                break;
+        }
 
-        // special case
-        if (info.function == MODBUS_FC_WRITE_AND_READ_REGISTERS) {
-            LMB_DGLOG(LDOM_HOOK, "R/W func");
+        const int first = info.rangeBaseAddress - offset;
+        if ((first < 0) || (first + info.rangeSize > nb)) {
+            return QByteArray();
+        }
 
-            info.type = DataType::HoldingRegister;
+        const int itemSize = bits ? 1 : 2;
+        const char *data = static_cast<const char *>(table) + first * itemSize;
+        QByteArray res;
+        seqLockRead(isSeqLocked() ? &m_mapLock : Q_NULLPTR, [&res, data, &info, itemSize]() {
+            res = QByteArray(data, info.rangeSize * itemSize);
+        });
 
-            info.rangeBaseAddress = GET_HDR_U16(2);
-            info.rangeSize = GET_HDR_U16(3);
-            info.accessMode = AccessMode::Write;
+        if (!bits && (m_registerStorage == RegisterStorage::WireOrder) &&
+                (AbstractBackend::getSystemNativeByteOrder() == ByteOrder::LittleEndian)) {
+            swapRegisters(reinterpret_cast<uint16_t *>(res.data()), info.rangeSize);
+        }
+        return res;
+    }
 
-            tryProcessUniHook(info);
+    /// fills function, type, access mode and range of request. FC23 is not described here
+    static bool describeRequest(const RequestView &req, UniHookInfo &info) {
 
-            info.rangeBaseAddress = GET_HDR_U16(0);
-            info.rangeSize = GET_HDR_U16(1);
-            info.accessMode = AccessMode::Read;
-            tryProcessUniHook(info);
-            return;
+        if (!req.supported) {
+            return false;
         }
 
+        info.function = req.function;
+        info.rangeBaseAddress = req.address;
+        info.rangeSize = req.count;
+
         switch(info.function) {
             case MODBUS_FC_READ_COILS              :
             case MODBUS_FC_READ_DISCRETE_INPUTS    :
@@ -225,8 +389,7 @@ public:
                 info.accessMode = AccessMode::Write;
                 break;
             default:
-                LMB_WGLOG(LDOM_HOOK, "unhookable function: " << info.function);
-                return;
+                return false;
         }
 
         switch(info.function) {
@@ -248,35 +411,268 @@ public:
                 info.type = DataType::InputRegister;
                 break;
             default:
-                LMB_WGLOG(LDOM_HOOK, "unhookable function: " << info.function);
-                return;
+                return false;
         }
-        switch(info.function) {
-            case MODBUS_FC_READ_COILS              :
-            case MODBUS_FC_READ_DISCRETE_INPUTS    :
-            case MODBUS_FC_READ_HOLDING_REGISTERS  :
-            case MODBUS_FC_READ_INPUT_REGISTERS    :
-            case MODBUS_FC_WRITE_MULTIPLE_COILS    :
-            case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
-                info.rangeSize = GET_HDR_U16(1);
-                break;
-            case MODBUS_FC_WRITE_SINGLE_COIL       :
-            case MODBUS_FC_WRITE_SINGLE_REGISTER   :
-            case MODBUS_FC_MASK_WRITE_REGISTER     :
-            default:
-                info.rangeSize = 1;
-                break;
+
+        return true;
+    }
+
+    /// write part of request, FC23 included
+    static bool describeWrite(const RequestView &req, UniHookInfo &info) {
+        if (req.supported && (req.function == MODBUS_FC_WRITE_AND_READ_REGISTERS)) {
+            info.function = req.function;
+            info.type = DataType::HoldingRegister;
+            info.accessMode = AccessMode::Write;
+            info.rangeBaseAddress = req.writeAddress;
+            info.rangeSize = req.writeCount;
+            return true;
+        }
+        return describeRequest(req, info) && (info.accessMode == AccessMode::Write);
+    }
+
+    void checkHookMap(const RequestView &req, const HooksByFunctionCode &oldHooks, HookTime hookTime) {
+
+        // FC23 writes one range and reads other one
+        UniHookInfo infos[2];
+        int count = 0;
+        if (req.supported && (req.function == MODBUS_FC_WRITE_AND_READ_REGISTERS)) {
+            LMB_DGLOG(LDOM_HOOK, "R/W func");
+
+            for (UniHookInfo &info : infos) {
+                info.function = req.function;
+                info.type = DataType::HoldingRegister;
+            }
+            infos[0].rangeBaseAddress = req.writeAddress;
+            infos[0].rangeSize = req.writeCount;
+            infos[0].accessMode = AccessMode::Write;
+            infos[1].rangeBaseAddress = req.address;
+            infos[1].rangeSize = req.count;
+            infos[1].accessMode = AccessMode::Read;
+            count = 2;
+        } else if (describeRequest(req, infos[0])) {
+            count = 1;
+        }
+        for (int i = 0; i < count; ++i) {
+            infos[i].hookTime = hookTime;
+        }
+
+        // snapshot of async hooks is map as request left it, post-processing hooks below may change it
+        if ((hookTime == HookTime::Postprocessing) && m_hookPool) {
+            for (int i = 0; i < count; ++i) {
+                tryPostUniHook(infos[i]);
+            }
+        }
+
+        // check old style hooks
+        {
+            const auto &addrHooks = oldHooks[req.function];
+            if (addrHooks.contains(req.address)) {
+                addrHooks[req.address]();
+            }
+        }
+
+        if (count == 0) {
+            LMB_WGLOG(LDOM_HOOK, "unhookable function: " << req.function);
+            return;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            LMB_DGLOG(LDOM_HOOK, "try process hook on A = " << infos[i].rangeBaseAddress
+                      << "-" << infos[i].rangeSize
+                      << "  T = " << (int)infos[i].type
+                      << "  F = " << infos[i].function);
+
+            tryProcessUniHook(infos[i]);
+        }
+    }
+
+    // map concurrency =====================================================
+
+    bool isSeqLocked() const {
+        return m_map && (m_mapConcurrency == MapConcurrency::SeqLock);
+    }
+
+    void transmit(modbus_t *ctx, const RequestView &req, uint8_t *rsp, int rspLength, const DeferredReply::Route *route) {
+        if (route) {
+            (*route)(rsp, rspLength);
+            return;
+        }
+
+        // no reply on RTU broadcast, as in modbus_reply
+        if ((ctx->backend->backend_type == _MODBUS_BACKEND_TYPE_RTU) && (req.unit == MODBUS_BROADCAST_ADDRESS)) {
+            return;
+        }
+
+        rspLength = ctx->backend->send_msg_pre(rsp, rspLength);
+        if (ctx->backend->send(ctx, rsp, rspLength) == -1) {
+            LMB_WGLOG(LDOM_HOOK, "send failed: " << modbus_strerror(errno));
+        }
+    }
+
+    ResponseBuilder builder(uint8_t *rsp) const {
+        return ResponseBuilder(rsp, m_registerStorage == RegisterStorage::WireOrder);
+    }
+
+    static void swapRegisters(uint16_t *table, int count) {
+        for (int i = 0; i < count; ++i) {
+            table[i] = static_cast<uint16_t>((table[i] >> 8) | (table[i] << 8));
+        }
+    }
+
+    /// register values are kept, on big endian host both storages are the same
+    void convertRegisters(RegisterStorage storage) {
+        if (!m_map || (storage == m_registerStorage) ||
+                (AbstractBackend::getSystemNativeByteOrder() == ByteOrder::BigEndian)) {
+            return;
+        }
+        SeqLockWriteGuard guard(q->getMapLock());
+        swapRegisters(m_map->tab_registers, m_map->nb_registers);
+        swapRegisters(m_map->tab_input_registers, m_map->nb_input_registers);
+    }
+
+    /// map formats of other processes and restarts keep host order
+    void resetRegisterStorage() {
+        if (m_registerStorage != RegisterStorage::HostOrder) {
+            LMB_WGLOG(LDOM_BK, "register storage is reset to host order");
+            m_registerStorage = RegisterStorage::HostOrder;
+        }
+    }
+
+    /// native reply for standard functions, libmodbus one for others
+    void send(modbus_t *ctx, const RequestView &req, modbus_mapping_t *map, const DeferredReply::Route *route) {
+        if (!req.supported) {
+            // frame without function is dropped, modbus_reply() would read past it
+            if (req.length > req.headerLength) {
+                SeqLockWriteGuard guard(isSeqLocked() ? &m_mapLock : Q_NULLPTR);
+                modbus_reply(ctx, req.adu, req.length, map);
+            }
+            return;
+        }
+
+        std::array<uint8_t, MODBUS_MAX_ADU_LENGTH> rsp;
+        transmit(ctx, req, rsp.data(), builder(rsp.data()).build(req, map), route);
+    }
+
+    /// route of deferred reply replaces context
+    void reply(modbus_t *ctx, const RequestView &req, const DeferredReply::Route *route = Q_NULLPTR) {
+        const bool seqLocked = isSeqLocked();
+        const std::shared_ptr<ChangeTracker> tracker = changeTracker();
+        const std::shared_ptr<ResponseCache> cache = responseCache();
+        if (!seqLocked && !tracker && !cache) {
+            send(ctx, req, m_map, route);
+            return;
+        }
+
+        UniHookInfo info;
+
+        if ((seqLocked || cache) && describeRequest(req, info) && (info.accessMode == AccessMode::Read)) {
+            std::array<uint8_t, MODBUS_MAX_ADU_LENGTH> rsp;
+            int rspLength = cache ? cache->lookup(req, rsp.data()) : 0;
+            if (rspLength == 0) {
+                // reply is built from live map and rebuilt if writer interfered, app writers are never blocked.
+                // Only local buffer is written, so concurrent readers of listener shards don't share anything
+                quint64 stamp = 0;
+                seqLockRead(seqLocked ? &m_mapLock : Q_NULLPTR, [this, &cache, &req, &info, &rsp, &rspLength, &stamp]() {
+                    if (cache) {
+                        stamp = cache->stamp(info.type, info.rangeBaseAddress, info.rangeSize);
+                    }
+                    rspLength = builder(rsp.data()).build(req, m_map);
+                });
+                if (cache) {
+                    cache->store(req, stamp, rsp.data(), rspLength);
+                }
+            }
+            transmit(ctx, req, rsp.data(), rspLength, route);
+            return;
+        }
+
+        if (!req.supported) {
+            // function is not standard one (truncated standard frame gets exception reply from parse),
+            // libmodbus answers it without writing items of map
+            send(ctx, req, m_map, route);
+            return;
         }
 
-        LMB_DGLOG(LDOM_HOOK, "try process hook on A = " << info.rangeBaseAddress
-                  << "-" << info.rangeSize
-                  << "  T = " << (int)info.type
-                  << "  F = " << info.function);
+        const bool written = (tracker || cache) && describeWrite(req, info);
 
-        tryProcessUniHook(info);
+        std::array<uint8_t, ChangeTracker::MaxWriteBytes> before;
+        bool hasBefore = false;
+        std::array<uint8_t, MODBUS_MAX_ADU_LENGTH> rsp;
+        int rspLength = 0;
+        {
+            // master write is one more map writer, reply is sent after release so readers don't wait for socket
+            SeqLockWriteGuard guard(seqLocked ? &m_mapLock : Q_NULLPTR);
+
+            hasBefore =
+                    written &&
+                    tracker &&
+                    tracker->isOnlyValueChanges() &&
+                    tracker->snapshot(info.type, info.rangeBaseAddress, info.rangeSize, before.data());
 
-#undef GET_HDR_U16
+            rspLength = builder(rsp.data()).build(req, m_map);
 
+            // exception reply (e.g. illegal address or value) has not written map
+            const bool applied = written && (rspLength > req.headerLength) && !(rsp[req.headerLength] & 0x80);
+            if (applied && tracker) {
+                tracker->markWritten(info.type, info.rangeBaseAddress, info.rangeSize, hasBefore ? before.data() : Q_NULLPTR);
+            }
+            // before master sees reply of write, so its next read can't get stale cached reply
+            if (written && cache) {
+                cache->markWritten(info.type, info.rangeBaseAddress, info.rangeSize);
+            }
+        }
+        transmit(ctx, req, rsp.data(), rspLength, route);
+    }
+
+    // deferred replies ======================================================
+
+    DeferredReplyPtr defer(CurrentRequest &current, int timeout_ms, uint8_t timeoutException) {
+        const RequestView &req = *current.req;
+        // no reply to RTU broadcast at all
+        if (!req.supported || req.exception || !m_map || ((req.headerLength == 1) && (req.unit == MODBUS_BROADCAST_ADDRESS))) {
+            return DeferredReplyPtr();
+        }
+
+        const DeferredReply::Route route = q->replyRoute(current.ctx);
+        if (!route) {
+            LMB_WGLOG(LDOM_BK, "transport of request can't defer reply");
+            return DeferredReplyPtr();
+        }
+
+        current.deferred = DeferredReply::create(req, route,
+            [this](DeferredReply *r, RequestView &req, const DeferredReply::Route &route) { finishDeferred(r, req, route); },
+            timeout_ms, timeoutException);
+
+        QMutexLocker lock(&m_deferredLock);
+        m_deferred.insert(current.deferred.get());
+        return current.deferred;
+    }
+
+    void finishDeferred(DeferredReply *r, RequestView &req, const DeferredReply::Route &route) {
+        {
+            QMutexLocker lock(&m_deferredLock);
+            m_deferred.remove(r);
+        }
+
+        if (!m_map) {
+            req.exception = MODBUS_EXCEPTION_SLAVE_OR_SERVER_FAILURE; // map is freed meanwhile
+        }
+        if (req.exception) {
+            std::array<uint8_t, MODBUS_MAX_ADU_LENGTH> rsp;
+            transmit(Q_NULLPTR, req, rsp.data(), builder(rsp.data()).build(req, m_map), &route);
+        } else {
+            reply(Q_NULLPTR, req, &route);
+        }
+        q->processHooks(req, HookTime::Postprocessing);
+    }
+
+    /// pending replies are never sent, listener threads are stopped already
+    void detachDeferred() {
+        QMutexLocker lock(&m_deferredLock);
+        for (DeferredReply *r : m_deferred) {
+            r->detach();
+        }
+        m_deferred.clear();
     }
 
     void beforeStartListen() {
@@ -292,6 +688,9 @@ public:
 
 
 
+thread_local AbstractSlaveBackendPrivate::CurrentRequest *AbstractSlaveBackendPrivate::m_currentRequest = Q_NULLPTR;
+
+
 AbstractSlaveBackend::AbstractSlaveBackend()
     : ad_ptr(new AbstractSlaveBackendPrivate(this))
 {
@@ -299,18 +698,70 @@ AbstractSlaveBackend::AbstractSlaveBackend()
 }
 
 void AbstractSlaveBackend::processHooks(const uint8_t *req, int req_length, HookTime hookTime)
+{
+    RequestView view;
+    view.parse(req, req_length, modbus_get_header_length(getCtx()));
+    processHooks(view, hookTime);
+}
+
+void AbstractSlaveBackend::processHooks(const RequestView &req, HookTime hookTime)
 {
     LMB_DGLOG(LDOM_HOOK, "process event " << (hookTime == HookTime::Preprocessing ? "pre" : "post"));
     if (hookTime == HookTime::Preprocessing) {
-        d_ptr->checkHookMap(req, req_length, d_ptr->m_hooks, hookTime);
+        d_ptr->checkHookMap(req, d_ptr->m_hooks, hookTime);
     } else {
-        d_ptr->checkHookMap(req, req_length, d_ptr->m_postMessageHooks, hookTime);
+        d_ptr->checkHookMap(req, d_ptr->m_postMessageHooks, hookTime);
     }
 }
 
+void AbstractSlaveBackend::processRequest(const uint8_t *req, int req_length)
+{
+    processRequest(getCtx(), req, req_length);
+}
+
+void AbstractSlaveBackend::processRequest(modbus_t *ctx, const uint8_t *req, int req_length)
+{
+    // frame is parsed once for hooks, tracking and reply
+    RequestView view;
+    view.parse(req, req_length, modbus_get_header_length(ctx));
+
+    {
+        AbstractSlaveBackendPrivate::CurrentRequest current(this, ctx, &view);
+        processHooks(view, HookTime::Preprocessing);
+        if (current.deferred) {
+            return; // reply and post-processing hooks follow its completion
+        }
+    }
+
+    d_ptr->reply(ctx, view);
+    processHooks(view, HookTime::Postprocessing);
+}
+
+DeferredReplyPtr AbstractSlaveBackend::deferReply(int timeout_ms, uint8_t timeoutException)
+{
+    AbstractSlaveBackendPrivate::CurrentRequest *current = AbstractSlaveBackendPrivate::m_currentRequest;
+    if (!current || (current->backend != this)) {
+        LMB_WGLOG(LDOM_BK, "reply may be deferred by pre-processing hook only");
+        return DeferredReplyPtr();
+    }
+    if (current->deferred) {
+        return current->deferred; // by other hook of the same request
+    }
+    return d_ptr->defer(*current, timeout_ms, timeoutException);
+}
+
+DeferredReply::Route AbstractSlaveBackend::replyRoute(modbus_t *ctx)
+{
+    Q_UNUSED(ctx);
+    return DeferredReply::Route();
+}
+
 AbstractSlaveBackend::~AbstractSlaveBackend()
 {
-    modbus_mapping_free(d_ptr->m_map);
+    // queued async hooks are run while slave is alive
+    d_ptr->m_hookPool.reset();
+    d_ptr->detachDeferred();
+    d_ptr->freeMap();
 }
 
 modbus_mapping_t *AbstractSlaveBackend::getMap() const {
@@ -319,15 +770,152 @@ modbus_mapping_t *AbstractSlaveBackend::getMap() const {
 
 bool AbstractSlaveBackend::initMap(int holdingBitsCount, int inputBitsCount, int holdingRegistersCount, int inputRegistersCount)
 {
-    d_ptr->m_map = modbus_mapping_new(holdingBitsCount, inputBitsCount, holdingRegistersCount, inputRegistersCount);
+    d_ptr->freeMap();
+    d_ptr->setMap(modbus_mapping_new(holdingBitsCount, inputBitsCount, holdingRegistersCount, inputRegistersCount));
     return (d_ptr->m_map != Q_NULLPTR);
 }
 
+bool AbstractSlaveBackend::initPersistentMap(const char *path, int holdingBitsCount, int inputBitsCount, int holdingRegistersCount, int inputRegistersCount)
+{
+    d_ptr->freeMap();
+    d_ptr->resetRegisterStorage();
+    d_ptr->m_mapFile.reset(new MapFile(QString::fromLocal8Bit(path)));
+    if (!d_ptr->m_mapFile->open(holdingBitsCount, inputBitsCount, holdingRegistersCount, inputRegistersCount)) {
+        d_ptr->m_mapFile.reset();
+        d_ptr->setMap(Q_NULLPTR);
+        return false;
+    }
+    d_ptr->setMap(d_ptr->m_mapFile->map());
+    return true;
+}
+
+#ifndef _WIN32
+bool AbstractSlaveBackend::initSharedMap(const char *name, int holdingBitsCount, int inputBitsCount, int holdingRegistersCount, int inputRegistersCount)
+{
+    d_ptr->freeMap();
+    d_ptr->resetRegisterStorage();
+    d_ptr->m_sharedMap.reset(new SharedMap(name));
+    if (!d_ptr->m_sharedMap->open(holdingBitsCount, inputBitsCount, holdingRegistersCount, inputRegistersCount)) {
+        d_ptr->m_sharedMap.reset();
+        d_ptr->setMap(Q_NULLPTR);
+        return false;
+    }
+    // other processes take part in map access only by sequence protocol
+    d_ptr->m_mapConcurrency = MapConcurrency::SeqLock;
+    d_ptr->m_mapLock.attach(&d_ptr->m_sharedMap->header()->seq);
+    d_ptr->setMap(d_ptr->m_sharedMap->map());
+    return true;
+}
+#endif
+
 bool AbstractSlaveBackend::initRegisterMap(int holdingRegistersCount, int inputRegistersCount)
 {
     return initMap(0, 0, holdingRegistersCount, inputRegistersCount);
 }
 
+void AbstractSlaveBackend::setMapConcurrency(MapConcurrency mode)
+{
+#ifndef _WIN32
+    if (d_ptr->m_sharedMap && (mode != MapConcurrency::SeqLock)) {
+        LMB_WGLOG(LDOM_BK, "shared map requires SeqLock concurrency");
+        return;
+    }
+#endif
+    d_ptr->m_mapConcurrency = mode;
+}
+
+MapConcurrency AbstractSlaveBackend::getMapConcurrency() const
+{
+    return d_ptr->m_mapConcurrency;
+}
+
+SeqLock *AbstractSlaveBackend::getMapLock() const
+{
+    return (d_ptr->m_mapConcurrency == MapConcurrency::SeqLock) ? &d_ptr->m_mapLock : Q_NULLPTR;
+}
+
+void AbstractSlaveBackend::setRegisterStorage(RegisterStorage storage)
+{
+#ifndef _WIN32
+    const bool hostOrderOnly = d_ptr->m_mapFile || d_ptr->m_sharedMap;
+#else
+    const bool hostOrderOnly = d_ptr->m_mapFile;
+#endif
+    if (hostOrderOnly && (storage != RegisterStorage::HostOrder)) {
+        LMB_WGLOG(LDOM_BK, "persistent and shared maps keep registers in host order");
+        return;
+    }
+    d_ptr->convertRegisters(storage);
+    d_ptr->m_registerStorage = storage;
+}
+
+RegisterStorage AbstractSlaveBackend::getRegisterStorage() const
+{
+    return d_ptr->m_registerStorage;
+}
+
+void AbstractSlaveBackend::enableChangeTracking(bool onlyValueChanges)
+{
+    if (!d_ptr->m_map) {
+        throw LocalWriteError("map was not inited");
+    }
+    d_ptr->setChangeTracker(std::make_shared<ChangeTracker>(d_ptr->m_map, onlyValueChanges));
+}
+
+void AbstractSlaveBackend::disableChangeTracking()
+{
+    d_ptr->setChangeTracker(std::shared_ptr<ChangeTracker>());
+}
+
+void AbstractSlaveBackend::setChangeDebounce(DataType type, Address rangeBaseAddress, Address rangeSize, int debounce_ms)
+{
+    const std::shared_ptr<ChangeTracker> tracker = d_ptr->changeTracker();
+    if (!tracker) {
+        throw LocalWriteError("change tracking is disabled");
+    }
+    tracker->setDebounce(type, rangeBaseAddress, rangeSize, debounce_ms);
+}
+
+QVector<MapChange> AbstractSlaveBackend::takeMapChanges()
+{
+    const std::shared_ptr<ChangeTracker> tracker = d_ptr->changeTracker();
+    if (!tracker) {
+        return QVector<MapChange>();
+    }
+    return tracker->takeChanges();
+}
+
+void AbstractSlaveBackend::enableResponseCache(int maxEntries)
+{
+    if (!d_ptr->m_map) {
+        throw LocalWriteError("map was not inited");
+    }
+#ifndef _WIN32
+    if (d_ptr->m_sharedMap) {
+        throw LocalWriteError("writes of shared map clients can't be tracked by response cache");
+    }
+#endif
+    d_ptr->setResponseCache(std::make_shared<ResponseCache>(d_ptr->m_map, maxEntries));
+}
+
+void AbstractSlaveBackend::disableResponseCache()
+{
+    d_ptr->setResponseCache(std::shared_ptr<ResponseCache>());
+}
+
+ResponseCache::Stats AbstractSlaveBackend::getResponseCacheStats() const
+{
+    const std::shared_ptr<ResponseCache> cache = d_ptr->responseCache();
+    return cache ? cache->stats() : ResponseCache::Stats();
+}
+
+void AbstractSlaveBackend::markMapWritten(DataType type, Address from, int count)
+{
+    if (const std::shared_ptr<ResponseCache> cache = d_ptr->responseCache()) {
+        cache->markWritten(type, from, count);
+    }
+}
+
 bool AbstractSlaveBackend::startListen()
 {
     d_ptr->beforeStartListen();
@@ -439,9 +1027,37 @@ ssize_t AbstractSlaveBackend::customSend(modbus_t *ctx, const uint8_t *rsp, int
 
 
 void AbstractSlaveBackend::addUniHook(DataType type, AccessMode accessMode, Address rangeBaseAddress, Address rangeSize, HookTime hookTime, UniHookFunction func)
+{
+    addUniHook(type, accessMode, rangeBaseAddress, rangeSize, hookTime, HookLimits(), func);
+}
+
+void AbstractSlaveBackend::addUniHook(DataType type, AccessMode accessMode, Address rangeBaseAddress, Address rangeSize, HookTime hookTime, const HookLimits &limits, UniHookFunction func)
 {
     const UniHookKey key = uniHookKey(type, accessMode, hookTime);
-    d_ptr->m_uniHook[key].add(rangeBaseAddress, rangeSize, func);
+    if (limits.isSet() && (hookTime == HookTime::AsyncPostprocessing)) {
+        LMB_WGLOG(LDOM_HOOK, "limits of async hook are ignored");
+        d_ptr->m_uniHook[key].add(rangeBaseAddress, rangeSize, func, HookLimits());
+    } else {
+        d_ptr->m_uniHook[key].add(rangeBaseAddress, rangeSize, func, limits);
+    }
+    if ((hookTime == HookTime::AsyncPostprocessing) && !d_ptr->m_hookPool) {
+        d_ptr->m_hookPool.reset(new HookPool(0, HookPool::DefaultQueueCapacity));
+    }
 
     LMB_DGLOG(LDOM_HOOK, "add hook for " << key << ". Count = " << d_ptr->m_uniHook[key].count());
 }
+
+void AbstractSlaveBackend::setAsyncHookWorkers(int workerCount, int queueCapacity)
+{
+    d_ptr->m_hookPool.reset(new HookPool(workerCount, queueCapacity));
+}
+
+HookPool::Stats AbstractSlaveBackend::getAsyncHookStats() const
+{
+    return d_ptr->m_hookPool ? d_ptr->m_hookPool->stats() : HookPool::Stats();
+}
+
+bool AbstractSlaveBackend::waitForAsyncHooks(int timeout_ms)
+{
+    return d_ptr->m_hookPool ? d_ptr->m_hookPool->waitForDone(timeout_ms) : true;
+}
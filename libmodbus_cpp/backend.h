@@ -5,6 +5,7 @@
 #include <QString>
 #include <QMap>
 #include <QMap>
+#include <QVector>
 #include <QIODevice>
 #include <functional>
 #include <cstring>
@@ -13,6 +14,12 @@
 #include <modbus/modbus-tcp.h>
 #include "defs.h"
 #include "mapping_wrapper.h"
+#include "seq_lock.h"
+#include "pdu.h"
+#include "response_cache.h"
+#include "hook_pool.h"
+#include "hook_gate.h"
+#include "deferred_reply.h"
 
 namespace libmodbus_cpp {
 
@@ -56,8 +63,22 @@ public:
         return m_ctx;
     }
 
-    bool openConnection();
-    void closeConnection();
+    virtual bool openConnection();
+    virtual void closeConnection();
+
+    /// request of master is sent, throws ConnectionError if it can't be
+    virtual void beforeTransaction() {}
+    /// request of master failed with error, true if connection is lost
+    virtual bool transactionFailed(int error) {
+        Q_UNUSED(error);
+        return false;
+    }
+    /// request of master was answered by device, by exception reply too
+    virtual void transactionSucceeded() {}
+    /// replies are matched to requests (MBAP transaction id), so late reply can't be taken as reply of retry
+    virtual bool hasTransactionIds() const {
+        return false;
+    }
 
     bool doesSystemNativeByteOrderMatchTarget() const;
 
@@ -79,9 +100,16 @@ protected:
     AbstractSlaveBackend();
 
     void processHooks(const uint8_t *req, int req_length, HookTime hookTime);
+    void processHooks(const RequestView &req, HookTime hookTime);
+    /// hooks + reply + hooks, respects map concurrency mode
+    void processRequest(const uint8_t *req, int req_length);
+    /// same with other context of this slave, e.g. of listener shard thread
+    void processRequest(modbus_t *ctx, const uint8_t *req, int req_length);
 
     virtual bool doStartListen() = 0;
     virtual void doStopListen() = 0;
+    /// sends reply of request being served by ctx later from this thread, empty if transport can't do it
+    virtual DeferredReply::Route replyRoute(modbus_t *ctx);
 
 public:
     ~AbstractSlaveBackend() override;
@@ -92,11 +120,54 @@ public:
 
     bool initMap(int holdingBitsCount, int inputBitsCount, int holdingRegistersCount, int inputRegistersCount);
     bool initRegisterMap(int holdingRegistersCount, int inputRegistersCount);
+    /// map tables in memory mapped file, state survives restarts
+    bool initPersistentMap(const char *path, int holdingBitsCount, int inputBitsCount, int holdingRegistersCount, int inputRegistersCount);
+#ifndef _WIN32
+    /// map tables in POSIX shared memory segment, see shared_map_client.h. Turns on SeqLock concurrency
+    bool initSharedMap(const char *name, int holdingBitsCount, int inputBitsCount, int holdingRegistersCount, int inputRegistersCount);
+#endif
+
+    void setMapConcurrency(MapConcurrency mode);
+    MapConcurrency getMapConcurrency() const;
+    /// nil if map is not shared between threads
+    SeqLock *getMapLock() const;
+    /// registers of current map are converted. Persistent and shared maps support HostOrder only
+    void setRegisterStorage(RegisterStorage storage);
+    RegisterStorage getRegisterStorage() const;
+
+    /// tracking of map items written by master. Must be (re)enabled after initMap, debounces are reset by initMap
+    void enableChangeTracking(bool onlyValueChanges);
+    void disableChangeTracking();
+    void setChangeDebounce(DataType type, Address rangeBaseAddress, Address rangeSize, int debounce_ms);
+    QVector<MapChange> takeMapChanges();
+
+    /// read replies kept until covered items are written, see ResponseCache
+    void enableResponseCache(int maxEntries);
+    void disableResponseCache();
+    ResponseCache::Stats getResponseCacheStats() const;
+    /// application write of map items, done by slave setters; writes through raw map pointer must be reported too
+    void markMapWritten(DataType type, Address from, int count);
 
     bool startListen();
     void stopListen();
 
     void addUniHook(DataType type, AccessMode accessMode, Address rangeBaseAddress, Address rangeSize, HookTime hookTime, UniHookFunction func);
+    /// calls of Preprocessing and Postprocessing hook are skipped by limits, e.g. refresh of polled range
+    void addUniHook(DataType type, AccessMode accessMode, Address rangeBaseAddress, Address rangeSize, HookTime hookTime, const HookLimits &limits, UniHookFunction func);
+
+    /// pool of AsyncPostprocessing hooks, first such hook creates default one. Must not be changed while listening
+    void setAsyncHookWorkers(int workerCount, int queueCapacity = HookPool::DefaultQueueCapacity);
+    HookPool::Stats getAsyncHookStats() const;
+    /// true if posted async hooks are done within timeout_ms
+    bool waitForAsyncHooks(int timeout_ms);
+    /**
+     * @brief called by pre-processing hook: reply of request is sent when returned token completes
+     * Slave serves other requests meanwhile. Without completion exception reply timeoutException
+     * is sent after timeout_ms (never if 0). Nil for unsupported function or transport without
+     * deferral, e.g. RTU: bus is not arbitrated, late reply would collide with next request.
+     * All hooks of request get the same token.
+     */
+    DeferredReplyPtr deferReply(int timeout_ms, uint8_t timeoutException = MODBUS_EXCEPTION_GATEWAY_TARGET);
     void addPreMessageHook(FunctionCode funcCode, Address address, HookFunction func);
     void addPostMessageHook(FunctionCode funcCode, Address address, HookFunction func);
 
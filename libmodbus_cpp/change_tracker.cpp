@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cstring>
+#include <libmodbus_cpp/change_tracker.h>
+#include <libmodbus_cpp/mapping_wrapper.h>
+
+
+namespace {
+
+using namespace libmodbus_cpp;
+
+template<DataType T>
+void initTable(const modbus_mapping_t *map, int itemSize, int &count, int &size, const uint8_t *&data) {
+    const MappingWrapper<T> m(const_cast<modbus_mapping_t *>(map));
+    count = m.count();
+    size = itemSize;
+    data = static_cast<const uint8_t *>(m.table());
+}
+
+inline bool testBit(const QVector<quint64> &bits, int i) {
+    return (bits.at(i >> 6) >> (i & 63)) & 1u;
+}
+
+}
+
+
+const int libmodbus_cpp::ChangeTracker::MaxWriteBytes;
+
+
+libmodbus_cpp::ChangeTracker::ChangeTracker(const modbus_mapping_t *map, bool onlyValueChanges)
+    : m_onlyValueChanges(onlyValueChanges)
+{
+    Table &c  = table(DataType::Coil);
+    Table &di = table(DataType::DiscreteInput);
+    Table &hr = table(DataType::HoldingRegister);
+    Table &ir = table(DataType::InputRegister);
+    initTable<DataType::Coil>           (map, sizeof(uint8_t),  c.count,  c.itemSize,  c.data);
+    initTable<DataType::DiscreteInput>  (map, sizeof(uint8_t),  di.count, di.itemSize, di.data);
+    initTable<DataType::HoldingRegister>(map, sizeof(uint16_t), hr.count, hr.itemSize, hr.data);
+    initTable<DataType::InputRegister>  (map, sizeof(uint16_t), ir.count, ir.itemSize, ir.data);
+
+    for (Table &t : m_tables) {
+        t.dirty.resize((t.count + 63) / 64);
+    }
+
+    m_clock.start();
+}
+
+
+void libmodbus_cpp::ChangeTracker::setDebounce(DataType type, Address rangeBaseAddress, Address rangeSize, int debounce_ms)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Table &t = table(type);
+    if (t.releaseAt.isEmpty()) {
+        t.releaseAt.resize(t.count);
+    }
+    t.debounces.append(Debounce { AddressRange::fromSizedRange(rangeBaseAddress, rangeSize), debounce_ms });
+}
+
+
+bool libmodbus_cpp::ChangeTracker::snapshot(DataType type, Address from, int count, uint8_t *buffer) const
+{
+    const Table &t = table(type);
+    if (!clampRange(t, from, count)) {
+        return false;
+    }
+    memcpy(buffer, t.data + from * t.itemSize, count * t.itemSize);
+    return true;
+}
+
+
+void libmodbus_cpp::ChangeTracker::markWritten(DataType type, Address from, int count, const uint8_t *before)
+{
+    Table &t = table(type);
+    if (!clampRange(t, from, count)) {
+        return;
+    }
+
+    const qint64 now = m_clock.elapsed();
+    const uint8_t *after = t.data + from * t.itemSize;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int i = 0; i < count; ++i) {
+        if (before && (memcmp(before + i * t.itemSize, after + i * t.itemSize, t.itemSize) == 0)) {
+            continue;
+        }
+        const int a = from + i;
+        if (testBit(t.dirty, a)) {
+            continue; // coalesced with pending change
+        }
+        t.dirty[a >> 6] |= (quint64(1) << (a & 63));
+        if (!t.releaseAt.isEmpty()) {
+            t.releaseAt[a] = now + t.debounceOf(a);
+        }
+    }
+}
+
+
+QVector<libmodbus_cpp::MapChange> libmodbus_cpp::ChangeTracker::takeChanges()
+{
+    QVector<MapChange> res;
+
+    const qint64 now = m_clock.elapsed();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int type = 0; type < 4; ++type) {
+        Table &t = m_tables[type];
+        const bool debounced = !t.releaseAt.isEmpty();
+        int rangeStart = -1;
+        for (int w = 0; w < t.dirty.size(); ++w) {
+            quint64 &word = t.dirty[w];
+            if (!word && (rangeStart < 0)) {
+                continue;
+            }
+            for (int b = 0; b < 64; ++b) {
+                const int a = (w << 6) + b;
+                const bool ready = ((word >> b) & 1u) && (!debounced || (t.releaseAt.at(a) <= now));
+                if (ready) {
+                    word &= ~(quint64(1) << b);
+                    if (rangeStart < 0) {
+                        rangeStart = a;
+                    }
+                } else if (rangeStart >= 0) {
+                    res.append(MapChange { static_cast<DataType>(type), AddressRange(rangeStart, a - 1) });
+                    rangeStart = -1;
+                }
+            }
+        }
+        if (rangeStart >= 0) {
+            res.append(MapChange { static_cast<DataType>(type), AddressRange(rangeStart, t.count - 1) });
+        }
+    }
+
+    return res;
+}
+
+
+bool libmodbus_cpp::ChangeTracker::clampRange(const Table &t, Address from, int &count) const
+{
+    if (from >= t.count) {
+        return false;
+    }
+    count = std::min(count, t.count - from);
+    return (count > 0) && (count * t.itemSize <= MaxWriteBytes);
+}
+
+
+int libmodbus_cpp::ChangeTracker::Table::debounceOf(Address address) const
+{
+    int res = 0;
+    for (const Debounce &d : debounces) {
+        if ((d.range.from <= address) && (address <= d.range.to)) {
+            res = std::max(res, d.debounce_ms);
+        }
+    }
+    return res;
+}
@@ -0,0 +1,73 @@
+#ifndef LIBMODBUS_CPP_CHANGE_TRACKER_H_GUARD
+#define LIBMODBUS_CPP_CHANGE_TRACKER_H_GUARD
+
+#include <mutex>
+#include <QVector>
+#include <QElapsedTimer>
+#include "defs.h"
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief dirty bitmap of map items written by master
+ * Slave thread marks written items, application drains coalesced ranges at its own pace.
+ * Item with debounce is drained not earlier than debounce ms after it became dirty,
+ * all writes within this window are coalesced.
+ */
+class ChangeTracker
+{
+public:
+    static const int MaxWriteBytes = MODBUS_MAX_WRITE_BITS; // more than MODBUS_MAX_WRITE_REGISTERS * 2
+
+    ChangeTracker(const modbus_mapping_t *map, bool onlyValueChanges);
+
+    bool isOnlyValueChanges() const {
+        return m_onlyValueChanges;
+    }
+
+    void setDebounce(DataType type, Address rangeBaseAddress, Address rangeSize, int debounce_ms);
+
+    /// copy items of range to buffer of MaxWriteBytes, returns false if range is not writable
+    bool snapshot(DataType type, Address from, int count, uint8_t *buffer) const;
+    /// before is nil or snapshot of range taken before write
+    void markWritten(DataType type, Address from, int count, const uint8_t *before);
+
+    QVector<MapChange> takeChanges();
+
+private:
+    struct Debounce {
+        AddressRange range;
+        int debounce_ms;
+    };
+
+    struct Table {
+        int count = 0;
+        int itemSize = 0;
+        const uint8_t *data = nullptr;
+        QVector<quint64> dirty;
+        QVector<qint64> releaseAt; // allocated with first debounce
+        QVector<Debounce> debounces;
+
+        int debounceOf(Address address) const;
+    };
+
+    Table &table(DataType type) {
+        return m_tables[static_cast<int>(type)];
+    }
+    const Table &table(DataType type) const {
+        return m_tables[static_cast<int>(type)];
+    }
+
+    bool clampRange(const Table &t, Address from, int &count) const;
+
+    const bool m_onlyValueChanges;
+    Table m_tables[4];
+    QElapsedTimer m_clock;
+    std::mutex m_mutex;
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_CHANGE_TRACKER_H_GUARD
@@ -0,0 +1,482 @@
+#include <libmodbus_cpp/compact_tcp_server.h>
+#include <libmodbus_cpp/global.h>
+#include <errno.h>
+#include <cstring>
+#include <QVector>
+#include "logger.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#endif
+
+#define LDOM_CTCP "[modbus.tcp.compact]"
+
+namespace {
+const int MbapHeaderLength = 7;
+}
+
+
+/// whole per connection state, output buffer is allocated only when socket is full
+struct libmodbus_cpp::CompactTcpServer::Connection {
+    int fd;
+    quint64 id; // serial and descriptor
+    bool closed = false;
+    bool paused = false;
+    uint16_t received = 0;
+    uint8_t buf[MODBUS_TCP_MAX_ADU_LENGTH];
+    QByteArray pending;
+    ConnectionThrottle throttle;
+};
+
+
+libmodbus_cpp::CompactTcpServer::CompactTcpServer(FrameHandler handler, QObject *parent)
+    : TcpFrameServer(handler, parent)
+{
+    m_clock.start();
+    m_resumeTimer.setSingleShot(true);
+#ifdef USE_QT5
+    connect(&m_resumeTimer, &QTimer::timeout, this, &CompactTcpServer::slot_resume);
+    connect(&m_checkTimer, &QTimer::timeout, this, &CompactTcpServer::slot_checkConnections);
+#else
+    connect(&m_resumeTimer, SIGNAL(timeout()), this, SLOT(slot_resume()));
+    connect(&m_checkTimer, SIGNAL(timeout()), this, SLOT(slot_checkConnections()));
+#endif
+}
+
+
+libmodbus_cpp::CompactTcpServer::~CompactTcpServer()
+{
+    close();
+}
+
+
+void libmodbus_cpp::CompactTcpServer::setLimits(const TcpConnectionLimits &limits)
+{
+    m_limits = limits;
+    const int interval = m_limits.checkInterval_ms();
+    if (interval > 0) {
+        m_checkTimer.start(interval);
+    } else {
+        m_checkTimer.stop();
+    }
+}
+
+
+#ifdef __linux__
+
+bool libmodbus_cpp::CompactTcpServer::listen(int serverSocket)
+{
+    close();
+
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll == -1) {
+        LMB_WGLOG(LDOM_CTCP, "epoll_create1 failed:" << strerror(errno));
+        return false;
+    }
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = serverSocket;
+    if ((fcntl(serverSocket, F_SETFL, fcntl(serverSocket, F_GETFL) | O_NONBLOCK) == -1) ||
+        (epoll_ctl(m_epoll, EPOLL_CTL_ADD, serverSocket, &ev) == -1)) {
+        LMB_WGLOG(LDOM_CTCP, "can't watch server socket:" << strerror(errno));
+        ::close(m_epoll);
+        m_epoll = -1;
+        return false;
+    }
+    m_serverSocket = serverSocket;
+
+    m_notifier = new QSocketNotifier(m_epoll, QSocketNotifier::Read, this);
+#ifdef USE_QT5
+    connect(m_notifier, &QSocketNotifier::activated, this, &CompactTcpServer::slot_activated);
+#else
+    connect(m_notifier, SIGNAL(activated(int)), this, SLOT(slot_activated()));
+#endif
+    return true;
+}
+
+
+void libmodbus_cpp::CompactTcpServer::close()
+{
+    delete m_notifier;
+    m_notifier = Q_NULLPTR;
+
+    for (Connection *c : m_connections) {
+        ::close(c->fd);
+        delete c;
+    }
+    m_connections.clear();
+    m_connectionCount.store(0, std::memory_order_relaxed);
+    m_rateLimited.clear();
+
+    if (m_epoll != -1) {
+        ::close(m_epoll);
+        m_epoll = -1;
+    }
+    if (m_serverSocket != -1) {
+        ::close(m_serverSocket);
+        m_serverSocket = -1;
+    }
+}
+
+
+ssize_t libmodbus_cpp::CompactTcpServer::send(const uint8_t *data, int length)
+{
+    Connection *c = m_current;
+    if (!c || c->closed) {
+        errno = ENOTCONN;
+        return -1;
+    }
+
+    ssize_t sent = 0;
+    if (c->pending.isEmpty()) {
+        sent = ::send(c->fd, data, length, MSG_NOSIGNAL);
+        if (sent == -1) {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                c->closed = true;
+                return -1;
+            }
+            sent = 0;
+        }
+    }
+    if (sent < length) {
+        const bool wasEmpty = c->pending.isEmpty();
+        c->pending.append(reinterpret_cast<const char*>(data) + sent, length - sent);
+        c->throttle.updateUnsent(m_clock.elapsed(), c->pending.size(), false);
+        if (wasEmpty) {
+            watch(c);
+        }
+    }
+    return length;
+}
+
+
+quint64 libmodbus_cpp::CompactTcpServer::currentConnection() const
+{
+    return m_current ? m_current->id : 0;
+}
+
+
+bool libmodbus_cpp::CompactTcpServer::sendTo(quint64 connection, const uint8_t *data, int length)
+{
+    Connection *c = m_connections.value(static_cast<int>(connection & 0xFFFFFFFF), Q_NULLPTR);
+    if (!c || (c->id != connection) || c->closed) {
+        return false;
+    }
+
+    m_current = c;
+    send(data, length);
+    m_current = Q_NULLPTR;
+    if (c->closed) {
+        remove(c);
+        return false;
+    }
+    return true;
+}
+
+
+void libmodbus_cpp::CompactTcpServer::slot_activated()
+{
+    const int MaxEvents = 64;
+    epoll_event events[MaxEvents];
+
+    int count;
+    do {
+        count = epoll_wait(m_epoll, events, MaxEvents, 0);
+        for (int i = 0; i < count; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == m_serverSocket) {
+                accept();
+                continue;
+            }
+            Connection *c = m_connections.value(fd, Q_NULLPTR);
+            if (!c) {
+                continue; // removed by earlier event of this batch
+            }
+            if (c->paused && (events[i].events & (EPOLLHUP | EPOLLERR))) {
+                c->closed = true; // not read while paused, so hang up would be reported again and again
+            }
+            if (!c->closed && (events[i].events & EPOLLOUT)) {
+                flush(c);
+            }
+            if (!c->closed && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                read(c);
+            }
+            if (c->closed) {
+                remove(c);
+            }
+        }
+    } while (count == MaxEvents);
+}
+
+
+void libmodbus_cpp::CompactTcpServer::accept()
+{
+    for (;;) {
+        const int fd = accept4(m_serverSocket, Q_NULLPTR, Q_NULLPTR, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+                LMB_WGLOG(LDOM_CTCP, "accept failed:" << strerror(errno));
+            }
+            return;
+        }
+
+        Connection *c = new Connection;
+        c->fd = fd;
+        c->id = (static_cast<quint64>(++m_serial) << 32) | static_cast<quint32>(fd);
+        c->throttle.start(m_clock.elapsed(), m_limits);
+        epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            LMB_WGLOG(LDOM_CTCP, "can't watch connection:" << strerror(errno));
+            ::close(fd);
+            delete c;
+            continue;
+        }
+        m_connections.insert(fd, c);
+        m_connectionCount.store(m_connections.size(), std::memory_order_relaxed);
+        LMB_DGLOG(LDOM_CTCP, "new connection:" << fd << "count =" << m_connections.size());
+    }
+}
+
+
+void libmodbus_cpp::CompactTcpServer::read(Connection *c)
+{
+    // paused connection is read only for hang up, buffer may be full then
+    if (c->received < sizeof(c->buf)) {
+        const ssize_t n = ::recv(c->fd, c->buf + c->received, sizeof(c->buf) - c->received, 0);
+        if (n == 0) {
+            c->closed = true;
+            return;
+        }
+        if (n == -1) {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+                c->closed = true;
+            }
+            return;
+        }
+        c->received += n;
+    }
+    serve(c);
+}
+
+
+void libmodbus_cpp::CompactTcpServer::serve(Connection *c)
+{
+    // MBAP: transaction id, protocol id, length of unit id and pdu
+    while (c->received >= MbapHeaderLength) {
+        const int length = (c->buf[4] << 8) | c->buf[5];
+        if ((length < 2) || (length > MODBUS_TCP_MAX_ADU_LENGTH - 6)) {
+            LMB_WGLOG(LDOM_CTCP, "wrong frame length" << length << ", close connection" << c->fd);
+            c->closed = true;
+            return;
+        }
+        const int frameLength = 6 + length;
+        if (c->received < frameLength) {
+            break;
+        }
+        if (c->throttle.isOverUnsent(c->pending.size(), m_limits)) {
+            pause(c); // until flush
+            return;
+        }
+        if (!c->throttle.takeRequest(m_clock.elapsed(), m_limits)) {
+            pause(c);
+            m_rateLimited.insert(c->fd);
+            scheduleResume(c->throttle.rateDelay_ms(m_limits));
+            return;
+        }
+        m_current = c;
+        m_handler(c->buf, frameLength);
+        m_current = Q_NULLPTR;
+        if (c->closed) {
+            return;
+        }
+        c->received -= frameLength;
+        memmove(c->buf, c->buf + frameLength, c->received);
+    }
+    if (c->paused) {
+        c->paused = false;
+        watch(c);
+    }
+}
+
+
+void libmodbus_cpp::CompactTcpServer::pause(Connection *c)
+{
+    if (!c->paused) {
+        c->paused = true;
+        watch(c);
+    }
+}
+
+
+void libmodbus_cpp::CompactTcpServer::flush(Connection *c)
+{
+    const ssize_t sent = ::send(c->fd, c->pending.constData(), c->pending.size(), MSG_NOSIGNAL);
+    if (sent == -1) {
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+            c->closed = true;
+        }
+        return;
+    }
+    c->pending.remove(0, sent);
+    c->throttle.updateUnsent(m_clock.elapsed(), c->pending.size(), sent > 0);
+    if (c->pending.isEmpty()) {
+        c->pending = QByteArray(); // give memory back
+        watch(c);
+    }
+    if (c->paused && !m_rateLimited.contains(c->fd) && !c->throttle.isOverUnsent(c->pending.size(), m_limits)) {
+        serve(c);
+    }
+}
+
+
+void libmodbus_cpp::CompactTcpServer::watch(Connection *c)
+{
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = (c->paused ? 0 : EPOLLIN) | (c->pending.isEmpty() ? 0 : EPOLLOUT);
+    ev.data.fd = c->fd;
+    epoll_ctl(m_epoll, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+
+void libmodbus_cpp::CompactTcpServer::remove(Connection *c)
+{
+    LMB_DGLOG(LDOM_CTCP, "remove connection:" << c->fd);
+    m_connections.remove(c->fd);
+    m_connectionCount.store(m_connections.size(), std::memory_order_relaxed);
+    m_rateLimited.remove(c->fd);
+    ::close(c->fd); // also removes it from epoll set
+    delete c;
+}
+
+
+void libmodbus_cpp::CompactTcpServer::scheduleResume(int delay_ms)
+{
+    // one timer for all limited connections: earliest of them is due first, others are limited again
+    const qint64 at = m_clock.elapsed() + delay_ms;
+    if (!m_resumeTimer.isActive() || (at < m_resumeAt_ms)) {
+        m_resumeAt_ms = at;
+        m_resumeTimer.start(delay_ms);
+    }
+}
+
+
+void libmodbus_cpp::CompactTcpServer::slot_resume()
+{
+    const QSet<int> limited = m_rateLimited;
+    m_rateLimited.clear();
+    for (int fd : limited) {
+        Connection *c = m_connections.value(fd, Q_NULLPTR);
+        if (c) {
+            serve(c); // may be limited again
+            if (c->closed) {
+                remove(c);
+            }
+        }
+    }
+}
+
+
+void libmodbus_cpp::CompactTcpServer::slot_checkConnections()
+{
+    const qint64 now = m_clock.elapsed();
+    QVector<Connection*> expired;
+    for (Connection *c : m_connections) {
+        if (c->throttle.isExpired(now, m_limits)) {
+            expired.append(c);
+        }
+    }
+    for (Connection *c : expired) {
+        LMB_DGLOG(LDOM_CTCP, "connection expired:" << c->fd);
+        remove(c);
+    }
+}
+
+#else
+
+bool libmodbus_cpp::CompactTcpServer::listen(int serverSocket)
+{
+    Q_UNUSED(serverSocket);
+    LMB_WGLOG(LDOM_CTCP, "compact connections are supported on Linux only");
+    return false;
+}
+
+void libmodbus_cpp::CompactTcpServer::close()
+{
+}
+
+ssize_t libmodbus_cpp::CompactTcpServer::send(const uint8_t *data, int length)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(length);
+    return -1;
+}
+
+quint64 libmodbus_cpp::CompactTcpServer::currentConnection() const
+{
+    return 0;
+}
+
+bool libmodbus_cpp::CompactTcpServer::sendTo(quint64 connection, const uint8_t *data, int length)
+{
+    Q_UNUSED(connection);
+    Q_UNUSED(data);
+    Q_UNUSED(length);
+    return false;
+}
+
+void libmodbus_cpp::CompactTcpServer::slot_activated()
+{
+}
+
+void libmodbus_cpp::CompactTcpServer::accept()
+{
+}
+
+void libmodbus_cpp::CompactTcpServer::read(Connection *c)
+{
+    Q_UNUSED(c);
+}
+
+void libmodbus_cpp::CompactTcpServer::serve(Connection *c)
+{
+    Q_UNUSED(c);
+}
+
+void libmodbus_cpp::CompactTcpServer::pause(Connection *c)
+{
+    Q_UNUSED(c);
+}
+
+void libmodbus_cpp::CompactTcpServer::flush(Connection *c)
+{
+    Q_UNUSED(c);
+}
+
+void libmodbus_cpp::CompactTcpServer::watch(Connection *c)
+{
+    Q_UNUSED(c);
+}
+
+void libmodbus_cpp::CompactTcpServer::remove(Connection *c)
+{
+    Q_UNUSED(c);
+}
+
+void libmodbus_cpp::CompactTcpServer::slot_resume()
+{
+}
+
+void libmodbus_cpp::CompactTcpServer::slot_checkConnections()
+{
+}
+
+#endif // __linux__
@@ -0,0 +1,72 @@
+#ifndef LIBMODBUS_CPP_COMPACT_TCP_SERVER_H_GUARD
+#define LIBMODBUS_CPP_COMPACT_TCP_SERVER_H_GUARD
+
+#include <QHash>
+#include <QSet>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "tcp_frame_server.h"
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief Modbus TCP connections of slave with small fixed state per connection
+ * Connections are plain non-blocking descriptors of one epoll set watched by one socket
+ * notifier: idle connection takes no CPU and few hundred bytes of memory instead of QTcpSocket.
+ * Complete MBAP frames are passed to handler, handler answers by send().
+ * Connection over limits is paused: its socket is not read until unsent replies drain or rate allows.
+ * Linux only, listen() fails on other systems.
+ */
+class CompactTcpServer : public TcpFrameServer
+{
+    Q_OBJECT
+
+public:
+    explicit CompactTcpServer(FrameHandler handler, QObject *parent = Q_NULLPTR);
+    ~CompactTcpServer() override;
+
+    bool listen(int serverSocket) override;
+    void close() override;
+    void setLimits(const TcpConnectionLimits &limits) override;
+    ssize_t send(const uint8_t *data, int length) override;
+    quint64 currentConnection() const override;
+    bool sendTo(quint64 connection, const uint8_t *data, int length) override;
+
+private slots:
+    void slot_activated();
+    void slot_resume();
+    void slot_checkConnections();
+
+private:
+    struct Connection;
+
+    void accept();
+    void read(Connection *c);
+    void serve(Connection *c);
+    void pause(Connection *c);
+    void scheduleResume(int delay_ms);
+    void flush(Connection *c);
+    void watch(Connection *c);
+    void remove(Connection *c);
+
+    int m_serverSocket = -1;
+    int m_epoll = -1;
+    QSocketNotifier *m_notifier = Q_NULLPTR;
+    QHash<int, Connection*> m_connections;
+    Connection *m_current = Q_NULLPTR;
+    quint32 m_serial = 0; // of accepted connections, ids of reused descriptors differ
+
+    TcpConnectionLimits m_limits;
+    QElapsedTimer m_clock;
+    QTimer m_checkTimer;
+    QTimer m_resumeTimer;
+    qint64 m_resumeAt_ms = 0;
+    QSet<int> m_rateLimited;
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_COMPACT_TCP_SERVER_H_GUARD
@@ -0,0 +1,105 @@
+#ifndef LIBMODBUS_CPP_CONNECTION_THROTTLE_H_GUARD
+#define LIBMODBUS_CPP_CONNECTION_THROTTLE_H_GUARD
+
+#include <QtGlobal>
+#include <algorithm>
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief per connection limits of TCP slave, zero turns limit off
+ * Connection over request or unsent bytes limit is not read until it drains, so abusive
+ * master is slowed down by TCP flow control instead of memory growth of slave.
+ */
+struct TcpConnectionLimits {
+    /// received requests waiting to be served (socket mode; compact mode never holds more than one)
+    int maxPendingRequests = 0;
+    /// reply bytes not yet taken by socket, requests are not served above it
+    int maxUnsentBytes = 0;
+    /// requests per second, excess ones wait in socket
+    int maxRequestRate = 0;
+    /// connection without requests is closed after it
+    int idleTimeout_ms = 0;
+    /// connection whose replies are not read by peer (half-open one) is closed after it
+    int unsentTimeout_ms = 0;
+
+    /// period of idle and half-open checks, 0 if there are no timeouts
+    int checkInterval_ms() const {
+        int timeout = 0;
+        for (int t : { idleTimeout_ms, unsentTimeout_ms }) {
+            if ((t > 0) && ((timeout == 0) || (t < timeout))) {
+                timeout = t;
+            }
+        }
+        return timeout ? std::max(timeout / 4, 10) : 0;
+    }
+};
+
+
+/// accounting of one connection against TcpConnectionLimits, times are of one monotonic clock
+class ConnectionThrottle
+{
+    qint64 m_lastRequest_ms = 0;
+    qint64 m_unsentSince_ms = -1;
+    qint64 m_refill_ms = 0;
+    float m_tokens = 0;
+
+public:
+    void start(qint64 now_ms, const TcpConnectionLimits &limits) {
+        m_lastRequest_ms = now_ms;
+        m_unsentSince_ms = -1;
+        m_refill_ms = now_ms;
+        m_tokens = static_cast<float>(limits.maxRequestRate);
+    }
+
+    /// rate check, request is counted if it may be served now
+    bool takeRequest(qint64 now_ms, const TcpConnectionLimits &limits) {
+        m_lastRequest_ms = now_ms;
+        if (limits.maxRequestRate <= 0) {
+            return true;
+        }
+        // bucket of one second burst
+        m_tokens = std::min<float>(limits.maxRequestRate, m_tokens + (now_ms - m_refill_ms) * limits.maxRequestRate / 1000.0f);
+        m_refill_ms = now_ms;
+        if (m_tokens < 1) {
+            return false;
+        }
+        m_tokens -= 1;
+        return true;
+    }
+
+    /// time until next request may be served
+    int rateDelay_ms(const TcpConnectionLimits &limits) const {
+        if (limits.maxRequestRate <= 0) {
+            return 0;
+        }
+        return std::max(1, static_cast<int>((1 - m_tokens) * 1000 / limits.maxRequestRate) + 1);
+    }
+
+    /// progress: peer took some bytes, slow reader is not half-open one
+    void updateUnsent(qint64 now_ms, qint64 unsentBytes, bool progress) {
+        if (unsentBytes == 0) {
+            m_unsentSince_ms = -1;
+        } else if (progress || (m_unsentSince_ms < 0)) {
+            m_unsentSince_ms = now_ms;
+        }
+    }
+
+    bool isOverUnsent(qint64 unsentBytes, const TcpConnectionLimits &limits) const {
+        return (limits.maxUnsentBytes > 0) && (unsentBytes > limits.maxUnsentBytes);
+    }
+
+    /// idle or half-open
+    bool isExpired(qint64 now_ms, const TcpConnectionLimits &limits) const {
+        if ((limits.idleTimeout_ms > 0) && (now_ms - m_lastRequest_ms > limits.idleTimeout_ms)) {
+            return true;
+        }
+        return (limits.unsentTimeout_ms > 0) && (m_unsentSince_ms >= 0) && (now_ms - m_unsentSince_ms > limits.unsentTimeout_ms);
+    }
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_CONNECTION_THROTTLE_H_GUARD
@@ -0,0 +1,96 @@
+#include <libmodbus_cpp/deferred_reply.h>
+#include <libmodbus_cpp/pdu.h>
+#include "logger.h"
+
+#define LDOM_DEFER "[modbus.slave.bk.defer]"
+
+
+libmodbus_cpp::DeferredReply::DeferredReply(const RequestView &req, Route route, Finish finish, uint8_t timeoutException)
+    : m_request(reinterpret_cast<const char *>(req.adu), req.length)
+    , m_headerLength(req.headerLength)
+    , m_route(route)
+    , m_finish(finish)
+    , m_timeoutException(timeoutException)
+{
+    m_timer.setSingleShot(true);
+#ifdef USE_QT5
+    connect(&m_timer, &QTimer::timeout, this, &DeferredReply::slot_timeout);
+#else
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(slot_timeout()));
+#endif
+}
+
+
+libmodbus_cpp::DeferredReplyPtr libmodbus_cpp::DeferredReply::create(const RequestView &req, Route route, Finish finish, int timeout_ms, uint8_t timeoutException)
+{
+    // last reference may be dropped in any thread, object is deleted in its own one
+    DeferredReplyPtr res(new DeferredReply(req, route, finish, timeoutException), [](DeferredReply *r) { r->deleteLater(); });
+    res->m_self = res;
+    if (timeout_ms > 0) {
+        res->m_timer.start(timeout_ms);
+    }
+    return res;
+}
+
+
+void libmodbus_cpp::DeferredReply::complete()
+{
+    if (settle(0)) {
+        QMetaObject::invokeMethod(this, "slot_finish", Qt::QueuedConnection);
+    }
+}
+
+
+void libmodbus_cpp::DeferredReply::fail(uint8_t exceptionCode)
+{
+    if (settle(exceptionCode ? exceptionCode : MODBUS_EXCEPTION_SLAVE_OR_SERVER_FAILURE)) {
+        QMetaObject::invokeMethod(this, "slot_finish", Qt::QueuedConnection);
+    }
+}
+
+
+bool libmodbus_cpp::DeferredReply::isFinished() const
+{
+    return m_exception.load(std::memory_order_acquire) != Pending;
+}
+
+
+void libmodbus_cpp::DeferredReply::detach()
+{
+    m_finish = Finish();
+}
+
+
+bool libmodbus_cpp::DeferredReply::settle(int exception)
+{
+    int expected = Pending;
+    return m_exception.compare_exchange_strong(expected, exception, std::memory_order_acq_rel);
+}
+
+
+void libmodbus_cpp::DeferredReply::slot_finish()
+{
+    if (m_sent) {
+        return;
+    }
+    m_sent = true;
+    m_timer.stop();
+
+    RequestView req;
+    req.parse(reinterpret_cast<const uint8_t *>(m_request.constData()), m_request.size(), m_headerLength);
+    req.exception = static_cast<uint8_t>(m_exception.load(std::memory_order_acquire));
+    if (m_finish) {
+        m_finish(this, req, m_route);
+        m_finish = Finish();
+    }
+    m_self.reset(); // deleted later if hook does not hold it
+}
+
+
+void libmodbus_cpp::DeferredReply::slot_timeout()
+{
+    if (settle(m_timeoutException)) {
+        LMB_DGLOG(LDOM_DEFER, "deferred reply timed out, exception " << static_cast<int>(m_timeoutException));
+        slot_finish();
+    }
+}
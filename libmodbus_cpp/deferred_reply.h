@@ -0,0 +1,75 @@
+#ifndef LIBMODBUS_CPP_DEFERRED_REPLY_H_GUARD
+#define LIBMODBUS_CPP_DEFERRED_REPLY_H_GUARD
+
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <QObject>
+#include <QByteArray>
+#include <QTimer>
+#include "defs.h"
+
+namespace libmodbus_cpp {
+
+struct RequestView;
+class DeferredReply;
+
+using DeferredReplyPtr = std::shared_ptr<DeferredReply>;
+
+
+/**
+ * @brief pending reply of request taken by pre-processing hook, see AbstractSlaveBackend::deferReply()
+ * Slave serves other requests meanwhile. complete() and fail() may be called from any thread,
+ * the first call (or timeout) wins: reply is built and sent from thread which served request,
+ * with header (MBAP transaction id) of request, then post-processing hooks are called.
+ * Token lives until reply is sent even if hook drops it.
+ */
+class DeferredReply : public QObject
+{
+    Q_OBJECT
+
+public:
+    /// sends reply ADU from thread of request, buffer has room for checksum
+    using Route = std::function<void(uint8_t *adu, int length)>;
+    /// builds and routes reply of request, exception of it is set if reply failed
+    using Finish = std::function<void(DeferredReply *reply, RequestView &req, const Route &route)>;
+
+    /// created in thread serving request, timer starts there
+    static DeferredReplyPtr create(const RequestView &req, Route route, Finish finish, int timeout_ms, uint8_t timeoutException);
+
+    /// reply is built from map now, so hook writes fetched items before
+    void complete();
+    /// exception reply, e.g. MODBUS_EXCEPTION_SLAVE_OR_SERVER_FAILURE
+    void fail(uint8_t exceptionCode);
+    /// reply is completed, failed or timed out
+    bool isFinished() const;
+
+    /// reply is never sent, e.g. slave is destroyed
+    void detach();
+
+private slots:
+    void slot_finish();
+    void slot_timeout();
+
+private:
+    DeferredReply(const RequestView &req, Route route, Finish finish, uint8_t timeoutException);
+
+    bool settle(int exception);
+
+    static const int Pending = -1;
+
+    QByteArray m_request;
+    int m_headerLength;
+    Route m_route;
+    Finish m_finish;
+    QTimer m_timer;
+    const uint8_t m_timeoutException;
+    std::atomic<int> m_exception { Pending }; // 0 on completion
+    bool m_sent = false;
+    DeferredReplyPtr m_self; // until reply is sent
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_DEFERRED_REPLY_H_GUARD
@@ -67,7 +67,31 @@ enum class AccessMode {
 
 enum class HookTime {
     Preprocessing,
-    Postprocessing
+    Postprocessing,
+    AsyncPostprocessing // after reply and Postprocessing hooks, on worker pool of slave (see HookPool)
+};
+
+/**
+ * @brief how register map is shared between application threads and slave reply path
+ * None    - no synchronization, application must access map from slave thread only
+ * SeqLock - application writers are serialized and readers (including reply path) retry on concurrent write,
+ *           so multiregister values are never observed half-updated
+ */
+enum class MapConcurrency {
+    None,
+    SeqLock
+};
+
+/**
+ * @brief memory order of register tables of slave map
+ * HostOrder - native uint16_t registers, as libmodbus keeps them
+ * WireOrder - big-endian registers as in Modbus packet: read replies copy tables as is and write requests
+ *             are copied to them, byte order is resolved by typed accessors of slave only.
+ *             Code using raw map tables must take it into account
+ */
+enum class RegisterStorage {
+    HostOrder,
+    WireOrder
 };
 
 // hooks ===================================================================
@@ -130,6 +154,16 @@ struct UniHookInfo {
     Address rangeSize;
 
     AddressRange range;
+
+    /// AsyncPostprocessing only: items of request range taken right after reply, before Postprocessing hooks,
+    /// one byte per bit or host order uint16_t per register. Empty if range is out of map
+    QByteArray snapshot;
+};
+
+/// coalesced range of map changed by master writes
+struct MapChange {
+    DataType type;
+    AddressRange range;
 };
 
 using HookFunction = std::function<void(void)>;
@@ -139,14 +173,25 @@ using UniHookFunction = std::function<void(const UniHookInfo* info)>;
 using Exception = std::runtime_error;
 using RemoteRWError = Exception;
 
+/// libmodbus errno of remote error is an exception reply of device, not a transport failure
+inline bool isExceptionReplyError(int error) {
+    return (error > MODBUS_ENOBASE) && (error <= EMBXGTAR);
+}
+
 class RemoteReadError : public RemoteRWError {
+    int m_error = 0;
 public:
-    RemoteReadError(const std::string &msg) : RemoteRWError(msg) {}
+    RemoteReadError(const std::string &msg, int error = 0) : RemoteRWError(msg), m_error(error) {}
+    /// libmodbus errno, zero if not known
+    int error() const { return m_error; }
 };
 
 class RemoteWriteError : public RemoteRWError {
+    int m_error = 0;
 public:
-    RemoteWriteError(const std::string &msg) : RemoteRWError(msg) {}
+    RemoteWriteError(const std::string &msg, int error = 0) : RemoteRWError(msg), m_error(error) {}
+    /// libmodbus errno, zero if not known
+    int error() const { return m_error; }
 };
 
 class ConnectionError : public RemoteRWError {
@@ -13,6 +13,13 @@ std::unique_ptr<libmodbus_cpp::AbstractMaster> libmodbus_cpp::Factory::createTcp
     return std::unique_ptr<AbstractMaster>(new MasterTcp(b.release()));
 }
 
+std::unique_ptr<libmodbus_cpp::AbstractMaster> libmodbus_cpp::Factory::createTcpMaster(const char *address, int port, TcpConnectionManager &manager)
+{
+    std::unique_ptr<MasterTcpBackend> b(new MasterTcpBackend());
+    b->init(address, port, manager);
+    return std::unique_ptr<AbstractMaster>(new MasterTcp(b.release()));
+}
+
 std::unique_ptr<libmodbus_cpp::AbstractSlave> libmodbus_cpp::Factory::createTcpSlave(const char *address, int port)
 {
     std::unique_ptr<SlaveTcpBackend> b(new SlaveTcpBackend());
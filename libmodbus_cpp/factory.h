@@ -8,11 +8,14 @@ namespace libmodbus_cpp {
 
 class AbstractSlave;
 class AbstractMaster;
+class TcpConnectionManager;
 
 class Factory
 {
 public:
     static std::unique_ptr<AbstractMaster> createTcpMaster(const char *address, int port);
+    /// connected and reconnected in background by manager, requests fail fast while device is down
+    static std::unique_ptr<AbstractMaster> createTcpMaster(const char *address, int port, TcpConnectionManager &manager);
     static std::unique_ptr<AbstractSlave> createTcpSlave(const char *address, int port);
 #ifdef USE_QT5
     static std::unique_ptr<AbstractMaster> createRtuMaster(const char *device, int baud, Parity parity = Parity::None, DataBits dataBits = DataBits::b8, StopBits stopBits = StopBits::b1);
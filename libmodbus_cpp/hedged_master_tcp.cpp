@@ -0,0 +1,243 @@
+#include <errno.h>
+#include <algorithm>
+#include <cmath>
+#include <libmodbus_cpp/hedged_master_tcp.h>
+#include "logger.h"
+
+#define LDOM_HMTCP "[modbus.master.hedged.tcp]"
+
+
+namespace {
+
+/// failed by device itself, other endpoint serving identical map would answer the same
+template<typename T>
+bool isExceptionReply(const libmodbus_cpp::AsyncReply<T> &reply)
+{
+    try {
+        reply.result();
+    } catch (const libmodbus_cpp::RemoteReadError &e) {
+        return libmodbus_cpp::isExceptionReplyError(e.error());
+    } catch (...) {
+    }
+    return false;
+}
+
+}
+
+
+libmodbus_cpp::HedgedMasterTcp::HedgedMasterTcp(const QString &primaryHost, const QString &secondaryHost, quint16 port, QObject *parent)
+    : QObject(parent)
+{
+    m_masters[Primary] = new AsyncMasterTcp(primaryHost, port, this);
+    m_masters[Secondary] = new AsyncMasterTcp(secondaryHost, port, this);
+    m_timer.setSingleShot(true);
+    m_clock.start();
+#ifdef USE_QT5
+    connect(&m_timer, &QTimer::timeout, this, &HedgedMasterTcp::slot_hedge);
+#else
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(slot_hedge()));
+#endif
+}
+
+
+libmodbus_cpp::HedgedMasterTcp::~HedgedMasterTcp()
+{
+    // reads in flight are failed here, while their accounting is alive
+    m_timer.stop();
+    m_hedges.clear();
+    delete m_masters[Primary];
+    delete m_masters[Secondary];
+}
+
+
+void libmodbus_cpp::HedgedMasterTcp::connectToSlave()
+{
+    for (AsyncMasterTcp *m : m_masters) {
+        m->connectToSlave();
+    }
+}
+
+
+void libmodbus_cpp::HedgedMasterTcp::disconnectFromSlave()
+{
+    for (AsyncMasterTcp *m : m_masters) {
+        m->disconnectFromSlave();
+    }
+}
+
+
+libmodbus_cpp::AsyncMasterTcp *libmodbus_cpp::HedgedMasterTcp::endpoint(Endpoint e) const
+{
+    return m_masters[e];
+}
+
+
+void libmodbus_cpp::HedgedMasterTcp::setSlaveAddress(uint8_t address)
+{
+    for (AsyncMasterTcp *m : m_masters) {
+        m->setSlaveAddress(address);
+    }
+}
+
+
+void libmodbus_cpp::HedgedMasterTcp::setResponseTimeout(int timeout_ms)
+{
+    for (AsyncMasterTcp *m : m_masters) {
+        m->setResponseTimeout(timeout_ms);
+    }
+}
+
+
+void libmodbus_cpp::HedgedMasterTcp::setHedgeDelay(double percentile, int min_ms, int max_ms)
+{
+    m_percentile = std::max(1.0, std::min(percentile, 100.0));
+    m_minHedge_ms = std::max(min_ms, 0);
+    m_maxHedge_ms = std::max(max_ms, m_minHedge_ms);
+}
+
+
+libmodbus_cpp::AsyncReply<QVector<bool>> libmodbus_cpp::HedgedMasterTcp::readCoils(Address address, int count)
+{
+    return read<bool>([address, count](AsyncMasterTcp *m) { return m->readCoils(address, count); });
+}
+
+
+libmodbus_cpp::AsyncReply<QVector<bool>> libmodbus_cpp::HedgedMasterTcp::readDiscreteInputs(Address address, int count)
+{
+    return read<bool>([address, count](AsyncMasterTcp *m) { return m->readDiscreteInputs(address, count); });
+}
+
+
+libmodbus_cpp::AsyncReply<QVector<uint16_t>> libmodbus_cpp::HedgedMasterTcp::readHoldingRegisters(Address address, int count)
+{
+    return read<uint16_t>([address, count](AsyncMasterTcp *m) { return m->readHoldingRegisters(address, count); });
+}
+
+
+libmodbus_cpp::AsyncReply<QVector<uint16_t>> libmodbus_cpp::HedgedMasterTcp::readInputRegisters(Address address, int count)
+{
+    return read<uint16_t>([address, count](AsyncMasterTcp *m) { return m->readInputRegisters(address, count); });
+}
+
+
+int libmodbus_cpp::HedgedMasterTcp::getHedgeDelay_ms(Endpoint e) const
+{
+    const LatencyWindow &latency = m_latency[e];
+    if (latency.count() < MinSamples) {
+        return m_maxHedge_ms;
+    }
+    const int delay = static_cast<int>(std::ceil(latency.percentile(m_percentile)));
+    return std::max(m_minHedge_ms, std::min(delay, m_maxHedge_ms));
+}
+
+
+const libmodbus_cpp::LatencyWindow &libmodbus_cpp::HedgedMasterTcp::getLatency(Endpoint e) const
+{
+    return m_latency[e];
+}
+
+
+libmodbus_cpp::HedgeStats libmodbus_cpp::HedgedMasterTcp::getHedgeStats() const
+{
+    return m_stats;
+}
+
+
+template<typename T>
+libmodbus_cpp::AsyncReply<QVector<T>> libmodbus_cpp::HedgedMasterTcp::read(Issue<T> issue)
+{
+    const std::shared_ptr<Read<T>> r = std::make_shared<Read<T>>();
+    r->issue = issue;
+    r->first = (!m_masters[Primary]->isConnected() && m_masters[Secondary]->isConnected()) ? Secondary : Primary;
+    ++m_stats.requests;
+    send(r, r->first);
+
+    if (!r->done) {
+        schedule(m_clock.elapsed() + getHedgeDelay_ms(static_cast<Endpoint>(r->first)), [this, r]() {
+            if (!r->done && !r->hedged) {
+                hedge(r);
+            }
+        });
+    }
+    return r->reply;
+}
+
+
+template<typename T>
+void libmodbus_cpp::HedgedMasterTcp::send(const std::shared_ptr<Read<T>> &read, int e)
+{
+    ++read->outstanding;
+    const qint64 sent_ns = m_clock.nsecsElapsed();
+    read->issue(m_masters[e]).onFinished([this, read, e, sent_ns](const AsyncReply<QVector<T>> &part) {
+        --read->outstanding;
+        const bool answered = !part.hasError() || isExceptionReply(part);
+        if (answered) {
+            // late reply is sampled too, it is latency of endpoint
+            m_latency[e].add((m_clock.nsecsElapsed() - sent_ns) / 1000000.0);
+        }
+        if (!part.hasError()) {
+            if (!read->done) {
+                read->done = true;
+                if (e != read->first) {
+                    ++m_stats.wonByHedge;
+                }
+                read->reply.finish(part.result());
+            }
+            return;
+        }
+        if (read->done) {
+            return;
+        }
+        if (!answered && !read->hedged && m_masters[1 - read->first]->isConnected()) {
+            LMB_DGLOG(LDOM_HMTCP, "read failed on endpoint" << e << ", passed to other one");
+            hedge(read);
+            return;
+        }
+        if (answered || (read->outstanding == 0)) {
+            read->done = true;
+            ++m_stats.failed;
+            try {
+                part.result();
+            } catch (...) {
+                read->reply.fail(std::current_exception());
+            }
+        }
+    });
+}
+
+
+template<typename T>
+void libmodbus_cpp::HedgedMasterTcp::hedge(const std::shared_ptr<Read<T>> &read)
+{
+    const int other = 1 - read->first;
+    if (!m_masters[other]->isConnected()) {
+        return; // read would wait for connection in queue
+    }
+    read->hedged = true;
+    ++m_stats.hedged;
+    send(read, other);
+}
+
+
+void libmodbus_cpp::HedgedMasterTcp::schedule(qint64 due_ms, std::function<void()> func)
+{
+    const bool earliest = m_hedges.isEmpty() || (due_ms < m_hedges.firstKey());
+    m_hedges.insert(due_ms, func);
+    if (earliest) {
+        m_timer.start(static_cast<int>(std::max<qint64>(due_ms - m_clock.elapsed(), 0)));
+    }
+}
+
+
+void libmodbus_cpp::HedgedMasterTcp::slot_hedge()
+{
+    const qint64 now = m_clock.elapsed();
+    while (!m_hedges.isEmpty() && (m_hedges.firstKey() <= now)) {
+        const std::function<void()> func = m_hedges.begin().value();
+        m_hedges.erase(m_hedges.begin());
+        func();
+    }
+    if (!m_hedges.isEmpty()) {
+        m_timer.start(static_cast<int>(std::max<qint64>(m_hedges.firstKey() - m_clock.elapsed(), 0)));
+    }
+}
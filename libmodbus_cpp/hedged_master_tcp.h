@@ -0,0 +1,108 @@
+#ifndef LIBMODBUS_CPP_HEDGED_MASTER_TCP_H_GUARD
+#define LIBMODBUS_CPP_HEDGED_MASTER_TCP_H_GUARD
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QVector>
+#include <memory>
+#include "async_master_tcp.h"
+#include "latency_window.h"
+
+namespace libmodbus_cpp {
+
+
+struct HedgeStats {
+    quint64 requests = 0;
+    quint64 hedged = 0;     // sent to other endpoint too, by delay or failure
+    quint64 wonByHedge = 0; // answered by other endpoint first
+    quint64 failed = 0;     // by exception reply or by both endpoints
+};
+
+
+/**
+ * @brief reads of one device over two redundant endpoints (e.g. NICs of PLC) serving identical maps
+ * Read is sent to primary endpoint (secondary one while primary is disconnected). If no reply
+ * arrives within hedge delay, same read is sent to other endpoint, first valid reply wins and
+ * the late one is dropped. Read failed by transport is passed to other endpoint at once, exception
+ * reply fails it as answer of device. Hedge delay is percentile of latencies observed on endpoint,
+ * clamped to [min, max], max until enough replies.
+ * Writes are not hedged, they go to endpoint() directly.
+ * Lives in thread of its endpoints, as AsyncMasterTcp.
+ */
+class HedgedMasterTcp : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Endpoint {
+        Primary = 0,
+        Secondary = 1
+    };
+
+    HedgedMasterTcp(const QString &primaryHost, const QString &secondaryHost, quint16 port = MODBUS_TCP_DEFAULT_PORT, QObject *parent = Q_NULLPTR);
+    ~HedgedMasterTcp() override;
+
+    void connectToSlave();
+    void disconnectFromSlave();
+    AsyncMasterTcp *endpoint(Endpoint e) const;
+
+    void setSlaveAddress(uint8_t address);
+    void setResponseTimeout(int timeout_ms);
+    /// hedge after percentile of latencies of endpoint, e.g. 95
+    void setHedgeDelay(double percentile, int min_ms = 1, int max_ms = 100);
+
+    AsyncReply<QVector<bool>> readCoils(Address address, int count);
+    AsyncReply<QVector<bool>> readDiscreteInputs(Address address, int count);
+    AsyncReply<QVector<uint16_t>> readHoldingRegisters(Address address, int count);
+    AsyncReply<QVector<uint16_t>> readInputRegisters(Address address, int count);
+
+    /// current delay before read sent to endpoint is hedged
+    int getHedgeDelay_ms(Endpoint e) const;
+    const LatencyWindow &getLatency(Endpoint e) const;
+    HedgeStats getHedgeStats() const;
+
+private slots:
+    void slot_hedge();
+
+private:
+    template<typename T>
+    using Issue = std::function<AsyncReply<QVector<T>>(AsyncMasterTcp *connection)>;
+
+    template<typename T>
+    struct Read {
+        AsyncReply<QVector<T>> reply;
+        Issue<T> issue;
+        int first;
+        int outstanding = 0;
+        bool hedged = false;
+        bool done = false;
+    };
+
+    template<typename T>
+    AsyncReply<QVector<T>> read(Issue<T> issue);
+    template<typename T>
+    void send(const std::shared_ptr<Read<T>> &read, int e);
+    template<typename T>
+    void hedge(const std::shared_ptr<Read<T>> &read);
+    void schedule(qint64 due_ms, std::function<void()> func);
+
+    static const int MinSamples = 16;
+
+    AsyncMasterTcp *m_masters[2];
+    LatencyWindow m_latency[2];
+    double m_percentile = 95;
+    int m_minHedge_ms = 1;
+    int m_maxHedge_ms = 100;
+    HedgeStats m_stats;
+
+    QMultiMap<qint64, std::function<void()>> m_hedges; // by due time
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_HEDGED_MASTER_TCP_H_GUARD
@@ -0,0 +1,122 @@
+#ifndef LIBMODBUS_CPP_HOOK_GATE_H_GUARD
+#define LIBMODBUS_CPP_HOOK_GATE_H_GUARD
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <atomic>
+#include <limits>
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief calls of synchronous hook which may be skipped, e.g. refresh of heavily polled range.
+ * Zero turns limit off. Skipped call is cheap: few atomic loads.
+ */
+struct HookLimits {
+    /// hook is not called again sooner after start of its last call
+    int minInterval_ms = 0;
+    /// refresh if older than: hook is not called while its last completed call is younger
+    int maxAge_ms = 0;
+    /// trigger of other thread (listener shard) waits for hook being called and skips own call
+    bool coalesce = false;
+
+    bool isSet() const {
+        return (minInterval_ms > 0) || (maxAge_ms > 0) || coalesce;
+    }
+};
+
+
+/// HookLimits of one hook, may be passed from any thread. Times are of one monotonic clock
+class HookGate
+{
+    static const qint64 Never = std::numeric_limits<qint64>::min() / 2;
+
+    const HookLimits m_limits;
+    std::atomic<qint64> m_lastStart_ms { Never };
+    std::atomic<qint64> m_lastDone_ms { Never };
+    QMutex m_running; // coalesced triggers wait on it
+    std::atomic<quint64> m_calls { 0 };
+    std::atomic<quint64> m_skipped { 0 };
+
+public:
+    explicit HookGate(const HookLimits &limits)
+        : m_limits(limits)
+    {
+    }
+
+    /// false if call at now_ms may be skipped by limits
+    bool isDue(qint64 now_ms) const {
+        if ((m_limits.minInterval_ms > 0) && (now_ms - m_lastStart_ms.load(std::memory_order_acquire) < m_limits.minInterval_ms)) {
+            return false;
+        }
+        return (m_limits.maxAge_ms <= 0) || (now_ms - m_lastDone_ms.load(std::memory_order_acquire) >= m_limits.maxAge_ms);
+    }
+
+    /// calls hook unless it is skipped, exception of hook is passed through
+    template<typename Call>
+    bool pass(const QElapsedTimer &clock, Call call) {
+        qint64 now = clock.elapsed();
+        if (!isDue(now)) {
+            return skip();
+        }
+
+        if (m_limits.coalesce) {
+            if (!m_running.tryLock()) {
+                // result of running call is taken instead of own one
+                m_running.lock();
+                m_running.unlock();
+                return skip();
+            }
+            now = clock.elapsed();
+            if (!isDue(now)) {
+                m_running.unlock(); // done by other thread between check and lock
+                return skip();
+            }
+        } else {
+            // one of concurrent triggers takes interval
+            qint64 lastStart = m_lastStart_ms.load(std::memory_order_acquire);
+            if ((m_limits.minInterval_ms > 0) &&
+                    ((now - lastStart < m_limits.minInterval_ms) ||
+                     !m_lastStart_ms.compare_exchange_strong(lastStart, now, std::memory_order_acq_rel))) {
+                return skip();
+            }
+        }
+
+        m_lastStart_ms.store(now, std::memory_order_release);
+        try {
+            call();
+        } catch (...) {
+            if (m_limits.coalesce) {
+                m_running.unlock();
+            }
+            throw;
+        }
+        m_lastDone_ms.store(clock.elapsed(), std::memory_order_release);
+        m_calls.fetch_add(1, std::memory_order_relaxed);
+        if (m_limits.coalesce) {
+            m_running.unlock();
+        }
+        return true;
+    }
+
+    quint64 calls() const {
+        return m_calls.load(std::memory_order_relaxed);
+    }
+
+    quint64 skipped() const {
+        return m_skipped.load(std::memory_order_relaxed);
+    }
+
+private:
+    bool skip() {
+        m_skipped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_HOOK_GATE_H_GUARD
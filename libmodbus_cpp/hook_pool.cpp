@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <memory>
+#include <QElapsedTimer>
+#include <QSemaphore>
+#include <QThread>
+#include <libmodbus_cpp/hook_pool.h>
+#include "logger.h"
+
+#define LDOM_HPOOL "[modbus.slave.bk.hook.pool]"
+
+
+/**
+ * @brief thread of pool with bounded multi-producer queue (Vyukov's array of sequenced cells)
+ * Producers claim cell by CAS of enqueue position, worker is the only consumer.
+ * Semaphore only wakes worker: it is released once per pushed job and once on stop.
+ */
+class libmodbus_cpp::HookPool::Worker : public QThread
+{
+    struct Cell {
+        std::atomic<quint64> seq;
+        Job job;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    const quint64 m_mask;
+    alignas(64) std::atomic<quint64> m_enqueuePos { 0 };
+    alignas(64) std::atomic<quint64> m_dequeuePos { 0 };
+    std::atomic<quint64> m_done { 0 };
+    std::atomic<bool> m_stop { false };
+    QSemaphore m_ready;
+
+public:
+    explicit Worker(int capacity)
+        : m_cells(new Cell[capacity])
+        , m_mask(static_cast<quint64>(capacity) - 1)
+    {
+        for (int i = 0; i < capacity; ++i) {
+            m_cells[i].seq.store(static_cast<quint64>(i), std::memory_order_relaxed);
+        }
+    }
+
+    bool push(Job &job) {
+        quint64 pos = m_enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &c = m_cells[pos & m_mask];
+            const qint64 diff = static_cast<qint64>(c.seq.load(std::memory_order_acquire) - pos);
+            if (diff == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.job = std::move(job);
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    m_ready.release();
+                    return true;
+                }
+            } else if (diff < 0) {
+                // worker has not taken job of previous round yet
+                return false;
+            } else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void stop() {
+        m_stop.store(true, std::memory_order_release);
+        m_ready.release();
+        wait();
+    }
+
+    int depth() const {
+        return static_cast<int>(m_enqueuePos.load(std::memory_order_relaxed) - m_dequeuePos.load(std::memory_order_relaxed));
+    }
+
+    quint64 posted() const {
+        return m_enqueuePos.load(std::memory_order_acquire);
+    }
+
+    quint64 done() const {
+        return m_done.load(std::memory_order_acquire);
+    }
+
+protected:
+    void run() override {
+        for (;;) {
+            m_ready.acquire();
+            Job job;
+            // queued jobs are run before stop
+            while (pop(job)) {
+                execute(job);
+            }
+            if (m_stop.load(std::memory_order_acquire)) {
+                return;
+            }
+        }
+    }
+
+private:
+    bool pop(Job &job) {
+        const quint64 pos = m_dequeuePos.load(std::memory_order_relaxed);
+        Cell &c = m_cells[pos & m_mask];
+        if (c.seq.load(std::memory_order_acquire) != pos + 1) {
+            return false;
+        }
+        job = std::move(c.job);
+        c.job = Job();
+        m_dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        c.seq.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    void execute(Job &job) {
+        try {
+            job();
+        } catch (const std::exception &e) {
+            LMB_WGLOG(LDOM_HPOOL, "async hook failed: " << e.what());
+        } catch (...) {
+            LMB_WGLOG(LDOM_HPOOL, "async hook failed");
+        }
+        m_done.fetch_add(1, std::memory_order_release);
+    }
+};
+
+
+const int libmodbus_cpp::HookPool::DefaultQueueCapacity;
+
+
+libmodbus_cpp::HookPool::HookPool(int workerCount, int queueCapacity)
+{
+    if (workerCount <= 0) {
+        workerCount = std::max(QThread::idealThreadCount(), 1);
+    }
+    int capacity = 2;
+    while (capacity < queueCapacity) {
+        capacity <<= 1;
+    }
+    for (int i = 0; i < workerCount; ++i) {
+        Worker *w = new Worker(capacity);
+        w->start();
+        m_workers.append(w);
+    }
+}
+
+
+libmodbus_cpp::HookPool::~HookPool()
+{
+    for (Worker *w : m_workers) {
+        w->stop();
+        delete w;
+    }
+}
+
+
+bool libmodbus_cpp::HookPool::post(quint64 lane, Job job)
+{
+    if (!m_workers[static_cast<int>(lane % m_workers.size())]->push(job)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+
+bool libmodbus_cpp::HookPool::waitForDone(int timeout_ms)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (;;) {
+        bool done = true;
+        for (const Worker *w : m_workers) {
+            done = done && (w->done() == w->posted());
+        }
+        if (done) {
+            return true;
+        }
+        if (timer.elapsed() >= timeout_ms) {
+            return false;
+        }
+        QThread::msleep(1);
+    }
+}
+
+
+libmodbus_cpp::HookPool::Stats libmodbus_cpp::HookPool::stats() const
+{
+    Stats s;
+    s.workers = m_workers.size();
+    for (const Worker *w : m_workers) {
+        s.depth += w->depth();
+        s.posted += w->posted();
+        s.done += w->done();
+    }
+    s.dropped = m_dropped.load(std::memory_order_relaxed);
+    return s;
+}
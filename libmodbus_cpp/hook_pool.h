@@ -0,0 +1,58 @@
+#ifndef LIBMODBUS_CPP_HOOK_POOL_H_GUARD
+#define LIBMODBUS_CPP_HOOK_POOL_H_GUARD
+
+#include <atomic>
+#include <functional>
+#include <QVector>
+#include <QtGlobal>
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief worker threads running asynchronous post-processing hooks
+ * Each worker owns bounded lock-free queue, jobs of one lane always go to the same worker,
+ * so they are run in order of post(). Job posted to full queue is dropped and counted.
+ * Destructor runs queued jobs and joins workers.
+ */
+class HookPool
+{
+public:
+    using Job = std::function<void()>;
+
+    static const int DefaultQueueCapacity = 1024;
+
+    struct Stats {
+        int workers = 0;
+        int depth = 0;        // jobs queued and not started
+        quint64 posted = 0;
+        quint64 done = 0;
+        quint64 dropped = 0;
+    };
+
+    /// workerCount <= 0 means QThread::idealThreadCount(), capacity is rounded up to power of two
+    HookPool(int workerCount, int queueCapacity);
+    ~HookPool();
+
+    HookPool(const HookPool&) = delete;
+    HookPool& operator=(const HookPool&) = delete;
+
+    /// may be called from any thread, false if job is dropped
+    bool post(quint64 lane, Job job);
+
+    /// true if all posted jobs are done within timeout_ms
+    bool waitForDone(int timeout_ms);
+
+    Stats stats() const;
+
+private:
+    class Worker;
+
+    QVector<Worker*> m_workers;
+    std::atomic<quint64> m_dropped { 0 };
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_HOOK_POOL_H_GUARD
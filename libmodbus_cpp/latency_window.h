@@ -0,0 +1,61 @@
+#ifndef LIBMODBUS_CPP_LATENCY_WINDOW_H_GUARD
+#define LIBMODBUS_CPP_LATENCY_WINDOW_H_GUARD
+
+#include <QtGlobal>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+
+namespace libmodbus_cpp {
+
+
+/// latencies of last capacity replies of one endpoint, percentiles are of nearest rank
+class LatencyWindow
+{
+    QVector<double> m_samples;
+    int m_capacity;
+    int m_next = 0;
+    quint64 m_total = 0;
+
+public:
+    explicit LatencyWindow(int capacity = 256)
+        : m_capacity(std::max(capacity, 1))
+    {
+        m_samples.reserve(m_capacity);
+    }
+
+    void add(double latency_ms) {
+        if (m_samples.size() < m_capacity) {
+            m_samples.append(latency_ms);
+        } else {
+            m_samples[m_next] = latency_ms;
+        }
+        m_next = (m_next + 1) % m_capacity;
+        ++m_total;
+    }
+
+    /// samples in window
+    int count() const {
+        return m_samples.size();
+    }
+
+    quint64 total() const {
+        return m_total;
+    }
+
+    /// p in (0, 100], zero without samples
+    double percentile(double p) const {
+        if (m_samples.isEmpty()) {
+            return 0;
+        }
+        QVector<double> sorted = m_samples;
+        const int rank = std::min(std::max(static_cast<int>(std::ceil(p / 100 * sorted.size())), 1), sorted.size());
+        std::nth_element(sorted.begin(), sorted.begin() + rank - 1, sorted.end());
+        return sorted[rank - 1];
+    }
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_LATENCY_WINDOW_H_GUARD
@@ -17,6 +17,7 @@ TARGET  = $${LIBMODBUS_CPP_TARGET}
 CONFIG += $${LIBMODBUS_CPP_CONFIG}
 
 LIBS += $${LIBMODBUS_LIB}
+unix:!macx: LIBS += -lrt
 
 QMAKE_CXXFLAGS += -Wno-unused -Wno-format
 
@@ -33,7 +34,21 @@ SOURCES += \
     slave_rtu_backend.cpp \
     master_rtu_backend.cpp \
     master_rtu.cpp \
-    global.cpp
+    global.cpp \
+    map_transaction.cpp \
+    change_tracker.cpp \
+    response_cache.cpp \
+    hook_pool.cpp \
+    deferred_reply.cpp \
+    map_file.cpp \
+    shared_map.cpp \
+    async_master_tcp.cpp \
+    parallel_master_tcp.cpp \
+    hedged_master_tcp.cpp \
+    tcp_connection_manager.cpp \
+    write_buffer.cpp \
+    compact_tcp_server.cpp \
+    uring_tcp_server.cpp
 
 HEADERS += \
     backend.h \
@@ -49,7 +64,31 @@ HEADERS += \
     slave_rtu_backend.h \
     master_rtu_backend.h \
     master_rtu.h \
-    global.h
+    global.h \
+    seq_lock.h \
+    map_transaction.h \
+    change_tracker.h \
+    response_cache.h \
+    hook_pool.h \
+    hook_gate.h \
+    rtt_estimator.h \
+    latency_window.h \
+    deferred_reply.h \
+    map_file.h \
+    shared_map.h \
+    shared_map_client.h \
+    async_reply.h \
+    async_master_tcp.h \
+    parallel_master_tcp.h \
+    hedged_master_tcp.h \
+    tcp_connection_manager.h \
+    write_buffer.h \
+    register_layout.h \
+    pdu.h \
+    tcp_frame_server.h \
+    compact_tcp_server.h \
+    uring_tcp_server.h \
+    connection_throttle.h
 
 DISTFILES += \
     libmodbus_cpp.prf
@@ -0,0 +1,133 @@
+#include <cstring>
+#include <libmodbus_cpp/map_file.h>
+#include "logger.h"
+
+#define LDOM_MAPF "[modbus.slave.mapfile]"
+
+
+namespace {
+
+const char MAP_FILE_MAGIC[8] = { 'L', 'M', 'B', 'C', 'P', 'M', 'A', 'P' };
+const quint16 MAP_FILE_BOM = 0x0102;
+
+quint32 alignUp(quint32 value) {
+    return (value + 7u) & ~7u;
+}
+
+bool sameLayout(const libmodbus_cpp::MapFileHeader &A, const libmodbus_cpp::MapFileHeader &B) {
+    return (memcmp(A.magic, B.magic, sizeof(A.magic)) == 0)
+            && (A.version == B.version)
+            && (A.byteOrderMark == B.byteOrderMark)
+            && (memcmp(A.counts, B.counts, sizeof(A.counts)) == 0)
+            && (memcmp(A.offsets, B.offsets, sizeof(A.offsets)) == 0);
+}
+
+}
+
+
+const quint32 libmodbus_cpp::MapFileHeader::CurrentVersion;
+
+
+libmodbus_cpp::MapFile::MapFile(const QString &path)
+    : m_file(path)
+{
+    memset(&m_map, 0, sizeof(m_map));
+}
+
+
+libmodbus_cpp::MapFile::~MapFile()
+{
+    close();
+}
+
+
+bool libmodbus_cpp::MapFile::open(int holdingBitsCount, int inputBitsCount, int holdingRegistersCount, int inputRegistersCount)
+{
+    close();
+
+    int counts[4];
+    counts[static_cast<int>(DataType::Coil)]            = holdingBitsCount;
+    counts[static_cast<int>(DataType::DiscreteInput)]   = inputBitsCount;
+    counts[static_cast<int>(DataType::HoldingRegister)] = holdingRegistersCount;
+    counts[static_cast<int>(DataType::InputRegister)]   = inputRegistersCount;
+
+    qint64 fileSize = 0;
+    const MapFileHeader header = makeHeader(counts, fileSize);
+
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        LMB_WGLOG(LDOM_MAPF, "can't open map file:" << m_file.fileName() << m_file.errorString());
+        return false;
+    }
+
+    MapFileHeader stored;
+    m_restored =
+            (m_file.size() == fileSize) &&
+            (m_file.read(reinterpret_cast<char *>(&stored), sizeof(stored)) == sizeof(stored)) &&
+            sameLayout(stored, header);
+
+    if (!m_restored) {
+        LMB_WGLOG(LDOM_MAPF, "map file layout differs, reinit:" << m_file.fileName());
+        // resize to zero first so all tables are filled with zeroes
+        if (!m_file.resize(0) || !m_file.resize(fileSize)) {
+            LMB_WGLOG(LDOM_MAPF, "can't resize map file:" << m_file.errorString());
+            m_file.close();
+            return false;
+        }
+    }
+
+    m_data = m_file.map(0, fileSize);
+    if (!m_data) {
+        LMB_WGLOG(LDOM_MAPF, "can't map file:" << m_file.errorString());
+        m_file.close();
+        return false;
+    }
+
+    if (!m_restored) {
+        memcpy(m_data, &header, sizeof(header));
+    }
+
+    m_map.nb_bits                = counts[static_cast<int>(DataType::Coil)];
+    m_map.nb_input_bits          = counts[static_cast<int>(DataType::DiscreteInput)];
+    m_map.nb_registers           = counts[static_cast<int>(DataType::HoldingRegister)];
+    m_map.nb_input_registers     = counts[static_cast<int>(DataType::InputRegister)];
+    m_map.tab_bits               = m_data + header.offsets[static_cast<int>(DataType::Coil)];
+    m_map.tab_input_bits         = m_data + header.offsets[static_cast<int>(DataType::DiscreteInput)];
+    m_map.tab_registers          = reinterpret_cast<uint16_t *>(m_data + header.offsets[static_cast<int>(DataType::HoldingRegister)]);
+    m_map.tab_input_registers    = reinterpret_cast<uint16_t *>(m_data + header.offsets[static_cast<int>(DataType::InputRegister)]);
+
+    return true;
+}
+
+
+void libmodbus_cpp::MapFile::close()
+{
+    if (m_data) {
+        m_file.unmap(m_data);
+        m_data = nullptr;
+    }
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    memset(&m_map, 0, sizeof(m_map));
+}
+
+
+libmodbus_cpp::MapFileHeader libmodbus_cpp::MapFile::makeHeader(const int counts[4], qint64 &fileSize)
+{
+    MapFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAP_FILE_MAGIC, sizeof(header.magic));
+    header.version = MapFileHeader::CurrentVersion;
+    header.byteOrderMark = MAP_FILE_BOM;
+
+    quint32 offset = alignUp(sizeof(MapFileHeader));
+    for (int i = 0; i < 4; ++i) {
+        const bool isRegister = (i == static_cast<int>(DataType::HoldingRegister)) || (i == static_cast<int>(DataType::InputRegister));
+        header.counts[i] = counts[i];
+        header.offsets[i] = offset;
+        offset = alignUp(offset + counts[i] * (isRegister ? sizeof(uint16_t) : sizeof(uint8_t)));
+    }
+    fileSize = offset;
+
+    return header;
+}
@@ -0,0 +1,63 @@
+#ifndef LIBMODBUS_CPP_MAP_FILE_H_GUARD
+#define LIBMODBUS_CPP_MAP_FILE_H_GUARD
+
+#include <QFile>
+#include <QString>
+#include "defs.h"
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief on-disk layout of persistent map
+ * Header is followed by tables in order: coils, discrete inputs, holding registers, input registers.
+ * Each table starts at 8 byte aligned offset. Bits take one byte each, registers are stored in host byte order.
+ */
+struct MapFileHeader {
+    static const quint32 CurrentVersion = 1;
+
+    char magic[8];           // "LMBCPMAP"
+    quint32 version;
+    quint16 byteOrderMark;   // 0x0102 written in host order
+    quint16 reserved;
+    qint32  counts[4];       // indexed by DataType
+    quint32 offsets[4];      // from file start, indexed by DataType
+};
+
+
+/**
+ * @brief map tables backed by memory mapped file
+ * Register state survives restarts without load step, persistence is left to OS page cache.
+ */
+class MapFile
+{
+    QFile m_file;
+    uchar *m_data = nullptr;
+    modbus_mapping_t m_map;
+    bool m_restored = false;
+
+public:
+    explicit MapFile(const QString &path);
+    ~MapFile();
+
+    /// maps file, file with other layout or version is reinitialized with zeroes
+    bool open(int holdingBitsCount, int inputBitsCount, int holdingRegistersCount, int inputRegistersCount);
+    void close();
+
+    modbus_mapping_t *map() {
+        return m_data ? &m_map : nullptr;
+    }
+
+    /// true if tables were taken from existing file
+    bool isRestored() const {
+        return m_restored;
+    }
+
+private:
+    static MapFileHeader makeHeader(const int counts[4], qint64 &fileSize);
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_MAP_FILE_H_GUARD
@@ -0,0 +1,130 @@
+#include <libmodbus_cpp/map_transaction.h>
+
+
+namespace {
+
+using namespace libmodbus_cpp;
+
+template<DataType T>
+void *tableOf(modbus_mapping_t *map, int &count) {
+    const MappingWrapper<T> m(map);
+    count = m.count();
+    return m.table();
+}
+
+void *tableOf(modbus_mapping_t *map, DataType type, int &count) {
+    switch (type) {
+        case DataType::Coil:
+            return tableOf<DataType::Coil>(map, count);
+        case DataType::DiscreteInput:
+            return tableOf<DataType::DiscreteInput>(map, count);
+        case DataType::HoldingRegister:
+            return tableOf<DataType::HoldingRegister>(map, count);
+        case DataType::InputRegister:
+            return tableOf<DataType::InputRegister>(map, count);
+    }
+    count = 0;
+    return nullptr;
+}
+
+}
+
+
+libmodbus_cpp::MapTransaction::MapTransaction(AbstractSlaveBackend *backend)
+    : m_backend(backend)
+    , m_codec(layout_detail::makeCodec(backend->getTargetByteOrder(), backend->getRegisterStorage()))
+{
+}
+
+
+bool libmodbus_cpp::MapTransaction::isEmpty() const
+{
+    return m_chunks.isEmpty();
+}
+
+
+void libmodbus_cpp::MapTransaction::clear()
+{
+    m_chunks.clear();
+    m_regs.clear();
+    m_masks.clear();
+    m_bits.clear();
+}
+
+
+void libmodbus_cpp::MapTransaction::commit()
+{
+    modbus_mapping_t *map = m_backend->getMap();
+    if (!map) {
+        throw LocalWriteError("map was not inited");
+    }
+
+    for (const Chunk &c : m_chunks) {
+        int count = 0;
+        tableOf(map, c.type, count);
+        if ((int)c.address + c.size > count) {
+            throw LocalWriteError("wrong address");
+        }
+    }
+
+    {
+        SeqLockWriteGuard guard(m_backend->getMapLock());
+        for (const Chunk &c : m_chunks) {
+            int count = 0;
+            void *table = tableOf(map, c.type, count);
+            if ((c.type == DataType::Coil) || (c.type == DataType::DiscreteInput)) {
+                memcpy(static_cast<uint8_t *>(table) + c.address, m_bits.constData() + c.offset, c.size);
+            } else if (c.partial) {
+                uint16_t *regs = static_cast<uint16_t *>(table) + c.address;
+                for (int i = 0; i < c.size; ++i) {
+                    const uint16_t mask = m_masks.at(c.offset + i);
+                    regs[i] = static_cast<uint16_t>((regs[i] & ~mask) | (m_regs.at(c.offset + i) & mask));
+                }
+            } else {
+                memcpy(static_cast<uint16_t *>(table) + c.address, m_regs.constData() + c.offset, c.size * sizeof(uint16_t));
+            }
+            m_backend->markMapWritten(c.type, c.address, c.size);
+        }
+    }
+
+    clear();
+}
+
+
+bool libmodbus_cpp::MapTransaction::canAppend(DataType type, Address address) const
+{
+    if (m_chunks.isEmpty()) {
+        return false;
+    }
+    const Chunk &last = m_chunks.last();
+    return (last.type == type) && ((int)last.address + last.size == (int)address);
+}
+
+
+int libmodbus_cpp::MapTransaction::stageRegisters(DataType type, Address address, int regCount, bool partial)
+{
+    const int offset = m_regs.size();
+    m_regs.resize(offset + regCount);
+    m_masks.resize(offset + regCount);
+    std::fill(m_masks.begin() + offset, m_masks.end(), partial ? 0 : 0xFFFF);
+    if (canAppend(type, address)) {
+        m_chunks.last().size += regCount;
+        m_chunks.last().partial = m_chunks.last().partial || partial;
+    } else {
+        m_chunks.append(Chunk { type, address, offset, regCount, partial });
+    }
+    return offset;
+}
+
+
+uint8_t *libmodbus_cpp::MapTransaction::stageBit(DataType type, Address address)
+{
+    const int offset = m_bits.size();
+    m_bits.resize(offset + 1);
+    if (canAppend(type, address)) {
+        m_chunks.last().size += 1;
+    } else {
+        m_chunks.append(Chunk { type, address, offset, 1, false });
+    }
+    return m_bits.data() + offset;
+}
@@ -0,0 +1,94 @@
+#ifndef LIBMODBUS_CPP_MAP_TRANSACTION_H_GUARD
+#define LIBMODBUS_CPP_MAP_TRANSACTION_H_GUARD
+
+#include <QVector>
+#include <algorithm>
+#include <cstring>
+#include "defs.h"
+#include "backend.h"
+#include "register_layout.h"
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief batch of typed writes to slave map
+ * Values are converted to target byte order and register storage while staging and adjacent writes are merged.
+ * commit() validates whole batch and publishes it under one map write lock, so
+ * in MapConcurrency::SeqLock mode master never observes half-updated batch.
+ */
+class MapTransaction
+{
+    struct Chunk {
+        DataType type;
+        Address address;
+        int offset; // in m_regs or m_bits
+        int size;
+        bool partial; // some registers are written by halves, see m_masks
+    };
+
+    AbstractSlaveBackend *m_backend;
+    layout_detail::Codec m_codec;
+    QVector<Chunk> m_chunks;
+    QVector<uint16_t> m_regs;
+    QVector<uint16_t> m_masks; // written bytes of m_regs
+    QVector<uint8_t> m_bits;
+
+public:
+    explicit MapTransaction(AbstractSlaveBackend *backend);
+
+    template<typename ValueType, DataType dataType>
+    void setValue(Address address, ValueType value) {
+        static_assert((dataType == DataType::HoldingRegister) || (dataType == DataType::InputRegister), "registers only");
+        const int regCount = (sizeof(ValueType) + 1) / sizeof(uint16_t); // odd size is padded
+        const bool partial = (sizeof(ValueType) % 2) != 0;
+        const int offset = stageRegisters(dataType, address, regCount, partial);
+        m_codec.encode<FieldOrder::Target, sizeof(ValueType)>(&value, m_regs.data() + offset);
+        if (partial) {
+            // last byte of value takes half of register, commit keeps other half as setValueToHoldingRegister does
+            uint8_t written[sizeof(ValueType)];
+            memset(written, 0xFF, sizeof(written));
+            m_codec.encode<FieldOrder::Target, sizeof(ValueType)>(written, m_masks.data() + offset);
+        }
+    }
+
+    template<DataType dataType>
+    void setBit(Address address, bool value) {
+        static_assert((dataType == DataType::Coil) || (dataType == DataType::DiscreteInput), "bits only");
+        *stageBit(dataType, address) = value ? 1 : 0;
+    }
+
+    void setValueToCoil(Address address, bool value) {
+        setBit<DataType::Coil>(address, value);
+    }
+
+    void setValueToDiscreteInput(Address address, bool value) {
+        setBit<DataType::DiscreteInput>(address, value);
+    }
+
+    template<typename ValueType>
+    void setValueToHoldingRegister(Address address, ValueType value) {
+        setValue<ValueType, DataType::HoldingRegister>(address, value);
+    }
+
+    template<typename ValueType>
+    void setValueToInputRegister(Address address, ValueType value) {
+        setValue<ValueType, DataType::InputRegister>(address, value);
+    }
+
+    bool isEmpty() const;
+    void clear();
+
+    /// all or nothing: throws LocalWriteError and leaves map untouched if any write is out of map
+    void commit();
+
+private:
+    bool canAppend(DataType type, Address address) const;
+    /// offset of staged registers in m_regs, masks of partial ones are left empty
+    int stageRegisters(DataType type, Address address, int regCount, bool partial);
+    uint8_t *stageBit(DataType type, Address address);
+};
+
+} // ns
+
+#endif // LIBMODBUS_CPP_MAP_TRANSACTION_H_GUARD
@@ -1,4 +1,34 @@
 #include <libmodbus_cpp/master_tcp_backend.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#endif
+
+namespace {
+
+// ETIMEDOUT is response timeout of libmodbus too, socket itself tells if keep-alive dropped it
+bool isSocketDead(int s)
+{
+    if (s == -1) {
+        return false;
+    }
+#ifndef _WIN32
+    int soError = 0;
+    socklen_t len = sizeof(soError);
+    if ((getsockopt(s, SOL_SOCKET, SO_ERROR, &soError, &len) == 0) && (soError != 0)) {
+        return true;
+    }
+    // error is reported once, closed socket reads EOF after it
+    char byte;
+    const ssize_t n = recv(s, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return (n == 0) || ((n == -1) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR));
+#else
+    return false;
+#endif
+}
+
+} // namespace
 
 libmodbus_cpp::MasterTcpBackend::MasterTcpBackend()
 {
@@ -6,6 +36,10 @@ libmodbus_cpp::MasterTcpBackend::MasterTcpBackend()
 
 libmodbus_cpp::MasterTcpBackend::~MasterTcpBackend()
 {
+    if (m_connection) {
+        closeSocket();
+        m_connection->park();
+    }
 }
 
 void libmodbus_cpp::MasterTcpBackend::init(const char *address, int port)
@@ -16,3 +50,82 @@ void libmodbus_cpp::MasterTcpBackend::init(const char *address, int port)
     }
     setCtx(ctx);
 }
+
+void libmodbus_cpp::MasterTcpBackend::init(const char *address, int port, TcpConnectionManager &manager)
+{
+    init(address, port);
+    m_connection = manager.add(address, port);
+}
+
+bool libmodbus_cpp::MasterTcpBackend::openConnection()
+{
+    if (!m_connection) {
+        return AbstractBackend::openConnection();
+    }
+    m_connection->unpark();
+    beforeTransaction();
+    return true;
+}
+
+void libmodbus_cpp::MasterTcpBackend::closeConnection()
+{
+    if (!m_connection) {
+        AbstractBackend::closeConnection();
+        return;
+    }
+    closeSocket();
+    m_connection->park();
+}
+
+void libmodbus_cpp::MasterTcpBackend::beforeTransaction()
+{
+    if (m_connection && (modbus_get_socket(getCtx()) == -1)) {
+        modbus_set_socket(getCtx(), m_connection->acquire());
+    }
+}
+
+void libmodbus_cpp::MasterTcpBackend::transactionSucceeded()
+{
+    if (m_connection) {
+        m_connection->succeeded();
+    }
+}
+
+bool libmodbus_cpp::MasterTcpBackend::transactionFailed(int error)
+{
+    if (!m_connection) {
+        return false;
+    }
+    switch (error) {
+        case ECONNRESET:
+        case ECONNABORTED:
+        case ECONNREFUSED:
+        case ENOTCONN:
+        case ENETDOWN:
+        case ENETUNREACH:
+        case EHOSTUNREACH:
+        case EPIPE:
+        case EBADF:
+            // reconnected in background, requests fail fast meanwhile
+            closeSocket();
+            m_connection->lost();
+            return true;
+        case ETIMEDOUT:
+            if (isSocketDead(modbus_get_socket(getCtx()))) {
+                closeSocket();
+                m_connection->lost();
+                return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+void libmodbus_cpp::MasterTcpBackend::closeSocket()
+{
+    if (modbus_get_socket(getCtx()) != -1) {
+        modbus_close(getCtx());
+        modbus_set_socket(getCtx(), -1);
+    }
+}
@@ -3,16 +3,33 @@
 
 #include <QTcpSocket>
 #include "backend.h"
+#include "tcp_connection_manager.h"
 
 namespace libmodbus_cpp {
 
 class MasterTcpBackend : public AbstractBackend
 {
+    ManagedTcpConnectionPtr m_connection;
+
 public:
     MasterTcpBackend();
     ~MasterTcpBackend();
 
     void init(const char *address, int port = MODBUS_TCP_DEFAULT_PORT);
+    /// connection is kept by manager, connect() is not needed
+    void init(const char *address, int port, TcpConnectionManager &manager);
+
+    bool openConnection() override;
+    void closeConnection() override;
+    void beforeTransaction() override;
+    bool transactionFailed(int error) override;
+    void transactionSucceeded() override;
+    bool hasTransactionIds() const override {
+        return true;
+    }
+
+private:
+    void closeSocket();
 };
 
 }
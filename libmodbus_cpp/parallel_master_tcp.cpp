@@ -0,0 +1,192 @@
+#include <errno.h>
+#include <algorithm>
+#include <memory>
+#include <libmodbus_cpp/parallel_master_tcp.h>
+#include "logger.h"
+
+#define LDOM_PMTCP "[modbus.master.parallel.tcp]"
+
+
+libmodbus_cpp::ParallelMasterTcp::ParallelMasterTcp(const QString &host, quint16 port, int connectionCount, QObject *parent)
+    : QObject(parent)
+{
+    connectionCount = std::max(connectionCount, 1);
+    for (int i = 0; i < connectionCount; ++i) {
+        m_connections.append(new AsyncMasterTcp(host, port, this));
+    }
+    m_load.fill(0, connectionCount);
+}
+
+
+libmodbus_cpp::ParallelMasterTcp::~ParallelMasterTcp()
+{
+    // chunks in flight are failed here, while their accounting is alive
+    for (AsyncMasterTcp *c : m_connections) {
+        delete c;
+    }
+}
+
+
+void libmodbus_cpp::ParallelMasterTcp::connectToSlave()
+{
+    for (AsyncMasterTcp *c : m_connections) {
+        c->connectToSlave();
+    }
+}
+
+
+void libmodbus_cpp::ParallelMasterTcp::disconnectFromSlave()
+{
+    for (AsyncMasterTcp *c : m_connections) {
+        c->disconnectFromSlave();
+    }
+}
+
+
+int libmodbus_cpp::ParallelMasterTcp::getConnectedCount() const
+{
+    return static_cast<int>(std::count_if(m_connections.begin(), m_connections.end(), [](const AsyncMasterTcp *c) { return c->isConnected(); }));
+}
+
+
+int libmodbus_cpp::ParallelMasterTcp::getConnectionCount() const
+{
+    return m_connections.size();
+}
+
+
+void libmodbus_cpp::ParallelMasterTcp::setSlaveAddress(uint8_t address)
+{
+    for (AsyncMasterTcp *c : m_connections) {
+        c->setSlaveAddress(address);
+    }
+}
+
+
+void libmodbus_cpp::ParallelMasterTcp::setResponseTimeout(int timeout_ms)
+{
+    for (AsyncMasterTcp *c : m_connections) {
+        c->setResponseTimeout(timeout_ms);
+    }
+}
+
+
+void libmodbus_cpp::ParallelMasterTcp::setMaxInFlight(int count)
+{
+    for (AsyncMasterTcp *c : m_connections) {
+        c->setMaxInFlight(count);
+    }
+}
+
+
+void libmodbus_cpp::ParallelMasterTcp::setMaxChunkRegisters(int count)
+{
+    m_maxChunkRegisters = std::max(1, std::min(count, static_cast<int>(MODBUS_MAX_READ_REGISTERS)));
+}
+
+
+libmodbus_cpp::AsyncReply<QVector<bool>> libmodbus_cpp::ParallelMasterTcp::readCoils(Address address, int count)
+{
+    return read<bool>(address, count, std::min(m_maxChunkRegisters * 16, static_cast<int>(MODBUS_MAX_READ_BITS)),
+                      [](AsyncMasterTcp *c, Address a, int n) { return c->readCoils(a, n); });
+}
+
+
+libmodbus_cpp::AsyncReply<QVector<bool>> libmodbus_cpp::ParallelMasterTcp::readDiscreteInputs(Address address, int count)
+{
+    return read<bool>(address, count, std::min(m_maxChunkRegisters * 16, static_cast<int>(MODBUS_MAX_READ_BITS)),
+                      [](AsyncMasterTcp *c, Address a, int n) { return c->readDiscreteInputs(a, n); });
+}
+
+
+libmodbus_cpp::AsyncReply<QVector<uint16_t>> libmodbus_cpp::ParallelMasterTcp::readHoldingRegisters(Address address, int count)
+{
+    return read<uint16_t>(address, count, m_maxChunkRegisters,
+                          [](AsyncMasterTcp *c, Address a, int n) { return c->readHoldingRegisters(a, n); });
+}
+
+
+libmodbus_cpp::AsyncReply<QVector<uint16_t>> libmodbus_cpp::ParallelMasterTcp::readInputRegisters(Address address, int count)
+{
+    return read<uint16_t>(address, count, m_maxChunkRegisters,
+                          [](AsyncMasterTcp *c, Address a, int n) { return c->readInputRegisters(a, n); });
+}
+
+
+QVector<libmodbus_cpp::ParallelMasterTcp::Chunk> libmodbus_cpp::ParallelMasterTcp::split(Address address, int count, int maxChunk)
+{
+    QVector<Chunk> res;
+    if (maxChunk <= 0) {
+        return res;
+    }
+    res.reserve((count + maxChunk - 1) / maxChunk);
+    for (int done = 0; done < count; done += maxChunk) {
+        res.append(Chunk(static_cast<Address>(address + done), std::min(maxChunk, count - done)));
+    }
+    return res;
+}
+
+
+template<typename T>
+libmodbus_cpp::AsyncReply<QVector<T>> libmodbus_cpp::ParallelMasterTcp::read(Address address, int count, int maxChunk, Issue<T> issue)
+{
+    AsyncReply<QVector<T>> reply;
+    if ((count <= 0) || (address + count > 0x10000)) {
+        reply.fail(std::make_exception_ptr(RemoteReadError(modbus_strerror(EMBMDATA))));
+        return reply;
+    }
+
+    struct State {
+        QVector<T> result;
+        int remaining;
+        bool failed = false;
+    };
+    const QVector<Chunk> chunks = split(address, count, maxChunk);
+    const std::shared_ptr<State> state = std::make_shared<State>();
+    state->result.resize(count);
+    state->remaining = chunks.size();
+    LMB_DGLOG(LDOM_PMTCP, "read of" << count << "items in" << chunks.size() << "chunks");
+
+    for (const Chunk &chunk : chunks) {
+        const int offset = chunk.first - address;
+        const int i = nextConnection();
+        ++m_load[i];
+        issue(m_connections[i], chunk.first, chunk.second).onFinished([this, state, reply, i, offset](const AsyncReply<QVector<T>> &part) mutable {
+            --m_load[i];
+            if (state->failed) {
+                return;
+            }
+            if (part.hasError()) {
+                state->failed = true;
+                try {
+                    part.result();
+                } catch (...) {
+                    reply.fail(std::current_exception());
+                }
+                return;
+            }
+            const QVector<T> items = part.result();
+            std::copy(items.begin(), items.end(), state->result.begin() + offset);
+            if (--state->remaining == 0) {
+                reply.finish(state->result);
+            }
+        });
+    }
+    return reply;
+}
+
+
+int libmodbus_cpp::ParallelMasterTcp::nextConnection() const
+{
+    // connected ones take all chunks, others queue them until connected
+    int best = -1;
+    bool bestConnected = false;
+    for (int i = 0; i < m_connections.size(); ++i) {
+        const bool connected = m_connections[i]->isConnected();
+        if ((best < 0) || (connected && !bestConnected) || ((connected == bestConnected) && (m_load[i] < m_load[best]))) {
+            best = i;
+            bestConnected = connected;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,66 @@
+#ifndef LIBMODBUS_CPP_PARALLEL_MASTER_TCP_H_GUARD
+#define LIBMODBUS_CPP_PARALLEL_MASTER_TCP_H_GUARD
+
+#include <QObject>
+#include <QVector>
+#include <QPair>
+#include "async_master_tcp.h"
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief bulk reads of one device over several TCP connections at once
+ * Read of any size is split into chunks of one PDU, chunks are issued in parallel over
+ * connected connections (least loaded first) and reassembled into one vector. First failed
+ * chunk fails whole read. Device must accept connectionCount concurrent connections.
+ * Lives in thread of its connections, as AsyncMasterTcp.
+ */
+class ParallelMasterTcp : public QObject
+{
+    Q_OBJECT
+
+public:
+    /// address and count of chunk
+    using Chunk = QPair<Address, int>;
+
+    ParallelMasterTcp(const QString &host, quint16 port, int connectionCount, QObject *parent = Q_NULLPTR);
+    ~ParallelMasterTcp() override;
+
+    void connectToSlave();
+    void disconnectFromSlave();
+    int getConnectedCount() const;
+    int getConnectionCount() const;
+
+    void setSlaveAddress(uint8_t address);
+    void setResponseTimeout(int timeout_ms);
+    /// requests pipelined on each connection
+    void setMaxInFlight(int count);
+    /// registers (or bits / 16) per request, less than PDU for devices with smaller buffers
+    void setMaxChunkRegisters(int count);
+
+    AsyncReply<QVector<bool>> readCoils(Address address, int count);
+    AsyncReply<QVector<bool>> readDiscreteInputs(Address address, int count);
+    AsyncReply<QVector<uint16_t>> readHoldingRegisters(Address address, int count);
+    AsyncReply<QVector<uint16_t>> readInputRegisters(Address address, int count);
+
+    static QVector<Chunk> split(Address address, int count, int maxChunk);
+
+private:
+    template<typename T>
+    using Issue = std::function<AsyncReply<QVector<T>>(AsyncMasterTcp *connection, Address address, int count)>;
+
+    template<typename T>
+    AsyncReply<QVector<T>> read(Address address, int count, int maxChunk, Issue<T> issue);
+    /// index of connection for next chunk
+    int nextConnection() const;
+
+    QVector<AsyncMasterTcp*> m_connections;
+    QVector<int> m_load; // chunks in flight per connection
+    int m_maxChunkRegisters = MODBUS_MAX_READ_REGISTERS;
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_PARALLEL_MASTER_TCP_H_GUARD
@@ -0,0 +1,395 @@
+#ifndef LIBMODBUS_CPP_PDU_H_GUARD
+#define LIBMODBUS_CPP_PDU_H_GUARD
+
+#include <cstdint>
+#include <cstring>
+#include <modbus/modbus.h>
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief validated view of request ADU, nothing is copied or allocated
+ * Frame is parsed once: hooks, change tracking and reply generation work on fields of view.
+ * Header is MBAP (7 bytes) for TCP and slave address (1 byte) for RTU.
+ * RTU frame is parsed with its CRC (already checked by libmodbus), so length of PDU checks
+ * includes 2 trailing bytes there.
+ */
+struct RequestView {
+    const uint8_t *adu = nullptr;
+    int headerLength = 0;
+    int length = 0;             // of whole frame as received: with CRC for RTU
+
+    uint8_t unit = 0;           // MBAP unit id for TCP, slave address for RTU
+    uint8_t function = 0;
+    uint16_t address = 0;       // read address for FC23
+    uint16_t count = 0;         // read count for FC23, 1 for single item functions
+    uint16_t writeAddress = 0;  // FC23 only
+    uint16_t writeCount = 0;    // FC23 only
+    uint16_t value = 0;         // FC5, FC6; AND mask for FC22
+    uint16_t orMask = 0;        // FC22
+    const uint8_t *data = nullptr; // packed values of FC15, FC16, FC23
+    uint8_t exception = 0;      // exception code of reply, 0 if request is valid
+    bool supported = false;     // standard function, others are left to modbus_reply()
+
+    static uint16_t u16(const uint8_t *p) {
+        return static_cast<uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    /// false if function is not standard or frame holds no function. Standard function with frame
+    /// too short for its counts gets exception ILLEGAL_DATA_VALUE, its items are never read
+    bool parse(const uint8_t *frame, int frameLength, int frameHeaderLength) {
+        adu = frame;
+        length = frameLength;
+        headerLength = frameHeaderLength;
+        unit = 0;
+        function = 0;
+        address = 0;
+        count = 0;
+        writeAddress = 0;
+        writeCount = 0;
+        value = 0;
+        orMask = 0;
+        data = nullptr;
+        exception = 0;
+        supported = parseFields();
+        return supported;
+    }
+
+    static bool isStandard(uint8_t function) {
+        switch (function) {
+            case MODBUS_FC_READ_COILS:
+            case MODBUS_FC_READ_DISCRETE_INPUTS:
+            case MODBUS_FC_READ_HOLDING_REGISTERS:
+            case MODBUS_FC_READ_INPUT_REGISTERS:
+            case MODBUS_FC_WRITE_SINGLE_COIL:
+            case MODBUS_FC_WRITE_SINGLE_REGISTER:
+            case MODBUS_FC_WRITE_MULTIPLE_COILS:
+            case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+            case MODBUS_FC_MASK_WRITE_REGISTER:
+            case MODBUS_FC_WRITE_AND_READ_REGISTERS:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+private:
+    /// frames cut by MBAP length (compact and io_uring servers) may end before data of function
+    bool truncated() {
+        count = 0;
+        writeCount = 0;
+        data = nullptr;
+        exception = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+        return true;
+    }
+
+    bool parseFields() {
+        if (length <= headerLength) {
+            return false;
+        }
+        const uint8_t *pdu = adu + headerLength;
+        const int pduLength = length - headerLength;
+
+        unit = adu[headerLength - 1];
+        function = pdu[0];
+        if (!isStandard(function)) {
+            return false;
+        }
+        if (pduLength < 3) {
+            return truncated();
+        }
+        address = u16(pdu + 1);
+        if (pduLength < 5) {
+            return truncated();
+        }
+
+        switch (function) {
+            case MODBUS_FC_READ_COILS:
+            case MODBUS_FC_READ_DISCRETE_INPUTS:
+                count = u16(pdu + 3);
+                if ((count < 1) || (count > MODBUS_MAX_READ_BITS)) {
+                    exception = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+                }
+                return true;
+            case MODBUS_FC_READ_HOLDING_REGISTERS:
+            case MODBUS_FC_READ_INPUT_REGISTERS:
+                count = u16(pdu + 3);
+                if ((count < 1) || (count > MODBUS_MAX_READ_REGISTERS)) {
+                    exception = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+                }
+                return true;
+            case MODBUS_FC_WRITE_SINGLE_COIL:
+                count = 1;
+                value = u16(pdu + 3);
+                if ((value != 0xFF00) && (value != 0x0000)) {
+                    exception = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+                }
+                return true;
+            case MODBUS_FC_WRITE_SINGLE_REGISTER:
+                count = 1;
+                value = u16(pdu + 3);
+                return true;
+            case MODBUS_FC_WRITE_MULTIPLE_COILS: {
+                if (pduLength < 6) {
+                    return truncated();
+                }
+                count = u16(pdu + 3);
+                const int byteCount = pdu[5];
+                if (pduLength < 6 + byteCount) {
+                    return truncated();
+                }
+                data = pdu + 6;
+                if ((count < 1) || (count > MODBUS_MAX_WRITE_BITS) || (byteCount != (count + 7) / 8)) {
+                    exception = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+                }
+                return true;
+            }
+            case MODBUS_FC_WRITE_MULTIPLE_REGISTERS: {
+                if (pduLength < 6) {
+                    return truncated();
+                }
+                count = u16(pdu + 3);
+                const int byteCount = pdu[5];
+                if (pduLength < 6 + byteCount) {
+                    return truncated();
+                }
+                data = pdu + 6;
+                if ((count < 1) || (count > MODBUS_MAX_WRITE_REGISTERS) || (byteCount != count * 2)) {
+                    exception = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+                }
+                return true;
+            }
+            case MODBUS_FC_MASK_WRITE_REGISTER:
+                if (pduLength < 7) {
+                    return truncated();
+                }
+                count = 1;
+                value = u16(pdu + 3);
+                orMask = u16(pdu + 5);
+                return true;
+            case MODBUS_FC_WRITE_AND_READ_REGISTERS: {
+                if (pduLength < 10) {
+                    return truncated();
+                }
+                count = u16(pdu + 3);
+                writeAddress = u16(pdu + 5);
+                writeCount = u16(pdu + 7);
+                const int byteCount = pdu[9];
+                if (pduLength < 10 + byteCount) {
+                    return truncated();
+                }
+                data = pdu + 10;
+                if ((writeCount < 1) || (writeCount > MODBUS_MAX_WR_WRITE_REGISTERS) ||
+                        (count < 1) || (count > MODBUS_MAX_WR_READ_REGISTERS) ||
+                        (byteCount != writeCount * 2)) {
+                    exception = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+                }
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+};
+
+
+/**
+ * @brief reply for standard functions written into caller buffer, same semantics as modbus_reply()
+ * Buffer must hold MODBUS_MAX_ADU_LENGTH bytes. Returns ADU length without checksum: header is
+ * copied from request (MBAP length is filled), checksum is left to backend send_msg_pre.
+ * With wireOrder register tables are big-endian (RegisterStorage::WireOrder) and are copied as is.
+ */
+class ResponseBuilder
+{
+    uint8_t *m_rsp;
+    int m_length;
+    bool m_wireOrder;
+
+public:
+    explicit ResponseBuilder(uint8_t *rsp, bool wireOrder = false) : m_rsp(rsp), m_length(0), m_wireOrder(wireOrder) {}
+
+    int build(const RequestView &req, modbus_mapping_t *map) {
+        memcpy(m_rsp, req.adu, req.headerLength);
+        m_length = req.headerLength;
+
+        if (req.exception) {
+            return exception(req, req.exception);
+        }
+
+        switch (req.function) {
+            case MODBUS_FC_READ_COILS:
+                return readBits(req, map->tab_bits, map->nb_bits, map->offset_bits);
+            case MODBUS_FC_READ_DISCRETE_INPUTS:
+                return readBits(req, map->tab_input_bits, map->nb_input_bits, map->offset_input_bits);
+            case MODBUS_FC_READ_HOLDING_REGISTERS:
+                return readRegisters(req, req.address, map->tab_registers, map->nb_registers, map->offset_registers);
+            case MODBUS_FC_READ_INPUT_REGISTERS:
+                return readRegisters(req, req.address, map->tab_input_registers, map->nb_input_registers, map->offset_input_registers);
+            case MODBUS_FC_WRITE_SINGLE_COIL: {
+                const int i = index(req.address, 1, map->nb_bits, map->offset_bits);
+                if (i < 0) {
+                    return exception(req, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+                }
+                map->tab_bits[i] = (req.value == 0xFF00) ? 1 : 0;
+                return echo(req, 5);
+            }
+            case MODBUS_FC_WRITE_SINGLE_REGISTER: {
+                const int i = index(req.address, 1, map->nb_registers, map->offset_registers);
+                if (i < 0) {
+                    return exception(req, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+                }
+                storeRegister(map->tab_registers + i, req.value);
+                return echo(req, 5);
+            }
+            case MODBUS_FC_WRITE_MULTIPLE_COILS: {
+                const int first = index(req.address, req.count, map->nb_bits, map->offset_bits);
+                if (first < 0) {
+                    return exception(req, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+                }
+                for (int i = 0; i < req.count; ++i) {
+                    map->tab_bits[first + i] = (req.data[i >> 3] >> (i & 7)) & 1;
+                }
+                return echo(req, 5);
+            }
+            case MODBUS_FC_WRITE_MULTIPLE_REGISTERS: {
+                const int first = index(req.address, req.count, map->nb_registers, map->offset_registers);
+                if (first < 0) {
+                    return exception(req, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+                }
+                storeRegisters(map->tab_registers + first, req.data, req.count);
+                return echo(req, 5);
+            }
+            case MODBUS_FC_MASK_WRITE_REGISTER: {
+                const int i = index(req.address, 1, map->nb_registers, map->offset_registers);
+                if (i < 0) {
+                    return exception(req, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+                }
+                const uint16_t v = loadRegister(map->tab_registers + i);
+                storeRegister(map->tab_registers + i, (v & req.value) | (req.orMask & ~req.value));
+                return echo(req, 7);
+            }
+            case MODBUS_FC_WRITE_AND_READ_REGISTERS: {
+                const int w = index(req.writeAddress, req.writeCount, map->nb_registers, map->offset_registers);
+                if ((w < 0) || (index(req.address, req.count, map->nb_registers, map->offset_registers) < 0)) {
+                    return exception(req, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+                }
+                // write is done before read
+                storeRegisters(map->tab_registers + w, req.data, req.writeCount);
+                return readRegisters(req, req.address, map->tab_registers, map->nb_registers, map->offset_registers);
+            }
+            default:
+                return exception(req, MODBUS_EXCEPTION_ILLEGAL_FUNCTION);
+        }
+    }
+
+private:
+    /// index in table or -1 if range is out of map
+    static int index(int address, int count, int nb, int offset) {
+        const int i = address - offset;
+        return ((i < 0) || (i + count > nb)) ? -1 : i;
+    }
+
+    uint16_t loadRegister(const uint16_t *reg) const {
+        return m_wireOrder ? RequestView::u16(reinterpret_cast<const uint8_t *>(reg)) : *reg;
+    }
+
+    void storeRegister(uint16_t *reg, uint16_t value) const {
+        if (m_wireOrder) {
+            uint8_t *d = reinterpret_cast<uint8_t *>(reg);
+            d[0] = static_cast<uint8_t>(value >> 8);
+            d[1] = static_cast<uint8_t>(value & 0xFF);
+        } else {
+            *reg = value;
+        }
+    }
+
+    /// from big-endian request data
+    void storeRegisters(uint16_t *regs, const uint8_t *data, int count) const {
+        if (m_wireOrder) {
+            memcpy(regs, data, 2 * count);
+            return;
+        }
+        for (int i = 0; i < count; ++i) {
+            regs[i] = RequestView::u16(data + 2 * i);
+        }
+    }
+
+    void put(uint8_t byte) {
+        m_rsp[m_length++] = byte;
+    }
+
+    void putU16(uint16_t value) {
+        m_rsp[m_length++] = static_cast<uint8_t>(value >> 8);
+        m_rsp[m_length++] = static_cast<uint8_t>(value & 0xFF);
+    }
+
+    int finish(const RequestView &req) {
+        if (req.headerLength == 7) {
+            // MBAP protocol id and length of unit + PDU
+            m_rsp[2] = 0;
+            m_rsp[3] = 0;
+            m_rsp[4] = static_cast<uint8_t>((m_length - 6) >> 8);
+            m_rsp[5] = static_cast<uint8_t>((m_length - 6) & 0xFF);
+        }
+        return m_length;
+    }
+
+    int exception(const RequestView &req, uint8_t code) {
+        put(req.function | 0x80);
+        put(code);
+        return finish(req);
+    }
+
+    int echo(const RequestView &req, int pduLength) {
+        memcpy(m_rsp + m_length, req.adu + req.headerLength, pduLength);
+        m_length += pduLength;
+        return finish(req);
+    }
+
+    int readBits(const RequestView &req, const uint8_t *table, int nb, int offset) {
+        const int first = index(req.address, req.count, nb, offset);
+        if (first < 0) {
+            return exception(req, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+        }
+        put(req.function);
+        put(static_cast<uint8_t>((req.count + 7) / 8));
+        uint8_t byte = 0;
+        int shift = 0;
+        for (int i = 0; i < req.count; ++i) {
+            byte |= (table[first + i] ? 1 : 0) << shift;
+            if (++shift == 8) {
+                put(byte);
+                byte = 0;
+                shift = 0;
+            }
+        }
+        if (shift) {
+            put(byte);
+        }
+        return finish(req);
+    }
+
+    int readRegisters(const RequestView &req, uint16_t address, const uint16_t *table, int nb, int offset) {
+        const int first = index(address, req.count, nb, offset);
+        if (first < 0) {
+            return exception(req, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+        }
+        put(req.function);
+        put(static_cast<uint8_t>(req.count * 2));
+        if (m_wireOrder) {
+            memcpy(m_rsp + m_length, table + first, 2 * req.count);
+            m_length += 2 * req.count;
+            return finish(req);
+        }
+        for (int i = 0; i < req.count; ++i) {
+            putU16(table[first + i]);
+        }
+        return finish(req);
+    }
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_PDU_H_GUARD
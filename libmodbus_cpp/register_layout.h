@@ -0,0 +1,189 @@
+#ifndef LIBMODBUS_CPP_REGISTER_LAYOUT_H_GUARD
+#define LIBMODBUS_CPP_REGISTER_LAYOUT_H_GUARD
+
+#include <cstdint>
+#include <type_traits>
+#include "defs.h"
+
+namespace libmodbus_cpp {
+
+
+/// word order of layout field, Target is order passed to codec (target byte order of slave or master)
+enum class FieldOrder {
+    Target,
+    LittleEndian,
+    BigEndian
+};
+
+
+namespace layout_detail {
+
+inline bool isNativeLittleEndian() {
+    const uint16_t x = 1;
+    return *reinterpret_cast<const uint8_t *>(&x) == 1;
+}
+
+template<int Size, bool Reverse, bool SwapPairs>
+inline void copyOrdered(const uint8_t *s, uint8_t *d) {
+    for (int i = 0; i < Size; ++i) {
+        const int k = SwapPairs ? (i ^ 1) : i;
+        d[i] = s[Reverse ? (Size - 1 - k) : k];
+    }
+}
+
+/// same permutation as registerMemoryCopy (it is involution), size is known at compile time
+/// and permutation is resolved once, so compiler turns loop into byte swaps
+template<int Size>
+inline void copyOrdered(const void *source, void *distance, bool reverse, bool swapPairs) {
+    const uint8_t *s = static_cast<const uint8_t *>(source);
+    uint8_t *d = static_cast<uint8_t *>(distance);
+    if (Size < 2) {
+        d[0] = s[0];
+    } else if (reverse) {
+        swapPairs ? copyOrdered<Size, true, true>(s, d) : copyOrdered<Size, true, false>(s, d);
+    } else {
+        swapPairs ? copyOrdered<Size, false, true>(s, d) : copyOrdered<Size, false, false>(s, d);
+    }
+}
+
+struct Codec {
+    bool nativeLittleEndian;
+    ByteOrder target;
+    bool wireStorage; // registers are kept big-endian, see RegisterStorage
+
+    template<FieldOrder Order, int Size>
+    void encode(const void *value, void *regs) const {
+        copy<Order, Size, true>(value, regs);
+    }
+
+    template<FieldOrder Order, int Size>
+    void decode(const void *regs, void *value) const {
+        copy<Order, Size, false>(regs, value);
+    }
+
+private:
+    template<FieldOrder Order, int Size, bool ToRegs>
+    void copy(const void *source, void *distance) const {
+        if (Size < 2) {
+            // byte keeps its place in register value: other half of register memory if it is swapped
+            const int i = (wireStorage && nativeLittleEndian) ? 1 : 0;
+            static_cast<uint8_t *>(distance)[ToRegs ? i : 0] = static_cast<const uint8_t *>(source)[ToRegs ? 0 : i];
+            return;
+        }
+        const ByteOrder order = (Order == FieldOrder::Target) ? target
+                              : (Order == FieldOrder::LittleEndian) ? ByteOrder::LittleEndian : ByteOrder::BigEndian;
+        const bool nativeIsTarget = (order == ByteOrder::LittleEndian) == nativeLittleEndian;
+        if (Size % 2) {
+            copyOdd<Size, ToRegs>(source, distance, nativeIsTarget);
+            return;
+        }
+        // wire order registers are host order ones with swapped bytes on little endian host
+        copyOrdered<Size>(source, distance, !nativeIsTarget, nativeLittleEndian && !wireStorage);
+    }
+
+    /// bytes of value in target order fill registers, last one is placed as byte value and
+    /// other half of last register is padding which is kept
+    template<int Size, bool ToRegs>
+    void copyOdd(const void *source, void *distance, bool nativeIsTarget) const {
+        const uint8_t *s = static_cast<const uint8_t *>(source);
+        uint8_t *d = static_cast<uint8_t *>(distance);
+        const int high = (nativeLittleEndian && !wireStorage) ? 1 : 0; // in register memory
+        for (int j = 0; j < Size; ++j) {
+            const int v = nativeIsTarget ? j : (Size - 1 - j);
+            const int r = (j == Size - 1) ? (j + ((wireStorage && nativeLittleEndian) ? 1 : 0))
+                                          : ((j & ~1) + (((j & 1) == 0) ? high : 1 - high));
+            if (ToRegs) {
+                d[r] = s[v];
+            } else {
+                d[v] = s[r];
+            }
+        }
+    }
+};
+
+inline Codec makeCodec(ByteOrder target, RegisterStorage storage) {
+    return Codec { isNativeLittleEndian(), target, storage == RegisterStorage::WireOrder };
+}
+
+constexpr int maxOf() {
+    return 0;
+}
+
+template<typename... Ints>
+constexpr int maxOf(int first, Ints... rest) {
+    return first > maxOf(rest...) ? first : maxOf(rest...);
+}
+
+} // ns layout_detail
+
+
+/**
+ * @brief field of register layout: member of struct placed at register offset
+ * Use LMB_REGISTER_FIELD / LMB_REGISTER_FIELD_ORDERED to declare it.
+ */
+template<typename Struct, typename ValueType, ValueType Struct::*Member, Address Offset, FieldOrder Order = FieldOrder::Target>
+struct RegisterField {
+    static_assert(std::is_arithmetic<ValueType>::value || std::is_enum<ValueType>::value, "only arithmetic and enum fields are supported");
+
+    static const int RegCount = (sizeof(ValueType) + 1) / 2;
+    static const int End = Offset + RegCount;
+
+    static void encode(const Struct &value, uint16_t *regs, const layout_detail::Codec &codec) {
+        codec.encode<Order, sizeof(ValueType)>(&(value.*Member), regs + Offset);
+    }
+
+    static void decode(const uint16_t *regs, Struct &value, const layout_detail::Codec &codec) {
+        codec.decode<Order, sizeof(ValueType)>(regs + Offset, &(value.*Member));
+    }
+};
+
+
+/**
+ * @brief compile time description of register block mapped to struct
+ * Encoder and decoder move whole struct in one pass with byte order resolved once,
+ * result is the same as per-field setValueToHoldingRegister / getValueFromHoldingRegister.
+ *
+ *   struct Drive { float speed; uint16_t state; int32_t position; };
+ *   using DriveLayout = RegisterLayout<Drive,
+ *       LMB_REGISTER_FIELD(Drive, speed, 0),
+ *       LMB_REGISTER_FIELD(Drive, state, 2),
+ *       LMB_REGISTER_FIELD_ORDERED(Drive, position, 3, FieldOrder::BigEndian)>;
+ */
+template<typename Struct, typename... Fields>
+struct RegisterLayout {
+    using StructType = Struct;
+
+    /// registers occupied by block, from offset 0 to end of last field
+    static const int RegCount = layout_detail::maxOf(Fields::End...);
+
+    static void encode(const Struct &value, uint16_t *regs, ByteOrder target, RegisterStorage storage = RegisterStorage::HostOrder) {
+        const layout_detail::Codec codec = layout_detail::makeCodec(target, storage);
+        const int expand[] = { 0, (Fields::encode(value, regs, codec), 0)... };
+        (void)expand;
+    }
+
+    static void decode(const uint16_t *regs, Struct &value, ByteOrder target, RegisterStorage storage = RegisterStorage::HostOrder) {
+        const layout_detail::Codec codec = layout_detail::makeCodec(target, storage);
+        const int expand[] = { 0, (Fields::decode(regs, value, codec), 0)... };
+        (void)expand;
+    }
+
+    static Struct decode(const uint16_t *regs, ByteOrder target, RegisterStorage storage = RegisterStorage::HostOrder) {
+        Struct value = Struct();
+        decode(regs, value, target, storage);
+        return value;
+    }
+};
+
+
+} // ns
+
+
+#define LMB_REGISTER_FIELD(StructType, member, offset) \
+    libmodbus_cpp::RegisterField<StructType, decltype(StructType::member), &StructType::member, offset>
+
+#define LMB_REGISTER_FIELD_ORDERED(StructType, member, offset, order) \
+    libmodbus_cpp::RegisterField<StructType, decltype(StructType::member), &StructType::member, offset, order>
+
+
+#endif // LIBMODBUS_CPP_REGISTER_LAYOUT_H_GUARD
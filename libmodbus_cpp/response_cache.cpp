@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cstring>
+#include <libmodbus_cpp/response_cache.h>
+#include <libmodbus_cpp/mapping_wrapper.h>
+#include <libmodbus_cpp/pdu.h>
+
+
+namespace {
+
+using namespace libmodbus_cpp;
+
+template<DataType T>
+int countOf(const modbus_mapping_t *map) {
+    return MappingWrapper<T>(const_cast<modbus_mapping_t *>(map)).count();
+}
+
+}
+
+
+const int libmodbus_cpp::ResponseCache::BlockSize;
+
+
+libmodbus_cpp::ResponseCache::ResponseCache(const modbus_mapping_t *map, int maxEntries)
+    : m_maxEntries(std::max(maxEntries, 1))
+{
+    m_tables[static_cast<int>(DataType::Coil)].count            = countOf<DataType::Coil>(map);
+    m_tables[static_cast<int>(DataType::DiscreteInput)].count   = countOf<DataType::DiscreteInput>(map);
+    m_tables[static_cast<int>(DataType::HoldingRegister)].count = countOf<DataType::HoldingRegister>(map);
+    m_tables[static_cast<int>(DataType::InputRegister)].count   = countOf<DataType::InputRegister>(map);
+
+    for (Table &t : m_tables) {
+        t.blockCount = (t.count + BlockSize - 1) / BlockSize;
+        t.generations.reset(new std::atomic<quint64>[std::max(t.blockCount, 1)]);
+        for (int i = 0; i < t.blockCount; ++i) {
+            t.generations[i].store(0, std::memory_order_relaxed);
+        }
+    }
+    m_order.reserve(m_maxEntries);
+}
+
+
+bool libmodbus_cpp::ResponseCache::typeOf(uint8_t function, DataType &type)
+{
+    switch (function) {
+        case MODBUS_FC_READ_COILS:
+            type = DataType::Coil;
+            return true;
+        case MODBUS_FC_READ_DISCRETE_INPUTS:
+            type = DataType::DiscreteInput;
+            return true;
+        case MODBUS_FC_READ_HOLDING_REGISTERS:
+            type = DataType::HoldingRegister;
+            return true;
+        case MODBUS_FC_READ_INPUT_REGISTERS:
+            type = DataType::InputRegister;
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+quint64 libmodbus_cpp::ResponseCache::keyOf(const RequestView &req)
+{
+    return (quint64(req.function) << 32) | (quint64(req.address) << 16) | req.count;
+}
+
+
+int libmodbus_cpp::ResponseCache::lookup(const RequestView &req, uint8_t *rsp)
+{
+    DataType type;
+    if (!req.supported || req.exception || !typeOf(req.function, type)) {
+        return 0;
+    }
+
+    int length = 0;
+    {
+        QReadLocker lock(&m_lock);
+        const auto it = m_entries.constFind(keyOf(req));
+        if ((it != m_entries.constEnd()) && (it.value().stamp == stamp(type, req.address, req.count))) {
+            // header of request: transaction id of MBAP or slave address of RTU
+            memcpy(rsp, req.adu, req.headerLength);
+            memcpy(rsp + req.headerLength, it.value().pdu.constData(), it.value().pdu.size());
+            length = req.headerLength + it.value().pdu.size();
+        }
+    }
+
+    if (length == 0) {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+    if (req.headerLength == 7) {
+        rsp[2] = 0;
+        rsp[3] = 0;
+        rsp[4] = static_cast<uint8_t>((length - 6) >> 8);
+        rsp[5] = static_cast<uint8_t>((length - 6) & 0xFF);
+    }
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+    return length;
+}
+
+
+quint64 libmodbus_cpp::ResponseCache::stamp(DataType type, Address from, int count) const
+{
+    const Table &t = table(type);
+    const int first = from / BlockSize;
+    const int last = std::min((from + count - 1) / BlockSize, t.blockCount - 1);
+    quint64 sum = 0;
+    for (int i = first; i <= last; ++i) {
+        sum += t.generations[i].load(std::memory_order_acquire);
+    }
+    return sum;
+}
+
+
+void libmodbus_cpp::ResponseCache::store(const RequestView &req, quint64 stamp, const uint8_t *rsp, int rspLength)
+{
+    DataType type;
+    if (!req.supported || req.exception || !typeOf(req.function, type) ||
+            (rspLength <= req.headerLength) || (rsp[req.headerLength] != req.function)) {
+        return;
+    }
+
+    const quint64 key = keyOf(req);
+    const QByteArray pdu(reinterpret_cast<const char *>(rsp + req.headerLength), rspLength - req.headerLength);
+
+    QWriteLocker lock(&m_lock);
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        // outdated one or same reply built by concurrent reader
+        m_bytes += pdu.size() - it.value().pdu.size();
+        it.value() = Entry { stamp, pdu };
+        return;
+    }
+
+    if (m_order.size() < m_maxEntries) {
+        m_order.append(key);
+    } else {
+        const auto oldest = m_entries.find(m_order[m_next]);
+        m_bytes -= oldest.value().pdu.size();
+        m_entries.erase(oldest);
+        m_order[m_next] = key;
+        m_next = (m_next + 1) % m_maxEntries;
+    }
+    m_entries.insert(key, Entry { stamp, pdu });
+    m_bytes += pdu.size();
+}
+
+
+void libmodbus_cpp::ResponseCache::markWritten(DataType type, Address from, int count)
+{
+    const Table &t = table(type);
+    if (count <= 0) {
+        return;
+    }
+    const int first = from / BlockSize;
+    const int last = std::min((from + count - 1) / BlockSize, t.blockCount - 1);
+    for (int i = first; i <= last; ++i) {
+        t.generations[i].fetch_add(1, std::memory_order_release);
+    }
+}
+
+
+libmodbus_cpp::ResponseCache::Stats libmodbus_cpp::ResponseCache::stats() const
+{
+    Stats s;
+    s.hits = m_hits.load(std::memory_order_relaxed);
+    s.misses = m_misses.load(std::memory_order_relaxed);
+    s.maxEntries = m_maxEntries;
+    QReadLocker lock(&m_lock);
+    s.entries = m_entries.size();
+    s.bytes = m_bytes;
+    return s;
+}
@@ -0,0 +1,90 @@
+#ifndef LIBMODBUS_CPP_RESPONSE_CACHE_H_GUARD
+#define LIBMODBUS_CPP_RESPONSE_CACHE_H_GUARD
+
+#include <atomic>
+#include <memory>
+#include <QByteArray>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QVector>
+#include "defs.h"
+
+namespace libmodbus_cpp {
+
+struct RequestView;
+
+
+/**
+ * @brief encoded read replies kept while items they cover are not written
+ * Map tables are split into blocks with generation counter bumped by every write to block.
+ * Reply PDU of (function, address, count) is cached with sum of generations of covered blocks:
+ * counters only grow, so sum is the same only if none of them was bumped.
+ * Cached reply is served by copying its PDU after header of request.
+ * Writes made bypassing slave (raw map pointer) must be reported by markWritten().
+ */
+class ResponseCache
+{
+public:
+    static const int BlockSize = 64; // items per generation counter
+
+    struct Stats {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        int entries = 0;
+        int maxEntries = 0;
+        qint64 bytes = 0; // of cached PDUs
+    };
+
+    ResponseCache(const modbus_mapping_t *map, int maxEntries);
+
+    int maxEntries() const {
+        return m_maxEntries;
+    }
+
+    /// reply of FC1-FC4 request into buffer of MODBUS_MAX_ADU_LENGTH, 0 if it is not cached or outdated
+    int lookup(const RequestView &req, uint8_t *rsp);
+    /// to be taken before reply is built from map, so write during build outdates it
+    quint64 stamp(DataType type, Address from, int count) const;
+    /// reply built by ResponseBuilder, exceptions are not cached
+    void store(const RequestView &req, quint64 stamp, const uint8_t *rsp, int rspLength);
+
+    void markWritten(DataType type, Address from, int count);
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        quint64 stamp;
+        QByteArray pdu;
+    };
+
+    struct Table {
+        int count = 0;
+        int blockCount = 0;
+        std::unique_ptr<std::atomic<quint64>[]> generations;
+    };
+
+    const Table &table(DataType type) const {
+        return m_tables[static_cast<int>(type)];
+    }
+
+    static bool typeOf(uint8_t function, DataType &type);
+    static quint64 keyOf(const RequestView &req);
+
+    const int m_maxEntries;
+    Table m_tables[4];
+
+    mutable QReadWriteLock m_lock;
+    QHash<quint64, Entry> m_entries;
+    QVector<quint64> m_order; // ring of keys in insertion order, oldest is evicted
+    int m_next = 0;
+    qint64 m_bytes = 0;
+
+    std::atomic<quint64> m_hits { 0 };
+    std::atomic<quint64> m_misses { 0 };
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_RESPONSE_CACHE_H_GUARD
@@ -0,0 +1,122 @@
+#ifndef LIBMODBUS_CPP_RTT_ESTIMATOR_H_GUARD
+#define LIBMODBUS_CPP_RTT_ESTIMATOR_H_GUARD
+
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+
+namespace libmodbus_cpp {
+
+
+/// retries of timed out requests of master, zero maxRetries turns them off
+struct RetryPolicy {
+    int maxRetries = 0;
+    /// retries are limited to this percent of requests, so master does not flood lost device
+    int budgetPercent = 10;
+    /// retries allowed at once, budget is refilled by requests
+    int burst = 3;
+};
+
+
+struct RttStats {
+    double srtt_ms = 0;     // smoothed round trip time
+    double rttvar_ms = 0;   // its mean deviation
+    int timeout_ms = 0;     // response timeout of next request
+    quint64 samples = 0;
+    quint64 timeouts = 0;
+    quint64 retries = 0;
+    quint64 retriesDenied = 0; // by budget
+};
+
+
+/**
+ * @brief response timeout derived from measured round trip times, as TCP RTO (RFC 6298)
+ * SRTT and RTTVAR are exponentially weighted (1/8, 1/4), timeout is SRTT + 4 RTTVAR within [min, max],
+ * max until first sample. Each timeout doubles it until next sample. Replies of retried requests
+ * are not sampled (Karn), they may answer the earlier attempt.
+ */
+class RttEstimator
+{
+    int m_min_ms = 1;
+    int m_max_ms = 500;
+    int m_backoff = 0;
+    bool m_hasSample = false;
+    RttStats m_stats;
+
+public:
+    void reset(int min_ms, int max_ms) {
+        m_min_ms = std::max(min_ms, 1);
+        m_max_ms = std::max(max_ms, m_min_ms);
+        m_backoff = 0;
+        m_hasSample = false;
+        m_stats = RttStats();
+    }
+
+    void sample(double rtt_ms) {
+        if (!m_hasSample) {
+            m_stats.srtt_ms = rtt_ms;
+            m_stats.rttvar_ms = rtt_ms / 2;
+            m_hasSample = true;
+        } else {
+            m_stats.rttvar_ms = 0.75 * m_stats.rttvar_ms + 0.25 * std::fabs(m_stats.srtt_ms - rtt_ms);
+            m_stats.srtt_ms = 0.875 * m_stats.srtt_ms + 0.125 * rtt_ms;
+        }
+        m_backoff = 0;
+        ++m_stats.samples;
+    }
+
+    void timedOut() {
+        m_backoff = std::min(m_backoff + 1, 16);
+        ++m_stats.timeouts;
+    }
+
+    int timeout_ms() const {
+        if (!m_hasSample) {
+            return m_max_ms;
+        }
+        // 1 ms is granularity of clock
+        const double rto = m_stats.srtt_ms + std::max(1.0, 4 * m_stats.rttvar_ms);
+        const double backedOff = std::ldexp(std::max<double>(rto, m_min_ms), m_backoff);
+        return static_cast<int>(std::min<double>(std::ceil(backedOff), m_max_ms));
+    }
+
+    RttStats stats() const {
+        RttStats s = m_stats;
+        s.timeout_ms = timeout_ms();
+        return s;
+    }
+
+    /// retry of timed out request, denied one by budget
+    void retried(bool granted) {
+        ++(granted ? m_stats.retries : m_stats.retriesDenied);
+    }
+};
+
+
+/// token bucket of RetryPolicy: request adds budgetPercent / 100, retry takes one
+class RetryBudget
+{
+    double m_tokens = 0;
+
+public:
+    void reset(const RetryPolicy &policy) {
+        m_tokens = policy.burst;
+    }
+
+    void request(const RetryPolicy &policy) {
+        m_tokens = std::min<double>(m_tokens + policy.budgetPercent / 100.0, policy.burst);
+    }
+
+    bool takeRetry() {
+        if (m_tokens < 1) {
+            return false;
+        }
+        m_tokens -= 1;
+        return true;
+    }
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_RTT_ESTIMATOR_H_GUARD
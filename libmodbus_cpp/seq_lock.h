@@ -0,0 +1,131 @@
+#ifndef LIBMODBUS_CPP_SEQ_LOCK_H_GUARD
+#define LIBMODBUS_CPP_SEQ_LOCK_H_GUARD
+
+#include <atomic>
+#include <thread>
+#include <cstdint>
+
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief sequence lock for register map
+ * Writer makes sequence odd while it modifies data, writers are serialized by this odd state.
+ * Readers never block writers: they copy data and retry if sequence was changed meanwhile.
+ * Sequence can be placed outside (e.g. in shared memory) to be used by other processes with same protocol.
+ * Write section is reentrant in its thread (e.g. setter called by other setter), reads of writer thread
+ * inside of it see data directly.
+ */
+class SeqLock
+{
+    static_assert(ATOMIC_INT_LOCK_FREE == 2, "lock free sequence is required");
+
+    std::atomic<uint32_t> m_ownSeq { 0 };
+    std::atomic<uint32_t> *m_seq = &m_ownSeq;
+    std::atomic<std::thread::id> m_writer { std::thread::id() }; // only writer thread may see own id
+    int m_depth = 0; // of nested write sections, used by writer thread only
+
+    bool isWriter() const {
+        return m_writer.load(std::memory_order_relaxed) == std::this_thread::get_id();
+    }
+
+public:
+    /// nil to use own sequence
+    void attach(std::atomic<uint32_t> *seq) {
+        m_seq = seq ? seq : &m_ownSeq;
+    }
+
+    void lockWrite() {
+        if (isWriter()) {
+            ++m_depth;
+            return;
+        }
+        uint32_t seq = m_seq->load(std::memory_order_relaxed);
+        while ((seq & 1) || !m_seq->compare_exchange_weak(seq, seq + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+            std::this_thread::yield();
+            seq = m_seq->load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        m_writer.store(std::this_thread::get_id(), std::memory_order_relaxed);
+        m_depth = 1;
+    }
+
+    void unlockWrite() {
+        if (--m_depth > 0) {
+            return;
+        }
+        m_writer.store(std::thread::id(), std::memory_order_relaxed);
+        m_seq->fetch_add(1, std::memory_order_release);
+    }
+
+    uint32_t readBegin() const {
+        uint32_t seq = m_seq->load(std::memory_order_acquire);
+        while (seq & 1) {
+            std::this_thread::yield();
+            seq = m_seq->load(std::memory_order_acquire);
+        }
+        return seq;
+    }
+
+    bool readRetry(uint32_t seq) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return m_seq->load(std::memory_order_relaxed) != seq;
+    }
+
+    uint32_t sequence() const {
+        return m_seq->load(std::memory_order_acquire);
+    }
+
+    template<typename Func>
+    void read(Func func) const {
+        if (isWriter()) {
+            func(); // nobody else writes, own sequence is odd
+            return;
+        }
+        uint32_t seq;
+        do {
+            seq = readBegin();
+            func();
+        } while (readRetry(seq));
+    }
+};
+
+
+/// no-op if lock is nil
+class SeqLockWriteGuard
+{
+    SeqLock *m_lock;
+
+public:
+    explicit SeqLockWriteGuard(SeqLock *lock) : m_lock(lock) {
+        if (m_lock) {
+            m_lock->lockWrite();
+        }
+    }
+
+    ~SeqLockWriteGuard() {
+        if (m_lock) {
+            m_lock->unlockWrite();
+        }
+    }
+
+    SeqLockWriteGuard(const SeqLockWriteGuard&) = delete;
+    SeqLockWriteGuard& operator=(const SeqLockWriteGuard&) = delete;
+};
+
+
+template<typename Func>
+inline void seqLockRead(const SeqLock *lock, Func func) {
+    if (lock) {
+        lock->read(func);
+    } else {
+        func();
+    }
+}
+
+
+} // ns
+
+
+#endif // LIBMODBUS_CPP_SEQ_LOCK_H_GUARD
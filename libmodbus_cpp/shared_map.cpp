@@ -0,0 +1,153 @@
+#ifndef _WIN32
+
+#include <new>
+#include <errno.h>
+#include <sys/file.h>
+#include <libmodbus_cpp/shared_map.h>
+#include "logger.h"
+
+#define LDOM_SHM "[modbus.slave.shm]"
+
+
+libmodbus_cpp::SharedMap::SharedMap(const char *name)
+    : m_name(name)
+{
+    memset(&m_map, 0, sizeof(m_map));
+}
+
+
+libmodbus_cpp::SharedMap::~SharedMap()
+{
+    close();
+}
+
+
+bool libmodbus_cpp::SharedMap::open(int holdingBitsCount, int inputBitsCount, int holdingRegistersCount, int inputRegistersCount)
+{
+    close();
+
+    int32_t counts[4];
+    counts[SharedCoils]            = holdingBitsCount;
+    counts[SharedDiscreteInputs]   = inputBitsCount;
+    counts[SharedHoldingRegisters] = holdingRegistersCount;
+    counts[SharedInputRegisters]   = inputRegistersCount;
+
+    int32_t layoutCounts[4];
+    uint32_t layoutOffsets[4];
+    const uint64_t size = SharedMapHeader::layout(counts, layoutCounts, layoutOffsets);
+
+    // try to reuse existing segment
+    int fd = shm_open(m_name.c_str(), O_RDWR, 0);
+    if (fd != -1) {
+        struct stat st;
+        const bool sameSize = (fstat(fd, &st) == 0) && (static_cast<uint64_t>(st.st_size) == size);
+        if (sameSize && mapSegment(fd, size)) {
+            SharedMapHeader *h = header();
+            const bool sameLayout =
+                    (h->magic == SharedMapHeader::Magic) &&
+                    (h->version == SharedMapHeader::CurrentVersion) &&
+                    (h->byteOrderMark == SharedMapHeader::ByteOrderMark) &&
+                    (h->size == size) &&
+                    (memcmp(h->counts, layoutCounts, sizeof(layoutCounts)) == 0) &&
+                    (memcmp(h->offsets, layoutOffsets, sizeof(layoutOffsets)) == 0);
+            if (!sameLayout) {
+                close();
+            } else if (flock(fd, LOCK_EX | LOCK_NB) == 0) {
+                // nobody else has segment open, so odd sequence is left by writer died in write section, all would wait forever
+                uint32_t seq = h->seq.load(std::memory_order_acquire);
+                while ((seq & 1) && !h->seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acq_rel)) {
+                }
+            } else if (h->seq.load(std::memory_order_acquire) & 1) {
+                LMB_WGLOG(LDOM_SHM, "shared map is being written by other party:" << m_name.c_str());
+            }
+        }
+        if (m_data && (flock(fd, LOCK_SH) == 0)) {
+            m_fd = fd;
+        } else {
+            close();
+            ::close(fd);
+            LMB_WGLOG(LDOM_SHM, "shared map layout differs, recreate:" << m_name.c_str());
+            shm_unlink(m_name.c_str());
+        }
+    }
+
+    // create new one
+    if (!m_data) {
+        fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660);
+        if (fd == -1) {
+            LMB_WGLOG(LDOM_SHM, "can't create shared map:" << m_name.c_str() << strerror(errno));
+            return false;
+        }
+        const bool ok = (ftruncate(fd, size) == 0) && mapSegment(fd, size) && (flock(fd, LOCK_SH) == 0);
+        if (!ok) {
+            LMB_WGLOG(LDOM_SHM, "can't map shared map:" << m_name.c_str() << strerror(errno));
+            close();
+            ::close(fd);
+            shm_unlink(m_name.c_str());
+            return false;
+        }
+        m_fd = fd;
+
+        SharedMapHeader *h = new (m_data) SharedMapHeader;
+        h->magic = SharedMapHeader::Magic;
+        h->version = SharedMapHeader::CurrentVersion;
+        h->byteOrderMark = SharedMapHeader::ByteOrderMark;
+        h->reserved = 0;
+        h->seq.store(0, std::memory_order_relaxed);
+        memcpy(h->counts, layoutCounts, sizeof(layoutCounts));
+        memcpy(h->offsets, layoutOffsets, sizeof(layoutOffsets));
+        h->size = size;
+    }
+
+    const SharedMapHeader *h = header();
+    m_map.nb_bits             = h->counts[SharedCoils];
+    m_map.nb_input_bits       = h->counts[SharedDiscreteInputs];
+    m_map.nb_registers        = h->counts[SharedHoldingRegisters];
+    m_map.nb_input_registers  = h->counts[SharedInputRegisters];
+    m_map.tab_bits            = m_data + h->offsets[SharedCoils];
+    m_map.tab_input_bits      = m_data + h->offsets[SharedDiscreteInputs];
+    m_map.tab_registers       = reinterpret_cast<uint16_t *>(m_data + h->offsets[SharedHoldingRegisters]);
+    m_map.tab_input_registers = reinterpret_cast<uint16_t *>(m_data + h->offsets[SharedInputRegisters]);
+
+    return true;
+}
+
+
+void libmodbus_cpp::SharedMap::close()
+{
+    if (m_data) {
+        munmap(m_data, m_size);
+        m_data = nullptr;
+        m_size = 0;
+    }
+    memset(&m_map, 0, sizeof(m_map));
+    if (m_fd != -1) {
+        // last party removes segment (if name still refers to it), attached clients keep it for next run of slave
+        struct stat st;
+        if ((flock(m_fd, LOCK_EX | LOCK_NB) == 0) && (fstat(m_fd, &st) == 0) && (st.st_nlink > 0)) {
+            shm_unlink(m_name.c_str());
+        }
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+
+bool libmodbus_cpp::SharedMap::remove(const char *name)
+{
+    return shm_unlink(name) == 0;
+}
+
+
+bool libmodbus_cpp::SharedMap::mapSegment(int fd, size_t size)
+{
+    void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    m_data = static_cast<uint8_t *>(data);
+    m_size = size;
+    return true;
+}
+
+#endif // _WIN32
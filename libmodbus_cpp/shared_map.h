@@ -0,0 +1,53 @@
+#ifndef LIBMODBUS_CPP_SHARED_MAP_H_GUARD
+#define LIBMODBUS_CPP_SHARED_MAP_H_GUARD
+
+#ifndef _WIN32
+
+#include <string>
+#include "defs.h"
+#include "shared_map_client.h"
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief map tables in named POSIX shared memory segment
+ * Layout and sequence protocol are described in shared_map_client.h.
+ * Segment with same layout is reused, segment with other layout is unlinked and created again.
+ * Segment is unlinked by close() when no other party has it open, see shared_map_client.h.
+ */
+class SharedMap
+{
+    std::string m_name;
+    uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+    int m_fd = -1; // holds shared lock of party
+    modbus_mapping_t m_map;
+
+public:
+    explicit SharedMap(const char *name);
+    ~SharedMap();
+
+    bool open(int holdingBitsCount, int inputBitsCount, int holdingRegistersCount, int inputRegistersCount);
+    void close();
+
+    modbus_mapping_t *map() {
+        return m_data ? &m_map : nullptr;
+    }
+
+    SharedMapHeader *header() const {
+        return reinterpret_cast<SharedMapHeader *>(m_data);
+    }
+
+    static bool remove(const char *name);
+
+private:
+    bool mapSegment(int fd, size_t size);
+};
+
+
+} // ns
+
+#endif // _WIN32
+
+#endif // LIBMODBUS_CPP_SHARED_MAP_H_GUARD
@@ -0,0 +1,212 @@
+#ifndef LIBMODBUS_CPP_SHARED_MAP_CLIENT_H_GUARD
+#define LIBMODBUS_CPP_SHARED_MAP_CLIENT_H_GUARD
+
+/**
+ * Client side of slave map exported to POSIX shared memory by AbstractSlave::initSharedMap().
+ * Header only, depends on nothing but C++11 and POSIX.
+ *
+ * Segment layout:
+ *   SharedMapHeader at offset 0
+ *   tables in order: coils, discrete inputs, holding registers, input registers
+ *   each table starts at 8 byte aligned offset, bits take one byte each,
+ *   registers are uint16_t in host byte order (multiregister values use slave target byte order)
+ *
+ * Sequence protocol (seqlock over SharedMapHeader::seq):
+ *   writer: CAS seq from even to odd, modify tables, increment seq (even again)
+ *   reader: wait for even seq, copy data, retry if seq was changed
+ * Writer must not die inside of write section: all other parties wait for even seq.
+ *
+ * Lifetime:
+ *   each party holds shared flock() of segment while it has segment open.
+ *   Slave repairs odd seq of reused segment only if nobody else has it open (writer is surely dead),
+ *   slave closing segment unlinks it if nobody else has it open. Attached clients keep it for next run of slave.
+ */
+
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+namespace libmodbus_cpp {
+
+
+enum SharedMapTable {
+    SharedCoils = 0,
+    SharedDiscreteInputs,
+    SharedHoldingRegisters,
+    SharedInputRegisters
+};
+
+
+struct SharedMapHeader {
+    static const uint32_t Magic = 0x504D424C; // "LBMP"
+    static const uint32_t CurrentVersion = 1;
+    static const uint16_t ByteOrderMark = 0x0102;
+
+    uint32_t magic;
+    uint32_t version;
+    uint16_t byteOrderMark;     // ByteOrderMark in host order of slave
+    uint16_t reserved;
+    std::atomic<uint32_t> seq;  // odd while writer is active
+    int32_t  counts[4];         // indexed by SharedMapTable
+    uint32_t offsets[4];        // from segment start, indexed by SharedMapTable
+    uint64_t size;              // of whole segment
+
+    /// fills counts and offsets, returns segment size
+    static uint64_t layout(const int32_t counts[4], int32_t outCounts[4], uint32_t outOffsets[4]) {
+        uint64_t offset = (sizeof(SharedMapHeader) + 7u) & ~uint64_t(7u);
+        for (int i = 0; i < 4; ++i) {
+            const bool isRegister = (i == SharedHoldingRegisters) || (i == SharedInputRegisters);
+            outCounts[i] = counts[i];
+            outOffsets[i] = static_cast<uint32_t>(offset);
+            offset = (offset + counts[i] * (isRegister ? sizeof(uint16_t) : sizeof(uint8_t)) + 7u) & ~uint64_t(7u);
+        }
+        return offset;
+    }
+
+    static int itemSize(SharedMapTable table) {
+        return ((table == SharedHoldingRegisters) || (table == SharedInputRegisters)) ? sizeof(uint16_t) : sizeof(uint8_t);
+    }
+};
+
+
+class SharedMapClient
+{
+    uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+    int m_fd = -1;
+
+public:
+    SharedMapClient() {}
+    ~SharedMapClient() {
+        close();
+    }
+
+    SharedMapClient(const SharedMapClient&) = delete;
+    SharedMapClient& operator=(const SharedMapClient&) = delete;
+
+    /// name as passed to initSharedMap, e.g. "/my_slave"
+    bool open(const char *name) {
+        close();
+
+        const int fd = shm_open(name, O_RDWR, 0);
+        if (fd == -1) {
+            return false;
+        }
+
+        // segment unlinked meanwhile by slave is not used by anybody else
+        struct stat st;
+        if ((flock(fd, LOCK_SH) == -1) || (fstat(fd, &st) == -1) || (st.st_nlink == 0) ||
+                (static_cast<size_t>(st.st_size) < sizeof(SharedMapHeader))) {
+            ::close(fd);
+            return false;
+        }
+
+        void *data = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+
+        m_data = static_cast<uint8_t *>(data);
+        m_size = st.st_size;
+        m_fd = fd;
+
+        const SharedMapHeader *h = header();
+        if ((h->magic != SharedMapHeader::Magic) ||
+                (h->version != SharedMapHeader::CurrentVersion) ||
+                (h->byteOrderMark != SharedMapHeader::ByteOrderMark) ||
+                (h->size != m_size)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (m_data) {
+            munmap(m_data, m_size);
+            m_data = nullptr;
+            m_size = 0;
+        }
+        if (m_fd != -1) {
+            ::close(m_fd); // releases lock
+            m_fd = -1;
+        }
+    }
+
+    bool isOpen() const {
+        return m_data != nullptr;
+    }
+
+    SharedMapHeader *header() const {
+        return reinterpret_cast<SharedMapHeader *>(m_data);
+    }
+
+    int count(SharedMapTable table) const {
+        return header()->counts[table];
+    }
+
+    /// consistent copy of items [from, from + count)
+    bool read(SharedMapTable table, int from, int count, void *dst) const {
+        if (!inRange(table, from, count)) {
+            return false;
+        }
+        const uint8_t *src = tableData(table) + from * SharedMapHeader::itemSize(table);
+        const size_t bytes = count * SharedMapHeader::itemSize(table);
+        std::atomic<uint32_t> &seq = header()->seq;
+        uint32_t s;
+        do {
+            while ((s = seq.load(std::memory_order_acquire)) & 1) {
+                std::this_thread::yield();
+            }
+            memcpy(dst, src, bytes);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while (seq.load(std::memory_order_relaxed) != s);
+        return true;
+    }
+
+    /// atomic for other parties of protocol
+    bool write(SharedMapTable table, int from, int count, const void *src) {
+        if (!inRange(table, from, count)) {
+            return false;
+        }
+        uint8_t *dst = tableData(table) + from * SharedMapHeader::itemSize(table);
+        const size_t bytes = count * SharedMapHeader::itemSize(table);
+        transaction([&]() { memcpy(dst, src, bytes); });
+        return true;
+    }
+
+    /// run func inside of write section, func must be short and must not throw
+    template<typename Func>
+    void transaction(Func func) {
+        std::atomic<uint32_t> &seq = header()->seq;
+        uint32_t s = seq.load(std::memory_order_relaxed);
+        while ((s & 1) || !seq.compare_exchange_weak(s, s + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+            std::this_thread::yield();
+            s = seq.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        func();
+        seq.fetch_add(1, std::memory_order_release);
+    }
+
+    uint8_t *tableData(SharedMapTable table) const {
+        return m_data + header()->offsets[table];
+    }
+
+private:
+    bool inRange(SharedMapTable table, int from, int count) const {
+        return m_data && (from >= 0) && (count >= 0) && (from + count <= header()->counts[table]);
+    }
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_SHARED_MAP_CLIENT_H_GUARD
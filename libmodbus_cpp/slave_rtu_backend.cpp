@@ -131,9 +131,7 @@ void libmodbus_cpp::SlaveRtuBackend::slot_readFromPort()
         int messageLength = modbus_receive(getCtx(), buf.data());
         if (messageLength > 0) {
             LMB_DLOG(LDOM_PKT, "received packet: " << BUF2HEX(buf.data(), messageLength));
-            processHooks(buf.data(), messageLength, HookTime::Preprocessing);
-            modbus_reply(getCtx(), buf.data(), messageLength, getMap());
-            processHooks(buf.data(), messageLength, HookTime::Postprocessing);
+            processRequest(buf.data(), messageLength);
         } else if (messageLength == -1) {
             LMB_WLOG(LDOM_PKT, modbus_strerror(errno));
         }
@@ -1,18 +1,132 @@
 #include <modbus/modbus-private.h>
+#include <modbus/modbus-tcp-private.h>
 #include <libmodbus_cpp/slave_tcp_backend.h>
 #include <libmodbus_cpp/global.h>
+#include <QMutex>
+#include <QPointer>
+#include <QThread>
 #include <errno.h>
 #include "logger.h"
+#include <algorithm>
 #include <array>
+#include <cstring>
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 #define LDOM_TCP "[modbus.tcp.bk]"
 #define LDOM_PKT "[modbus.tcp.bk.pkt]"
 
-QTcpSocket *libmodbus_cpp::SlaveTcpBackend::m_currentSocket = Q_NULLPTR;
+thread_local QTcpSocket *libmodbus_cpp::SlaveTcpBackend::m_currentSocket = Q_NULLPTR;
+thread_local libmodbus_cpp::TcpFrameServer *libmodbus_cpp::SlaveTcpBackend::m_currentFrameServer = Q_NULLPTR;
+
+namespace {
+const int MbapHeaderLength = 7;
+}
+
+
+namespace libmodbus_cpp {
+
+/// listener thread of SlaveTcpBackend: own context and connections of listening socket
+class TcpListenerShard : public QThread
+{
+    SlaveTcpBackend *m_backend;
+    modbus_t *m_ctx;
+    int m_serverSocket;
+    int m_core;
+    TcpConnectionLimits m_limits;
+    mutable QMutex m_serverMutex;
+    TcpConnectionMode m_mode;
+    TcpFrameServer *m_server = Q_NULLPTR; // while event loop runs
+
+public:
+    TcpListenerShard(SlaveTcpBackend *backend, modbus_t *ctx, int serverSocket, int core)
+        : m_backend(backend)
+        , m_ctx(ctx)
+        , m_serverSocket(serverSocket)
+        , m_core(core)
+        , m_limits(backend->m_limits)
+        , m_mode((backend->m_connectionMode == TcpConnectionMode::Uring) ? TcpConnectionMode::Uring : TcpConnectionMode::Compact)
+    {
+    }
+
+    ~TcpListenerShard() override {
+        quit();
+        wait();
+#ifdef __linux__
+        if (m_serverSocket != -1) {
+            ::close(m_serverSocket); // not taken by server
+        }
+#endif
+        m_ctx->backend = m_backend->m_originalBackend;
+        modbus_free(m_ctx);
+    }
+
+    int connectionCount() const {
+        QMutexLocker lock(&m_serverMutex);
+        return m_server ? m_server->connectionCount() : 0;
+    }
+
+    /// limits of running server are set by its event loop
+    void setLimits(const TcpConnectionLimits &limits) {
+        QMutexLocker lock(&m_serverMutex);
+        m_limits = limits;
+        if (m_server) {
+            m_server->postLimits(limits);
+        }
+    }
+
+protected:
+    void run() override {
+#ifdef __linux__
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(m_core, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+            LMB_WGLOG(LDOM_TCP, "can't pin listener shard to core" << m_core);
+        }
+#endif
+        // handler is called by event loop only, server is set then.
+        // Limits set meanwhile are taken by server or posted to it
+        QScopedPointer<TcpFrameServer> server;
+        {
+            QMutexLocker lock(&m_serverMutex);
+            server.reset(SlaveTcpBackend::listenFrameServer(m_mode, m_serverSocket, m_limits,
+                [this](const uint8_t *adu, int length) { m_backend->processFrame(m_ctx, m_server, adu, length); }));
+            if (!server) {
+                return;
+            }
+            m_server = server.data();
+        }
+        m_serverSocket = -1;
+
+        exec();
+        {
+            QMutexLocker lock(&m_serverMutex);
+            m_server = Q_NULLPTR;
+        }
+    }
+};
+
+}
 
 libmodbus_cpp::SlaveTcpBackend::SlaveTcpBackend()
     : m_verbose(libmodbus_cpp::isVerbose())
 {
+    m_clock.start();
+    m_resumeTimer.setSingleShot(true);
+#ifdef USE_QT5
+    connect(&m_resumeTimer, &QTimer::timeout, this, &SlaveTcpBackend::slot_resume);
+    connect(&m_checkTimer, &QTimer::timeout, this, &SlaveTcpBackend::slot_checkConnections);
+#else
+    connect(&m_resumeTimer, SIGNAL(timeout()), this, SLOT(slot_resume()));
+    connect(&m_checkTimer, SIGNAL(timeout()), this, SLOT(slot_checkConnections()));
+#endif
 }
 
 libmodbus_cpp::SlaveTcpBackend::~SlaveTcpBackend()
@@ -45,11 +159,88 @@ void libmodbus_cpp::SlaveTcpBackend::init(const char *address, int port, int max
     getCtx()->backend = m_customBackend.data();
 }
 
+void libmodbus_cpp::SlaveTcpBackend::setListenBacklog(int backlog)
+{
+    m_maxConnectionCount = backlog;
+}
+
+int libmodbus_cpp::SlaveTcpBackend::getListenBacklog() const
+{
+    return m_maxConnectionCount;
+}
+
+void libmodbus_cpp::SlaveTcpBackend::setConnectionMode(TcpConnectionMode mode)
+{
+    m_connectionMode = mode;
+}
+
+libmodbus_cpp::TcpConnectionMode libmodbus_cpp::SlaveTcpBackend::getConnectionMode() const
+{
+    return m_connectionMode;
+}
+
+void libmodbus_cpp::SlaveTcpBackend::setShardCount(int count)
+{
+    m_shardCount = count;
+}
+
+int libmodbus_cpp::SlaveTcpBackend::getShardCount() const
+{
+    return m_shardCount;
+}
+
+int libmodbus_cpp::SlaveTcpBackend::getConnectionCount() const
+{
+    int count = m_sockets.size() + (m_frameServer ? m_frameServer->connectionCount() : 0);
+    for (const TcpListenerShard *shard : m_shards) {
+        count += shard->connectionCount();
+    }
+    return count;
+}
+
+void libmodbus_cpp::SlaveTcpBackend::setConnectionLimits(const TcpConnectionLimits &limits)
+{
+    m_limits = limits;
+    for (auto it = m_sockets.begin(); it != m_sockets.end(); ++it) {
+        it.key()->setReadBufferSize(m_limits.maxPendingRequests * MODBUS_TCP_MAX_ADU_LENGTH);
+    }
+    if (m_frameServer) {
+        m_frameServer->setLimits(m_limits);
+    }
+    for (TcpListenerShard *shard : m_shards) {
+        shard->setLimits(m_limits);
+    }
+    const int interval = m_limits.checkInterval_ms();
+    if (interval > 0) {
+        m_checkTimer.start(interval);
+    } else {
+        m_checkTimer.stop();
+    }
+}
+
+const libmodbus_cpp::TcpConnectionLimits &libmodbus_cpp::SlaveTcpBackend::getConnectionLimits() const
+{
+    return m_limits;
+}
+
 bool libmodbus_cpp::SlaveTcpBackend::doStartListen()
 {
     LMB_DLOG(LDOM_TCP, "Start listen");
 
+    const int shardCount = (m_shardCount == 0) ? QThread::idealThreadCount() : m_shardCount;
+    if (shardCount > 1) {
+        return startShards(shardCount);
+    }
+
     int serverSocket = modbus_tcp_listen(getCtx(), m_maxConnectionCount);
+    if ((serverSocket != -1) && (m_connectionMode != TcpConnectionMode::Socket)) {
+        m_frameServer.reset(listenFrameServer(m_connectionMode, serverSocket, m_limits,
+            [this](const uint8_t *adu, int length) { processFrame(getCtx(), m_frameServer.data(), adu, length); }));
+        if (m_frameServer) {
+            return true;
+        }
+        LMB_WLOG(LDOM_TCP, "compact connections are not available, use sockets");
+    }
     if (serverSocket != -1) {
         m_tcpServer.setSocketDescriptor(serverSocket);
 #ifdef USE_QT5
@@ -66,9 +257,74 @@ bool libmodbus_cpp::SlaveTcpBackend::doStartListen()
 
 void libmodbus_cpp::SlaveTcpBackend::doStopListen()
 {
+    stopShards();
+    m_frameServer.reset();
     m_tcpServer.close();
 }
 
+bool libmodbus_cpp::SlaveTcpBackend::startShards(int count)
+{
+#ifdef __linux__
+    if (getMapConcurrency() != MapConcurrency::SeqLock) {
+        LMB_WLOG(LDOM_TCP, "listener shards read map concurrently, turn on SeqLock map concurrency");
+        setMapConcurrency(MapConcurrency::SeqLock);
+    }
+
+    // address of context as modbus_tcp_listen does
+    const modbus_tcp_t *tcp = static_cast<const modbus_tcp_t*>(getCtx()->backend_data);
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(tcp->port);
+    address.sin_addr.s_addr = (tcp->ip[0] == '0') ? htonl(INADDR_ANY) : inet_addr(tcp->ip);
+
+    const int cores = std::max(1, QThread::idealThreadCount());
+    for (int i = 0; i < count; ++i) {
+        const int enable = 1;
+        int serverSocket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+        if ((serverSocket == -1) ||
+            (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) == -1) ||
+            (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == -1) ||
+            (bind(serverSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1) ||
+            (::listen(serverSocket, m_maxConnectionCount) == -1)) {
+            LMB_WLOG(LDOM_TCP, "listener shard" << i << "failed:" << strerror(errno));
+            if (serverSocket != -1) {
+                ::close(serverSocket);
+            }
+            stopShards();
+            return false;
+        }
+
+        modbus_t *ctx = modbus_new_tcp(tcp->ip, tcp->port);
+        if (!ctx) {
+            ::close(serverSocket);
+            stopShards();
+            throw Exception(std::string("Failed to create TCP context: ") + modbus_strerror(errno));
+        }
+        ctx->debug = getCtx()->debug;
+        ctx->backend = m_customBackend.data();
+
+        m_shards.append(new TcpListenerShard(this, ctx, serverSocket, i % cores));
+    }
+    for (TcpListenerShard *shard : m_shards) {
+        shard->start();
+    }
+    LMB_DLOG(LDOM_TCP, "listener shards:" << count);
+    return true;
+#else
+    Q_UNUSED(count);
+    LMB_WLOG(LDOM_TCP, "listener shards are supported on Linux only, use single listener");
+    m_shardCount = 1;
+    return doStartListen();
+#endif
+}
+
+void libmodbus_cpp::SlaveTcpBackend::stopShards()
+{
+    qDeleteAll(m_shards); // each stops its thread
+    m_shards.clear();
+}
+
 void libmodbus_cpp::SlaveTcpBackend::slot_processConnection()
 {
     LMB_DLOG(LDOM_TCP, "Process connection");
@@ -80,37 +336,130 @@ void libmodbus_cpp::SlaveTcpBackend::slot_processConnection()
         LMB_DLOG(LDOM_TCP, "new socket:" << s->socketDescriptor());
 #ifdef USE_QT5
         connect(s, &QTcpSocket::readyRead, this, &SlaveTcpBackend::slot_readFromSocket);
+        connect(s, &QTcpSocket::bytesWritten, this, &SlaveTcpBackend::slot_socketWritten);
         connect(s, &QTcpSocket::disconnected, this, &SlaveTcpBackend::slot_removeSocket);
 #else
         connect(s, SIGNAL(readyRead()),    this, SLOT(slot_readFromSocket()));
+        connect(s, SIGNAL(bytesWritten(qint64)), this, SLOT(slot_socketWritten()));
         connect(s, SIGNAL(disconnected()), this, SLOT(slot_removeSocket()));
 #endif
-        m_sockets.insert(s);
+        // Qt stops reading socket when buffer is full, so flooding master is slowed by TCP
+        s->setReadBufferSize(m_limits.maxPendingRequests * MODBUS_TCP_MAX_ADU_LENGTH);
+        m_sockets[s].start(m_clock.elapsed(), m_limits);
     }
 }
 
 void libmodbus_cpp::SlaveTcpBackend::slot_readFromSocket()
 {
     QTcpSocket *s = dynamic_cast<QTcpSocket*>(sender());
-    if (s) {
-        LMB_DLOG(LDOM_TCP, "Read from socket id =" << s->socketDescriptor());
-        m_currentSocket = s;
-        modbus_set_socket(getCtx(), s->socketDescriptor());
+    if (s && !m_rateLimited.contains(s)) {
+        serveSocket(s);
+    }
+}
+
+void libmodbus_cpp::SlaveTcpBackend::slot_socketWritten()
+{
+    QTcpSocket *s = dynamic_cast<QTcpSocket*>(sender());
+    auto it = m_sockets.find(s);
+    if (it == m_sockets.end()) {
+        return;
+    }
+    it.value().updateUnsent(m_clock.elapsed(), s->bytesToWrite(), true);
+    // requests held back by unsent limit
+    if (!m_rateLimited.contains(s) && !it.value().isOverUnsent(s->bytesToWrite(), m_limits)) {
+        serveSocket(s);
+    }
+}
+
+void libmodbus_cpp::SlaveTcpBackend::serveSocket(QTcpSocket *s)
+{
+    LMB_DLOG(LDOM_TCP, "Read from socket id =" << s->socketDescriptor());
+    m_currentSocket = s;
+    modbus_set_socket(getCtx(), s->socketDescriptor());
+
+    for (;;) {
+        auto it = m_sockets.find(s);
+        if (it == m_sockets.end()) {
+            break;
+        }
+
+        // whole frame or broken header which modbus_receive rejects
+        uint8_t header[MbapHeaderLength];
+        if (s->peek(reinterpret_cast<char*>(header), sizeof(header)) < static_cast<qint64>(sizeof(header))) {
+            break;
+        }
+        const int length = (header[4] << 8) | header[5];
+        const bool validLength = (length >= 2) && (length <= MODBUS_TCP_MAX_ADU_LENGTH - 6);
+        if (validLength && (s->bytesAvailable() < 6 + length)) {
+            break;
+        }
+
+        const qint64 now = m_clock.elapsed();
+        if (it.value().isOverUnsent(s->bytesToWrite(), m_limits)) {
+            break; // until bytesWritten
+        }
+        if (!it.value().takeRequest(now, m_limits)) {
+            m_rateLimited.insert(s);
+            scheduleResume(it.value().rateDelay_ms(m_limits));
+            break;
+        }
+
         std::array<uint8_t, MODBUS_TCP_MAX_ADU_LENGTH> buf;
         int messageLength = modbus_receive(getCtx(), buf.data());
         if (messageLength > 0) {
             LMB_DLOG(LDOM_PKT, "received:" << BUF2HEX(buf.data(), messageLength));
-            processHooks(buf.data(), messageLength, HookTime::Preprocessing);
-            modbus_reply(getCtx(), buf.data(), messageLength, getMap());
-            processHooks(buf.data(), messageLength, HookTime::Postprocessing);
+            processRequest(buf.data(), messageLength);
         } else if (messageLength == -1) {
             LMB_WLOG(LDOM_TCP, modbus_strerror(errno));
             removeSocket(s); // if it wasn't removed by slot already
+            break;
+        }
+
+        it = m_sockets.find(s);
+        if (it != m_sockets.end()) {
+            it.value().updateUnsent(now, s->bytesToWrite(), false);
         }
     }
     m_currentSocket = Q_NULLPTR;
 }
 
+void libmodbus_cpp::SlaveTcpBackend::scheduleResume(int delay_ms)
+{
+    // one timer for all limited sockets: earliest of them is due first, others are limited again
+    const qint64 at = m_clock.elapsed() + delay_ms;
+    if (!m_resumeTimer.isActive() || (at < m_resumeAt_ms)) {
+        m_resumeAt_ms = at;
+        m_resumeTimer.start(delay_ms);
+    }
+}
+
+void libmodbus_cpp::SlaveTcpBackend::slot_resume()
+{
+    const QSet<QTcpSocket*> limited = m_rateLimited;
+    m_rateLimited.clear();
+    for (QTcpSocket *s : limited) {
+        if (m_sockets.contains(s)) {
+            serveSocket(s); // may be limited again
+        }
+    }
+}
+
+void libmodbus_cpp::SlaveTcpBackend::slot_checkConnections()
+{
+    const qint64 now = m_clock.elapsed();
+    QVector<QTcpSocket*> expired;
+    for (auto it = m_sockets.begin(); it != m_sockets.end(); ++it) {
+        if (it.value().isExpired(now, m_limits)) {
+            expired.append(it.key());
+        }
+    }
+    for (QTcpSocket *s : expired) {
+        LMB_DLOG(LDOM_TCP, "socket expired:" << s->socketDescriptor());
+        s->abort(); // don't wait for unsent replies
+        removeSocket(s);
+    }
+}
+
 void libmodbus_cpp::SlaveTcpBackend::slot_removeSocket()
 {
     LMB_DLOG(LDOM_TCP, "Try remove socket");
@@ -126,12 +475,63 @@ void libmodbus_cpp::SlaveTcpBackend::removeSocket(QTcpSocket *s)
     if (m_sockets.contains(s)) {
         LMB_DLOG(LDOM_TCP, "remove socket:" << s->socketDescriptor());
         m_sockets.remove(s);
+        m_rateLimited.remove(s);
         s->close();
         s->deleteLater();
     }
 }
 
 
+libmodbus_cpp::TcpFrameServer *libmodbus_cpp::SlaveTcpBackend::listenFrameServer(TcpConnectionMode mode, int serverSocket, const TcpConnectionLimits &limits, TcpFrameServer::FrameHandler handler)
+{
+    if (mode == TcpConnectionMode::Uring) {
+        QScopedPointer<TcpFrameServer> server(new UringTcpServer(handler));
+        server->setLimits(limits);
+        if (server->listen(serverSocket)) {
+            return server.take();
+        }
+        LMB_WGLOG(LDOM_TCP, "io_uring connections are not available, use compact ones");
+    }
+    QScopedPointer<TcpFrameServer> server(new CompactTcpServer(handler));
+    server->setLimits(limits);
+    return server->listen(serverSocket) ? server.take() : Q_NULLPTR;
+}
+
+void libmodbus_cpp::SlaveTcpBackend::processFrame(modbus_t *ctx, TcpFrameServer *server, const uint8_t *adu, int length)
+{
+    LMB_DLOG(LDOM_PKT, "received:" << BUF2HEX(adu, length));
+    m_currentFrameServer = server;
+    processRequest(ctx, adu, length);
+    m_currentFrameServer = Q_NULLPTR;
+}
+
+libmodbus_cpp::DeferredReply::Route libmodbus_cpp::SlaveTcpBackend::replyRoute(modbus_t *ctx)
+{
+    Q_UNUSED(ctx);
+    // connection is looked up again on reply, it may be closed meanwhile
+    if (m_currentFrameServer) {
+        const QPointer<TcpFrameServer> server(m_currentFrameServer);
+        const quint64 connection = server->currentConnection();
+        return [server, connection](uint8_t *adu, int length) {
+            if (!server || !server->sendTo(connection, adu, length)) {
+                LMB_DGLOG(LDOM_TCP, "deferred reply is dropped, connection is closed");
+            }
+        };
+    }
+    if (m_currentSocket) {
+        const QPointer<QTcpSocket> socket(m_currentSocket);
+        return [this, socket](uint8_t *adu, int length) {
+            if (!socket || !m_sockets.contains(socket.data())) {
+                LMB_DGLOG(LDOM_TCP, "deferred reply is dropped, connection is closed");
+                return;
+            }
+            AbstractSlaveBackend::customSend(Q_NULLPTR, adu, length, socket.data());
+        };
+    }
+    return DeferredReply::Route();
+}
+
+
 int libmodbus_cpp::SlaveTcpBackend::customSelect(modbus_t *ctx, fd_set *rset, timeval *tv, int msg_length)
 {
     return AbstractSlaveBackend::customSelect(ctx, rset, tv, msg_length, m_currentSocket);
@@ -145,5 +545,8 @@ ssize_t libmodbus_cpp::SlaveTcpBackend::customRecv(modbus_t *ctx, uint8_t *rsp,
 
 ssize_t libmodbus_cpp::SlaveTcpBackend::customSend(modbus_t *ctx, const uint8_t *rsp, int rsp_length)
 {
+    if (m_currentFrameServer) {
+        return m_currentFrameServer->send(rsp, rsp_length);
+    }
     return AbstractSlaveBackend::customSend(ctx, rsp, rsp_length, m_currentSocket);
 }
@@ -3,19 +3,52 @@
 
 #include <QTcpServer>
 #include <QSet>
+#include <QHash>
 #include <QTcpSocket>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
 #include "backend.h"
+#include "compact_tcp_server.h"
+#include "uring_tcp_server.h"
 
 typedef struct _modbus_backend modbus_backend_t;
 
 namespace libmodbus_cpp {
 
+class TcpListenerShard;
+
+/**
+ * @brief how slave keeps accepted connections
+ * Socket: QTcpSocket per connection, works everywhere.
+ * Compact: descriptor and one frame buffer per connection in one epoll set, for thousands
+ * of mostly idle masters. Linux only, Socket is used elsewhere.
+ * Uring: as Compact, but connections are read by io_uring multishot receive and replies of
+ * batch are submitted by one syscall. Linux 6.0+, Compact is used when io_uring is not available
+ * or LIBMODBUS_CPP_DISABLE_IO_URING environment variable is set.
+ */
+enum class TcpConnectionMode {
+    Socket,
+    Compact,
+    Uring
+};
+
 class SlaveTcpBackend : public QObject, public AbstractSlaveBackend {
     Q_OBJECT
 
     int m_maxConnectionCount = 10;
+    TcpConnectionMode m_connectionMode = TcpConnectionMode::Socket;
     QTcpServer m_tcpServer;
-    QSet<QTcpSocket*> m_sockets;
+    QHash<QTcpSocket*, ConnectionThrottle> m_sockets;
+    QScopedPointer<TcpFrameServer> m_frameServer;
+    int m_shardCount = 1;
+    QVector<TcpListenerShard*> m_shards;
+    TcpConnectionLimits m_limits;
+    QElapsedTimer m_clock;
+    QTimer m_checkTimer;
+    QTimer m_resumeTimer;
+    qint64 m_resumeAt_ms = 0;
+    QSet<QTcpSocket*> m_rateLimited;
     const modbus_backend_t *m_originalBackend = nullptr;
     QScopedPointer<modbus_backend_t> m_customBackend;
     bool m_verbose;
@@ -26,19 +59,58 @@ public:
 
     void init(const char *address = nullptr, int port = MODBUS_TCP_DEFAULT_PORT, int maxConnectionCount = 10); // NULL for server to listen all
 
+    /// maxConnectionCount of init: backlog of not yet accepted connections. Applied by next startListen
+    void setListenBacklog(int backlog);
+    int getListenBacklog() const;
+
+    /// applied by next startListen
+    void setConnectionMode(TcpConnectionMode mode);
+    TcpConnectionMode getConnectionMode() const;
+
+    /**
+     * @brief listener threads sharing port by SO_REUSEPORT, kernel spreads connections over them.
+     * Each shard is pinned to core, has own event loop, context and compact (or io_uring) connections.
+     * 1 (default) is single listener of application thread, 0 is one shard per core.
+     * Hooks are called from shard threads concurrently, SeqLock map concurrency is turned on.
+     * Linux only, applied by next startListen
+     */
+    void setShardCount(int count);
+    int getShardCount() const;
+
+    int getConnectionCount() const;
+
+    /// applied to connections of running listeners too
+    void setConnectionLimits(const TcpConnectionLimits &limits);
+    const TcpConnectionLimits &getConnectionLimits() const;
+
 protected:
     bool doStartListen() override;
     void doStopListen() override;
+    DeferredReply::Route replyRoute(modbus_t *ctx) override;
 
 private slots:
     void slot_processConnection();
     void slot_readFromSocket();
+    void slot_socketWritten();
     void slot_removeSocket();
+    void slot_resume();
+    void slot_checkConnections();
 
 private:
+    void serveSocket(QTcpSocket *s);
+    void scheduleResume(int delay_ms);
     void removeSocket(QTcpSocket *s);
+    bool startShards(int count);
+    void stopShards();
+    void processFrame(modbus_t *ctx, TcpFrameServer *server, const uint8_t *adu, int length);
+    /// server of mode taking listening socket, io_uring one falls back to compact one. Nil if socket is not taken
+    static TcpFrameServer *listenFrameServer(TcpConnectionMode mode, int serverSocket, const TcpConnectionLimits &limits, TcpFrameServer::FrameHandler handler);
+
+    friend class TcpListenerShard;
 
-    static QTcpSocket *m_currentSocket;
+    // per thread: shards serve requests concurrently
+    static thread_local QTcpSocket *m_currentSocket;
+    static thread_local TcpFrameServer *m_currentFrameServer;
     static int customSelect(modbus_t *ctx, fd_set *rset, struct timeval *tv, int msg_length);
     static ssize_t customRecv(modbus_t *ctx, uint8_t *rsp, int rsp_length);
     static ssize_t customSend(modbus_t *ctx, const uint8_t *rsp, int rsp_length);
@@ -0,0 +1,576 @@
+#include <libmodbus_cpp/tcp_connection_manager.h>
+#include <errno.h>
+#include <cstring>
+#include <limits>
+#include <QSocketNotifier>
+#include "logger.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+
+#define LDOM_TCPCM "[modbus.master.tcp.connections]"
+
+
+/// manager side of connection, lives in thread of manager
+struct libmodbus_cpp::TcpConnectionManager::Slot {
+    ManagedTcpConnectionPtr connection;
+    int fd = -1; // connecting socket
+    QSocketNotifier *notifier = Q_NULLPTR;
+    qint64 deadline_ms = 0;
+    qint64 retryAt_ms = 0;
+    ReconnectBackoff backoff;
+    bool up = false;        // connected, loss is not seen yet
+    bool confirmed = false; // device answered since connect
+};
+
+
+/// ManagedTcpConnection
+
+libmodbus_cpp::ManagedTcpConnection::ManagedTcpConnection(const std::string &address, int port, int wait_ms, TcpConnectionManager *manager)
+    : m_address(address)
+    , m_port(port)
+    , m_wait_ms(wait_ms)
+    , m_manager(manager)
+{
+}
+
+
+libmodbus_cpp::ManagedTcpConnection::~ManagedTcpConnection()
+{
+#ifndef _WIN32
+    if (m_fd != -1) {
+        ::close(m_fd);
+    }
+#endif
+}
+
+
+int libmodbus_cpp::ManagedTcpConnection::acquire()
+{
+    QMutexLocker locker(&m_lock);
+    if (m_parked) {
+        throw ConnectionError("connection is closed");
+    }
+    if (!m_requested) {
+        // lazy connect of master not warmed by start()
+        m_requested = true;
+        wakeManager();
+    }
+
+    // first connect is waited for, later ones fail fast
+    QElapsedTimer timer;
+    timer.start();
+    while (((m_state == State::Idle) || ((m_state == State::Connecting) && (m_lastError == 0))) && m_manager) {
+        const qint64 left = m_wait_ms - timer.elapsed();
+        if ((left <= 0) || !m_changed.wait(&m_lock, static_cast<unsigned long>(left))) {
+            break;
+        }
+    }
+
+    if (m_fd != -1) {
+        const int fd = m_fd;
+        m_fd = -1;
+        return fd;
+    }
+    if (!m_manager) {
+        throw ConnectionError("connection manager is destroyed");
+    }
+    if (m_state == State::Failed) {
+        throw ConnectionError(std::string("can't connect: ") + modbus_strerror(m_lastError));
+    }
+    if (m_state == State::Up) {
+        // taken socket was closed by master without lost()
+        m_state = State::Down;
+        wakeManager();
+    }
+    throw ConnectionError(std::string("device is down: ") + modbus_strerror(m_lastError ? m_lastError : ETIMEDOUT));
+}
+
+
+void libmodbus_cpp::ManagedTcpConnection::lost()
+{
+    QMutexLocker locker(&m_lock);
+    if (m_state == State::Up) {
+        m_state = State::Down;
+        m_lastError = ECONNRESET;
+        wakeManager();
+    }
+}
+
+
+void libmodbus_cpp::ManagedTcpConnection::succeeded()
+{
+    // seen by manager when it is woken next, e.g. by loss of connection
+    QMutexLocker locker(&m_lock);
+    m_confirmed = true;
+}
+
+
+void libmodbus_cpp::ManagedTcpConnection::park()
+{
+    QMutexLocker locker(&m_lock);
+    m_parked = true;
+    if (m_state == State::Up) {
+        m_state = State::Down;
+    }
+#ifndef _WIN32
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+#endif
+}
+
+
+void libmodbus_cpp::ManagedTcpConnection::unpark()
+{
+    QMutexLocker locker(&m_lock);
+    m_parked = false;
+    m_requested = true;
+    if ((m_state != State::Connecting) && (m_state != State::Failed)) {
+        // waited for as first connect
+        m_state = State::Idle;
+        m_lastError = 0;
+    }
+    wakeManager();
+}
+
+
+const std::string &libmodbus_cpp::ManagedTcpConnection::getAddress() const
+{
+    return m_address;
+}
+
+
+int libmodbus_cpp::ManagedTcpConnection::getPort() const
+{
+    return m_port;
+}
+
+
+libmodbus_cpp::ManagedTcpConnection::State libmodbus_cpp::ManagedTcpConnection::getState() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_state;
+}
+
+
+bool libmodbus_cpp::ManagedTcpConnection::wantsConnect(bool started) const
+{
+    QMutexLocker locker(&m_lock);
+    if (m_parked) {
+        return false;
+    }
+    return ((m_state == State::Down) || (m_state == State::Idle)) && (started || m_requested);
+}
+
+
+void libmodbus_cpp::ManagedTcpConnection::connecting()
+{
+    QMutexLocker locker(&m_lock);
+    m_state = State::Connecting;
+}
+
+
+void libmodbus_cpp::ManagedTcpConnection::connected(int fd)
+{
+    QMutexLocker locker(&m_lock);
+#ifndef _WIN32
+    if (m_parked) {
+        ::close(fd);
+        m_state = State::Down;
+        return;
+    }
+    if (m_fd != -1) {
+        ::close(m_fd);
+    }
+#endif
+    m_fd = fd;
+    m_state = State::Up;
+    m_lastError = 0;
+    m_confirmed = false;
+    m_changed.wakeAll();
+}
+
+
+void libmodbus_cpp::ManagedTcpConnection::failed(int error, bool permanent)
+{
+    QMutexLocker locker(&m_lock);
+    m_state = permanent ? State::Failed : State::Down;
+    m_lastError = error;
+    m_changed.wakeAll();
+}
+
+
+bool libmodbus_cpp::ManagedTcpConnection::isConfirmed() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_confirmed;
+}
+
+
+void libmodbus_cpp::ManagedTcpConnection::detachManager()
+{
+    QMutexLocker locker(&m_lock);
+    m_manager = Q_NULLPTR;
+    if (m_state != State::Up) {
+        m_state = State::Down;
+    }
+    m_changed.wakeAll();
+}
+
+
+void libmodbus_cpp::ManagedTcpConnection::wakeManager()
+{
+    // under lock, manager is not destroyed meanwhile
+    if (m_manager) {
+        QMetaObject::invokeMethod(m_manager, "slot_wake", Qt::QueuedConnection);
+    }
+}
+
+
+/// TcpConnectionManager
+
+libmodbus_cpp::TcpConnectionManager::TcpConnectionManager(QObject *parent)
+    : QObject(parent)
+    , m_jitter(static_cast<unsigned>(reinterpret_cast<quintptr>(this)))
+{
+    m_timer.setSingleShot(true);
+    m_clock.start();
+#ifdef USE_QT5
+    connect(&m_timer, &QTimer::timeout, this, &TcpConnectionManager::slot_wake);
+#else
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(slot_wake()));
+#endif
+}
+
+
+libmodbus_cpp::TcpConnectionManager::~TcpConnectionManager()
+{
+    // masters outliving manager fail fast
+    m_timer.stop();
+    for (Slot *slot : m_slots) {
+        abort(slot);
+        slot->connection->detachManager();
+        delete slot;
+    }
+    QMutexLocker locker(&m_lock);
+    for (const ManagedTcpConnectionPtr &c : m_incoming) {
+        c->detachManager();
+    }
+}
+
+
+void libmodbus_cpp::TcpConnectionManager::setOptions(const TcpConnectionOptions &options)
+{
+    QMutexLocker locker(&m_lock);
+    m_options = options;
+}
+
+
+libmodbus_cpp::TcpConnectionOptions libmodbus_cpp::TcpConnectionManager::getOptions() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_options;
+}
+
+
+libmodbus_cpp::ManagedTcpConnectionPtr libmodbus_cpp::TcpConnectionManager::add(const char *address, int port)
+{
+    const ManagedTcpConnectionPtr c = std::make_shared<ManagedTcpConnection>(address, port, getOptions().connectTimeout_ms, this);
+    {
+        QMutexLocker locker(&m_lock);
+        m_incoming.append(c);
+    }
+    QMetaObject::invokeMethod(this, "slot_wake", Qt::QueuedConnection);
+    return c;
+}
+
+
+void libmodbus_cpp::TcpConnectionManager::start()
+{
+    // direct call in thread of manager, queued one from others
+    QMetaObject::invokeMethod(this, "slot_start");
+}
+
+
+void libmodbus_cpp::TcpConnectionManager::slot_start()
+{
+    m_started = true;
+    slot_wake();
+}
+
+
+int libmodbus_cpp::TcpConnectionManager::getConnectedCount() const
+{
+    int count = 0;
+    for (const Slot *slot : m_slots) {
+        if (slot->connection->getState() == ManagedTcpConnection::State::Up) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+
+int libmodbus_cpp::TcpConnectionManager::getConnectionCount() const
+{
+    return m_slots.size();
+}
+
+
+void libmodbus_cpp::TcpConnectionManager::slot_wake()
+{
+    {
+        QMutexLocker locker(&m_lock);
+        for (const ManagedTcpConnectionPtr &c : m_incoming) {
+            Slot *slot = new Slot;
+            slot->connection = c;
+            m_slots.append(slot);
+        }
+        m_incoming.clear();
+    }
+
+    const qint64 now = m_clock.elapsed();
+    qint64 due = std::numeric_limits<qint64>::max();
+    auto it = m_slots.begin();
+    while (it != m_slots.end()) {
+        Slot *slot = *it;
+        if (slot->connection.use_count() == 1) {
+            // master is destroyed
+            abort(slot);
+            delete slot;
+            it = m_slots.erase(it);
+            continue;
+        }
+        if (slot->up && !slot->confirmed && slot->connection->isConfirmed()) {
+            slot->confirmed = true;
+            slot->backoff.reset();
+        }
+        if (slot->up && (slot->connection->getState() != ManagedTcpConnection::State::Up)) {
+            slot->up = false;
+            if (!slot->confirmed) {
+                // accepted and dropped without answer, e.g. by overloaded gateway
+                const int wait_ms = delay(slot);
+                LMB_DGLOG(LDOM_TCPCM, "connection to" << slot->connection->getAddress().c_str() << slot->connection->getPort()
+                          << "lost before any reply, reconnect in" << wait_ms << "ms");
+            }
+        }
+        if (slot->fd != -1) {
+            if (slot->deadline_ms <= now) {
+                fail(slot, ETIMEDOUT);
+            }
+        } else if (slot->connection->wantsConnect(m_started) && (slot->retryAt_ms <= now)) {
+            begin(slot);
+        }
+        if (slot->fd != -1) {
+            due = std::min(due, slot->deadline_ms);
+        } else if (slot->retryAt_ms > now) {
+            due = std::min(due, slot->retryAt_ms);
+        }
+        ++it;
+    }
+    rearm(due);
+}
+
+
+void libmodbus_cpp::TcpConnectionManager::rearm(qint64 due_ms)
+{
+    if (due_ms == std::numeric_limits<qint64>::max()) {
+        m_timer.stop();
+        return;
+    }
+    m_timer.start(static_cast<int>(std::max<qint64>(due_ms - m_clock.elapsed(), 0)));
+}
+
+
+#ifndef _WIN32
+
+bool libmodbus_cpp::TcpConnectionManager::setupSocket(int fd, const TcpConnectionOptions &options)
+{
+    // as libmodbus sets up its own sockets
+    int on = 1;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) == -1) {
+        return false;
+    }
+    if (options.keepAliveIdle_s <= 0) {
+        return true;
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on)) == -1) {
+        return false;
+    }
+#ifdef __linux__
+    const int idle = options.keepAliveIdle_s;
+    const int interval = std::max(options.keepAliveInterval_s, 1);
+    const int count = std::max(options.keepAliveCount, 1);
+    return (setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle)) == 0) &&
+           (setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval)) == 0) &&
+           (setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count)) == 0);
+#else
+    return true;
+#endif
+}
+
+
+void libmodbus_cpp::TcpConnectionManager::begin(Slot *slot)
+{
+    const TcpConnectionOptions options = getOptions();
+    const ManagedTcpConnectionPtr &c = slot->connection;
+    c->connecting();
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(c->getPort()));
+    if (inet_pton(AF_INET, c->getAddress().c_str(), &addr.sin_addr) != 1) {
+        // would fail the same way forever
+        LMB_WGLOG(LDOM_TCPCM, "invalid address" << c->getAddress().c_str());
+        c->failed(EINVAL, true);
+        return;
+    }
+
+    // socket stays non-blocking for libmodbus, as its own ones
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if ((fd == -1) || (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1) || (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)) {
+        const int error = errno;
+        if (fd != -1) {
+            ::close(fd);
+        }
+        fail(slot, error);
+        return;
+    }
+    slot->fd = fd;
+    slot->deadline_ms = m_clock.elapsed() + options.connectTimeout_ms;
+
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+        done(slot);
+        return;
+    }
+    if (errno != EINPROGRESS) {
+        fail(slot, errno);
+        return;
+    }
+    slot->notifier = new QSocketNotifier(fd, QSocketNotifier::Write, this);
+    m_connecting.insert(slot->notifier, slot);
+#ifdef USE_QT5
+    connect(slot->notifier, &QSocketNotifier::activated, this, &TcpConnectionManager::slot_connectReady);
+#else
+    connect(slot->notifier, SIGNAL(activated(int)), this, SLOT(slot_connectReady()));
+#endif
+}
+
+
+void libmodbus_cpp::TcpConnectionManager::slot_connectReady()
+{
+    Slot *slot = m_connecting.value(static_cast<QSocketNotifier*>(sender()));
+    if (!slot) {
+        return;
+    }
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(slot->fd, SOL_SOCKET, SO_ERROR, &error, &length) == -1) {
+        error = errno;
+    }
+    if (error != 0) {
+        fail(slot, error);
+    } else {
+        done(slot);
+    }
+    slot_wake(); // reschedule
+}
+
+
+void libmodbus_cpp::TcpConnectionManager::done(Slot *slot)
+{
+    const int fd = slot->fd;
+    slot->fd = -1;
+    abort(slot);
+    if (!setupSocket(fd, getOptions())) {
+        const int error = errno;
+        ::close(fd);
+        fail(slot, error);
+        return;
+    }
+    LMB_DGLOG(LDOM_TCPCM, "connected to" << slot->connection->getAddress().c_str() << slot->connection->getPort());
+    // backoff is reset by first answer of device, not by accepted connect
+    slot->retryAt_ms = 0;
+    slot->up = true;
+    slot->confirmed = false;
+    slot->connection->connected(fd);
+}
+
+
+void libmodbus_cpp::TcpConnectionManager::abort(Slot *slot)
+{
+    if (slot->notifier) {
+        m_connecting.remove(slot->notifier);
+        slot->notifier->setEnabled(false);
+        slot->notifier->deleteLater();
+        slot->notifier = Q_NULLPTR;
+    }
+    if (slot->fd != -1) {
+        ::close(slot->fd);
+        slot->fd = -1;
+    }
+}
+
+#else
+
+bool libmodbus_cpp::TcpConnectionManager::setupSocket(int fd, const TcpConnectionOptions &options)
+{
+    Q_UNUSED(fd);
+    Q_UNUSED(options);
+    return false;
+}
+
+
+void libmodbus_cpp::TcpConnectionManager::begin(Slot *slot)
+{
+    LMB_WGLOG(LDOM_TCPCM, "managed connections are not supported on Windows");
+    slot->connection->failed(ENOTSUP, true);
+}
+
+
+void libmodbus_cpp::TcpConnectionManager::slot_connectReady()
+{
+}
+
+
+void libmodbus_cpp::TcpConnectionManager::done(Slot *slot)
+{
+    Q_UNUSED(slot);
+}
+
+
+void libmodbus_cpp::TcpConnectionManager::abort(Slot *slot)
+{
+    Q_UNUSED(slot);
+}
+
+#endif // _WIN32
+
+
+int libmodbus_cpp::TcpConnectionManager::delay(Slot *slot)
+{
+    const int backoff = slot->backoff.next(getOptions());
+    // spread reconnects of devices which failed together
+    const int jitter = static_cast<int>(m_jitter() % static_cast<unsigned>(backoff / 5 + 1));
+    slot->retryAt_ms = m_clock.elapsed() + backoff + jitter;
+    return backoff + jitter;
+}
+
+
+void libmodbus_cpp::TcpConnectionManager::fail(Slot *slot, int error)
+{
+    abort(slot);
+    const int wait_ms = delay(slot);
+    LMB_DGLOG(LDOM_TCPCM, "connect to" << slot->connection->getAddress().c_str() << slot->connection->getPort()
+              << "failed:" << modbus_strerror(error) << ", retry in" << wait_ms << "ms");
+    slot->connection->failed(error);
+}
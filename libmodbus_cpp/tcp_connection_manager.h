@@ -0,0 +1,186 @@
+#ifndef LIBMODBUS_CPP_TCP_CONNECTION_MANAGER_H_GUARD
+#define LIBMODBUS_CPP_TCP_CONNECTION_MANAGER_H_GUARD
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QHash>
+#include <memory>
+#include <random>
+#include <string>
+#include "defs.h"
+
+class QSocketNotifier;
+
+namespace libmodbus_cpp {
+
+class TcpConnectionManager;
+
+
+struct TcpConnectionOptions {
+    /// first request of master waits for first connect that long, zero fails it at once
+    int connectTimeout_ms = 3000;
+    /// reconnect after failed attempt is delayed, doubled up to max with each failure
+    int minBackoff_ms = 100;
+    int maxBackoff_ms = 30000;
+    /// TCP keep-alive probes of idle connection, zero idle time turns them off
+    int keepAliveIdle_s = 10;
+    int keepAliveInterval_s = 5;
+    int keepAliveCount = 3;
+};
+
+
+/// delay of reconnect after count failures in row, jitter is added by manager
+class ReconnectBackoff
+{
+    int m_current_ms = 0;
+
+public:
+    void reset() {
+        m_current_ms = 0;
+    }
+
+    int next(const TcpConnectionOptions &options) {
+        m_current_ms = (m_current_ms <= 0) ? options.minBackoff_ms : std::min(m_current_ms * 2, options.maxBackoff_ms);
+        return m_current_ms;
+    }
+};
+
+
+/**
+ * @brief socket of one managed master, handed from manager thread to thread of master
+ * Master takes connected socket on request; while device is down (reconnect backoff) request
+ * fails at once instead of waiting for connect timeout. Only first connect is waited for.
+ */
+class ManagedTcpConnection
+{
+public:
+    enum class State {
+        Idle,       // not connected yet
+        Connecting,
+        Up,
+        Down,       // failed or lost, reconnect is scheduled
+        Failed      // never connects, e.g. invalid address
+    };
+
+    ManagedTcpConnection(const std::string &address, int port, int wait_ms, TcpConnectionManager *manager);
+    ~ManagedTcpConnection();
+
+    // thread of master
+
+    /// connected socket, throws ConnectionError while device is down
+    int acquire();
+    /// socket taken by master is broken and closed by it
+    void lost();
+    /// device answered request over socket
+    void succeeded();
+    /// disconnect() of master, no reconnects until unpark()
+    void park();
+    void unpark();
+
+    // thread of manager
+
+    const std::string &getAddress() const;
+    int getPort() const;
+    State getState() const;
+    /// attempt is due: for all after start() of manager, else for used masters only
+    bool wantsConnect(bool started) const;
+    void connecting();
+    void connected(int fd);
+    /// permanent failure is not retried
+    void failed(int error, bool permanent = false);
+    /// device answered since last connect
+    bool isConfirmed() const;
+    void detachManager();
+
+private:
+    void wakeManager();
+
+    const std::string m_address;
+    const int m_port;
+    const int m_wait_ms; // for first connect
+    mutable QMutex m_lock;
+    QWaitCondition m_changed;
+    TcpConnectionManager *m_manager;
+    State m_state = State::Idle;
+    int m_fd = -1; // connected socket not taken by master yet
+    int m_lastError = 0;
+    bool m_requested = false;
+    bool m_parked = false;
+    bool m_confirmed = false;
+};
+
+using ManagedTcpConnectionPtr = std::shared_ptr<ManagedTcpConnection>;
+
+
+/**
+ * @brief background connects and reconnects of many TCP masters, see Factory::createTcpMaster()
+ * start() connects all masters at once with non-blocking sockets, so startup takes one connect
+ * timeout, not sum of them. Without start() masters are connected lazily on first request.
+ * Broken connection reported by master is reconnected right away, failed attempts back off with
+ * jitter. Connection lost before device answered anything counts as failed attempt too, so gateway
+ * accepting and dropping connections is not hammered. Invalid address is not retried. Connected
+ * sockets have TCP keep-alive, so dead peers are found on idle connections too.
+ * Lives in thread with event loop, masters may be used from any threads.
+ */
+class TcpConnectionManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TcpConnectionManager(QObject *parent = Q_NULLPTR);
+    ~TcpConnectionManager() override;
+
+    void setOptions(const TcpConnectionOptions &options);
+    TcpConnectionOptions getOptions() const;
+
+    /// connection for master, from any thread
+    ManagedTcpConnectionPtr add(const char *address, int port);
+
+    /// connects all masters, later ones are connected as they are added; from any thread
+    void start();
+    /// from thread of manager
+    int getConnectedCount() const;
+    int getConnectionCount() const;
+
+    /// socket is ready for master, keep-alive is set up
+    static bool setupSocket(int fd, const TcpConnectionOptions &options);
+
+public slots:
+    /// connections have changed, from any thread by queued call
+    void slot_wake();
+
+private slots:
+    void slot_start();
+    void slot_connectReady();
+
+private:
+    struct Slot;
+
+    void begin(Slot *slot);
+    void done(Slot *slot);
+    void fail(Slot *slot, int error);
+    void abort(Slot *slot);
+    /// next reconnect of slot is delayed by backoff with jitter, returns the delay
+    int delay(Slot *slot);
+    void rearm(qint64 due_ms);
+
+    mutable QMutex m_lock; // of options and new connections
+    TcpConnectionOptions m_options;
+    QList<ManagedTcpConnectionPtr> m_incoming;
+
+    QList<Slot*> m_slots;
+    QHash<QSocketNotifier*, Slot*> m_connecting;
+    bool m_started = false;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    std::minstd_rand m_jitter;
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_TCP_CONNECTION_MANAGER_H_GUARD
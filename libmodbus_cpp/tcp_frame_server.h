@@ -0,0 +1,81 @@
+#ifndef LIBMODBUS_CPP_TCP_FRAME_SERVER_H_GUARD
+#define LIBMODBUS_CPP_TCP_FRAME_SERVER_H_GUARD
+
+#include <QObject>
+#include <QEvent>
+#include <QCoreApplication>
+#include <atomic>
+#include <functional>
+#include <sys/types.h>
+#include "defs.h"
+#include "connection_throttle.h"
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief accepted Modbus TCP connections of slave served without QTcpSocket
+ * Complete MBAP frames of listening socket connections are passed to handler, handler answers
+ * by send(). Server lives in thread which calls listen().
+ */
+class TcpFrameServer : public QObject
+{
+    struct LimitsEvent : public QEvent {
+        static Type eventType() {
+            static const Type type = static_cast<Type>(QEvent::registerEventType());
+            return type;
+        }
+        explicit LimitsEvent(const TcpConnectionLimits &limits) : QEvent(eventType()), limits(limits) {}
+        const TcpConnectionLimits limits;
+    };
+
+public:
+    using FrameHandler = std::function<void(const uint8_t *adu, int length)>;
+
+    explicit TcpFrameServer(FrameHandler handler, QObject *parent = Q_NULLPTR)
+        : QObject(parent)
+        , m_handler(handler)
+    {
+    }
+
+    /// takes ownership of listening descriptor on success
+    virtual bool listen(int serverSocket) = 0;
+    virtual void close() = 0;
+
+    /// may be called from any thread
+    int connectionCount() const {
+        return m_connectionCount.load(std::memory_order_relaxed);
+    }
+
+    virtual void setLimits(const TcpConnectionLimits &limits) = 0;
+
+    /// may be called from any thread, limits are set in thread of server
+    void postLimits(const TcpConnectionLimits &limits) {
+        QCoreApplication::postEvent(this, new LimitsEvent(limits));
+    }
+
+    /// sends to connection of frame being handled, unsent rest is queued
+    virtual ssize_t send(const uint8_t *data, int length) = 0;
+
+    /// id of connection of frame being handled for later sendTo(), 0 outside of handler
+    virtual quint64 currentConnection() const = 0;
+    /// sends from thread of server outside of handler, false if connection is gone
+    virtual bool sendTo(quint64 connection, const uint8_t *data, int length) = 0;
+
+protected:
+    bool event(QEvent *e) override {
+        if (e->type() == LimitsEvent::eventType()) {
+            setLimits(static_cast<LimitsEvent*>(e)->limits);
+            return true;
+        }
+        return QObject::event(e);
+    }
+
+    FrameHandler m_handler;
+    std::atomic<int> m_connectionCount { 0 };
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_TCP_FRAME_SERVER_H_GUARD
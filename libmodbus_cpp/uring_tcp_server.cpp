@@ -0,0 +1,880 @@
+#include <libmodbus_cpp/uring_tcp_server.h>
+#include <libmodbus_cpp/global.h>
+#include <errno.h>
+#include <cstdlib>
+#include <cstring>
+#include "logger.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+// multishot receive is the newest feature used, kernel headers without it are too old
+#if defined(__linux__) && defined(IORING_RECV_MULTISHOT)
+#define LMB_HAVE_IO_URING
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#endif
+
+#define LDOM_UTCP "[modbus.tcp.uring]"
+
+
+libmodbus_cpp::UringTcpServer::UringTcpServer(FrameHandler handler, QObject *parent)
+    : TcpFrameServer(handler, parent)
+{
+    m_clock.start();
+    m_resumeTimer.setSingleShot(true);
+#ifdef USE_QT5
+    connect(&m_resumeTimer, &QTimer::timeout, this, &UringTcpServer::slot_resume);
+    connect(&m_checkTimer, &QTimer::timeout, this, &UringTcpServer::slot_checkConnections);
+#else
+    connect(&m_resumeTimer, SIGNAL(timeout()), this, SLOT(slot_resume()));
+    connect(&m_checkTimer, SIGNAL(timeout()), this, SLOT(slot_checkConnections()));
+#endif
+}
+
+
+libmodbus_cpp::UringTcpServer::~UringTcpServer()
+{
+    close();
+}
+
+
+void libmodbus_cpp::UringTcpServer::setLimits(const TcpConnectionLimits &limits)
+{
+    m_limits = limits;
+    const int interval = m_limits.checkInterval_ms();
+    if (interval > 0) {
+        m_checkTimer.start(interval);
+    } else {
+        m_checkTimer.stop();
+    }
+}
+
+
+#ifdef LMB_HAVE_IO_URING
+
+namespace {
+
+const int MbapHeaderLength = 7;
+
+const unsigned SubmissionEntries = 256;
+const unsigned CompletionEntries = 4096;
+// shared by all connections, so idle connection holds no receive buffer
+const unsigned BufferCount = 256; // power of 2
+const unsigned BufferSize = 2048;
+const unsigned short BufferGroup = 0;
+
+// request kind in low bits of user data, rest is connection
+enum Operation : quint64 {
+    OpRecv = 0,
+    OpSend = 1,
+    OpCancel = 2,
+    OpAccept = 3
+};
+const quint64 OpMask = 3;
+
+int ringSetup(unsigned entries, io_uring_params *params) {
+    // e.g. for seccomp profiles killing io_uring calls instead of failing them
+    if (getenv("LIBMODBUS_CPP_DISABLE_IO_URING")) {
+        errno = ENOSYS;
+        return -1;
+    }
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, Q_NULLPTR, 0));
+}
+
+int ringRegister(int fd, unsigned opcode, const void *arg, unsigned count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+}
+
+
+/// mapped queues of io_uring and its provided receive buffers, no liburing dependency
+struct libmodbus_cpp::UringTcpServer::Ring {
+    int fd = -1;
+    io_uring_params params;
+    void *sqMap = MAP_FAILED;
+    size_t sqMapSize = 0;
+    void *cqMap = MAP_FAILED;
+    size_t cqMapSize = 0;
+    void *sqesMap = MAP_FAILED;
+    size_t sqesMapSize = 0;
+    void *bufRingMap = MAP_FAILED;
+    size_t bufRingMapSize = 0;
+    void *buffersMap = MAP_FAILED;
+    size_t buffersMapSize = 0;
+
+    unsigned *sqHead = Q_NULLPTR;
+    unsigned *sqTail = Q_NULLPTR;
+    unsigned sqMask = 0;
+    unsigned *sqArray = Q_NULLPTR;
+    io_uring_sqe *sqes = Q_NULLPTR;
+    unsigned sqLocalTail = 0;
+    unsigned toSubmit = 0;
+
+    unsigned *cqHead = Q_NULLPTR;
+    unsigned *cqTail = Q_NULLPTR;
+    unsigned cqMask = 0;
+    io_uring_cqe *cqes = Q_NULLPTR;
+
+    io_uring_buf *bufRing = Q_NULLPTR; // io_uring_buf_ring, its flexible array is laid out differently by C++
+    unsigned short *bufRingTail = Q_NULLPTR;
+    uint8_t *buffers = Q_NULLPTR;
+
+    ~Ring() {
+        if (fd != -1) {
+            ::close(fd); // cancels requests in flight
+        }
+        for (auto map : { std::make_pair(sqesMap, sqesMapSize),
+                          std::make_pair(cqMap == sqMap ? MAP_FAILED : cqMap, cqMapSize),
+                          std::make_pair(sqMap, sqMapSize),
+                          std::make_pair(bufRingMap, bufRingMapSize),
+                          std::make_pair(buffersMap, buffersMapSize) }) {
+            if (map.first != MAP_FAILED) {
+                munmap(map.first, map.second);
+            }
+        }
+    }
+
+    bool open() {
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = CompletionEntries;
+        fd = ringSetup(SubmissionEntries, &params);
+        if (fd == -1) {
+            return false;
+        }
+
+        sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+        }
+        sqMap = mmap(Q_NULLPTR, sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqMap == MAP_FAILED) {
+            return false;
+        }
+        cqMap = singleMap ? sqMap : mmap(Q_NULLPTR, cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        sqesMapSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqesMap = mmap(Q_NULLPTR, sqesMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if ((cqMap == MAP_FAILED) || (sqesMap == MAP_FAILED)) {
+            return false;
+        }
+
+        char *sq = static_cast<char*>(sqMap);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sqes = static_cast<io_uring_sqe*>(sqesMap);
+        sqLocalTail = *sqTail;
+        char *cq = static_cast<char*>(cqMap);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        // provided buffers: kernel picks free one per receive completion
+        bufRingMapSize = BufferCount * sizeof(io_uring_buf);
+        bufRingMap = mmap(Q_NULLPTR, bufRingMapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        buffersMapSize = BufferCount * BufferSize;
+        buffersMap = mmap(Q_NULLPTR, buffersMapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if ((bufRingMap == MAP_FAILED) || (buffersMap == MAP_FAILED)) {
+            return false;
+        }
+        bufRing = static_cast<io_uring_buf*>(bufRingMap);
+        bufRingTail = &bufRing[0].resv; // tail overlays reserved field of first entry
+        buffers = static_cast<uint8_t*>(buffersMap);
+
+        io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = reinterpret_cast<quint64>(bufRing);
+        reg.ring_entries = BufferCount;
+        reg.bgid = BufferGroup;
+        if (ringRegister(fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1) {
+            return false;
+        }
+        for (unsigned short id = 0; id < BufferCount; ++id) {
+            recycle(id);
+        }
+        return true;
+    }
+
+    /// zeroed entry, published by submit()
+    io_uring_sqe *sqe() {
+        if (sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= params.sq_entries) {
+            submit();
+            if (sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= params.sq_entries) {
+                return Q_NULLPTR;
+            }
+        }
+        const unsigned index = sqLocalTail & sqMask;
+        io_uring_sqe *e = &sqes[index];
+        memset(e, 0, sizeof(*e));
+        sqArray[index] = index;
+        ++sqLocalTail;
+        ++toSubmit;
+        return e;
+    }
+
+    /// all queued entries by one syscall
+    bool submit(unsigned minComplete = 0) {
+        __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+        while ((toSubmit > 0) || (minComplete > 0)) {
+            const int n = ringEnter(fd, toSubmit, minComplete, minComplete ? IORING_ENTER_GETEVENTS : 0);
+            if (n == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false; // entries stay queued, e.g. until completions are reaped on EBUSY
+            }
+            toSubmit -= std::min<unsigned>(toSubmit, n);
+            minComplete = 0;
+        }
+        return true;
+    }
+
+    /// completions are copied out, so handler may queue new entries
+    template<typename Handler>
+    void reap(Handler handler) {
+        unsigned head = *cqHead;
+        while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            const io_uring_cqe cqe = cqes[head & cqMask];
+            __atomic_store_n(cqHead, ++head, __ATOMIC_RELEASE);
+            handler(cqe.user_data, cqe.res, cqe.flags);
+        }
+    }
+
+    const uint8_t *buffer(unsigned short id) const {
+        return buffers + id * BufferSize;
+    }
+
+    void recycle(unsigned short id) {
+        const unsigned short tail = *bufRingTail;
+        io_uring_buf *b = &bufRing[tail & (BufferCount - 1)];
+        b->addr = reinterpret_cast<quint64>(buffers + id * BufferSize);
+        b->len = BufferSize;
+        b->bid = id;
+        __atomic_store_n(bufRingTail, static_cast<unsigned short>(tail + 1), __ATOMIC_RELEASE);
+    }
+};
+
+
+/// per connection state, buffers are allocated only for partial frames and unsent replies
+struct libmodbus_cpp::UringTcpServer::Connection {
+    int fd;
+    quint64 id;           // serial and descriptor
+    bool closed = false; // shut down, released when its requests in flight complete
+    bool paused = false;
+    bool recvArmed = false;
+    bool replied = false; // in m_replied
+    int inFlight = 0;
+    QByteArray input;     // partial frame or frames held back while paused
+    QByteArray pending;   // replies not yet submitted
+    QByteArray inSend;    // replies owned by send in flight
+    ConnectionThrottle throttle;
+
+    qint64 unsent() const {
+        return pending.size() + inSend.size();
+    }
+};
+
+
+bool libmodbus_cpp::UringTcpServer::isAvailable()
+{
+    // multishot receive is 6.0+, it is checked on real socket pair
+    static const bool available = []() {
+        Ring ring;
+        if (!ring.open()) {
+            return false;
+        }
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1) {
+            return false;
+        }
+        bool ok = false;
+        io_uring_sqe *e = ring.sqe();
+        e->opcode = IORING_OP_RECV;
+        e->fd = sv[0];
+        e->ioprio = IORING_RECV_MULTISHOT;
+        e->flags = IOSQE_BUFFER_SELECT;
+        e->buf_group = BufferGroup;
+        const char probe = 0;
+        if ((::write(sv[1], &probe, 1) == 1) && ring.submit(1)) {
+            ring.reap([&ok](quint64, int result, unsigned flags) {
+                ok = ok || ((result == 1) && (flags & IORING_CQE_F_BUFFER) && (flags & IORING_CQE_F_MORE));
+            });
+        }
+        ::close(sv[0]);
+        ::close(sv[1]);
+        return ok;
+    }();
+    return available;
+}
+
+
+bool libmodbus_cpp::UringTcpServer::listen(int serverSocket)
+{
+    close();
+
+    if (!isAvailable()) {
+        LMB_WGLOG(LDOM_UTCP, "io_uring with multishot receive is not available");
+        return false;
+    }
+    m_ring = new Ring;
+    m_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (!m_ring->open() || (m_event == -1) || (ringRegister(m_ring->fd, IORING_REGISTER_EVENTFD, &m_event, 1) == -1)) {
+        LMB_WGLOG(LDOM_UTCP, "can't set up io_uring:" << strerror(errno));
+        close();
+        return false;
+    }
+    m_serverSocket = serverSocket;
+    armAccept();
+    m_ring->submit();
+
+    // completions are signalled by event descriptor
+    m_notifier = new QSocketNotifier(m_event, QSocketNotifier::Read, this);
+#ifdef USE_QT5
+    connect(m_notifier, &QSocketNotifier::activated, this, &UringTcpServer::slot_activated);
+#else
+    connect(m_notifier, SIGNAL(activated(int)), this, SLOT(slot_activated()));
+#endif
+    return true;
+}
+
+
+void libmodbus_cpp::UringTcpServer::close()
+{
+    delete m_notifier;
+    m_notifier = Q_NULLPTR;
+
+    delete m_ring; // before connections, kernel may hold their buffers
+    m_ring = Q_NULLPTR;
+
+    for (Connection *c : m_connections) {
+        ::close(c->fd);
+        delete c;
+    }
+    m_connections.clear();
+    m_connectionCount.store(0, std::memory_order_relaxed);
+    m_replied.clear();
+    m_rateLimited.clear();
+    m_acceptArmed = false;
+
+    if (m_event != -1) {
+        ::close(m_event);
+        m_event = -1;
+    }
+    if (m_serverSocket != -1) {
+        ::close(m_serverSocket);
+        m_serverSocket = -1;
+    }
+}
+
+
+ssize_t libmodbus_cpp::UringTcpServer::send(const uint8_t *data, int length)
+{
+    Connection *c = m_current;
+    if (!c || c->closed) {
+        errno = ENOTCONN;
+        return -1;
+    }
+
+    // submitted with other replies of completion batch
+    c->pending.append(reinterpret_cast<const char*>(data), length);
+    c->throttle.updateUnsent(m_clock.elapsed(), c->unsent(), false);
+    if (!c->replied) {
+        c->replied = true;
+        m_replied.append(c);
+    }
+    return length;
+}
+
+
+quint64 libmodbus_cpp::UringTcpServer::currentConnection() const
+{
+    return m_current ? m_current->id : 0;
+}
+
+
+bool libmodbus_cpp::UringTcpServer::sendTo(quint64 connection, const uint8_t *data, int length)
+{
+    Connection *c = m_connections.value(static_cast<int>(connection & 0xFFFFFFFF), Q_NULLPTR);
+    if (!m_ring || !c || (c->id != connection) || c->closed) {
+        return false;
+    }
+
+    m_current = c;
+    send(data, length);
+    m_current = Q_NULLPTR;
+    // not in completion batch, nothing else would submit it
+    submitReplies();
+    m_ring->submit();
+    return true;
+}
+
+
+void libmodbus_cpp::UringTcpServer::slot_activated()
+{
+    eventfd_t count;
+    eventfd_read(m_event, &count);
+
+    m_ring->reap([this](quint64 userData, int result, unsigned flags) { complete(userData, result, flags); });
+    submitReplies();
+    m_ring->submit();
+}
+
+
+void libmodbus_cpp::UringTcpServer::complete(quint64 userData, int result, unsigned flags)
+{
+    const bool more = flags & IORING_CQE_F_MORE;
+
+    if ((userData & OpMask) == OpAccept) {
+        if (result >= 0) {
+            Connection *c = new Connection;
+            c->fd = result;
+            c->id = (static_cast<quint64>(++m_serial) << 32) | static_cast<quint32>(result);
+            c->throttle.start(m_clock.elapsed(), m_limits);
+            m_connections.insert(c->fd, c);
+            // shut down connections stay in m_connections until kernel releases them, they are not counted
+            m_connectionCount.fetch_add(1, std::memory_order_relaxed);
+            armRecv(c);
+            LMB_DGLOG(LDOM_UTCP, "new connection:" << c->fd << "count =" << m_connections.size());
+        } else if (result != -ECANCELED) {
+            LMB_WGLOG(LDOM_UTCP, "accept failed:" << strerror(-result));
+        }
+        if (!more) {
+            m_acceptArmed = false;
+            if (result >= 0) {
+                armAccept();
+            } else {
+                scheduleResume(100); // e.g. out of descriptors, don't spin
+            }
+        }
+        return;
+    }
+
+    Connection *c = reinterpret_cast<Connection*>(userData & ~OpMask);
+    switch (userData & OpMask) {
+    case OpRecv:
+        if (flags & IORING_CQE_F_BUFFER) {
+            const unsigned short id = flags >> IORING_CQE_BUFFER_SHIFT;
+            if ((result > 0) && !c->closed) {
+                received(c, m_ring->buffer(id), result);
+            }
+            m_ring->recycle(id);
+        }
+        if (!more) {
+            c->recvArmed = false;
+            --c->inFlight;
+            if ((result == 0) || ((result < 0) && (result != -ENOBUFS) && (result != -ECANCELED))) {
+                shutdown(c); // peer closed or error
+            } else if (!c->closed && !c->paused) {
+                armRecv(c);
+            }
+        }
+        break;
+    case OpSend:
+        --c->inFlight;
+        sent(c, result);
+        break;
+    default: // cancel
+        --c->inFlight;
+        break;
+    }
+    release(c);
+}
+
+
+void libmodbus_cpp::UringTcpServer::received(Connection *c, const uint8_t *data, int length)
+{
+    if (!c->paused && c->input.isEmpty()) {
+        // frames are served right from kernel buffer, only rest is copied
+        const int served = serveFrames(c, data, length);
+        if (!c->closed && (served < length)) {
+            c->input.append(reinterpret_cast<const char*>(data) + served, length - served);
+        }
+        return;
+    }
+    c->input.append(reinterpret_cast<const char*>(data), length);
+    if (!c->paused) {
+        serve(c);
+    }
+}
+
+
+void libmodbus_cpp::UringTcpServer::serve(Connection *c)
+{
+    const int served = serveFrames(c, reinterpret_cast<const uint8_t*>(c->input.constData()), c->input.size());
+    if (c->closed) {
+        return;
+    }
+    c->input.remove(0, served);
+    if (c->input.isEmpty()) {
+        c->input = QByteArray(); // give memory back
+    }
+}
+
+
+int libmodbus_cpp::UringTcpServer::serveFrames(Connection *c, const uint8_t *data, int length)
+{
+    // MBAP: transaction id, protocol id, length of unit id and pdu
+    int offset = 0;
+    while (length - offset >= MbapHeaderLength) {
+        const uint8_t *frame = data + offset;
+        const int frameDataLength = (frame[4] << 8) | frame[5];
+        if ((frameDataLength < 2) || (frameDataLength > MODBUS_TCP_MAX_ADU_LENGTH - 6)) {
+            LMB_WGLOG(LDOM_UTCP, "wrong frame length" << frameDataLength << ", close connection" << c->fd);
+            shutdown(c);
+            break;
+        }
+        const int frameLength = 6 + frameDataLength;
+        if (length - offset < frameLength) {
+            break;
+        }
+        if (c->throttle.isOverUnsent(c->unsent(), m_limits)) {
+            pause(c); // until sent
+            break;
+        }
+        if (!c->throttle.takeRequest(m_clock.elapsed(), m_limits)) {
+            pause(c);
+            m_rateLimited.insert(c->fd);
+            scheduleResume(c->throttle.rateDelay_ms(m_limits));
+            break;
+        }
+        m_current = c;
+        m_handler(frame, frameLength);
+        m_current = Q_NULLPTR;
+        if (c->closed) {
+            break;
+        }
+        offset += frameLength;
+    }
+    return offset;
+}
+
+
+void libmodbus_cpp::UringTcpServer::pause(Connection *c)
+{
+    if (c->paused) {
+        return;
+    }
+    c->paused = true;
+    if (!c->recvArmed) {
+        return;
+    }
+    // socket is not read until resume, so peer is slowed by TCP flow control
+    io_uring_sqe *e = m_ring->sqe();
+    if (e) {
+        e->opcode = IORING_OP_ASYNC_CANCEL;
+        e->addr = reinterpret_cast<quint64>(c) | OpRecv;
+        e->user_data = reinterpret_cast<quint64>(c) | OpCancel;
+        ++c->inFlight;
+    }
+}
+
+
+void libmodbus_cpp::UringTcpServer::resume(Connection *c)
+{
+    c->paused = false;
+    serve(c); // may be paused again
+    if (!c->closed && !c->paused && !c->recvArmed) {
+        armRecv(c);
+    }
+}
+
+
+void libmodbus_cpp::UringTcpServer::sent(Connection *c, int result)
+{
+    if (result < 0) {
+        shutdown(c);
+        return;
+    }
+    c->inSend.remove(0, result);
+    if (!c->inSend.isEmpty()) {
+        c->pending.prepend(c->inSend); // short send, rest goes first
+    }
+    c->inSend = QByteArray();
+    if (c->closed) {
+        return;
+    }
+    c->throttle.updateUnsent(m_clock.elapsed(), c->unsent(), result > 0);
+    if (!c->pending.isEmpty() && !c->replied) {
+        c->replied = true;
+        m_replied.append(c);
+    }
+    if (c->paused && !m_rateLimited.contains(c->fd) && !c->throttle.isOverUnsent(c->unsent(), m_limits)) {
+        resume(c);
+    }
+}
+
+
+void libmodbus_cpp::UringTcpServer::armAccept()
+{
+    io_uring_sqe *e = m_ring->sqe();
+    if (!e) {
+        scheduleResume(100);
+        return;
+    }
+    e->opcode = IORING_OP_ACCEPT;
+    e->fd = m_serverSocket;
+    e->ioprio = IORING_ACCEPT_MULTISHOT;
+    e->accept_flags = SOCK_CLOEXEC;
+    e->user_data = OpAccept;
+    m_acceptArmed = true;
+}
+
+
+void libmodbus_cpp::UringTcpServer::armRecv(Connection *c)
+{
+    io_uring_sqe *e = m_ring->sqe();
+    if (!e) {
+        shutdown(c); // can't be read
+        return;
+    }
+    e->opcode = IORING_OP_RECV;
+    e->fd = c->fd;
+    e->ioprio = IORING_RECV_MULTISHOT;
+    e->flags = IOSQE_BUFFER_SELECT;
+    e->buf_group = BufferGroup;
+    e->user_data = reinterpret_cast<quint64>(c) | OpRecv;
+    c->recvArmed = true;
+    ++c->inFlight;
+}
+
+
+void libmodbus_cpp::UringTcpServer::submitReplies()
+{
+    // one send per connection: replies of all its frames of batch are coalesced
+    const QVector<Connection*> replied = m_replied;
+    m_replied.clear();
+    for (Connection *c : replied) {
+        c->replied = false;
+        if (!c->closed && c->inSend.isEmpty() && !c->pending.isEmpty()) {
+            io_uring_sqe *e = m_ring->sqe();
+            if (!e) {
+                c->replied = true;
+                m_replied.append(c); // next batch
+                continue;
+            }
+            c->inSend.swap(c->pending);
+            e->opcode = IORING_OP_SEND;
+            e->fd = c->fd;
+            e->addr = reinterpret_cast<quint64>(c->inSend.constData());
+            e->len = c->inSend.size();
+            e->msg_flags = MSG_NOSIGNAL;
+            e->user_data = reinterpret_cast<quint64>(c) | OpSend;
+            ++c->inFlight;
+        }
+        release(c);
+    }
+}
+
+
+void libmodbus_cpp::UringTcpServer::shutdown(Connection *c)
+{
+    if (c->closed) {
+        return;
+    }
+    LMB_DGLOG(LDOM_UTCP, "shut down connection:" << c->fd);
+    c->closed = true;
+    m_connectionCount.fetch_sub(1, std::memory_order_relaxed);
+    m_rateLimited.remove(c->fd);
+    c->input = QByteArray();
+    c->pending = QByteArray();
+    ::shutdown(c->fd, SHUT_RDWR); // completes receive and sends in flight
+}
+
+
+void libmodbus_cpp::UringTcpServer::release(Connection *c)
+{
+    // descriptor is kept open while kernel may refer it, so it is not reused meanwhile
+    if (c->closed && (c->inFlight == 0) && !c->replied) {
+        m_connections.remove(c->fd);
+        ::close(c->fd);
+        delete c;
+    }
+}
+
+
+void libmodbus_cpp::UringTcpServer::scheduleResume(int delay_ms)
+{
+    // one timer for all limited connections: earliest of them is due first, others are limited again
+    const qint64 at = m_clock.elapsed() + delay_ms;
+    if (!m_resumeTimer.isActive() || (at < m_resumeAt_ms)) {
+        m_resumeAt_ms = at;
+        m_resumeTimer.start(delay_ms);
+    }
+}
+
+
+void libmodbus_cpp::UringTcpServer::slot_resume()
+{
+    if (!m_ring) {
+        return;
+    }
+    if (!m_acceptArmed) {
+        armAccept();
+    }
+    const QSet<int> limited = m_rateLimited;
+    m_rateLimited.clear();
+    for (int fd : limited) {
+        Connection *c = m_connections.value(fd, Q_NULLPTR);
+        if (c && !c->closed && !c->throttle.isOverUnsent(c->unsent(), m_limits)) {
+            resume(c); // may be limited again
+        }
+    }
+    submitReplies();
+    m_ring->submit();
+}
+
+
+void libmodbus_cpp::UringTcpServer::slot_checkConnections()
+{
+    if (!m_ring) {
+        return;
+    }
+    const qint64 now = m_clock.elapsed();
+    QVector<Connection*> expired;
+    for (Connection *c : m_connections) {
+        if (!c->closed && c->throttle.isExpired(now, m_limits)) {
+            expired.append(c);
+        }
+    }
+    for (Connection *c : expired) {
+        LMB_DGLOG(LDOM_UTCP, "connection expired:" << c->fd);
+        shutdown(c);
+        release(c);
+    }
+    m_ring->submit();
+}
+
+#else
+
+bool libmodbus_cpp::UringTcpServer::isAvailable()
+{
+    return false;
+}
+
+bool libmodbus_cpp::UringTcpServer::listen(int serverSocket)
+{
+    Q_UNUSED(serverSocket);
+    LMB_WGLOG(LDOM_UTCP, "io_uring connections are supported on Linux only");
+    return false;
+}
+
+void libmodbus_cpp::UringTcpServer::close()
+{
+}
+
+ssize_t libmodbus_cpp::UringTcpServer::send(const uint8_t *data, int length)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(length);
+    return -1;
+}
+
+quint64 libmodbus_cpp::UringTcpServer::currentConnection() const
+{
+    return 0;
+}
+
+bool libmodbus_cpp::UringTcpServer::sendTo(quint64 connection, const uint8_t *data, int length)
+{
+    Q_UNUSED(connection);
+    Q_UNUSED(data);
+    Q_UNUSED(length);
+    return false;
+}
+
+void libmodbus_cpp::UringTcpServer::slot_activated()
+{
+}
+
+void libmodbus_cpp::UringTcpServer::complete(quint64 userData, int result, unsigned flags)
+{
+    Q_UNUSED(userData);
+    Q_UNUSED(result);
+    Q_UNUSED(flags);
+}
+
+void libmodbus_cpp::UringTcpServer::received(Connection *c, const uint8_t *data, int length)
+{
+    Q_UNUSED(c);
+    Q_UNUSED(data);
+    Q_UNUSED(length);
+}
+
+void libmodbus_cpp::UringTcpServer::serve(Connection *c)
+{
+    Q_UNUSED(c);
+}
+
+int libmodbus_cpp::UringTcpServer::serveFrames(Connection *c, const uint8_t *data, int length)
+{
+    Q_UNUSED(c);
+    Q_UNUSED(data);
+    Q_UNUSED(length);
+    return 0;
+}
+
+void libmodbus_cpp::UringTcpServer::pause(Connection *c)
+{
+    Q_UNUSED(c);
+}
+
+void libmodbus_cpp::UringTcpServer::resume(Connection *c)
+{
+    Q_UNUSED(c);
+}
+
+void libmodbus_cpp::UringTcpServer::sent(Connection *c, int result)
+{
+    Q_UNUSED(c);
+    Q_UNUSED(result);
+}
+
+void libmodbus_cpp::UringTcpServer::armAccept()
+{
+}
+
+void libmodbus_cpp::UringTcpServer::armRecv(Connection *c)
+{
+    Q_UNUSED(c);
+}
+
+void libmodbus_cpp::UringTcpServer::submitReplies()
+{
+}
+
+void libmodbus_cpp::UringTcpServer::shutdown(Connection *c)
+{
+    Q_UNUSED(c);
+}
+
+void libmodbus_cpp::UringTcpServer::release(Connection *c)
+{
+    Q_UNUSED(c);
+}
+
+void libmodbus_cpp::UringTcpServer::slot_resume()
+{
+}
+
+void libmodbus_cpp::UringTcpServer::slot_checkConnections()
+{
+}
+
+#endif // LMB_HAVE_IO_URING
@@ -0,0 +1,85 @@
+#ifndef LIBMODBUS_CPP_URING_TCP_SERVER_H_GUARD
+#define LIBMODBUS_CPP_URING_TCP_SERVER_H_GUARD
+
+#include <QHash>
+#include <QSet>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
+#include "tcp_frame_server.h"
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief Modbus TCP connections of slave served through io_uring
+ * Connections are accepted and read by multishot requests into one ring of kernel provided
+ * buffers, so there is no recv syscall per request and idle connection holds no buffer.
+ * Replies of one completion batch are coalesced per connection and submitted by one syscall.
+ * Connection over limits is paused by cancelling its receive.
+ * Linux 6.0+ only, listen() fails when io_uring or its multishot receive is not available.
+ */
+class UringTcpServer : public TcpFrameServer
+{
+    Q_OBJECT
+
+public:
+    explicit UringTcpServer(FrameHandler handler, QObject *parent = Q_NULLPTR);
+    ~UringTcpServer() override;
+
+    /// io_uring with multishot receive and provided buffer rings may be used
+    static bool isAvailable();
+
+    bool listen(int serverSocket) override;
+    void close() override;
+    void setLimits(const TcpConnectionLimits &limits) override;
+    ssize_t send(const uint8_t *data, int length) override;
+    quint64 currentConnection() const override;
+    bool sendTo(quint64 connection, const uint8_t *data, int length) override;
+
+private slots:
+    void slot_activated();
+    void slot_resume();
+    void slot_checkConnections();
+
+private:
+    struct Ring;
+    struct Connection;
+
+    void complete(quint64 userData, int result, unsigned flags);
+    void received(Connection *c, const uint8_t *data, int length);
+    void serve(Connection *c);
+    int serveFrames(Connection *c, const uint8_t *data, int length);
+    void pause(Connection *c);
+    void scheduleResume(int delay_ms);
+    void resume(Connection *c);
+    void sent(Connection *c, int result);
+    void armAccept();
+    void armRecv(Connection *c);
+    void submitReplies();
+    void shutdown(Connection *c);
+    void release(Connection *c);
+
+    Ring *m_ring = Q_NULLPTR;
+    int m_serverSocket = -1;
+    int m_event = -1;
+    QSocketNotifier *m_notifier = Q_NULLPTR;
+    QHash<int, Connection*> m_connections;
+    QVector<Connection*> m_replied;
+    Connection *m_current = Q_NULLPTR;
+    quint32 m_serial = 0; // of accepted connections, ids of reused descriptors differ
+    bool m_acceptArmed = false;
+
+    TcpConnectionLimits m_limits;
+    QElapsedTimer m_clock;
+    QTimer m_checkTimer;
+    QTimer m_resumeTimer;
+    qint64 m_resumeAt_ms = 0;
+    QSet<int> m_rateLimited;
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_URING_TCP_SERVER_H_GUARD
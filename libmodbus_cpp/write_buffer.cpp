@@ -0,0 +1,184 @@
+#include <libmodbus_cpp/write_buffer.h>
+
+namespace {
+
+/// item past 0xFFFF would wrap to start of table, nothing is staged then
+void checkRange(uint16_t address, int count) {
+    if (static_cast<int>(address) + count > 0x10000) {
+        throw libmodbus_cpp::LocalWriteError("wrong address");
+    }
+}
+
+/// first run of consecutive addresses, not longer than maxCount
+template<typename ValueType>
+QVector<ValueType> firstRun(const QMap<uint16_t, ValueType> &table, int maxCount, uint16_t &address, bool &isLast) {
+    auto it = table.begin();
+    address = it.key();
+    QVector<ValueType> values;
+    while ((it != table.end()) && (it.key() == address + values.size()) && (values.size() < maxCount)) {
+        values.append(it.value());
+        ++it;
+    }
+    isLast = (it == table.end());
+    return values;
+}
+
+template<typename ValueType>
+void dropFirst(QMap<uint16_t, ValueType> &table, int count) {
+    for (int i = 0; i < count; ++i) {
+        table.erase(table.begin());
+    }
+}
+
+/// sends runs of consecutive addresses, each run is split by maxCount
+template<typename ValueType, typename WriteFunc>
+void flushTable(QMap<uint16_t, ValueType> &table, int maxCount, int &requestCount, WriteFunc write) {
+    while (!table.isEmpty()) {
+        uint16_t address;
+        bool isLast;
+        const QVector<ValueType> values = firstRun(table, maxCount, address, isLast);
+        write(address, values);
+        ++requestCount;
+        dropFirst(table, values.size());
+    }
+}
+
+}
+
+
+libmodbus_cpp::WriteBuffer::WriteBuffer(AbstractMaster *master) :
+    m_master(master)
+{
+}
+
+
+void libmodbus_cpp::WriteBuffer::writeCoil(uint16_t address, bool value)
+{
+    m_coils.insert(address, value);
+    staged();
+}
+
+
+void libmodbus_cpp::WriteBuffer::writeCoils(uint16_t address, const QVector<bool> &values)
+{
+    checkRange(address, values.size());
+    for (int i = 0; i < values.size(); ++i) {
+        m_coils.insert(address + i, values.at(i));
+    }
+    staged();
+}
+
+
+void libmodbus_cpp::WriteBuffer::writeHoldingRegisters(uint16_t address, const QVector<uint16_t> &values)
+{
+    checkRange(address, values.size());
+    for (int i = 0; i < values.size(); ++i) {
+        m_regs.insert(address + i, values.at(i));
+    }
+    staged();
+}
+
+
+void libmodbus_cpp::WriteBuffer::setFlushThreshold(int itemCount)
+{
+    m_flushThreshold = itemCount;
+}
+
+
+void libmodbus_cpp::WriteBuffer::setFlushInterval(int interval_ms)
+{
+    m_flushInterval_ms = interval_ms;
+}
+
+
+bool libmodbus_cpp::WriteBuffer::flushIfDue()
+{
+    if (isEmpty()) {
+        return false;
+    }
+    const bool bySize = (m_flushThreshold > 0) && (pendingCount() >= m_flushThreshold);
+    const bool byAge = (m_flushInterval_ms > 0) && m_age.isValid() && (m_age.elapsed() >= m_flushInterval_ms);
+    if (!bySize && !byAge) {
+        return false;
+    }
+    flush();
+    return true;
+}
+
+
+void libmodbus_cpp::WriteBuffer::flush()
+{
+    flushTable(m_coils, MODBUS_MAX_WRITE_BITS, m_requestCount, [this](uint16_t address, const QVector<bool> &values) {
+        m_master->writeCoils(address, values);
+    });
+    flushTable(m_regs, MODBUS_MAX_WRITE_REGISTERS, m_requestCount, [this](uint16_t address, const QVector<uint16_t> &values) {
+        m_master->writeHoldingRegisters(address, values);
+    });
+    m_age.invalidate();
+}
+
+
+QVector<uint16_t> libmodbus_cpp::WriteBuffer::flushAndRead(uint16_t readAddress, int readCount)
+{
+    flushTable(m_coils, MODBUS_MAX_WRITE_BITS, m_requestCount, [this](uint16_t address, const QVector<bool> &values) {
+        m_master->writeCoils(address, values);
+    });
+
+    QVector<uint16_t> result;
+    bool isRead = false;
+    while (!m_regs.isEmpty()) {
+        uint16_t address;
+        bool isLast;
+        const QVector<uint16_t> values = firstRun(m_regs, MODBUS_MAX_WRITE_REGISTERS, address, isLast);
+        if (isLast && (values.size() <= MODBUS_MAX_WR_WRITE_REGISTERS)) {
+            result = m_master->writeAndReadHoldingRegisters(address, values, readAddress, readCount);
+            isRead = true;
+        } else {
+            m_master->writeHoldingRegisters(address, values);
+        }
+        ++m_requestCount;
+        dropFirst(m_regs, values.size());
+    }
+    m_age.invalidate();
+
+    if (!isRead) {
+        result = m_master->readHoldingRegisters(readAddress, readCount);
+        ++m_requestCount;
+    }
+    return result;
+}
+
+
+void libmodbus_cpp::WriteBuffer::clear()
+{
+    m_coils.clear();
+    m_regs.clear();
+    m_age.invalidate();
+}
+
+
+bool libmodbus_cpp::WriteBuffer::isEmpty() const
+{
+    return m_coils.isEmpty() && m_regs.isEmpty();
+}
+
+
+int libmodbus_cpp::WriteBuffer::pendingCount() const
+{
+    return m_coils.size() + m_regs.size();
+}
+
+
+int libmodbus_cpp::WriteBuffer::requestCount() const
+{
+    return m_requestCount;
+}
+
+
+void libmodbus_cpp::WriteBuffer::staged()
+{
+    if (!m_age.isValid()) {
+        m_age.start();
+    }
+    flushIfDue();
+}
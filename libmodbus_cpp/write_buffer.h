@@ -0,0 +1,77 @@
+#ifndef LIBMODBUS_CPP_WRITE_BUFFER_H_GUARD
+#define LIBMODBUS_CPP_WRITE_BUFFER_H_GUARD
+
+#include <QMap>
+#include <QVector>
+#include <QElapsedTimer>
+#include <cstring>
+#include <algorithm>
+#include "abstract_master.h"
+
+namespace libmodbus_cpp {
+
+
+/**
+ * @brief write-combining buffer on top of master
+ * Writes are staged per address, later write to same address wins. Flush sends
+ * adjacent coils as FC15 and adjacent holding registers as FC16 requests, each
+ * as long as PDU allows. Buffer is flushed explicitly or when size or age
+ * trigger fires on next staged write (or flushIfDue() call).
+ * Destructor doesn't flush: error of remote side can't be reported from it.
+ * Range which passes address 0xFFFF is rejected by LocalWriteError.
+ */
+class WriteBuffer
+{
+    AbstractMaster *m_master;
+    QMap<uint16_t, bool> m_coils;
+    QMap<uint16_t, uint16_t> m_regs;
+    int m_flushThreshold = 0;
+    int m_flushInterval_ms = 0;
+    QElapsedTimer m_age;
+    int m_requestCount = 0;
+
+public:
+    explicit WriteBuffer(AbstractMaster *master);
+
+    WriteBuffer(const WriteBuffer&) = delete;
+    WriteBuffer& operator=(const WriteBuffer&) = delete;
+
+    void writeCoil(uint16_t address, bool value);
+    void writeCoils(uint16_t address, const QVector<bool> &values);
+
+    template<typename ValueType>
+    void writeHoldingRegister(uint16_t address, ValueType value) {
+        QVector<uint16_t> regs(std::max(sizeof(ValueType) / sizeof(uint16_t), static_cast<size_t>(1u)), 0);
+        memcpy(regs.data(), &value, sizeof(ValueType));
+        writeHoldingRegisters(address, regs);
+    }
+
+    /// registers in host order as in AbstractMaster
+    void writeHoldingRegisters(uint16_t address, const QVector<uint16_t> &values);
+
+    /// flush when count of staged items reaches threshold, 0 to disable
+    void setFlushThreshold(int itemCount);
+    /// flush when oldest staged item is older than interval, 0 to disable
+    void setFlushInterval(int interval_ms);
+
+    /// flushes if any trigger fired, true if flush was done
+    bool flushIfDue();
+    /// sent items are removed even if one of later requests throws
+    void flush();
+    /// flush with read of holding registers piggybacked on last register write (FC23) when possible
+    QVector<uint16_t> flushAndRead(uint16_t readAddress, int readCount);
+    void clear();
+
+    bool isEmpty() const;
+    int pendingCount() const;
+    /// count of requests sent by this buffer
+    int requestCount() const;
+
+private:
+    void staged();
+};
+
+
+} // ns
+
+#endif // LIBMODBUS_CPP_WRITE_BUFFER_H_GUARD
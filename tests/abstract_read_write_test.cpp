@@ -1,4 +1,23 @@
 #include "abstract_read_write_test.h"
+#include <libmodbus_cpp/write_buffer.h>
+#include <libmodbus_cpp/register_layout.h>
+
+namespace {
+
+struct RemoteTestBlock {
+    float speed;
+    uint16_t state;
+    int32_t position;
+    double total;
+};
+
+using RemoteTestBlockLayout = libmodbus_cpp::RegisterLayout<RemoteTestBlock,
+    LMB_REGISTER_FIELD(RemoteTestBlock, speed, 0),
+    LMB_REGISTER_FIELD(RemoteTestBlock, state, 2),
+    LMB_REGISTER_FIELD_ORDERED(RemoteTestBlock, position, 3, libmodbus_cpp::FieldOrder::BigEndian),
+    LMB_REGISTER_FIELD(RemoteTestBlock, total, 6)>;
+
+}
 
 void libmodbus_cpp::AbstractReadWriteTest::testConnection()
 {
@@ -256,6 +275,110 @@ void libmodbus_cpp::AbstractReadWriteTest::writeReadHoldingRegisters_double()
     testWriteToHoldingRegisters<double>();
 }
 
+void libmodbus_cpp::AbstractReadWriteTest::writeBuffered()
+{
+    connect();
+    try {
+        WriteBuffer buffer(m_master.data());
+        for (int i = 0; i < TABLE_SIZE; i += 2) {
+            buffer.writeHoldingRegister<uint32_t>(i, 0x10000u * i + i + 1);
+            buffer.writeCoil(i, true);
+            buffer.writeCoil(i + 1, false);
+        }
+        buffer.writeHoldingRegister<uint16_t>(4, 0xABCD);
+        QCOMPARE(buffer.pendingCount(), 2 * TABLE_SIZE);
+        QCOMPARE(buffer.requestCount(), 0);
+        buffer.flush();
+        QCOMPARE(buffer.isEmpty(), true);
+        QCOMPARE(buffer.requestCount(), 2);
+
+        QCOMPARE(m_master->readHoldingRegister<uint16_t>(4), (uint16_t)0xABCD);
+        QCOMPARE(m_master->readHoldingRegister<uint32_t>(TABLE_SIZE - 2), 0x10000u * (TABLE_SIZE - 2) + TABLE_SIZE - 1);
+        QVector<bool> coils = m_master->readCoils(0, TABLE_SIZE);
+        for (int i = 0; i < TABLE_SIZE; ++i)
+            QCOMPARE(coils.at(i), !(bool)(i & 1));
+
+        buffer.setFlushThreshold(4);
+        buffer.writeHoldingRegister<uint16_t>(0, 1);
+        buffer.writeHoldingRegister<uint16_t>(10, 1);
+        buffer.writeHoldingRegister<uint16_t>(20, 1);
+        QCOMPARE(buffer.requestCount(), 2);
+        buffer.writeHoldingRegister<uint16_t>(30, 1);
+        QCOMPARE(buffer.isEmpty(), true);
+        QCOMPARE(buffer.requestCount(), 6);
+
+        // range past last address doesn't wrap to address 0
+        bool thrown = false;
+        try {
+            buffer.writeHoldingRegister<uint32_t>(0xFFFF, 1);
+        } catch (LocalWriteError &) {
+            thrown = true;
+        }
+        QVERIFY(thrown);
+        QCOMPARE(buffer.isEmpty(), true);
+    } catch (RemoteRWError &e) {
+        QVERIFY2(false, e.what());
+    }
+    disconnect();
+}
+
+void libmodbus_cpp::AbstractReadWriteTest::writeAndReadHoldingRegisters()
+{
+    connect();
+    try {
+        m_master->writeHoldingRegister<uint32_t>(8, 0x12345678u);
+        uint32_t previous = m_master->writeAndReadHoldingRegisters<uint32_t>(10, (uint32_t)0xCAFEBABEu, 8);
+        QCOMPARE(previous, 0x12345678u);
+        QCOMPARE(m_master->readHoldingRegister<uint32_t>(10), 0xCAFEBABEu);
+
+        QVector<uint16_t> regs = m_master->writeAndReadHoldingRegisters(20, QVector<uint16_t>{ 1, 2, 3 }, 19, 5);
+        QCOMPARE(regs.size(), 5);
+        QCOMPARE(regs.at(1), (uint16_t)1);
+        QCOMPARE(regs.at(3), (uint16_t)3);
+
+        WriteBuffer buffer(m_master.data());
+        buffer.writeHoldingRegister<uint16_t>(30, 7);
+        buffer.writeHoldingRegister<uint16_t>(31, 8);
+        regs = buffer.flushAndRead(30, 2);
+        QCOMPARE(buffer.requestCount(), 1);
+        QCOMPARE(regs.at(0), (uint16_t)7);
+        QCOMPARE(regs.at(1), (uint16_t)8);
+    } catch (RemoteRWError &e) {
+        QVERIFY2(false, e.what());
+    }
+    disconnect();
+}
+
+void libmodbus_cpp::AbstractReadWriteTest::writeReadHoldingStruct()
+{
+    connect();
+    const RemoteTestBlock block { 1.5f, 0xBEEF, -123456, 2.25e10 };
+    const ByteOrder orders[] = { ByteOrder::LittleEndian, ByteOrder::BigEndian };
+    try {
+        for (const ByteOrder order : orders) {
+            m_master->setTargetByteOrder(order);
+            m_master->writeHoldingStruct<RemoteTestBlockLayout>(40, block);
+
+            const RemoteTestBlock read = m_master->readHoldingStruct<RemoteTestBlockLayout>(40);
+            QCOMPARE(read.speed, block.speed);
+            QCOMPARE(read.state, block.state);
+            QCOMPARE(read.position, block.position);
+            QCOMPARE(read.total, block.total);
+
+            // fields are the registers of per-value access
+            QCOMPARE(m_master->readHoldingRegister<uint16_t>(42), block.state);
+            QVector<uint16_t> regs(RemoteTestBlockLayout::RegCount, 0);
+            RemoteTestBlockLayout::encode(block, regs.data(), order);
+            QVERIFY(m_master->readHoldingRegisters(40, RemoteTestBlockLayout::RegCount) == regs);
+        }
+    } catch (RemoteRWError &e) {
+        m_master->setTargetByteOrder(ByteOrder::LittleEndian);
+        QVERIFY2(false, e.what());
+    }
+    m_master->setTargetByteOrder(ByteOrder::LittleEndian);
+    disconnect();
+}
+
 void libmodbus_cpp::AbstractReadWriteTest::connect()
 {
     bool masterConnected = m_master->connect();
@@ -56,6 +56,9 @@ private slots:
     void writeReadHoldingRegisters_int64();
     void writeReadHoldingRegisters_uint64();
     void writeReadHoldingRegisters_double();
+    void writeBuffered();
+    void writeAndReadHoldingRegisters();
+    void writeReadHoldingStruct();
     virtual void cleanupTestCase() = 0;
 
 private:
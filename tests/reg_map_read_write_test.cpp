@@ -1,4 +1,22 @@
 #include "reg_map_read_write_test.h"
+#include <QTemporaryFile>
+#include <libmodbus_cpp/change_tracker.h>
+#include <libmodbus_cpp/response_cache.h>
+#include <libmodbus_cpp/hook_pool.h>
+#include <libmodbus_cpp/deferred_reply.h>
+#include <libmodbus_cpp/hook_gate.h>
+#include <libmodbus_cpp/parallel_master_tcp.h>
+#include <libmodbus_cpp/rtt_estimator.h>
+#include <libmodbus_cpp/latency_window.h>
+#include <libmodbus_cpp/tcp_connection_manager.h>
+#include <libmodbus_cpp/shared_map.h>
+#include <libmodbus_cpp/pdu.h>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
 
 void libmodbus_cpp::RegMapReadWriteTest::initTestCase()
 {
@@ -38,6 +56,14 @@ void libmodbus_cpp::RegMapReadWriteTest::testHoldingRegisters()
     testHoldingValue(int64_t(rand()), m_slave, address);
     testHoldingValue(float(rand()), m_slave, address);
     testHoldingValue(double(rand()), m_slave, address);
+
+    // value of odd size is padded to whole registers, padding byte is kept
+    struct Rgb { uint8_t r, g, b; };
+    m_slave->setValueToHoldingRegister(41, uint16_t(0xABCD));
+    m_slave->setValueToHoldingRegister(40, Rgb { 1, 2, 3 });
+    const Rgb rgb = m_slave->getValueFromHoldingRegister<Rgb>(40);
+    QVERIFY((rgb.r == 1) && (rgb.g == 2) && (rgb.b == 3));
+    QCOMPARE(m_slave->getValueFromHoldingRegister<uint16_t>(41) >> 8, 0xAB);
 }
 
 void libmodbus_cpp::RegMapReadWriteTest::testInputRegisters()
@@ -55,6 +81,792 @@ void libmodbus_cpp::RegMapReadWriteTest::testInputRegisters()
     testInputValue(double(rand()), m_slave, address);
 }
 
+void libmodbus_cpp::RegMapReadWriteTest::testSeqLockHoldingRegisters()
+{
+    m_slave->setMapConcurrency(MapConcurrency::SeqLock);
+
+    const double A = 1.0 / 3.0;
+    const double B = -12345.678;
+    std::atomic_bool stop { false };
+
+    m_slave->setValueToHoldingRegister(0, A);
+    std::thread writer([&]() {
+        bool flip = false;
+        while (!stop) {
+            m_slave->setValueToHoldingRegister(0, flip ? A : B);
+            flip = !flip;
+        }
+    });
+
+    bool torn = false;
+    for (int i = 0; i < 100000; ++i) {
+        const double v = m_slave->getValueFromHoldingRegister<double>(0);
+        torn = torn || ((v != A) && (v != B));
+    }
+    stop = true;
+    writer.join();
+
+    // setter and getter inside of write section don't wait for own odd sequence
+    {
+        SeqLockWriteGuard outer(m_backend->getMapLock());
+        m_slave->setValueToHoldingRegister(0, A);
+        QCOMPARE(m_slave->getValueFromHoldingRegister<double>(0), A);
+    }
+    QCOMPARE(m_backend->getMapLock()->sequence() & 1, 0u);
+
+    m_slave->setMapConcurrency(MapConcurrency::None);
+    QVERIFY(!torn);
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testTransaction()
+{
+    m_slave->setValueToHoldingRegister(0, uint16_t(0));
+    m_slave->setValueToHoldingRegister(1, double(0));
+
+    MapTransaction t = m_slave->beginTransaction();
+    t.setValueToHoldingRegister(0, uint16_t(42));
+    t.setValueToHoldingRegister(1, double(3.5));
+    t.setValueToCoil(3, true);
+    QCOMPARE(m_slave->getValueFromHoldingRegister<uint16_t>(0), uint16_t(0));
+
+    t.commit();
+    QVERIFY(t.isEmpty());
+    QCOMPARE(m_slave->getValueFromHoldingRegister<uint16_t>(0), uint16_t(42));
+    QCOMPARE(m_slave->getValueFromHoldingRegister<double>(1), double(3.5));
+    QCOMPARE(m_slave->getValueFromCoil(3), true);
+
+    // out of map write rejects whole batch
+    t.setValueToHoldingRegister(0, uint16_t(7));
+    t.setValueToHoldingRegister(m_backend->getMap()->nb_registers - 1, double(1));
+    bool thrown = false;
+    try {
+        t.commit();
+    } catch (LocalWriteError &) {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+    QCOMPARE(m_slave->getValueFromHoldingRegister<uint16_t>(0), uint16_t(42));
+    t.clear();
+
+    // byte setters change only their half of register
+    m_slave->setValueToHoldingRegister(5, uint16_t(0x1234));
+    m_slave->setValueToHoldingRegister(6, uint16_t(0x1234));
+    m_slave->setValueToHoldingRegister(6, uint8_t(0x56));
+    t.setValueToHoldingRegister(5, uint8_t(0x56));
+    t.setValueToHoldingRegister(7, uint16_t(0x789A));
+    t.commit();
+    QCOMPARE(m_slave->getValueFromHoldingRegister<uint16_t>(5), m_slave->getValueFromHoldingRegister<uint16_t>(6));
+    QCOMPARE(m_slave->getValueFromHoldingRegister<uint8_t>(5), uint8_t(0x56));
+    QCOMPARE(m_slave->getValueFromHoldingRegister<uint16_t>(7), uint16_t(0x789A));
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testChangeTracker()
+{
+    ChangeTracker t(m_backend->getMap(), true);
+    uint8_t before[ChangeTracker::MaxWriteBytes];
+
+    // same block written twice and neighbour block: one coalesced range
+    t.markWritten(DataType::HoldingRegister, 4, 4, Q_NULLPTR);
+    t.markWritten(DataType::HoldingRegister, 4, 4, Q_NULLPTR);
+    t.markWritten(DataType::HoldingRegister, 8, 2, Q_NULLPTR);
+    t.markWritten(DataType::Coil, 1, 1, Q_NULLPTR);
+
+    QVector<MapChange> changes = t.takeChanges();
+    QCOMPARE(changes.size(), 2);
+    QVERIFY(changes[0].type == DataType::Coil);
+    QCOMPARE(changes[0].range.from, Address(1));
+    QCOMPARE(changes[0].range.to, Address(1));
+    QVERIFY(changes[1].type == DataType::HoldingRegister);
+    QCOMPARE(changes[1].range.from, Address(4));
+    QCOMPARE(changes[1].range.to, Address(9));
+    QVERIFY(t.takeChanges().isEmpty());
+
+    // rewrite with identical values is not a change
+    QVERIFY(t.snapshot(DataType::HoldingRegister, 0, 2, before));
+    m_slave->setValueToHoldingRegister(1, m_slave->getValueFromHoldingRegister<uint16_t>(1) + 1);
+    t.markWritten(DataType::HoldingRegister, 0, 2, before);
+    changes = t.takeChanges();
+    QCOMPARE(changes.size(), 1);
+    QCOMPARE(changes[0].range.from, Address(1));
+    QCOMPARE(changes[0].range.to, Address(1));
+
+    // debounced range is held back
+    t.setDebounce(DataType::HoldingRegister, 16, 8, 60 * 1000);
+    t.markWritten(DataType::HoldingRegister, 16, 1, Q_NULLPTR);
+    QVERIFY(t.takeChanges().isEmpty());
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testPersistentMap()
+{
+    // removed with temporary file, empty one is inited as other layout
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.close();
+    const QByteArray path = QFile::encodeName(file.fileName());
+
+    {
+        QScopedPointer<SlaveTcpBackend> b(new SlaveTcpBackend());
+        QVERIFY(b->initPersistentMap(path.constData(), 8, 8, 64, 64));
+        SlaveTcp s(b.take());
+        s.setValueToHoldingRegister(10, double(2.25));
+        s.setValueToCoil(3, true);
+    }
+
+    {
+        SlaveTcpBackend *b = new SlaveTcpBackend();
+        SlaveTcp s(b);
+        QVERIFY(b->initPersistentMap(path.constData(), 8, 8, 64, 64));
+        QCOMPARE(s.getValueFromHoldingRegister<double>(10), double(2.25));
+        QCOMPARE(s.getValueFromCoil(3), true);
+
+        // other layout starts from zeroes
+        QVERIFY(b->initPersistentMap(path.constData(), 8, 8, 32, 64));
+        QCOMPARE(s.getValueFromHoldingRegister<double>(10), double(0));
+    }
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testSharedMap()
+{
+    const char *name = "/lmb_test_shared_map";
+
+    SharedMapClient c;
+    {
+        SlaveTcpBackend *b = new SlaveTcpBackend();
+        SlaveTcp s(b);
+        QVERIFY(b->initRegisterMap(8, 8));
+        b->enableResponseCache(16);
+        QVERIFY(b->initSharedMap(name, 8, 8, 64, 64));
+        QVERIFY(b->getMapConcurrency() == MapConcurrency::SeqLock);
+        // cache can't see writes of other processes
+        QCOMPARE(b->getResponseCacheStats().maxEntries, 0);
+        s.setValueToHoldingRegister(2, uint16_t(0x1234));
+
+        QVERIFY(c.open(name));
+        QCOMPARE(c.count(SharedHoldingRegisters), 64);
+
+        uint16_t reg = 0;
+        QVERIFY(c.read(SharedHoldingRegisters, 2, 1, &reg));
+        QCOMPARE(reg, s.getValueFromHoldingRegister<uint16_t>(2));
+
+        const uint16_t regs[2] = { 7, 8 };
+        QVERIFY(c.write(SharedInputRegisters, 62, 2, regs));
+        QVERIFY(!c.write(SharedInputRegisters, 63, 2, regs));
+        QVERIFY(memcmp(b->getMap()->tab_input_registers + 62, regs, sizeof(regs)) == 0);
+
+        // writer may be alive while others have segment open, reopening slave keeps sequence
+        c.header()->seq.fetch_add(1);
+        {
+            SharedMap reopened(name);
+            QVERIFY(reopened.open(8, 8, 64, 64));
+            QCOMPARE(reopened.header()->seq.load() & 1, 1u);
+        }
+        c.header()->seq.fetch_add(1);
+        QVERIFY(c.read(SharedHoldingRegisters, 2, 1, &reg));
+
+        // attached client keeps segment
+        c.close();
+    }
+    QVERIFY(!c.open(name));
+
+    // writer died in write section and nobody has segment open, reopening slave makes sequence even again
+    const pid_t pid = fork();
+    if (pid == 0) {
+        SharedMap crashed(name);
+        const bool ok = crashed.open(8, 8, 64, 64);
+        if (ok)
+            crashed.header()->seq.fetch_add(1);
+        _exit(ok ? 0 : 1); // without unlink
+    }
+    int status = 0;
+    QCOMPARE(waitpid(pid, &status, 0), pid);
+    QVERIFY(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+    {
+        SharedMap reopened(name);
+        QVERIFY(reopened.open(8, 8, 64, 64));
+        QCOMPARE(reopened.header()->seq.load() & 1, 0u);
+    }
+    QVERIFY(!c.open(name));
+    SharedMap::remove(name);
+}
+
+namespace {
+
+struct LayoutTestBlock {
+    float speed;
+    uint16_t state;
+    int32_t position;
+    double total;
+};
+
+using LayoutTestBlockLayout = libmodbus_cpp::RegisterLayout<LayoutTestBlock,
+    LMB_REGISTER_FIELD(LayoutTestBlock, speed, 0),
+    LMB_REGISTER_FIELD(LayoutTestBlock, state, 2),
+    LMB_REGISTER_FIELD(LayoutTestBlock, position, 4),
+    LMB_REGISTER_FIELD(LayoutTestBlock, total, 6)>;
+
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testRegisterLayout()
+{
+    const int regCount = LayoutTestBlockLayout::RegCount;
+    QCOMPARE(regCount, 10);
+
+    const LayoutTestBlock block { 1.5f, 0xBEEF, -123456, 2.25e10 };
+    const ByteOrder orders[] = { ByteOrder::LittleEndian, ByteOrder::BigEndian };
+    for (const ByteOrder order : orders) {
+        m_slave->setTargetByteOrder(order);
+        m_slave->setStructToHoldingRegisters<LayoutTestBlockLayout>(10, block);
+
+        // same registers as per-value access
+        QCOMPARE(m_slave->getValueFromHoldingRegister<float>(10), block.speed);
+        QCOMPARE(m_slave->getValueFromHoldingRegister<uint16_t>(12), block.state);
+        QCOMPARE(m_slave->getValueFromHoldingRegister<int32_t>(14), block.position);
+        QCOMPARE(m_slave->getValueFromHoldingRegister<double>(16), block.total);
+
+        const LayoutTestBlock read = m_slave->getStructFromHoldingRegisters<LayoutTestBlockLayout>(10);
+        QCOMPARE(read.speed, block.speed);
+        QCOMPARE(read.state, block.state);
+        QCOMPARE(read.position, block.position);
+        QCOMPARE(read.total, block.total);
+    }
+    m_slave->setTargetByteOrder(ByteOrder::LittleEndian);
+
+    bool thrown = false;
+    try {
+        m_slave->setStructToHoldingRegisters<LayoutTestBlockLayout>(m_backend->getMap()->nb_registers - 2, block);
+    } catch (LocalReadError &) {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testRequestView()
+{
+    modbus_mapping_t *map = m_backend->getMap();
+    std::array<uint8_t, MODBUS_MAX_ADU_LENGTH> rsp;
+    RequestView view;
+
+    // FC16: write 2 registers at 4
+    const uint8_t write[] = { 0x12, 0x34, 0, 0, 0, 11, 1, 0x10, 0, 4, 0, 2, 4, 0xAB, 0xCD, 0x00, 0x01 };
+    QVERIFY(view.parse(write, sizeof(write), 7));
+    QCOMPARE((int)view.function, MODBUS_FC_WRITE_MULTIPLE_REGISTERS);
+    QCOMPARE((int)view.address, 4);
+    QCOMPARE((int)view.count, 2);
+    QCOMPARE((int)view.exception, 0);
+    int length = ResponseBuilder(rsp.data()).build(view, map);
+    const uint8_t writeReply[] = { 0x12, 0x34, 0, 0, 0, 6, 1, 0x10, 0, 4, 0, 2 };
+    QCOMPARE(length, (int)sizeof(writeReply));
+    QVERIFY(memcmp(rsp.data(), writeReply, length) == 0);
+    QCOMPARE(map->tab_registers[4], (uint16_t)0xABCD);
+    QCOMPARE(map->tab_registers[5], (uint16_t)0x0001);
+
+    // FC3: read them back
+    const uint8_t read[] = { 0, 7, 0, 0, 0, 6, 1, 0x03, 0, 4, 0, 2 };
+    QVERIFY(view.parse(read, sizeof(read), 7));
+    length = ResponseBuilder(rsp.data()).build(view, map);
+    const uint8_t readReply[] = { 0, 7, 0, 0, 0, 7, 1, 0x03, 4, 0xAB, 0xCD, 0x00, 0x01 };
+    QCOMPARE(length, (int)sizeof(readReply));
+    QVERIFY(memcmp(rsp.data(), readReply, length) == 0);
+
+    // FC1 out of map: illegal data address
+    const uint8_t outOfMap[] = { 0, 8, 0, 0, 0, 6, 1, 0x01, 0, 60, 0, 8 };
+    QVERIFY(view.parse(outOfMap, sizeof(outOfMap), 7));
+    length = ResponseBuilder(rsp.data()).build(view, map);
+    const uint8_t outOfMapReply[] = { 0, 8, 0, 0, 0, 3, 1, 0x81, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS };
+    QCOMPARE(length, (int)sizeof(outOfMapReply));
+    QVERIFY(memcmp(rsp.data(), outOfMapReply, length) == 0);
+
+    // FC15 with wrong byte count: illegal data value
+    const uint8_t badCount[] = { 0, 9, 0, 0, 0, 9, 1, 0x0F, 0, 0, 0, 10, 1, 0xFF, 0x03 };
+    QVERIFY(view.parse(badCount, sizeof(badCount), 7));
+    QCOMPARE((int)view.exception, (int)MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+
+    // truncated frame (cut by MBAP length) is refused without reading past it, no value of
+    // previous parse is kept
+    QVERIFY(view.parse(write, 14, 7));
+    QCOMPARE((int)view.exception, (int)MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+    QCOMPARE((int)view.count, 0);
+    QVERIFY(view.data == nullptr);
+    map->tab_registers[4] = 0x1111;
+    length = ResponseBuilder(rsp.data()).build(view, map);
+    const uint8_t truncatedReply[] = { 0x12, 0x34, 0, 0, 0, 3, 1, 0x90, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE };
+    QCOMPARE(length, (int)sizeof(truncatedReply));
+    QVERIFY(memcmp(rsp.data(), truncatedReply, length) == 0);
+    QCOMPARE(map->tab_registers[4], (uint16_t)0x1111);
+
+    // non-standard function is left to libmodbus
+    const uint8_t reportId[] = { 0, 10, 0, 0, 0, 2, 1, MODBUS_FC_REPORT_SLAVE_ID };
+    QVERIFY(!view.parse(reportId, sizeof(reportId), 7));
+    QCOMPARE((int)view.function, MODBUS_FC_REPORT_SLAVE_ID);
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testResponseCache()
+{
+    modbus_mapping_t *map = m_backend->getMap();
+    ResponseCache cache(map, 2);
+    std::array<uint8_t, MODBUS_MAX_ADU_LENGTH> rsp;
+    RequestView view;
+
+    map->tab_registers[4] = 0x1111;
+    map->tab_registers[5] = 0x2222;
+
+    // FC3 miss, stored reply is served to next request with its own transaction id
+    const uint8_t read[] = { 0, 1, 0, 0, 0, 6, 1, 0x03, 0, 4, 0, 2 };
+    QVERIFY(view.parse(read, sizeof(read), 7));
+    QCOMPARE(cache.lookup(view, rsp.data()), 0);
+    const quint64 stamp = cache.stamp(DataType::HoldingRegister, 4, 2);
+    cache.store(view, stamp, rsp.data(), ResponseBuilder(rsp.data()).build(view, map));
+
+    const uint8_t again[] = { 0, 2, 0, 0, 0, 6, 1, 0x03, 0, 4, 0, 2 };
+    QVERIFY(view.parse(again, sizeof(again), 7));
+    rsp.fill(0);
+    const uint8_t readReply[] = { 0, 2, 0, 0, 0, 7, 1, 0x03, 4, 0x11, 0x11, 0x22, 0x22 };
+    QCOMPARE(cache.lookup(view, rsp.data()), (int)sizeof(readReply));
+    QVERIFY(memcmp(rsp.data(), readReply, sizeof(readReply)) == 0);
+
+    // write of other block keeps it, write of covered item outdates it
+    cache.markWritten(DataType::HoldingRegister, ResponseCache::BlockSize, 1);
+    cache.markWritten(DataType::InputRegister, 4, 1);
+    QVERIFY(cache.lookup(view, rsp.data()) > 0);
+    cache.markWritten(DataType::HoldingRegister, 5, 1);
+    QCOMPARE(cache.lookup(view, rsp.data()), 0);
+
+    // exception replies are not cached
+    const uint8_t outOfMap[] = { 0, 3, 0, 0, 0, 6, 1, 0x01, 0, 60, 0, 8 };
+    QVERIFY(view.parse(outOfMap, sizeof(outOfMap), 7));
+    cache.store(view, cache.stamp(DataType::Coil, 60, 8), rsp.data(), ResponseBuilder(rsp.data()).build(view, map));
+    QCOMPARE(cache.lookup(view, rsp.data()), 0);
+
+    // oldest entry is evicted when cache is full
+    const uint8_t first[] = { 0, 4, 0, 0, 0, 6, 1, 0x04, 0, 0, 0, 1 };
+    const uint8_t second[] = { 0, 5, 0, 0, 0, 6, 1, 0x04, 0, 1, 0, 1 };
+    const uint8_t third[] = { 0, 6, 0, 0, 0, 6, 1, 0x04, 0, 2, 0, 1 };
+    for (const uint8_t *frame : { first, second, third }) {
+        QVERIFY(view.parse(frame, sizeof(first), 7));
+        cache.store(view, cache.stamp(DataType::InputRegister, view.address, 1), rsp.data(), ResponseBuilder(rsp.data()).build(view, map));
+    }
+    QVERIFY(view.parse(first, sizeof(first), 7));
+    QCOMPARE(cache.lookup(view, rsp.data()), 0);
+    QVERIFY(view.parse(third, sizeof(third), 7));
+    QVERIFY(cache.lookup(view, rsp.data()) > 0);
+
+    const ResponseCache::Stats stats = cache.stats();
+    QCOMPARE(stats.entries, 2);
+    QCOMPARE(stats.maxEntries, 2);
+    QCOMPARE(stats.hits, quint64(3));
+    QCOMPARE(stats.misses, quint64(4));
+
+    m_slave->enableResponseCache(16);
+    QCOMPARE(m_slave->getResponseCacheStats().maxEntries, 16);
+    m_slave->disableResponseCache();
+    QCOMPARE(m_slave->getResponseCacheStats().maxEntries, 0);
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testWireOrderStorage()
+{
+    modbus_mapping_t *map = m_backend->getMap();
+    std::array<uint8_t, MODBUS_MAX_ADU_LENGTH> hostRsp;
+    std::array<uint8_t, MODBUS_MAX_ADU_LENGTH> wireRsp;
+    RequestView view;
+
+    const LayoutTestBlock block { 1.5f, 0xBEEF, -123456, 2.25e10 };
+    m_slave->setTargetByteOrder(ByteOrder::BigEndian);
+    m_slave->setStructToHoldingRegisters<LayoutTestBlockLayout>(20, block);
+    m_slave->setValueToHoldingRegister<uint16_t>(30, 0x1234);
+    m_slave->setValueToHoldingRegister<uint8_t>(31, 0x56);
+
+    const uint8_t read[] = { 0, 1, 0, 0, 0, 6, 1, 0x03, 0, 20, 0, 12 };
+    QVERIFY(view.parse(read, sizeof(read), 7));
+    const int hostLength = ResponseBuilder(hostRsp.data()).build(view, map);
+
+    // existing registers are converted, values and replies are the same
+    m_slave->setRegisterStorage(RegisterStorage::WireOrder);
+    QVERIFY(m_backend->getRegisterStorage() == RegisterStorage::WireOrder);
+    const uint8_t *raw = reinterpret_cast<const uint8_t *>(map->tab_registers + 30);
+    QCOMPARE((int)raw[0], 0x12);
+    QCOMPARE((int)raw[1], 0x34);
+    QCOMPARE(m_slave->getValueFromHoldingRegister<uint16_t>(30), uint16_t(0x1234));
+    QCOMPARE(m_slave->getValueFromHoldingRegister<uint8_t>(31), uint8_t(0x56));
+    const LayoutTestBlock read1 = m_slave->getStructFromHoldingRegisters<LayoutTestBlockLayout>(20);
+    QCOMPARE(read1.position, block.position);
+    QCOMPARE(read1.total, block.total);
+    QCOMPARE(ResponseBuilder(wireRsp.data(), true).build(view, map), hostLength);
+    QVERIFY(memcmp(hostRsp.data(), wireRsp.data(), hostLength) == 0);
+
+    // writes of master and app land in wire order
+    const uint8_t write[] = { 0, 2, 0, 0, 0, 11, 1, 0x10, 0, 32, 0, 2, 4, 0xAB, 0xCD, 0x00, 0x01 };
+    QVERIFY(view.parse(write, sizeof(write), 7));
+    ResponseBuilder(wireRsp.data(), true).build(view, map);
+    QCOMPARE(m_slave->getValueFromHoldingRegister<uint32_t>(32), uint32_t(0xABCD0001));
+    MapTransaction t = m_slave->beginTransaction();
+    t.setValueToHoldingRegister<int32_t>(34, -2);
+    t.commit();
+    QCOMPARE(m_slave->getValueFromHoldingRegister<int32_t>(34), int32_t(-2));
+
+    m_slave->setRegisterStorage(RegisterStorage::HostOrder);
+    QCOMPARE(map->tab_registers[30], uint16_t(0x1234));
+    QCOMPARE(map->tab_registers[32], uint16_t(0xABCD));
+    QCOMPARE(map->tab_registers[35], uint16_t(0xFFFE));
+    QCOMPARE(m_slave->getValueFromHoldingRegister<uint8_t>(31), uint8_t(0x56));
+    m_slave->setTargetByteOrder(ByteOrder::LittleEndian);
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testHookPool()
+{
+    // jobs of lane are run in order of posting from many threads
+    {
+        HookPool pool(3, 64);
+        const int laneCount = 6;
+        const int perLane = 2000;
+        QVector<QVector<int>> seen(laneCount);
+        std::vector<std::thread> producers;
+        for (int lane = 0; lane < laneCount; ++lane) {
+            producers.emplace_back([&pool, &seen, lane]() {
+                for (int i = 0; i < perLane; ++i) {
+                    while (!pool.post(lane, [&seen, lane, i]() { seen[lane].append(i); })) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (std::thread &t : producers) {
+            t.join();
+        }
+        QVERIFY(pool.waitForDone(10000));
+        for (int lane = 0; lane < laneCount; ++lane) {
+            QCOMPARE(seen[lane].size(), perLane);
+            for (int i = 0; i < perLane; ++i) {
+                QCOMPARE(seen[lane][i], i);
+            }
+        }
+        const HookPool::Stats stats = pool.stats();
+        QCOMPARE(stats.workers, 3);
+        QCOMPARE(stats.depth, 0);
+        QCOMPARE(stats.done, stats.posted);
+    }
+
+    // full queue drops, queued jobs are run by destructor
+    std::atomic<int> done { 0 };
+    {
+        HookPool pool(1, 4);
+        std::atomic<bool> release { false };
+        pool.post(0, [&release, &done]() { while (!release) { std::this_thread::yield(); } ++done; });
+        while (pool.stats().depth != 0) {
+            std::this_thread::yield();
+        }
+        int posted = 0;
+        for (int i = 0; i < 10; ++i) {
+            posted += pool.post(0, [&done]() { ++done; }) ? 1 : 0;
+        }
+        QCOMPARE(posted, 4);
+        QCOMPARE(pool.stats().dropped, quint64(6));
+        QCOMPARE(pool.stats().depth, 4);
+        release = true;
+    }
+    QCOMPARE(done.load(), 5);
+}
+
+namespace {
+
+/// requests are fed by test instead of socket
+class FedSlaveBackend : public libmodbus_cpp::SlaveTcpBackend
+{
+public:
+    using SlaveTcpBackend::processRequest;
+};
+
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testAsyncHookSnapshot()
+{
+    FedSlaveBackend *b = new FedSlaveBackend();
+    b->init("127.0.0.1");
+    SlaveTcp s(b);
+    s.initMap(8, 8, 16, 16);
+    s.setAsyncHookWorkers(1);
+
+    // snapshot is map as request left it, not as post-processing hook changed it
+    QByteArray snapshot;
+    s.registerWriteHook(DataType::HoldingRegister, 2, [&s](const UniHookInfo *) {
+        s.setValueToHoldingRegister(2, uint16_t(9));
+    });
+    s.registerWriteHook(DataType::HoldingRegister, 2, [&snapshot](const UniHookInfo *info) {
+        snapshot = info->snapshot;
+    }, HookTime::AsyncPostprocessing);
+
+    // FC6: write 5 to register 2
+    const uint8_t write[] = { 0, 1, 0, 0, 0, 6, 1, 0x06, 0, 2, 0, 5 };
+    b->processRequest(write, sizeof(write));
+    QVERIFY(s.waitForAsyncHooks(5000));
+    QCOMPARE(snapshot.size(), 2);
+    uint16_t written = 0;
+    memcpy(&written, snapshot.constData(), sizeof(written));
+    QCOMPARE(written, uint16_t(5));
+    QCOMPARE(s.getValueFromHoldingRegister<uint16_t>(2), uint16_t(9));
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testDeferredReply()
+{
+    modbus_mapping_t *map = m_backend->getMap();
+    QByteArray sent;
+    int finished = 0;
+    const DeferredReply::Route route = [&sent](uint8_t *adu, int length) {
+        sent = QByteArray(reinterpret_cast<const char *>(adu), length);
+    };
+    const DeferredReply::Finish finish = [map, &finished](DeferredReply *, RequestView &req, const DeferredReply::Route &route) {
+        std::array<uint8_t, MODBUS_MAX_ADU_LENGTH> rsp;
+        route(rsp.data(), ResponseBuilder(rsp.data()).build(req, map));
+        ++finished;
+    };
+
+    // not in pre-processing hook
+    QVERIFY(!m_backend->deferReply(100));
+
+    // completed from other thread, reply is sent with transaction id of request by thread of token
+    const uint8_t read[] = { 0x21, 0x43, 0, 0, 0, 6, 1, 0x03, 0, 10, 0, 1 };
+    RequestView view;
+    QVERIFY(view.parse(read, sizeof(read), 7));
+    DeferredReplyPtr r = DeferredReply::create(view, route, finish, 1000, MODBUS_EXCEPTION_GATEWAY_TARGET);
+    std::thread([map, r]() {
+        map->tab_registers[10] = 0x1234;
+        r->complete();
+        r->fail(MODBUS_EXCEPTION_ILLEGAL_FUNCTION); // too late
+    }).join();
+    QVERIFY(r->isFinished());
+    QVERIFY(sent.isEmpty());
+    QTest::qWait(20);
+    const uint8_t readReply[] = { 0x21, 0x43, 0, 0, 0, 5, 1, 0x03, 2, 0x12, 0x34 };
+    QCOMPARE(sent, QByteArray(reinterpret_cast<const char *>(readReply), sizeof(readReply)));
+    QCOMPARE(finished, 1);
+
+    // no completion: exception reply on timeout, later completion is ignored
+    sent.clear();
+    r = DeferredReply::create(view, route, finish, 10, MODBUS_EXCEPTION_GATEWAY_TARGET);
+    QTest::qWait(100);
+    const uint8_t timeoutReply[] = { 0x21, 0x43, 0, 0, 0, 3, 1, 0x83, MODBUS_EXCEPTION_GATEWAY_TARGET };
+    QCOMPARE(sent, QByteArray(reinterpret_cast<const char *>(timeoutReply), sizeof(timeoutReply)));
+    r->complete();
+    QTest::qWait(20);
+    QCOMPARE(finished, 2);
+
+    // detached token sends nothing
+    sent.clear();
+    r = DeferredReply::create(view, route, finish, 0, MODBUS_EXCEPTION_GATEWAY_TARGET);
+    r->detach();
+    r->fail(MODBUS_EXCEPTION_SLAVE_OR_SERVER_FAILURE);
+    QTest::qWait(20);
+    QVERIFY(sent.isEmpty());
+    QCOMPARE(finished, 2);
+    r.reset();
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testHookGate()
+{
+    QElapsedTimer clock;
+    clock.start();
+    int calls = 0;
+    const auto call = [&calls]() { ++calls; };
+
+    // rate limit
+    {
+        HookLimits limits;
+        limits.minInterval_ms = 10000;
+        HookGate gate(limits);
+        QVERIFY(gate.pass(clock, call));
+        QVERIFY(!gate.pass(clock, call));
+        QCOMPARE(calls, 1);
+        QCOMPARE(gate.skipped(), quint64(1));
+    }
+
+    // refresh if older than max age, counted from end of last call
+    {
+        HookLimits limits;
+        limits.maxAge_ms = 40;
+        HookGate gate(limits);
+        QVERIFY(gate.pass(clock, [&calls]() { std::this_thread::sleep_for(std::chrono::milliseconds(30)); ++calls; }));
+        QVERIFY(!gate.pass(clock, call));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        QVERIFY(gate.pass(clock, call));
+        QCOMPARE(calls, 3);
+    }
+
+    // coalesced trigger waits for running call and skips own one
+    {
+        HookLimits limits;
+        limits.coalesce = true;
+        limits.maxAge_ms = 10000;
+        HookGate gate(limits);
+        std::atomic<bool> started { false };
+        std::atomic<bool> done { false };
+        std::thread refresh([&gate, &clock, &started, &done]() {
+            gate.pass(clock, [&started, &done]() {
+                started = true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                done = true;
+            });
+        });
+        while (!started) {
+            std::this_thread::yield();
+        }
+        QVERIFY(!gate.pass(clock, call));
+        QVERIFY(done);
+        refresh.join();
+        QCOMPARE(gate.calls(), quint64(1));
+        QCOMPARE(calls, 3);
+    }
+
+    // concurrent triggers of interval call hook once
+    {
+        HookLimits limits;
+        limits.minInterval_ms = 10000;
+        HookGate gate(limits);
+        std::atomic<int> concurrentCalls { 0 };
+        std::vector<std::thread> triggers;
+        for (int i = 0; i < 4; ++i) {
+            triggers.emplace_back([&gate, &clock, &concurrentCalls]() {
+                for (int k = 0; k < 1000; ++k) {
+                    gate.pass(clock, [&concurrentCalls]() { ++concurrentCalls; });
+                }
+            });
+        }
+        for (std::thread &t : triggers) {
+            t.join();
+        }
+        QCOMPARE(concurrentCalls.load(), 1);
+    }
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testParallelSplit()
+{
+    // chunks of one PDU cover whole range, the last one is shorter
+    const QVector<ParallelMasterTcp::Chunk> chunks = ParallelMasterTcp::split(100, 300, MODBUS_MAX_READ_REGISTERS);
+    QCOMPARE(chunks.size(), 3);
+    QCOMPARE((int)chunks[0].first, 100);
+    QCOMPARE(chunks[0].second, 125);
+    QCOMPARE((int)chunks[1].first, 225);
+    QCOMPARE(chunks[1].second, 125);
+    QCOMPARE((int)chunks[2].first, 350);
+    QCOMPARE(chunks[2].second, 50);
+
+    // up to the end of address space
+    const QVector<ParallelMasterTcp::Chunk> last = ParallelMasterTcp::split(0xFFF0, 16, 2000);
+    QCOMPARE(last.size(), 1);
+    QCOMPARE((int)last[0].first, 0xFFF0);
+    QCOMPARE(last[0].second, 16);
+
+    QVERIFY(ParallelMasterTcp::split(0, 0, 125).isEmpty());
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testRttEstimator()
+{
+    RttEstimator rtt;
+    rtt.reset(5, 500);
+    QCOMPARE(rtt.timeout_ms(), 500); // no sample yet
+
+    // steady device: timeout converges near its RTT, not far above it
+    for (int i = 0; i < 50; ++i) {
+        rtt.sample(20);
+    }
+    QVERIFY(rtt.timeout_ms() >= 20);
+    QVERIFY(rtt.timeout_ms() <= 22);
+
+    // each timeout doubles it until the next sample, up to max
+    const int base = rtt.timeout_ms();
+    rtt.timedOut();
+    QCOMPARE(rtt.timeout_ms(), base * 2);
+    for (int i = 0; i < 10; ++i) {
+        rtt.timedOut();
+    }
+    QCOMPARE(rtt.timeout_ms(), 500);
+    rtt.sample(20);
+    QVERIFY(rtt.timeout_ms() < 50);
+
+    // fast device is clamped to min
+    rtt.reset(5, 500);
+    for (int i = 0; i < 50; ++i) {
+        rtt.sample(0.1);
+    }
+    QCOMPARE(rtt.timeout_ms(), 5);
+    QCOMPARE(rtt.stats().samples, quint64(50));
+
+    // burst of retries, then one retry per ten requests
+    RetryPolicy policy;
+    policy.maxRetries = 1;
+    RetryBudget budget;
+    budget.reset(policy);
+    for (int i = 0; i < policy.burst; ++i) {
+        QVERIFY(budget.takeRetry());
+    }
+    QVERIFY(!budget.takeRetry());
+    for (int i = 0; i < 9; ++i) {
+        budget.request(policy);
+    }
+    QVERIFY(!budget.takeRetry());
+    budget.request(policy);
+    budget.request(policy);
+    QVERIFY(budget.takeRetry());
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testLatencyWindow()
+{
+    LatencyWindow window(100);
+    QCOMPARE(window.percentile(95), 0.0);
+    for (int i = 100; i >= 1; --i) {
+        window.add(i);
+    }
+    QCOMPARE(window.count(), 100);
+    QCOMPARE(window.percentile(50), 50.0);
+    QCOMPARE(window.percentile(95), 95.0);
+    QCOMPARE(window.percentile(100), 100.0);
+
+    // only the latest samples are kept
+    for (int i = 0; i < 100; ++i) {
+        window.add(1000 + i);
+    }
+    QCOMPARE(window.count(), 100);
+    QCOMPARE(window.total(), quint64(200));
+    QCOMPARE(window.percentile(1), 1000.0);
+}
+
+void libmodbus_cpp::RegMapReadWriteTest::testManagedConnection()
+{
+    TcpConnectionOptions options;
+    ReconnectBackoff backoff;
+    QCOMPARE(backoff.next(options), 100);
+    QCOMPARE(backoff.next(options), 200);
+    for (int i = 0; i < 20; ++i) {
+        backoff.next(options);
+    }
+    QCOMPARE(backoff.next(options), options.maxBackoff_ms);
+    backoff.reset();
+    QCOMPARE(backoff.next(options), 100);
+
+    // request to device which is down fails without waiting for connect timeout
+    TcpConnectionManager manager;
+    const ManagedTcpConnectionPtr c = manager.add("127.0.0.1", 1);
+    c->connecting();
+    c->failed(ECONNREFUSED);
+    QElapsedTimer timer;
+    timer.start();
+    bool failed = false;
+    try {
+        c->acquire();
+    } catch (ConnectionError &) {
+        failed = true;
+    }
+    QVERIFY(failed);
+    QVERIFY(timer.elapsed() < options.connectTimeout_ms);
+    QCOMPARE(c->getState(), ManagedTcpConnection::State::Down);
+
+    // invalid address is not retried
+    const ManagedTcpConnectionPtr invalid = manager.add("no.such.address", 502);
+    manager.start();
+    QTest::qWait(options.minBackoff_ms * 2);
+    QCOMPARE(invalid->getState(), ManagedTcpConnection::State::Failed);
+    invalid->unpark();
+    QCOMPARE(invalid->getState(), ManagedTcpConnection::State::Failed);
+}
+
 void libmodbus_cpp::RegMapReadWriteTest::cleanupTestCase()
 {
     delete m_slave;
@@ -19,6 +19,23 @@ private slots:
     void testDiscreteInputs();
     void testHoldingRegisters();
     void testInputRegisters();
+    void testSeqLockHoldingRegisters();
+    void testTransaction();
+    void testChangeTracker();
+    void testPersistentMap();
+    void testSharedMap();
+    void testRegisterLayout();
+    void testRequestView();
+    void testResponseCache();
+    void testWireOrderStorage();
+    void testHookPool();
+    void testAsyncHookSnapshot();
+    void testDeferredReply();
+    void testHookGate();
+    void testParallelSplit();
+    void testRttEstimator();
+    void testLatencyWindow();
+    void testManagedConnection();
     void cleanupTestCase();
 
 private:
@@ -1,7 +1,419 @@
 #include "tests/tcp_read_write_test.h"
 #include <QThreadPool>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QElapsedTimer>
 #include <libmodbus_cpp/master_tcp.h>
+#include <libmodbus_cpp/async_master_tcp.h>
+#include <libmodbus_cpp/parallel_master_tcp.h>
+#include <libmodbus_cpp/hedged_master_tcp.h>
+#include <libmodbus_cpp/uring_tcp_server.h>
+#include <libmodbus_cpp/deferred_reply.h>
 #include <thread>
+#include <mutex>
+#include <set>
+#include <algorithm>
+#include <limits>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#endif
+
+namespace {
+
+/// runs event loop of test thread until reply is finished
+template<typename Reply>
+bool waitFor(const Reply &reply, int timeout_ms = 5000)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!reply.isFinished() && (timer.elapsed() < timeout_ms))
+        QTest::qWait(5);
+    return reply.isFinished();
+}
+
+#ifndef _WIN32
+
+/// FC3 of count registers from 0
+QByteArray readRequest(uint16_t tid, uint16_t count)
+{
+    const char adu[] = { char(tid >> 8), char(tid & 0xFF), 0, 0, 0, 6, 1, MODBUS_FC_READ_HOLDING_REGISTERS, 0, 0, char(count >> 8), char(count & 0xFF) };
+    return QByteArray(adu, sizeof(adu));
+}
+
+int readReplyLength(int count)
+{
+    return 9 + count * 2;
+}
+
+/// reply of readRequest(), registers of SlaveThread map are 1
+bool isReadReply(const QByteArray &rsp, uint16_t tid, int count)
+{
+    if ((rsp.size() != readReplyLength(count)) || (rsp.at(0) != char(tid >> 8)) || (rsp.at(1) != char(tid & 0xFF)) ||
+            (rsp.at(7) != MODBUS_FC_READ_HOLDING_REGISTERS) || (rsp.at(8) != char(count * 2)))
+        return false;
+    for (int i = 0; i < count; ++i) {
+        if ((rsp.at(9 + i * 2) != 0) || (rsp.at(10 + i * 2) != 1))
+            return false;
+    }
+    return true;
+}
+
+/// blocking client of raw frame tests, it shows framing and flow control which master hides
+class RawClient
+{
+    int m_fd = -1;
+
+public:
+    /// small socket buffers make flow control of peer visible sooner
+    explicit RawClient(int port, int bufferSize = 0) {
+        m_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (bufferSize > 0) {
+            setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+            setsockopt(m_fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+        }
+        const int noDelay = 1; // split frame is sent in parts
+        setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = inet_addr(libmodbus_cpp::TEST_IP_ADDRESS);
+        if (::connect(m_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    ~RawClient() {
+        if (m_fd != -1)
+            ::close(m_fd);
+    }
+
+    bool isConnected() const {
+        return m_fd != -1;
+    }
+
+    bool write(const QByteArray &data) {
+        int offset = 0;
+        while (offset < data.size()) {
+            const ssize_t n = ::send(m_fd, data.constData() + offset, data.size() - offset, MSG_NOSIGNAL);
+            if (n <= 0)
+                return false;
+            offset += n;
+        }
+        return true;
+    }
+
+    /// sends until peer takes nothing for stall_ms, returns count of sent bytes
+    int flood(const QByteArray &data, int stall_ms) {
+        int offset = 0;
+        while (offset < data.size()) {
+            const ssize_t n = ::send(m_fd, data.constData() + offset, data.size() - offset, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n > 0) {
+                offset += n;
+                continue;
+            }
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+                break;
+            pollfd p = { m_fd, POLLOUT, 0 };
+            if (poll(&p, 1, stall_ms) == 0)
+                break;
+        }
+        return offset;
+    }
+
+    /// count bytes, less on timeout or close
+    QByteArray read(int count, int timeout_ms) {
+        QByteArray data;
+        QElapsedTimer timer;
+        timer.start();
+        char buf[4096];
+        while (data.size() < count) {
+            const int left_ms = timeout_ms - static_cast<int>(timer.elapsed());
+            pollfd p = { m_fd, POLLIN, 0 };
+            if ((left_ms <= 0) || (poll(&p, 1, left_ms) <= 0))
+                break;
+            const ssize_t n = ::recv(m_fd, buf, std::min<int>(sizeof(buf), count - data.size()), 0);
+            if (n <= 0)
+                break;
+            data.append(buf, n);
+        }
+        return data;
+    }
+
+    /// true if peer closes connection within timeout, received data is dropped
+    bool waitForClose(int timeout_ms) {
+        QElapsedTimer timer;
+        timer.start();
+        char buf[4096];
+        for (;;) {
+            const int left_ms = timeout_ms - static_cast<int>(timer.elapsed());
+            pollfd p = { m_fd, POLLIN, 0 };
+            if ((left_ms <= 0) || (poll(&p, 1, left_ms) <= 0))
+                return false;
+            const ssize_t n = ::recv(m_fd, buf, sizeof(buf), 0);
+            if ((n == 0) || ((n == -1) && (errno == ECONNRESET)))
+                return true;
+        }
+    }
+};
+
+/// frame split over reads and many frames in one read, replies keep order of requests
+void checkFraming(int port)
+{
+    RawClient c(port);
+    QVERIFY(c.isConnected());
+
+    const QByteArray split = readRequest(1, 2);
+    QVERIFY(c.write(split.left(3)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    QVERIFY(c.write(split.mid(3, 4))); // rest of header
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    QVERIFY(c.write(split.mid(7)));
+    QVERIFY(isReadReply(c.read(readReplyLength(2), 2000), 1, 2));
+
+    // more than receive buffer of io_uring server (2048 bytes), frames cross its buffers
+    const int FrameCount = 300;
+    QByteArray batch;
+    int expected = 0;
+    for (int i = 0; i < FrameCount; ++i) {
+        const int count = 1 + i % libmodbus_cpp::TABLE_SIZE;
+        batch += readRequest(100 + i, count);
+        expected += readReplyLength(count);
+    }
+    QVERIFY(c.write(batch));
+    const QByteArray replies = c.read(expected, 5000);
+    QCOMPARE(replies.size(), expected);
+    int offset = 0;
+    for (int i = 0; i < FrameCount; ++i) {
+        const int count = 1 + i % libmodbus_cpp::TABLE_SIZE;
+        QVERIFY(isReadReply(replies.mid(offset, readReplyLength(count)), 100 + i, count));
+        offset += readReplyLength(count);
+    }
+}
+
+/// master not reading replies is paused by maxUnsentBytes, other masters are served meanwhile
+void checkBackpressure(int port)
+{
+    RawClient flooder(port, 4096);
+    QVERIFY(flooder.isConnected());
+    QByteArray requests;
+    const int RequestCount = 100000;
+    requests.reserve(RequestCount * 12);
+    for (int i = 0; i < RequestCount; ++i)
+        requests += readRequest(i, libmodbus_cpp::TABLE_SIZE);
+
+    // slave stops reading, so its socket buffers fill and send blocks
+    const int sent = flooder.flood(requests, 500);
+    QVERIFY(sent < requests.size());
+
+    RawClient other(port);
+    QVERIFY(other.isConnected());
+    QVERIFY(other.write(readRequest(7, 1)));
+    QVERIFY(isReadReply(other.read(readReplyLength(1), 1000), 7, 1));
+
+    // nothing is lost: every whole request is answered once flooder reads
+    const int answered = sent / 12;
+    const QByteArray replies = flooder.read(answered * readReplyLength(libmodbus_cpp::TABLE_SIZE), 30000);
+    QCOMPARE(replies.size(), answered * readReplyLength(libmodbus_cpp::TABLE_SIZE));
+    QVERIFY(isReadReply(replies.right(readReplyLength(libmodbus_cpp::TABLE_SIZE)), (answered - 1) & 0xFFFF, libmodbus_cpp::TABLE_SIZE));
+}
+
+/// burst of one second is served at once, rest at request rate
+void checkRateLimit(int port, int rate)
+{
+    RawClient c(port);
+    QVERIFY(c.isConnected());
+    QByteArray batch;
+    for (int i = 0; i < rate * 2; ++i)
+        batch += readRequest(i, 1);
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(c.write(batch));
+    const QByteArray replies = c.read(rate * 2 * readReplyLength(1), 5000);
+    QCOMPARE(replies.size(), rate * 2 * readReplyLength(1));
+    QVERIFY(timer.elapsed() >= 700); // second half needs one second
+    QVERIFY(isReadReply(replies.right(readReplyLength(1)), rate * 2 - 1, 1));
+}
+
+/// silent connection is closed, polling one is kept
+void checkIdleReaping(int port, int idleTimeout_ms)
+{
+    RawClient idle(port);
+    RawClient polling(port);
+    QVERIFY(idle.isConnected());
+    QVERIFY(polling.isConnected());
+    QElapsedTimer timer;
+    timer.start();
+    for (uint16_t i = 0; timer.elapsed() < idleTimeout_ms * 3; ++i) {
+        QVERIFY(polling.write(readRequest(i, 1)));
+        QVERIFY(isReadReply(polling.read(readReplyLength(1), 1000), i, 1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(idleTimeout_ms / 4));
+    }
+    QVERIFY(idle.waitForClose(idleTimeout_ms * 4));
+    QVERIFY(polling.write(readRequest(1, 1)));
+    QVERIFY(isReadReply(polling.read(readReplyLength(1), 1000), 1, 1));
+}
+
+/// connection whose replies are not read is closed as half-open one
+void checkUnsentReaping(int port, int unsentTimeout_ms)
+{
+    RawClient c(port, 4096);
+    QVERIFY(c.isConnected());
+    QByteArray requests;
+    for (int i = 0; i < 20000; ++i)
+        requests += readRequest(i, libmodbus_cpp::TABLE_SIZE);
+    c.flood(requests, 300);
+    // reading would be progress, so close is seen only after timeout has surely passed
+    std::this_thread::sleep_for(std::chrono::milliseconds(unsentTimeout_ms * 3));
+    QVERIFY(c.waitForClose(5000));
+}
+
+/// QTcpServer answering readRequest() frames from loop of test thread, see runBlocking()
+class PumpedServer
+{
+    QTcpServer m_server;
+    QList<QTcpSocket*> m_sockets;
+    int m_accepted = 0;
+    bool m_dropOnAccept = false;
+    int m_replyUnit = -1;
+
+public:
+    ~PumpedServer() {
+        dropAll();
+    }
+
+    bool listen(int port) {
+        return m_server.listen(QHostAddress(libmodbus_cpp::TEST_IP_ADDRESS), port);
+    }
+    void close() {
+        m_server.close();
+    }
+
+    /// accepted connections are closed at once, as by overloaded gateway
+    void setDropOnAccept(bool drop) {
+        m_dropOnAccept = drop;
+    }
+    void dropAll() {
+        for (QTcpSocket *s : m_sockets) {
+            s->abort();
+            delete s;
+        }
+        m_sockets.clear();
+    }
+    int accepted() const {
+        return m_accepted;
+    }
+    /// unit of replies instead of unit of request, -1 is unit of request
+    void setReplyUnit(int unit) {
+        m_replyUnit = unit;
+    }
+
+    void pump() {
+        while (m_server.hasPendingConnections()) {
+            QTcpSocket *s = m_server.nextPendingConnection();
+            ++m_accepted;
+            if (m_dropOnAccept) {
+                s->abort();
+                delete s;
+                continue;
+            }
+            m_sockets.append(s);
+        }
+        for (QTcpSocket *s : m_sockets) {
+            while (s->bytesAvailable() >= 12) {
+                const QByteArray req = s->read(12);
+                const char *r = req.constData();
+                const int count = (uchar(r[10]) << 8) | uchar(r[11]);
+                QByteArray rsp(readReplyLength(count), 0);
+                char *p = rsp.data();
+                p[0] = r[0];
+                p[1] = r[1];
+                p[5] = char(3 + count * 2);
+                p[6] = (m_replyUnit < 0) ? r[6] : char(m_replyUnit);
+                p[7] = r[7];
+                p[8] = char(count * 2);
+                for (int i = 0; i < count; ++i)
+                    p[10 + i * 2] = 1;
+                s->write(rsp);
+            }
+        }
+    }
+};
+
+/// true if condition holds within timeout, server is pumped meanwhile
+template<typename Condition>
+bool pumpUntil(PumpedServer &server, Condition condition, int timeout_ms)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (;;) {
+        server.pump();
+        if (condition())
+            return true;
+        if (timer.elapsed() >= timeout_ms)
+            return false;
+        QTest::qWait(5);
+    }
+}
+
+/// blocking call of master runs in other thread, server is pumped by loop of test thread meanwhile
+template<typename Call>
+void runBlocking(PumpedServer &server, Call call)
+{
+    std::atomic_bool done { false };
+    std::exception_ptr error;
+    std::thread t([&call, &done, &error]() {
+        try {
+            call();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        done = true;
+    });
+    pumpUntil(server, [&done]() { return done.load(); }, std::numeric_limits<int>::max());
+    t.join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+/// true if blocking call throws exception of type E
+template<typename E, typename Call>
+bool throwsOf(PumpedServer &server, Call call)
+{
+    try {
+        runBlocking(server, call);
+    } catch (E &) {
+        return true;
+    } catch (...) {
+    }
+    return false;
+}
+
+#endif
+
+/// true if reply failed with exception of type E
+template<typename E, typename Reply>
+bool failedWith(const Reply &reply)
+{
+    try {
+        reply.result();
+    } catch (E &) {
+        return true;
+    } catch (...) {
+    }
+    return false;
+}
+
+}
 
 void libmodbus_cpp::TcpReadWriteTest::initTestCase()
 {
@@ -19,3 +431,713 @@ void libmodbus_cpp::TcpReadWriteTest::cleanupTestCase()
     emit sig_finished();
     // m_serverStarter will be deleted by thread pool
 }
+
+void libmodbus_cpp::TcpReadWriteTest::seqLockedMapThroughMaster()
+{
+    // app writes and master reads registers 0-3, master writes and app reads registers 8-11,
+    // all four registers of value are always equal, so torn one has different words
+    SlaveThread slave(TEST_PORT_SEQLOCK, [](SlaveTcpBackend *, AbstractSlave *s) {
+        s->setMapConcurrency(MapConcurrency::SeqLock);
+    });
+    QVERIFY(slave.startSlave());
+
+    std::atomic_bool stop { false };
+    std::atomic_int tornByApp { 0 };
+    std::thread app([&]() {
+        for (uint64_t k = 1; !stop; ++k) {
+            slave.slave()->setValueToHoldingRegister<uint64_t>(0, (k & 0xFFFF) * 0x0001000100010001ull);
+            const uint64_t v = slave.slave()->getValueFromHoldingRegister<uint64_t>(8);
+            if (v != (v & 0xFFFF) * 0x0001000100010001ull)
+                ++tornByApp;
+        }
+    });
+
+    std::unique_ptr<AbstractMaster> master = Factory::createTcpMaster(TEST_IP_ADDRESS, TEST_PORT_SEQLOCK);
+    QVERIFY(master->connect());
+    int tornByMaster = 0;
+    try {
+        for (int i = 1; i <= 2000; ++i) {
+            master->writeHoldingRegisters(8, QVector<uint16_t>(4, (uint16_t)i));
+            const QVector<uint16_t> regs = master->readHoldingRegisters(0, 4);
+            if (std::count(regs.begin(), regs.end(), regs.at(0)) != 4)
+                ++tornByMaster;
+        }
+    } catch (RemoteRWError &e) {
+        stop = true;
+        app.join();
+        QVERIFY2(false, e.what());
+    }
+    master->disconnect();
+    stop = true;
+    app.join();
+    QCOMPARE(tornByMaster, 0);
+    QCOMPARE(tornByApp.load(), 0);
+}
+
+void libmodbus_cpp::TcpReadWriteTest::changesOfRejectedWrite()
+{
+    SlaveThread slave(TEST_PORT_CHANGES, [](SlaveTcpBackend *, AbstractSlave *s) {
+        s->enableChangeTracking();
+    });
+    QVERIFY(slave.startSlave());
+
+    std::unique_ptr<AbstractMaster> master = Factory::createTcpMaster(TEST_IP_ADDRESS, TEST_PORT_CHANGES);
+    QVERIFY(master->connect());
+    // runs past end of table, slave replies illegal data address and writes nothing
+    bool rejected = false;
+    try {
+        master->writeHoldingRegisters(TABLE_SIZE - 2, QVector<uint16_t>(4, 7));
+    } catch (RemoteRWError &) {
+        rejected = true;
+    }
+    QCOMPARE(rejected, true);
+    QCOMPARE(slave.slave()->takeMapChanges().size(), 0);
+
+    try {
+        master->writeHoldingRegisters(TABLE_SIZE - 4, QVector<uint16_t>(4, 7));
+    } catch (RemoteRWError &e) {
+        QVERIFY2(false, e.what());
+    }
+    master->disconnect();
+    const QVector<MapChange> changes = slave.slave()->takeMapChanges();
+    QCOMPARE(changes.size(), 1);
+    QCOMPARE(changes.at(0).type, DataType::HoldingRegister);
+}
+
+void libmodbus_cpp::TcpReadWriteTest::asyncRefusedConnect()
+{
+    AsyncMasterTcp master(TEST_IP_ADDRESS, TEST_PORT_CLOSED);
+    master.setResponseTimeout(3000);
+    master.connectToSlave();
+    AsyncReply<QVector<uint16_t>> reply = master.readHoldingRegisters(0, 1);
+
+    // failed by socket error, not by timeout of queued request
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(waitFor(reply));
+    QVERIFY(timer.elapsed() < 3000);
+    QVERIFY(reply.hasError());
+    QVERIFY(failedWith<ConnectionError>(reply));
+    QCOMPARE(master.isConnected(), false);
+}
+
+void libmodbus_cpp::TcpReadWriteTest::asyncReplyTimeout()
+{
+    QTcpServer silent;
+    QVERIFY(silent.listen(QHostAddress(TEST_IP_ADDRESS), TEST_PORT_SILENT));
+
+    AsyncMasterTcp master(TEST_IP_ADDRESS, TEST_PORT_SILENT);
+    master.setResponseTimeout(200);
+    master.connectToSlave();
+    AsyncReply<QVector<uint16_t>> reply = master.readHoldingRegisters(0, 1);
+    QVERIFY(waitFor(reply));
+    QVERIFY(failedWith<RemoteReadError>(reply));
+    QCOMPARE(master.isConnected(), true);
+
+    // never sent, deadline runs from queueing
+    AsyncMasterTcp idle(TEST_IP_ADDRESS, TEST_PORT_SILENT);
+    idle.setResponseTimeout(200);
+    QElapsedTimer timer;
+    timer.start();
+    AsyncReply<QVector<uint16_t>> queued = idle.readHoldingRegisters(0, 1);
+    QVERIFY(waitFor(queued));
+    QVERIFY(timer.elapsed() >= 200);
+    QVERIFY(failedWith<RemoteReadError>(queued));
+}
+
+void libmodbus_cpp::TcpReadWriteTest::compactFraming()
+{
+#ifndef _WIN32
+    SlaveThread slave(TEST_PORT_COMPACT_FRAMING, [](SlaveTcpBackend *b, AbstractSlave *) {
+        b->setConnectionMode(TcpConnectionMode::Compact);
+    });
+    QVERIFY(slave.startSlave());
+    checkFraming(TEST_PORT_COMPACT_FRAMING);
+#else
+    QSKIP("raw socket client is POSIX only");
+#endif
+}
+
+void libmodbus_cpp::TcpReadWriteTest::compactBackpressure()
+{
+#ifndef _WIN32
+    SlaveThread slave(TEST_PORT_COMPACT_BACKPRESSURE, [](SlaveTcpBackend *b, AbstractSlave *) {
+        b->setConnectionMode(TcpConnectionMode::Compact);
+        TcpConnectionLimits limits;
+        limits.maxUnsentBytes = 4096;
+        b->setConnectionLimits(limits);
+    });
+    QVERIFY(slave.startSlave());
+    checkBackpressure(TEST_PORT_COMPACT_BACKPRESSURE);
+#else
+    QSKIP("raw socket client is POSIX only");
+#endif
+}
+
+void libmodbus_cpp::TcpReadWriteTest::socketBackpressure()
+{
+#ifndef _WIN32
+    SlaveThread slave(TEST_PORT_SOCKET_BACKPRESSURE, [](SlaveTcpBackend *b, AbstractSlave *) {
+        TcpConnectionLimits limits;
+        limits.maxPendingRequests = 1;
+        limits.maxUnsentBytes = 4096;
+        b->setConnectionLimits(limits);
+    });
+    QVERIFY(slave.startSlave());
+    checkBackpressure(TEST_PORT_SOCKET_BACKPRESSURE);
+#else
+    QSKIP("raw socket client is POSIX only");
+#endif
+}
+
+void libmodbus_cpp::TcpReadWriteTest::connectionLimits()
+{
+#ifndef _WIN32
+    const TcpConnectionMode modes[] = { TcpConnectionMode::Socket, TcpConnectionMode::Compact };
+    for (int i = 0; i < 2; ++i) {
+        const TcpConnectionMode mode = modes[i];
+        const int port = TEST_PORT_LIMITS + i;
+        SlaveThread slave(port, [mode](SlaveTcpBackend *b, AbstractSlave *) {
+            b->setConnectionMode(mode);
+            TcpConnectionLimits limits;
+            limits.maxRequestRate = 20;
+            b->setConnectionLimits(limits);
+        });
+        QVERIFY(slave.startSlave());
+        checkRateLimit(port, 20);
+        if (QTest::currentTestFailed())
+            return;
+    }
+#else
+    QSKIP("raw socket client is POSIX only");
+#endif
+}
+
+void libmodbus_cpp::TcpReadWriteTest::connectionReaping()
+{
+#ifndef _WIN32
+    const TcpConnectionMode modes[] = { TcpConnectionMode::Socket, TcpConnectionMode::Compact };
+    for (int i = 0; i < 2; ++i) {
+        const TcpConnectionMode mode = modes[i];
+        {
+            const int port = TEST_PORT_IDLE + i;
+            SlaveThread slave(port, [mode](SlaveTcpBackend *b, AbstractSlave *) {
+                b->setConnectionMode(mode);
+                TcpConnectionLimits limits;
+                limits.idleTimeout_ms = 200;
+                b->setConnectionLimits(limits);
+            });
+            QVERIFY(slave.startSlave());
+            checkIdleReaping(port, 200);
+        }
+        {
+            const int port = TEST_PORT_UNSENT + i;
+            SlaveThread slave(port, [mode](SlaveTcpBackend *b, AbstractSlave *) {
+                b->setConnectionMode(mode);
+                TcpConnectionLimits limits;
+                limits.unsentTimeout_ms = 200;
+                b->setConnectionLimits(limits);
+            });
+            QVERIFY(slave.startSlave());
+            checkUnsentReaping(port, 200);
+        }
+        if (QTest::currentTestFailed())
+            return;
+    }
+#else
+    QSKIP("raw socket client is POSIX only");
+#endif
+}
+
+void libmodbus_cpp::TcpReadWriteTest::shardsShareOnePort()
+{
+#ifdef __linux__
+    std::mutex lock;
+    std::set<std::thread::id> threads;
+    SlaveThread slave(TEST_PORT_SHARDS, [&lock, &threads](SlaveTcpBackend *b, AbstractSlave *s) {
+        b->setShardCount(2);
+        s->registerReadHookOnRange(DataType::HoldingRegister, 0, TABLE_SIZE, [&lock, &threads](const UniHookInfo *) {
+            std::lock_guard<std::mutex> guard(lock);
+            threads.insert(std::this_thread::get_id());
+        });
+    });
+    QVERIFY(slave.startSlave());
+
+    // kernel spreads connections by hash of ports, all 16 on one shard is unlikely as 1 of 2^15
+    std::vector<std::unique_ptr<AbstractMaster>> masters;
+    for (int i = 0; i < 16; ++i) {
+        masters.push_back(Factory::createTcpMaster(TEST_IP_ADDRESS, TEST_PORT_SHARDS));
+        QVERIFY(masters.back()->connect());
+    }
+    try {
+        for (const std::unique_ptr<AbstractMaster> &m : masters) {
+            m->writeHoldingRegister<uint16_t>(1, 5);
+            QCOMPARE(m->readHoldingRegister<uint16_t>(1), (uint16_t)5);
+        }
+    } catch (RemoteRWError &e) {
+        QVERIFY2(false, e.what());
+    }
+    for (const std::unique_ptr<AbstractMaster> &m : masters)
+        m->disconnect();
+
+    std::lock_guard<std::mutex> guard(lock);
+    QCOMPARE((int)threads.size(), 2);
+    QVERIFY(threads.count(std::this_thread::get_id()) == 0);
+#else
+    QSKIP("listener shards are Linux only");
+#endif
+}
+
+void libmodbus_cpp::TcpReadWriteTest::uringRoundTrip()
+{
+#ifdef __linux__
+    if (!UringTcpServer::isAvailable())
+        QSKIP("io_uring with multishot receive is not available");
+    SlaveThread slave(TEST_PORT_URING, [](SlaveTcpBackend *b, AbstractSlave *) {
+        b->setConnectionMode(TcpConnectionMode::Uring);
+    });
+    QVERIFY(slave.startSlave());
+
+    std::unique_ptr<AbstractMaster> master = Factory::createTcpMaster(TEST_IP_ADDRESS, TEST_PORT_URING);
+    QVERIFY(master->connect());
+    try {
+        master->writeHoldingRegisters(10, QVector<uint16_t>{ 1, 2, 3 });
+        QVERIFY(master->readHoldingRegisters(10, 3) == (QVector<uint16_t>{ 1, 2, 3 }));
+        master->writeHoldingRegisters(10, QVector<uint16_t>(3, 1));
+    } catch (RemoteRWError &e) {
+        QVERIFY2(false, e.what());
+    }
+    master->disconnect();
+
+    // batch of frames is longer than provided receive buffer, frames are split between buffers
+    checkFraming(TEST_PORT_URING);
+#else
+    QSKIP("io_uring is Linux only");
+#endif
+}
+
+void libmodbus_cpp::TcpReadWriteTest::uringFallback()
+{
+#ifdef __linux__
+    // io_uring_setup fails, slave listens with compact connections
+    setenv("LIBMODBUS_CPP_DISABLE_IO_URING", "1", 1);
+    {
+        SlaveThread slave(TEST_PORT_URING_FALLBACK, [](SlaveTcpBackend *b, AbstractSlave *) {
+            b->setConnectionMode(TcpConnectionMode::Uring);
+        });
+        const bool listening = slave.startSlave();
+        unsetenv("LIBMODBUS_CPP_DISABLE_IO_URING");
+        QVERIFY(listening);
+
+        std::unique_ptr<AbstractMaster> master = Factory::createTcpMaster(TEST_IP_ADDRESS, TEST_PORT_URING_FALLBACK);
+        QVERIFY(master->connect());
+        try {
+            QCOMPARE(master->readHoldingRegister<uint16_t>(0), (uint16_t)1);
+        } catch (RemoteRWError &e) {
+            QVERIFY2(false, e.what());
+        }
+        master->disconnect();
+    }
+#else
+    QSKIP("io_uring is Linux only");
+#endif
+}
+
+void libmodbus_cpp::TcpReadWriteTest::cachedReadAfterWrite()
+{
+    // write acknowledged to one master is seen by read of other one, on other shard too
+    SlaveThread slave(TEST_PORT_CACHE, [](SlaveTcpBackend *b, AbstractSlave *s) {
+#ifdef __linux__
+        b->setShardCount(2);
+#else
+        Q_UNUSED(b);
+#endif
+        s->enableResponseCache();
+    });
+    QVERIFY(slave.startSlave());
+
+    std::unique_ptr<AbstractMaster> writer = Factory::createTcpMaster(TEST_IP_ADDRESS, TEST_PORT_CACHE);
+    std::unique_ptr<AbstractMaster> reader = Factory::createTcpMaster(TEST_IP_ADDRESS, TEST_PORT_CACHE);
+    QVERIFY(writer->connect());
+    QVERIFY(reader->connect());
+    int stale = 0;
+    try {
+        for (uint16_t i = 1; i <= 500; ++i) {
+            reader->readHoldingRegisters(0, 8); // cached before write
+            writer->writeHoldingRegister<uint16_t>(3, i);
+            if (reader->readHoldingRegisters(0, 8).at(3) != i)
+                ++stale;
+        }
+    } catch (RemoteRWError &e) {
+        QVERIFY2(false, e.what());
+    }
+    writer->disconnect();
+    reader->disconnect();
+    QCOMPARE(stale, 0);
+    QVERIFY(slave.slave()->getResponseCacheStats().hits > 0);
+}
+
+void libmodbus_cpp::TcpReadWriteTest::deferredReply()
+{
+#ifndef _WIN32
+    // reply taken by pre-processing hook is sent on completion from other thread with transaction id
+    // of request, post-processing hooks run once then
+    std::mutex lock;
+    DeferredReplyPtr deferred;
+    std::atomic_int postHooks { 0 };
+    SlaveThread slave(TEST_PORT_DEFERRED, [&lock, &deferred, &postHooks](SlaveTcpBackend *, AbstractSlave *s) {
+        s->registerReadHook(DataType::HoldingRegister, 0, [&lock, &deferred, s](const UniHookInfo *) {
+            const DeferredReplyPtr r = s->deferReply(2000);
+            std::lock_guard<std::mutex> guard(lock);
+            deferred = r;
+        });
+        s->registerReadHook(DataType::HoldingRegister, 0, [&postHooks](const UniHookInfo *) {
+            ++postHooks;
+        }, HookTime::Postprocessing);
+    });
+    QVERIFY(slave.startSlave());
+
+    RawClient client(TEST_PORT_DEFERRED);
+    QVERIFY(client.isConnected());
+    QVERIFY(client.write(readRequest(0x2143, 1)));
+    QVERIFY(client.read(1, 100).isEmpty());
+    DeferredReplyPtr r;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        r = deferred;
+    }
+    QVERIFY(r);
+    QCOMPARE(postHooks.load(), 0);
+
+    slave.slave()->setValueToHoldingRegister(0, (uint16_t)0x1234);
+    r->complete();
+    const char expected[] = { 0x21, 0x43, 0, 0, 0, 5, 1, MODBUS_FC_READ_HOLDING_REGISTERS, 2, 0x12, 0x34 };
+    QCOMPARE(client.read(readReplyLength(1), 2000), QByteArray(expected, sizeof(expected)));
+    QTest::qWait(50);
+    QCOMPARE(postHooks.load(), 1);
+#else
+    QSKIP("raw socket client is POSIX only");
+#endif
+}
+
+void libmodbus_cpp::TcpReadWriteTest::parallelReassembly()
+{
+    SlaveThread slave(TEST_PORT_PARALLEL, [](SlaveTcpBackend *, AbstractSlave *s) {
+        for (int i = 0; i < TABLE_SIZE; ++i)
+            s->setValueToHoldingRegister(i, (uint16_t)(0x100 + i));
+    });
+    QVERIFY(slave.startSlave());
+
+    ParallelMasterTcp master(TEST_IP_ADDRESS, TEST_PORT_PARALLEL, 4);
+    master.setMaxChunkRegisters(5);
+    master.setMaxInFlight(2);
+    master.setResponseTimeout(2000);
+    master.connectToSlave();
+    QElapsedTimer timer;
+    timer.start();
+    while ((master.getConnectedCount() < 4) && (timer.elapsed() < 5000))
+        QTest::qWait(5);
+    QCOMPARE(master.getConnectedCount(), 4);
+
+    // 13 chunks over 4 connections land at their offsets, last one is short
+    AsyncReply<QVector<uint16_t>> reply = master.readHoldingRegisters(1, TABLE_SIZE - 1);
+    QVERIFY(waitFor(reply));
+    QVERIFY(!reply.hasError());
+    const QVector<uint16_t> regs = reply.result();
+    QCOMPARE(regs.size(), TABLE_SIZE - 1);
+    for (int i = 0; i < regs.size(); ++i)
+        QCOMPARE(regs.at(i), (uint16_t)(0x101 + i));
+
+    // chunks past end of map are refused by slave, whole read fails once
+    int finished = 0;
+    AsyncReply<QVector<uint16_t>> past = master.readHoldingRegisters(TABLE_SIZE - 12, 24);
+    past.onFinished([&finished](const AsyncReply<QVector<uint16_t>> &) { ++finished; });
+    QVERIFY(waitFor(past));
+    QVERIFY(failedWith<RemoteReadError>(past));
+    QTest::qWait(50);
+    QCOMPARE(finished, 1);
+
+    // connections are still usable
+    AsyncReply<QVector<uint16_t>> again = master.readHoldingRegisters(0, 10);
+    QVERIFY(waitFor(again));
+    QVERIFY(!again.hasError());
+    QCOMPARE(again.result().at(9), (uint16_t)0x109);
+    QCOMPARE(master.getConnectedCount(), 4);
+    master.disconnectFromSlave();
+}
+
+void libmodbus_cpp::TcpReadWriteTest::retryOfSlowReply()
+{
+    // first reply comes after timeout of master, retry is sent at once and its reply is refused behind late one
+    // by transaction id, both are dropped and third attempt gets its own reply
+    std::atomic_int served { 0 };
+    SlaveThread slave(TEST_PORT_RETRY, [&served](SlaveTcpBackend *, AbstractSlave *s) {
+        s->setValueToHoldingRegister(1, (uint16_t)7);
+        s->registerReadHook(DataType::HoldingRegister, 0, [&served](const UniHookInfo *) {
+            if (served++ == 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        });
+    });
+    QVERIFY(slave.startSlave());
+
+    std::unique_ptr<AbstractMaster> master = Factory::createTcpMaster(TEST_IP_ADDRESS, TEST_PORT_RETRY);
+    master->enableAdaptiveTimeout(20, 150);
+    RetryPolicy policy;
+    policy.maxRetries = 2;
+    master->setRetryPolicy(policy);
+    QVERIFY(master->connect());
+    try {
+        QElapsedTimer timer;
+        timer.start();
+        QCOMPARE(master->readHoldingRegister<uint16_t>(0), (uint16_t)1);
+        QVERIFY(timer.elapsed() >= 150);
+        QCOMPARE(served.load(), 3);
+        RttStats stats = master->getRttStats();
+        QCOMPARE(stats.timeouts, (quint64)2);
+        QCOMPARE(stats.retries, (quint64)2);
+        QCOMPARE(stats.samples, (quint64)0); // reply of retry may be of earlier attempt
+
+        // nothing late is left on connection
+        QCOMPARE(master->readHoldingRegister<uint16_t>(1), (uint16_t)7);
+        QCOMPARE(master->readHoldingRegister<uint16_t>(0), (uint16_t)1);
+        stats = master->getRttStats();
+        QCOMPARE(stats.timeouts, (quint64)2);
+        QCOMPARE(stats.retries, (quint64)2);
+        QCOMPARE(stats.samples, (quint64)2);
+    } catch (RemoteRWError &e) {
+        QVERIFY2(false, e.what());
+    }
+    master->disconnect();
+}
+
+void libmodbus_cpp::TcpReadWriteTest::hedgeOfDelayedPrimary()
+{
+#ifdef __linux__
+    // whole 127/8 is loopback on Linux, endpoints differ by host as NICs of one device
+    const char *secondaryAddress = "127.0.0.2";
+    SlaveThread primary(TEST_PORT_HEDGE, [](SlaveTcpBackend *, AbstractSlave *s) {
+        s->registerReadHook(DataType::HoldingRegister, 0, [](const UniHookInfo *) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        });
+    });
+    SlaveThread secondary(secondaryAddress, TEST_PORT_HEDGE, [](SlaveTcpBackend *, AbstractSlave *s) {
+        s->setValueToHoldingRegister(0, (uint16_t)2);
+    });
+    QVERIFY(primary.startSlave());
+    QVERIFY(secondary.startSlave());
+
+    HedgedMasterTcp master(TEST_IP_ADDRESS, secondaryAddress, TEST_PORT_HEDGE);
+    master.setResponseTimeout(2000);
+    master.setHedgeDelay(95, 1, 50);
+    master.connectToSlave();
+    QElapsedTimer timer;
+    timer.start();
+    while ((!master.endpoint(HedgedMasterTcp::Primary)->isConnected() || !master.endpoint(HedgedMasterTcp::Secondary)->isConnected()) &&
+           (timer.elapsed() < 5000))
+        QTest::qWait(5);
+    QVERIFY(master.endpoint(HedgedMasterTcp::Primary)->isConnected());
+    QVERIFY(master.endpoint(HedgedMasterTcp::Secondary)->isConnected());
+
+    // hedged after max delay, as primary has no samples yet, and won by secondary
+    timer.restart();
+    AsyncReply<QVector<uint16_t>> reply = master.readHoldingRegisters(0, 1);
+    QVERIFY(waitFor(reply));
+    QVERIFY(timer.elapsed() < 300);
+    QVERIFY(!reply.hasError());
+    QCOMPARE(reply.result(), QVector<uint16_t>{ 2 });
+    HedgeStats stats = master.getHedgeStats();
+    QCOMPARE(stats.hedged, (quint64)1);
+    QCOMPARE(stats.wonByHedge, (quint64)1);
+
+    // late reply of primary is dropped, its latency is sampled
+    timer.restart();
+    while ((master.getLatency(HedgedMasterTcp::Primary).count() == 0) && (timer.elapsed() < 2000))
+        QTest::qWait(5);
+    QCOMPARE(master.getLatency(HedgedMasterTcp::Primary).count(), 1);
+    QCOMPARE(reply.result(), QVector<uint16_t>{ 2 });
+
+    // exception reply of primary fails read, it is not hedged
+    AsyncReply<QVector<uint16_t>> refused = master.readHoldingRegisters(TABLE_SIZE, 1);
+    QVERIFY(waitFor(refused));
+    QVERIFY(failedWith<RemoteReadError>(refused));
+    QTest::qWait(100);
+    stats = master.getHedgeStats();
+    QCOMPARE(stats.hedged, (quint64)1);
+    QCOMPARE(stats.failed, (quint64)1);
+    master.disconnectFromSlave();
+#else
+    QSKIP("second loopback address is Linux only");
+#endif
+}
+
+void libmodbus_cpp::TcpReadWriteTest::managedConnections()
+{
+#ifndef _WIN32
+    PumpedServer server;
+    QVERIFY(server.listen(TEST_PORT_MANAGED));
+    TcpConnectionOptions options;
+    options.minBackoff_ms = 200;
+    options.maxBackoff_ms = 400;
+    ManagerThread managerThread;
+    TcpConnectionManager *manager = managerThread.startManager(options);
+
+    std::vector<std::unique_ptr<AbstractMaster>> masters;
+    for (int i = 0; i < 3; ++i)
+        masters.push_back(Factory::createTcpMaster(TEST_IP_ADDRESS, TEST_PORT_MANAGED, *manager));
+    AbstractMaster *master = masters.front().get();
+    uint16_t value = 0;
+    const auto read = [master, &value]() {
+        value = master->readHoldingRegister<uint16_t>(0);
+    };
+
+    // connected lazily until start() from other thread, then all at once
+    QVERIFY(!pumpUntil(server, [&server]() { return server.accepted() > 0; }, 200));
+    manager->start();
+    QVERIFY(pumpUntil(server, [&server]() { return server.accepted() == 3; }, 1000));
+
+    // connected socket is handed to context of master
+    try {
+        runBlocking(server, read);
+    } catch (RemoteRWError &e) {
+        QVERIFY2(false, e.what());
+    }
+    QCOMPARE(value, (uint16_t)1);
+
+    // reset is reported by master, device has answered, so it is reconnected at once
+    server.dropAll();
+    QElapsedTimer timer;
+    timer.start();
+    int error = 0;
+    try {
+        runBlocking(server, read);
+    } catch (RemoteReadError &e) {
+        error = e.error();
+    }
+    QVERIFY((error == ECONNRESET) || (error == EPIPE));
+    QVERIFY(pumpUntil(server, [&server]() { return server.accepted() == 4; }, 1000));
+    QVERIFY(timer.elapsed() < options.minBackoff_ms);
+    QVERIFY(!throwsOf<RemoteRWError>(server, read));
+
+    // requests fail fast while device is down
+    server.close();
+    server.dropAll();
+    QVERIFY(throwsOf<RemoteReadError>(server, read));
+    QTest::qWait(50);
+    timer.restart();
+    QVERIFY(throwsOf<ConnectionError>(server, read));
+    QVERIFY(timer.elapsed() < options.connectTimeout_ms / 4);
+
+    // connections dropped before any answer back off as failed connects
+    server.setDropOnAccept(true);
+    QVERIFY(server.listen(TEST_PORT_MANAGED));
+    const int dropped = server.accepted();
+    timer.restart();
+    while (timer.elapsed() < 1200) {
+        try {
+            runBlocking(server, read);
+        } catch (RemoteRWError &) {
+        }
+        QTest::qWait(10);
+    }
+    QVERIFY(server.accepted() > dropped);
+    QVERIFY(server.accepted() - dropped <= 5);
+
+    // first answer resets backoff
+    server.setDropOnAccept(false);
+    QVERIFY(pumpUntil(server, [&server, &read]() { return !throwsOf<RemoteRWError>(server, read); }, 2000));
+    const int answered = server.accepted();
+    server.dropAll();
+    timer.restart();
+    QVERIFY(throwsOf<RemoteReadError>(server, read));
+    QVERIFY(pumpUntil(server, [&server, answered]() { return server.accepted() > answered; }, 1000));
+    QVERIFY(timer.elapsed() < options.minBackoff_ms);
+    QVERIFY(!throwsOf<RemoteRWError>(server, read));
+
+    // parked master is not reconnected, connect() waits for new connection
+    master->disconnect();
+    const int parked = server.accepted();
+    QVERIFY(throwsOf<ConnectionError>(server, read));
+    QVERIFY(!pumpUntil(server, [&server, parked]() { return server.accepted() > parked; }, 300));
+    runBlocking(server, [master]() { master->connect(); });
+    QVERIFY(!throwsOf<RemoteRWError>(server, read));
+    QCOMPARE(server.accepted(), parked + 1);
+#else
+    QSKIP("managed connections are POSIX only");
+#endif
+}
+
+void libmodbus_cpp::TcpReadWriteTest::truncatedWrite()
+{
+#ifndef _WIN32
+    // compact server cuts frames by MBAP length, FC16 ending before its data must not write map
+    SlaveThread slave(TEST_PORT_TRUNCATED, [](SlaveTcpBackend *b, AbstractSlave *) {
+        b->setConnectionMode(TcpConnectionMode::Compact);
+    });
+    QVERIFY(slave.startSlave());
+
+    RawClient c(TEST_PORT_TRUNCATED);
+    QVERIFY(c.isConnected());
+    const char truncated[] = { 0, 1, 0, 0, 0, 7, 1, MODBUS_FC_WRITE_MULTIPLE_REGISTERS, 0, 0, 0, 2, 4 };
+    // bytes after truncated frame are next request, not data of write
+    QVERIFY(c.write(QByteArray(truncated, sizeof(truncated)) + readRequest(2, libmodbus_cpp::TABLE_SIZE)));
+    const char refused[] = { 0, 1, 0, 0, 0, 3, 1, char(MODBUS_FC_WRITE_MULTIPLE_REGISTERS | 0x80), MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE };
+    QCOMPARE(c.read(sizeof(refused), 1000), QByteArray(refused, sizeof(refused)));
+    QVERIFY(isReadReply(c.read(readReplyLength(libmodbus_cpp::TABLE_SIZE), 1000), 2, libmodbus_cpp::TABLE_SIZE));
+#else
+    QSKIP("raw socket client is POSIX only");
+#endif
+}
+
+void libmodbus_cpp::TcpReadWriteTest::shardLimitsWhileListening()
+{
+#if defined(__linux__) && defined(USE_QT5)
+    std::atomic_bool applied { false };
+    SlaveThread slave(TEST_PORT_SHARD_LIMITS, [&applied](SlaveTcpBackend *b, AbstractSlave *) {
+        b->setShardCount(2);
+        // shards listen already when event loop of slave runs
+        QTimer::singleShot(0, b, [b, &applied]() {
+            TcpConnectionLimits limits;
+            limits.maxRequestRate = 20;
+            b->setConnectionLimits(limits);
+            applied = true;
+        });
+    });
+    QVERIFY(slave.startSlave());
+    while (!applied)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    checkRateLimit(TEST_PORT_SHARD_LIMITS, 20);
+#else
+    QSKIP("listener shards are Linux only");
+#endif
+}
+
+void libmodbus_cpp::TcpReadWriteTest::asyncRepliesOfOneRead()
+{
+#ifndef _WIN32
+    PumpedServer server;
+    QVERIFY(server.listen(TEST_PORT_ASYNC_REPLIES));
+    AsyncMasterTcp *master = new AsyncMasterTcp(TEST_IP_ADDRESS, TEST_PORT_ASYNC_REPLIES);
+    master->setMaxInFlight(2);
+    master->connectToSlave();
+
+    // reply of other unit fails request
+    server.setReplyUnit(7);
+    AsyncReply<QVector<uint16_t>> other = master->readHoldingRegisters(0, 1);
+    QVERIFY(pumpUntil(server, [&other]() { return other.isFinished(); }, 5000));
+    QVERIFY(failedWith<RemoteReadError>(other));
+    server.setReplyUnit(-1);
+
+    // continuation deletes master while replies are parsed, next one is finished anyway
+    AsyncReply<QVector<uint16_t>> first = master->readHoldingRegisters(0, 1);
+    AsyncReply<QVector<uint16_t>> second = master->readHoldingRegisters(0, 2);
+    first.onFinished([&master](const AsyncReply<QVector<uint16_t>> &) {
+        delete master;
+        master = nullptr;
+    });
+    QVERIFY(pumpUntil(server, [&second]() { return second.isFinished(); }, 5000));
+    QVERIFY(first.isFinished() && !first.hasError());
+    QVERIFY(master == nullptr);
+#else
+    QSKIP("pumped server is POSIX only");
+#endif
+}
@@ -2,16 +2,47 @@
 #define LIBMODBUS_CPP_TCPREADWRITETEST_H
 
 #include <QRunnable>
+#include <QThread>
 #include <atomic>
+#include <functional>
+#include <thread>
 #include "abstract_read_write_test.h"
 #include <libmodbus_cpp/factory.h>
 #include <libmodbus_cpp/slave_tcp.h>
+#include <libmodbus_cpp/tcp_connection_manager.h>
 
 namespace libmodbus_cpp {
 
 namespace {
 const char *TEST_IP_ADDRESS = "127.0.0.1";
 const int TEST_PORT = 1503;
+// slaves of SlaveThread, one per test
+const int TEST_PORT_SEQLOCK = 1504;
+const int TEST_PORT_CHANGES = 1505;
+// nothing listens
+const int TEST_PORT_CLOSED = 1506;
+// accepts and never replies
+const int TEST_PORT_SILENT = 1507;
+const int TEST_PORT_COMPACT_FRAMING = 1508;
+const int TEST_PORT_COMPACT_BACKPRESSURE = 1509;
+const int TEST_PORT_SOCKET_BACKPRESSURE = 1510;
+// socket and compact mode ones
+const int TEST_PORT_LIMITS = 1511;
+const int TEST_PORT_IDLE = 1513;
+const int TEST_PORT_UNSENT = 1515;
+const int TEST_PORT_SHARDS = 1517;
+const int TEST_PORT_URING = 1518;
+const int TEST_PORT_URING_FALLBACK = 1519;
+const int TEST_PORT_CACHE = 1520;
+const int TEST_PORT_DEFERRED = 1521;
+const int TEST_PORT_PARALLEL = 1522;
+const int TEST_PORT_RETRY = 1523;
+// slaves on two loopback addresses
+const int TEST_PORT_HEDGE = 1524;
+const int TEST_PORT_MANAGED = 1525;
+const int TEST_PORT_TRUNCATED = 1526;
+const int TEST_PORT_SHARD_LIMITS = 1527;
+const int TEST_PORT_ASYNC_REPLIES = 1528;
 }
 
 class TcpServerStarter : public QObject, public QRunnable {
@@ -47,6 +78,103 @@ public slots:
     }
 };
 
+/// slave on own port with event loop of own thread, for tests needing special configuration
+class SlaveThread : public QThread {
+    Q_OBJECT
+
+public:
+    using Setup = std::function<void(SlaveTcpBackend *backend, AbstractSlave *slave)>;
+
+    explicit SlaveThread(int port, Setup setup = Setup())
+        : SlaveThread(TEST_IP_ADDRESS, port, setup) {
+    }
+    SlaveThread(const char *address, int port, Setup setup = Setup())
+        : m_address(address), m_port(port), m_setup(setup) {
+    }
+    ~SlaveThread() override {
+        quit();
+        wait();
+    }
+
+    /// true when slave listens
+    bool startSlave() {
+        start();
+        while (!m_ready)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return m_listening;
+    }
+    AbstractSlave *slave() const {
+        return m_slave;
+    }
+    SlaveTcpBackend *backend() const {
+        return m_backend;
+    }
+
+protected:
+    void run() override {
+        SlaveTcpBackend *b = new SlaveTcpBackend;
+        b->init(m_address, m_port);
+        QScopedPointer<AbstractSlave> s(new SlaveTcp(b));
+        s->initMap(TABLE_SIZE, TABLE_SIZE, TABLE_SIZE, TABLE_SIZE);
+        for (int i = 0; i < TABLE_SIZE; ++i) {
+            s->setValueToHoldingRegister(i, (uint16_t)1);
+            s->setValueToInputRegister(i, (uint16_t)1);
+        }
+        if (m_setup)
+            m_setup(b, s.data());
+        m_backend = b;
+        m_slave = s.data();
+        m_listening = s->startListen();
+        m_ready = true;
+        if (m_listening)
+            exec();
+        s->stopListen();
+        m_slave = nullptr;
+        m_backend = nullptr;
+    }
+
+private:
+    const char *m_address;
+    const int m_port;
+    Setup m_setup;
+    std::atomic<AbstractSlave*> m_slave { nullptr };
+    std::atomic<SlaveTcpBackend*> m_backend { nullptr };
+    std::atomic_bool m_listening { false };
+    std::atomic_bool m_ready { false };
+};
+
+/// connection manager with event loop of own thread, masters may block test thread on it
+class ManagerThread : public QThread {
+    Q_OBJECT
+
+public:
+    ~ManagerThread() override {
+        quit();
+        wait();
+    }
+
+    TcpConnectionManager *startManager(const TcpConnectionOptions &options) {
+        m_options = options;
+        start();
+        while (!m_manager)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return m_manager;
+    }
+
+protected:
+    void run() override {
+        TcpConnectionManager manager;
+        manager.setOptions(m_options);
+        m_manager = &manager;
+        exec();
+        m_manager = nullptr;
+    }
+
+private:
+    TcpConnectionOptions m_options;
+    std::atomic<TcpConnectionManager*> m_manager { nullptr };
+};
+
 class TcpReadWriteTest : public AbstractReadWriteTest
 {
     Q_OBJECT
@@ -55,6 +183,27 @@ class TcpReadWriteTest : public AbstractReadWriteTest
 private slots:
     void initTestCase() override;
     void cleanupTestCase() override;
+    void seqLockedMapThroughMaster();
+    void changesOfRejectedWrite();
+    void asyncRefusedConnect();
+    void asyncReplyTimeout();
+    void compactFraming();
+    void compactBackpressure();
+    void socketBackpressure();
+    void connectionLimits();
+    void connectionReaping();
+    void shardsShareOnePort();
+    void uringRoundTrip();
+    void uringFallback();
+    void cachedReadAfterWrite();
+    void deferredReply();
+    void parallelReassembly();
+    void retryOfSlowReply();
+    void hedgeOfDelayedPrimary();
+    void managedConnections();
+    void truncatedWrite();
+    void shardLimitsWhileListening();
+    void asyncRepliesOfOneRead();
 
 signals:
     void sig_finished();
@@ -0,0 +1,14 @@
+QT -= gui
+
+TEMPLATE = app
+
+CONFIG += c++11 console
+
+include(../../libmodbus_cpp.prf)
+
+DESTDIR = $${LIBMODBUS_CPP_DESTDIR}
+TARGET  = $${LIBMODBUS_CPP_TARGET}_load_generator
+CONFIG += $${LIBMODBUS_CPP_CONFIG}
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,441 @@
+/**
+ * Modbus TCP load generator.
+ *
+ *   modbus_load_generator [--host H] [--port P] [--unit U]
+ *                         [--connections N] [--in-flight M] [--rate R]
+ *                         [--duration S] [--warmup S] [--timeout MS]
+ *                         [--mix fc3:10:60,fc16:10:20,fc1:100:20]
+ *                         [--address A] [--range R] [--seed X]
+ *
+ * --rate is total requests per second over all connections. With rate each
+ * request has intended send time on fixed schedule (open loop) and latency is
+ * measured from that time, so stalls of slave are not hidden by the generator
+ * waiting for them (no coordinated omission). Without rate every connection
+ * keeps in-flight requests outstanding (closed loop, saturation throughput).
+ *
+ * --mix is list of function:count:weight, functions are fc1-fc6, fc15, fc16, fc23.
+ */
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <libmodbus_cpp/async_master_tcp.h>
+
+using namespace libmodbus_cpp;
+
+namespace {
+
+struct Options {
+    QString host = "127.0.0.1";
+    quint16 port = MODBUS_TCP_DEFAULT_PORT;
+    uint8_t unit = MODBUS_TCP_SLAVE;
+    int connections = 1;
+    int inFlight = 1;
+    double rate = 0;
+    double duration_s = 10;
+    double warmup_s = 1;
+    int timeout_ms = 1000;
+    QString mix = "fc3:10:1";
+    int address = 0;
+    int range = 0;
+    unsigned seed = 1;
+};
+
+struct MixEntry {
+    int function;
+    int count;
+    int weight;
+};
+
+
+/// log-linear latency histogram in microseconds, about 1.5% precision
+class Histogram
+{
+    static const int SubBuckets = 64;
+    QVector<quint64> m_buckets;
+    quint64 m_count = 0;
+    qint64 m_max = 0;
+
+public:
+    Histogram() : m_buckets(2 * SubBuckets + 48 * SubBuckets, 0) {}
+
+    void add(qint64 us) {
+        us = std::max<qint64>(us, 0);
+        ++m_buckets[index(us)];
+        ++m_count;
+        m_max = std::max(m_max, us);
+    }
+
+    quint64 count() const {
+        return m_count;
+    }
+
+    qint64 max() const {
+        return m_max;
+    }
+
+    qint64 percentile(double p) const {
+        const quint64 rank = static_cast<quint64>(std::ceil(p / 100 * m_count));
+        quint64 seen = 0;
+        for (int i = 0; i < m_buckets.size(); ++i) {
+            seen += m_buckets[i];
+            if (seen >= std::max<quint64>(rank, 1)) {
+                return std::min(upperValue(i), m_max);
+            }
+        }
+        return m_max;
+    }
+
+private:
+    static int index(qint64 v) {
+        if (v < 2 * SubBuckets) {
+            return static_cast<int>(v);
+        }
+        int shift = 0;
+        while ((v >> shift) >= 2 * SubBuckets) {
+            ++shift;
+        }
+        return 2 * SubBuckets + (shift - 1) * SubBuckets + static_cast<int>((v >> shift) - SubBuckets);
+    }
+
+    static qint64 upperValue(int i) {
+        if (i < 2 * SubBuckets) {
+            return i;
+        }
+        const int shift = (i - 2 * SubBuckets) / SubBuckets + 1;
+        const qint64 sub = (i - 2 * SubBuckets) % SubBuckets + SubBuckets;
+        return ((sub + 1) << shift) - 1;
+    }
+};
+
+
+struct Stats {
+    Histogram latency;
+    quint64 sent = 0;
+    quint64 completed = 0;
+    quint64 errors = 0;
+    QVector<quint64> perFunction = QVector<quint64>(256, 0);
+};
+
+
+class LoadGenerator : public QObject
+{
+    Options m_options;
+    QVector<MixEntry> m_mix;
+    int m_totalWeight = 0;
+    std::vector<std::unique_ptr<AsyncMasterTcp>> m_masters;
+    QVector<qint64> m_nextIntended_ns; // per connection, open loop only
+    std::mt19937 m_random;
+    QElapsedTimer m_clock;
+    QTimer m_ticker;
+    qint64 m_start_ns = 0;
+    qint64 m_measureFrom_ns = 0;
+    qint64 m_stop_ns = 0;
+    qint64 m_measuredUntil_ns = 0;
+    bool m_stopping = false;
+    quint64 m_outstanding = 0;
+    Stats m_stats;
+
+public:
+    LoadGenerator(const Options &options, const QVector<MixEntry> &mix)
+        : m_options(options)
+        , m_mix(mix)
+        , m_random(options.seed)
+    {
+        for (const MixEntry &e : m_mix) {
+            m_totalWeight += e.weight;
+        }
+        m_ticker.setTimerType(Qt::PreciseTimer);
+        m_ticker.setInterval(1);
+        QObject::connect(&m_ticker, &QTimer::timeout, [this]() { tick(); });
+    }
+
+    void start() {
+        for (int i = 0; i < m_options.connections; ++i) {
+            std::unique_ptr<AsyncMasterTcp> m(new AsyncMasterTcp(m_options.host, m_options.port));
+            m->setSlaveAddress(m_options.unit);
+            m->setMaxInFlight(m_options.inFlight);
+            m->setResponseTimeout(m_options.timeout_ms);
+            m->connectToSlave();
+            m_masters.push_back(std::move(m));
+        }
+        m_clock.start();
+        waitForConnections();
+    }
+
+private:
+    void waitForConnections() {
+        const bool allConnected = std::all_of(m_masters.begin(), m_masters.end(),
+                                              [](const std::unique_ptr<AsyncMasterTcp> &m) { return m->isConnected(); });
+        if (!allConnected) {
+            if (m_clock.elapsed() > 5000) {
+                fprintf(stderr, "can't connect to %s:%d\n", qPrintable(m_options.host), m_options.port);
+                QCoreApplication::exit(1);
+                return;
+            }
+            QTimer::singleShot(10, [this]() { waitForConnections(); });
+            return;
+        }
+
+        printf("%d connection(s) to %s:%d, %s, in flight %d\n", m_options.connections, qPrintable(m_options.host), m_options.port,
+               m_options.rate > 0 ? qPrintable(QString("open loop %1 req/s").arg(m_options.rate)) : "closed loop",
+               m_options.inFlight);
+        fflush(stdout);
+
+        m_start_ns = m_clock.nsecsElapsed();
+        m_measureFrom_ns = m_start_ns + static_cast<qint64>(m_options.warmup_s * 1e9);
+        m_stop_ns = m_measureFrom_ns + static_cast<qint64>(m_options.duration_s * 1e9);
+
+        if (m_options.rate > 0) {
+            m_nextIntended_ns.fill(m_start_ns, m_options.connections);
+            // spread connections over one period
+            const double period_ns = 1e9 * m_options.connections / m_options.rate;
+            for (int i = 0; i < m_options.connections; ++i) {
+                m_nextIntended_ns[i] += static_cast<qint64>(period_ns * i / m_options.connections);
+            }
+        } else {
+            for (size_t i = 0; i < m_masters.size(); ++i) {
+                for (int j = 0; j < m_options.inFlight; ++j) {
+                    issue(static_cast<int>(i), m_clock.nsecsElapsed());
+                }
+            }
+        }
+        m_ticker.start();
+    }
+
+    void tick() {
+        const qint64 now = m_clock.nsecsElapsed();
+        if (now >= m_stop_ns) {
+            finish();
+            return;
+        }
+        if (m_options.rate <= 0) {
+            return;
+        }
+        const qint64 period_ns = static_cast<qint64>(1e9 * m_options.connections / m_options.rate);
+        for (int i = 0; i < m_options.connections; ++i) {
+            while (m_nextIntended_ns[i] <= now) {
+                issue(i, m_nextIntended_ns[i]);
+                m_nextIntended_ns[i] += period_ns;
+            }
+        }
+    }
+
+    const MixEntry &pick() {
+        int w = std::uniform_int_distribution<int>(0, m_totalWeight - 1)(m_random);
+        for (const MixEntry &e : m_mix) {
+            if (w < e.weight) {
+                return e;
+            }
+            w -= e.weight;
+        }
+        return m_mix.last();
+    }
+
+    void issue(int connection, qint64 intended_ns) {
+        const MixEntry &e = pick();
+        const Address address = static_cast<Address>(m_options.address +
+                (m_options.range > 0 ? std::uniform_int_distribution<int>(0, m_options.range - 1)(m_random) : 0));
+        AsyncMasterTcp *m = m_masters[connection].get();
+
+        ++m_stats.sent;
+        ++m_outstanding;
+        const int function = e.function;
+        auto done = [this, connection, intended_ns, function](bool isError) {
+            --m_outstanding;
+            const qint64 now = m_clock.nsecsElapsed();
+            if ((intended_ns >= m_measureFrom_ns) && (intended_ns < m_stop_ns)) {
+                if (isError) {
+                    ++m_stats.errors;
+                } else {
+                    ++m_stats.completed;
+                    ++m_stats.perFunction[function];
+                    m_stats.latency.add((now - intended_ns) / 1000);
+                }
+                m_measuredUntil_ns = std::max(m_measuredUntil_ns, now);
+            }
+            if (m_stopping) {
+                if (m_outstanding == 0) {
+                    report();
+                }
+            } else if (m_options.rate <= 0) {
+                issue(connection, now);
+            }
+        };
+
+        switch (e.function) {
+            case MODBUS_FC_READ_COILS:
+                m->readCoils(address, e.count).onFinished([done](const AsyncReply<QVector<bool>> &r) { done(r.hasError()); });
+                break;
+            case MODBUS_FC_READ_DISCRETE_INPUTS:
+                m->readDiscreteInputs(address, e.count).onFinished([done](const AsyncReply<QVector<bool>> &r) { done(r.hasError()); });
+                break;
+            case MODBUS_FC_READ_HOLDING_REGISTERS:
+                m->readHoldingRegisters(address, e.count).onFinished([done](const AsyncReply<QVector<uint16_t>> &r) { done(r.hasError()); });
+                break;
+            case MODBUS_FC_READ_INPUT_REGISTERS:
+                m->readInputRegisters(address, e.count).onFinished([done](const AsyncReply<QVector<uint16_t>> &r) { done(r.hasError()); });
+                break;
+            case MODBUS_FC_WRITE_SINGLE_COIL:
+                m->writeCoil(address, (m_stats.sent & 1) != 0).onFinished([done](const AsyncReply<void> &r) { done(r.hasError()); });
+                break;
+            case MODBUS_FC_WRITE_SINGLE_REGISTER: {
+                QByteArray pdu;
+                pdu.append(char(MODBUS_FC_WRITE_SINGLE_REGISTER));
+                pdu.append(char(address >> 8));
+                pdu.append(char(address & 0xFF));
+                pdu.append(char(m_stats.sent >> 8));
+                pdu.append(char(m_stats.sent & 0xFF));
+                m->request(m_options.unit, pdu,
+                           [done](const uint8_t *rsp, int) { done((rsp[0] & 0x80) != 0); },
+                           [done](std::exception_ptr) { done(true); });
+                break;
+            }
+            case MODBUS_FC_WRITE_MULTIPLE_COILS:
+                m->writeCoils(address, QVector<bool>(e.count, true)).onFinished([done](const AsyncReply<void> &r) { done(r.hasError()); });
+                break;
+            case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+                m->writeHoldingRegisters(address, QVector<uint16_t>(e.count, static_cast<uint16_t>(m_stats.sent)))
+                        .onFinished([done](const AsyncReply<void> &r) { done(r.hasError()); });
+                break;
+            case MODBUS_FC_WRITE_AND_READ_REGISTERS:
+                m->writeAndReadHoldingRegisters(address, QVector<uint16_t>(e.count, 1), address, e.count)
+                        .onFinished([done](const AsyncReply<QVector<uint16_t>> &r) { done(r.hasError()); });
+                break;
+        }
+    }
+
+    void finish() {
+        m_ticker.stop();
+        m_stopping = true;
+        if (m_outstanding == 0) {
+            report();
+        }
+        // otherwise report after last reply or timeout
+    }
+
+    void report() {
+        const double seconds = std::max<qint64>(m_measuredUntil_ns - m_measureFrom_ns, 1) / 1e9;
+        const Histogram &h = m_stats.latency;
+        printf("\nrequests: %llu completed, %llu errors in %.2f s\n",
+               (unsigned long long)m_stats.completed, (unsigned long long)m_stats.errors, seconds);
+        printf("throughput: %.1f req/s\n", m_stats.completed / seconds);
+        for (int fc = 0; fc < m_stats.perFunction.size(); ++fc) {
+            if (m_stats.perFunction[fc]) {
+                printf("  fc%-3d %llu\n", fc, (unsigned long long)m_stats.perFunction[fc]);
+            }
+        }
+        if (h.count()) {
+            printf("latency us: p50 %lld  p90 %lld  p99 %lld  p99.9 %lld  max %lld\n",
+                   (long long)h.percentile(50), (long long)h.percentile(90), (long long)h.percentile(99),
+                   (long long)h.percentile(99.9), (long long)h.max());
+        }
+        fflush(stdout);
+        QCoreApplication::exit(m_stats.errors ? 1 : 0);
+    }
+};
+
+
+bool parseMix(const QString &text, QVector<MixEntry> &mix) {
+#if QT_VERSION >= QT_VERSION_CHECK(5,14,0)
+    const QStringList items = text.split(',', Qt::SkipEmptyParts);
+#else
+    const QStringList items = text.split(',', QString::SkipEmptyParts);
+#endif
+    for (const QString &item : items) {
+        const QStringList parts = item.trimmed().split(':');
+        if ((parts.size() < 2) || !parts[0].startsWith("fc")) {
+            return false;
+        }
+        MixEntry e;
+        e.function = parts[0].mid(2).toInt();
+        e.count = parts[1].toInt();
+        e.weight = (parts.size() > 2) ? parts[2].toInt() : 1;
+        switch (e.function) {
+            case MODBUS_FC_READ_COILS:
+            case MODBUS_FC_READ_DISCRETE_INPUTS:
+            case MODBUS_FC_READ_HOLDING_REGISTERS:
+            case MODBUS_FC_READ_INPUT_REGISTERS:
+            case MODBUS_FC_WRITE_SINGLE_COIL:
+            case MODBUS_FC_WRITE_SINGLE_REGISTER:
+            case MODBUS_FC_WRITE_MULTIPLE_COILS:
+            case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+            case MODBUS_FC_WRITE_AND_READ_REGISTERS:
+                break;
+            default:
+                return false;
+        }
+        if ((e.count < 1) || (e.weight < 1)) {
+            return false;
+        }
+        mix.append(e);
+    }
+    return !mix.isEmpty();
+}
+
+bool parseOptions(const QStringList &args, Options &o) {
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args[i];
+        if (i + 1 >= args.size()) {
+            return false;
+        }
+        const QString value = args[++i];
+        if (arg == "--host") {
+            o.host = value;
+        } else if (arg == "--port") {
+            o.port = value.toUShort();
+        } else if (arg == "--unit") {
+            o.unit = static_cast<uint8_t>(value.toUInt());
+        } else if (arg == "--connections") {
+            o.connections = std::max(1, value.toInt());
+        } else if (arg == "--in-flight") {
+            o.inFlight = std::max(1, value.toInt());
+        } else if (arg == "--rate") {
+            o.rate = value.toDouble();
+        } else if (arg == "--duration") {
+            o.duration_s = value.toDouble();
+        } else if (arg == "--warmup") {
+            o.warmup_s = value.toDouble();
+        } else if (arg == "--timeout") {
+            o.timeout_ms = value.toInt();
+        } else if (arg == "--mix") {
+            o.mix = value;
+        } else if (arg == "--address") {
+            o.address = value.toInt();
+        } else if (arg == "--range") {
+            o.range = value.toInt();
+        } else if (arg == "--seed") {
+            o.seed = value.toUInt();
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    Options options;
+    QVector<MixEntry> mix;
+    if (!parseOptions(app.arguments(), options) || !parseMix(options.mix, mix)) {
+        fprintf(stderr, "usage: %s [--host H] [--port P] [--unit U] [--connections N] [--in-flight M] [--rate R]\n"
+                        "       [--duration S] [--warmup S] [--timeout MS] [--mix fc3:10:60,fc16:10:20]\n"
+                        "       [--address A] [--range R] [--seed X]\n", argv[0]);
+        return 2;
+    }
+
+    LoadGenerator generator(options, mix);
+    generator.start();
+    return app.exec();
+}